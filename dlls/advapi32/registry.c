@@ -2360,6 +2360,49 @@ LSTATUS WINAPI RegLoadKeyA( HKEY hkey, LPCSTR subkey, LPCSTR filename )
  *  Failure: nonzero error code from Winerror.h
  */
 LSTATUS WINAPI RegSaveKeyW( HKEY hkey, LPCWSTR file, LPSECURITY_ATTRIBUTES sa )
+{
+    return RegSaveKeyExW( hkey, file, sa, REG_STANDARD_FORMAT );
+}
+
+
+/******************************************************************************
+ * RegSaveKeyA  [ADVAPI32.@]
+ *
+ * See RegSaveKeyW.
+ */
+LSTATUS WINAPI RegSaveKeyA( HKEY hkey, LPCSTR file, LPSECURITY_ATTRIBUTES sa )
+{
+    UNICODE_STRING *fileW = &NtCurrentTeb()->StaticUnicodeString;
+    NTSTATUS status;
+    STRING fileA;
+
+    RtlInitAnsiString(&fileA, file);
+    if ((status = RtlAnsiStringToUnicodeString(fileW, &fileA, FALSE)))
+        return RtlNtStatusToDosError( status );
+    return RegSaveKeyW(hkey, fileW->Buffer, sa);
+}
+
+/******************************************************************************
+ * RegSaveKeyExA  [ADVAPI32.@]
+ *
+ */
+LSTATUS WINAPI RegSaveKeyExA( HKEY hkey, LPCSTR file, SECURITY_ATTRIBUTES *sa, DWORD flags )
+{
+    UNICODE_STRING *fileW = &NtCurrentTeb()->StaticUnicodeString;
+    NTSTATUS status;
+    STRING fileA;
+
+    RtlInitAnsiString(&fileA, file);
+    if ((status = RtlAnsiStringToUnicodeString(fileW, &fileA, FALSE)))
+        return RtlNtStatusToDosError( status );
+    return RegSaveKeyExW(hkey, fileW->Buffer, sa, flags);
+}
+
+/******************************************************************************
+ * RegSaveKeyExW  [ADVAPI32.@]
+ *
+ */
+LSTATUS WINAPI RegSaveKeyExW( HKEY hkey, LPCWSTR file, SECURITY_ATTRIBUTES *sa, DWORD flags )
 {
     static const WCHAR format[] =
         {'r','e','g','%','0','4','x','.','t','m','p',0};
@@ -2369,7 +2412,7 @@ LSTATUS WINAPI RegSaveKeyW( HKEY hkey, LPCWSTR file, LPSECURITY_ATTRIBUTES sa )
     DWORD ret, err;
     HANDLE handle;
 
-    TRACE( "(%p,%s,%p)\n", hkey, debugstr_w(file), sa );
+    TRACE( "(%p,%s,%p,%x)\n", hkey, debugstr_w(file), sa, flags );
 
     if (!file || !*file) return ERROR_INVALID_PARAMETER;
     if (!(hkey = get_special_root_hkey( hkey, 0 ))) return ERROR_INVALID_HANDLE;
@@ -2390,7 +2433,7 @@ LSTATUS WINAPI RegSaveKeyW( HKEY hkey, LPCWSTR file, LPSECURITY_ATTRIBUTES sa )
             MESSAGE("Wow, we are already fiddling with a temp file %s with an ordinal as high as %d !\nYou might want to delete all corresponding temp files in that directory.\n", debugstr_w(buffer), count);
     }
 
-    ret = RtlNtStatusToDosError(NtSaveKey(hkey, handle));
+    ret = RtlNtStatusToDosError(NtSaveKeyEx(hkey, handle, flags));
 
     CloseHandle( handle );
     if (!ret)
@@ -2409,44 +2452,6 @@ done:
     return ret;
 }
 
-
-/******************************************************************************
- * RegSaveKeyA  [ADVAPI32.@]
- *
- * See RegSaveKeyW.
- */
-LSTATUS WINAPI RegSaveKeyA( HKEY hkey, LPCSTR file, LPSECURITY_ATTRIBUTES sa )
-{
-    UNICODE_STRING *fileW = &NtCurrentTeb()->StaticUnicodeString;
-    NTSTATUS status;
-    STRING fileA;
-
-    RtlInitAnsiString(&fileA, file);
-    if ((status = RtlAnsiStringToUnicodeString(fileW, &fileA, FALSE)))
-        return RtlNtStatusToDosError( status );
-    return RegSaveKeyW(hkey, fileW->Buffer, sa);
-}
-
-/******************************************************************************
- * RegSaveKeyExA  [ADVAPI32.@]
- *
- */
-LSTATUS WINAPI RegSaveKeyExA( HKEY hkey, LPCSTR file, SECURITY_ATTRIBUTES *sa, DWORD flags )
-{
-    FIXME( "(%p,%s,%p,%d) flags not handled\n", hkey, debugstr_a(file), sa, flags );
-    return RegSaveKeyA(hkey, file, sa);
-}
-
-/******************************************************************************
- * RegSaveKeyExW  [ADVAPI32.@]
- *
- */
-LSTATUS WINAPI RegSaveKeyExW( HKEY hkey, LPCWSTR file, SECURITY_ATTRIBUTES *sa, DWORD flags )
-{
-    FIXME( "(%p,%s,%p,%d) flags not handled\n", hkey, debugstr_w(file), sa, flags );
-    return RegSaveKeyW(hkey, file, sa);
-}
-
 /******************************************************************************
  * RegRestoreKeyW [ADVAPI32.@]
  *
@@ -1609,6 +1609,274 @@ static void test_reg_unload_key(void)
     DeleteFileA("saved_key.LOG");
 }
 
+static void test_reg_save_load_formats(void)
+{
+    static const DWORD formats[] = { REG_STANDARD_FORMAT, REG_LATEST_FORMAT };
+    static const DWORD count = 2000;
+    char name[32], data[64];
+    DWORD ret, i, j, start, subkeys, size, type, dw;
+    HKEY hkey, subkey;
+
+    ret = RegCreateKeyA(hkey_main, "SaveFormats", &hkey);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "key%u", i);
+        RegCreateKeyA(hkey, name, &subkey);
+        RegSetValueExA(subkey, "dword", 0, REG_DWORD, (const BYTE *)&i, sizeof(i));
+        sprintf(data, "string value number %u", i);
+        RegSetValueExA(subkey, "string", 0, REG_SZ, (const BYTE *)data, strlen(data) + 1);
+        RegSetValueExA(subkey, "binary", 0, REG_BINARY, (const BYTE *)data, sizeof(data));
+        RegCloseKey(subkey);
+    }
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        DeleteFileA("saved_formats");
+
+        if (!set_privileges(SE_BACKUP_NAME, TRUE))
+        {
+            win_skip("Failed to set SE_BACKUP_NAME privileges, skipping tests\n");
+            break;
+        }
+        start = GetTickCount();
+        ret = RegSaveKeyExA(hkey, "saved_formats", NULL, formats[i]);
+        ok(ret == ERROR_SUCCESS, "format %u: expected ERROR_SUCCESS, got %d\n", formats[i], ret);
+        trace("format %u: saved %u keys in %u ms\n", formats[i], count, GetTickCount() - start);
+        set_privileges(SE_BACKUP_NAME, FALSE);
+        if (ret) continue;
+
+        if (!set_privileges(SE_RESTORE_NAME, TRUE))
+        {
+            win_skip("Failed to set SE_RESTORE_NAME privileges, skipping tests\n");
+            break;
+        }
+        start = GetTickCount();
+        ret = RegLoadKeyA(HKEY_LOCAL_MACHINE, "TestFormats", "saved_formats");
+        ok(ret == ERROR_SUCCESS, "format %u: expected ERROR_SUCCESS, got %d\n", formats[i], ret);
+        trace("format %u: loaded %u keys in %u ms\n", formats[i], count, GetTickCount() - start);
+        if (ret)
+        {
+            set_privileges(SE_RESTORE_NAME, FALSE);
+            continue;
+        }
+
+        ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "TestFormats", &subkey);
+        ok(ret == ERROR_SUCCESS, "format %u: expected ERROR_SUCCESS, got %d\n", formats[i], ret);
+        ret = RegQueryInfoKeyA(subkey, NULL, NULL, NULL, &subkeys, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+        ok(ret == ERROR_SUCCESS, "format %u: expected ERROR_SUCCESS, got %d\n", formats[i], ret);
+        ok(subkeys == count, "format %u: expected %u subkeys, got %u\n", formats[i], count, subkeys);
+        RegCloseKey(subkey);
+
+        /* read everything back */
+        start = GetTickCount();
+        for (j = 0; j < count; j++)
+        {
+            sprintf(name, "TestFormats\\key%u", j);
+            ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, name, &subkey);
+            ok(ret == ERROR_SUCCESS, "format %u: expected ERROR_SUCCESS, got %d\n", formats[i], ret);
+            if (ret) break;
+            size = sizeof(dw);
+            ret = RegQueryValueExA(subkey, "dword", NULL, &type, (BYTE *)&dw, &size);
+            ok(ret == ERROR_SUCCESS && type == REG_DWORD && dw == j,
+               "format %u: got %d type %u value %u for key %u\n", formats[i], ret, type, dw, j);
+            size = sizeof(data);
+            ret = RegQueryValueExA(subkey, "string", NULL, &type, (BYTE *)data, &size);
+            ok(ret == ERROR_SUCCESS && type == REG_SZ, "format %u: got %d type %u\n", formats[i], ret, type);
+            RegCloseKey(subkey);
+        }
+        trace("format %u: read %u keys in %u ms\n", formats[i], count, GetTickCount() - start);
+
+        ret = RegUnLoadKeyA(HKEY_LOCAL_MACHINE, "TestFormats");
+        ok(ret == ERROR_SUCCESS, "format %u: expected ERROR_SUCCESS, got %d\n", formats[i], ret);
+        set_privileges(SE_RESTORE_NAME, FALSE);
+    }
+
+    DeleteFileA("saved_formats");
+    DeleteFileA("saved_formats.LOG");
+    delete_key(hkey);
+    RegCloseKey(hkey);
+}
+
+static void test_reg_write_stress(void)
+{
+    static const DWORD nb_keys = 200, nb_values = 50, nb_rounds = 5;
+    DWORD ret, i, j, round, start, count, size, dw;
+    char name[32];
+    HKEY hkey, subkey;
+
+    ret = RegCreateKeyA(hkey_main, "WriteStress", &hkey);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+
+    start = GetTickCount();
+    count = 0;
+    for (round = 0; round < nb_rounds; round++)
+    {
+        for (i = 0; i < nb_keys; i++)
+        {
+            sprintf(name, "key%u", i);
+            ret = RegCreateKeyA(hkey, name, &subkey);
+            ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+            if (ret) break;
+            for (j = 0; j < nb_values; j++)
+            {
+                sprintf(name, "value%u", j);
+                dw = round * nb_values + j;
+                RegSetValueExA(subkey, name, 0, REG_DWORD, (const BYTE *)&dw, sizeof(dw));
+                count++;
+            }
+            /* delete every other value again */
+            for (j = 0; j < nb_values; j += 2)
+            {
+                sprintf(name, "value%u", j);
+                ret = RegDeleteValueA(subkey, name);
+                ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+                count++;
+            }
+            RegCloseKey(subkey);
+        }
+        /* and every other key */
+        for (i = 0; i < nb_keys; i += 2)
+        {
+            sprintf(name, "key%u", i);
+            ret = RegDeleteKeyA(hkey, name);
+            ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+            count++;
+        }
+    }
+    trace("%u registry writes in %u ms\n", count, GetTickCount() - start);
+
+    for (i = 1; i < nb_keys; i += 2)
+    {
+        sprintf(name, "key%u", i);
+        ret = RegOpenKeyA(hkey, name, &subkey);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+        if (ret) break;
+        ret = RegQueryInfoKeyA(subkey, NULL, NULL, NULL, NULL, NULL, NULL, &count, NULL, NULL, NULL, NULL);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+        ok(count == nb_values / 2, "expected %u values, got %u\n", nb_values / 2, count);
+        size = sizeof(dw);
+        ret = RegQueryValueExA(subkey, "value1", NULL, NULL, (BYTE *)&dw, &size);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+        ok(dw == (nb_rounds - 1) * nb_values + 1, "got %u\n", dw);
+        RegCloseKey(subkey);
+    }
+
+    delete_key(hkey);
+    RegCloseKey(hkey);
+}
+
+static void test_reg_wide_keys(void)
+{
+    static const DWORD count = 20000;
+    char name[32], expect[32];
+    DWORD ret, i, start, subkeys, values, size, dw;
+    HKEY hkey, subkey;
+    FILE *f;
+
+    /* a text file in the Wine format, in reverse order to make the import as slow as possible */
+    f = fopen("wide_keys", "w");
+    ok(f != NULL, "failed to create file\n");
+    if (!f) return;
+    fprintf(f, "WINE REGISTRY Version 2\n");
+    for (i = count; i > 0; i--) fprintf(f, "\n[Wide\\\\key%05u] 0\n\"value\"=dword:%08x\n", i - 1, i - 1);
+    fprintf(f, "\n[Values] 0\n");
+    for (i = count; i > 0; i--) fprintf(f, "\"value%05u\"=dword:%08x\n", i - 1, i - 1);
+    fclose(f);
+
+    if (!set_privileges(SE_RESTORE_NAME, TRUE))
+    {
+        win_skip("Failed to set SE_RESTORE_NAME privileges, skipping tests\n");
+        DeleteFileA("wide_keys");
+        return;
+    }
+    start = GetTickCount();
+    ret = RegLoadKeyA(HKEY_LOCAL_MACHINE, "TestWide", "wide_keys");
+    if (ret)
+    {
+        /* only Wine supports its own format */
+        win_skip("Failed to load the registry file, got %d\n", ret);
+        set_privileges(SE_RESTORE_NAME, FALSE);
+        DeleteFileA("wide_keys");
+        return;
+    }
+    trace("imported %u keys and %u values in %u ms\n", count, count, GetTickCount() - start);
+
+    ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "TestWide\\Wide", &hkey);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    ret = RegQueryInfoKeyA(hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    ok(subkeys == count, "expected %u subkeys, got %u\n", count, subkeys);
+
+    /* delete every third key, the others must still be found and sorted */
+    for (i = 0; i < count; i += 3)
+    {
+        sprintf(name, "key%05u", i);
+        ret = RegDeleteKeyA(hkey, name);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    }
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "KEY%05u", i);
+        ret = RegOpenKeyA(hkey, name, &subkey);
+        if (i % 3)
+        {
+            ok(ret == ERROR_SUCCESS, "key %u: expected ERROR_SUCCESS, got %d\n", i, ret);
+            if (ret) break;
+            size = sizeof(dw);
+            ret = RegQueryValueExA(subkey, "value", NULL, NULL, (BYTE *)&dw, &size);
+            ok(ret == ERROR_SUCCESS && dw == i, "key %u: got %d value %u\n", i, ret, dw);
+            RegCloseKey(subkey);
+        }
+        else ok(ret == ERROR_FILE_NOT_FOUND, "key %u: expected ERROR_FILE_NOT_FOUND, got %d\n", i, ret);
+    }
+    trace("opened %u keys in %u ms\n", count, GetTickCount() - start);
+    for (i = subkeys = 0; i < count; i++)
+    {
+        if (!(i % 3)) continue;
+        sprintf(expect, "key%05u", i);
+        size = sizeof(name);
+        ret = RegEnumKeyExA(hkey, subkeys++, name, &size, NULL, NULL, NULL, NULL);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+        if (ret) break;
+        ok(!strcmp(name, expect), "expected %s, got %s\n", expect, name);
+        if (strcmp(name, expect)) break;
+    }
+    RegCloseKey(hkey);
+
+    ret = RegOpenKeyA(HKEY_LOCAL_MACHINE, "TestWide\\Values", &hkey);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    ret = RegQueryInfoKeyA(hkey, NULL, NULL, NULL, NULL, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    ok(values == count, "expected %u values, got %u\n", count, values);
+    for (i = 0; i < count; i += 2)
+    {
+        sprintf(name, "value%05u", i);
+        ret = RegDeleteValueA(hkey, name);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    }
+    for (i = 1; i < count; i += 2)
+    {
+        sprintf(expect, "value%05u", i);
+        size = sizeof(name);
+        ret = RegEnumValueA(hkey, i / 2, name, &size, NULL, NULL, NULL, NULL);
+        ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+        if (ret) break;
+        ok(!strcmp(name, expect), "expected %s, got %s\n", expect, name);
+        if (strcmp(name, expect)) break;
+        size = sizeof(dw);
+        ret = RegQueryValueExA(hkey, expect, NULL, NULL, (BYTE *)&dw, &size);
+        ok(ret == ERROR_SUCCESS && dw == i, "value %u: got %d value %u\n", i, ret, dw);
+    }
+    RegCloseKey(hkey);
+
+    ret = RegUnLoadKeyA(HKEY_LOCAL_MACHINE, "TestWide");
+    ok(ret == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %d\n", ret);
+    set_privileges(SE_RESTORE_NAME, FALSE);
+    DeleteFileA("wide_keys");
+}
+
 /* tests that show that RegConnectRegistry and 
    OpenSCManager accept computer names without the
    \\ prefix (what MSDN says).   */
@@ -3556,6 +3824,9 @@ START_TEST(registry)
     test_reg_save_key();
     test_reg_load_key();
     test_reg_unload_key();
+    test_reg_save_load_formats();
+    test_reg_write_stress();
+    test_reg_wide_keys();
     test_reg_copy_tree();
     test_reg_delete_tree();
     test_rw_order();
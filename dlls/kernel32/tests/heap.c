@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static BOOL (WINAPI *pGetPhysicallyInstalledSystemMemory)(ULONGLONG *);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
@@ -880,6 +881,162 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+#define LFH_THREADS 16
+#define LFH_BLOCKS  256
+
+struct lfh_thread_params
+{
+    HANDLE heap;
+    HANDLE start;
+    DWORD  iterations;
+    LONG   errors;
+};
+
+static DWORD WINAPI lfh_thread( void *arg )
+{
+    struct lfh_thread_params *params = arg;
+    BYTE *blocks[LFH_BLOCKS];
+    DWORD i, j, size;
+
+    WaitForSingleObject( params->start, INFINITE );
+    for (i = 0; i < params->iterations; i++)
+    {
+        for (j = 0; j < LFH_BLOCKS; j++)
+        {
+            size = 1 + (j * 37 + i) % 2048;
+            if (!(blocks[j] = HeapAlloc( params->heap, 0, size )))
+            {
+                InterlockedIncrement( &params->errors );
+                continue;
+            }
+            blocks[j][0] = blocks[j][size - 1] = j;
+            if (HeapSize( params->heap, 0, blocks[j] ) != size) InterlockedIncrement( &params->errors );
+        }
+        for (j = 0; j < LFH_BLOCKS; j++)
+        {
+            size = 1 + (j * 37 + i) % 2048;
+            if (!blocks[j]) continue;
+            if (blocks[j][0] != (BYTE)j || blocks[j][size - 1] != (BYTE)j) InterlockedIncrement( &params->errors );
+            if (!HeapFree( params->heap, 0, blocks[j] )) InterlockedIncrement( &params->errors );
+        }
+    }
+    return 0;
+}
+
+static DWORD run_lfh_threads( HANDLE heap, DWORD iterations, LONG *errors )
+{
+    struct lfh_thread_params params;
+    HANDLE threads[LFH_THREADS];
+    DWORD i, start;
+
+    params.heap = heap;
+    params.start = CreateEventA( NULL, TRUE, FALSE, NULL );
+    params.iterations = iterations;
+    params.errors = 0;
+    for (i = 0; i < LFH_THREADS; i++)
+        threads[i] = CreateThread( NULL, 0, lfh_thread, &params, 0, NULL );
+
+    start = GetTickCount();
+    SetEvent( params.start );
+    WaitForMultipleObjects( LFH_THREADS, threads, TRUE, INFINITE );
+    start = GetTickCount() - start;
+
+    for (i = 0; i < LFH_THREADS; i++) CloseHandle( threads[i] );
+    CloseHandle( params.start );
+    *errors = params.errors;
+    return start;
+}
+
+static void test_heap_lfh(void)
+{
+    HANDLE heap;
+    ULONG info;
+    DWORD i, time_std, time_lfh;
+    LONG errors;
+    void *ptr;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapQueryInformation || !pHeapSetInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded on a HEAP_NO_SERIALIZE heap\n" );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    if (info == 2)
+    {
+        win_skip( "new heaps use the LFH by default\n" );
+        HeapDestroy( heap );
+        return;
+    }
+    ok( info == 0, "expected 0, got %u\n", info );
+
+    time_std = run_lfh_threads( heap, 200, &errors );
+    ok( !errors, "got %d errors on the standard heap\n", errors );
+
+    ptr = HeapAlloc( heap, 0, 100 );
+    ok( ptr != NULL, "HeapAlloc failed\n" );
+
+    SetLastError( 0xdeadbeef );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) - 1 );
+    ok( !ret, "HeapSetInformation succeeded\n" );
+
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation error %u\n", GetLastError() );
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    if (info != 2)
+    {
+        skip( "LFH not enabled, probably running with a debug heap\n" );
+        HeapFree( heap, 0, ptr );
+        HeapDestroy( heap );
+        return;
+    }
+
+    info = 0;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "LFH could be turned off again\n" );
+
+    /* blocks allocated before enabling the LFH are still valid */
+    ok( HeapSize( heap, 0, ptr ) == 100, "wrong size %lu\n", HeapSize( heap, 0, ptr ) );
+    ret = HeapFree( heap, 0, ptr );
+    ok( ret, "HeapFree failed\n" );
+
+    ptr = HeapAlloc( heap, HEAP_ZERO_MEMORY, 24 );
+    ok( ptr != NULL, "HeapAlloc failed\n" );
+    for (i = 0; i < 24; i++) if (((BYTE *)ptr)[i]) break;
+    ok( i == 24, "block not zeroed at %u\n", i );
+    ok( HeapSize( heap, 0, ptr ) == 24, "wrong size %lu\n", HeapSize( heap, 0, ptr ) );
+    ptr = HeapReAlloc( heap, 0, ptr, 3000 );
+    ok( ptr != NULL, "HeapReAlloc failed\n" );
+    ok( HeapSize( heap, 0, ptr ) == 3000, "wrong size %lu\n", HeapSize( heap, 0, ptr ) );
+    ret = HeapFree( heap, 0, ptr );
+    ok( ret, "HeapFree failed\n" );
+
+    time_lfh = run_lfh_threads( heap, 200, &errors );
+    ok( !errors, "got %d errors on the LFH heap\n", errors );
+    ok( HeapValidate( heap, 0, NULL ), "heap is corrupted\n" );
+    trace( "%u threads x %u blocks: standard heap %u ms, LFH %u ms\n",
+           LFH_THREADS, LFH_BLOCKS * 200, time_std, time_lfh );
+
+    HeapDestroy( heap );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1233,6 +1390,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_heap_lfh();
     test_GetPhysicallyInstalledSystemMemory();
 
     if (pRtlGetNtGlobalFlags)
@@ -1501,6 +1501,380 @@ static void test_import_resolution(void)
     }
 }
 
+#define DATA_PAGES 64
+
+/* load the test dll in a child process; the second child must share the relocated copy of the first one */
+static void relocated_image_child( const char *dll_name )
+{
+    VM_COUNTERS before, after;
+    ULONG_PTR *ptr, *shared;
+    HANDLE mapping, ready, done;
+    NTSTATUS status;
+    HMODULE mod;
+    void *reserved;
+    DWORD i, data_size = DATA_PAGES * page_size;
+
+    mapping = OpenFileMappingA( FILE_MAP_READ | FILE_MAP_WRITE, FALSE, "winetest_loader_reloc" );
+    ok( mapping != 0, "OpenFileMapping failed %u\n", GetLastError() );
+    shared = MapViewOfFile( mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(*shared) );
+    ok( shared != NULL, "MapViewOfFile failed %u\n", GetLastError() );
+    if (!shared) return;
+
+    reserved = VirtualAlloc( (void *)0x12340000, page_size, MEM_RESERVE, PAGE_NOACCESS );
+    ok( reserved != NULL, "failed to reserve %p err %u\n", (void *)0x12340000, GetLastError() );
+
+    status = pNtQueryInformationProcess( GetCurrentProcess(), ProcessVmCounters, &before, sizeof(before), NULL );
+    ok( !status, "NtQueryInformationProcess failed %x\n", status );
+
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "failed to load err %u\n", GetLastError() );
+    if (mod)
+    {
+        ptr = (ULONG_PTR *)((char *)mod + page_size);
+        for (i = 0; i < data_size / sizeof(ULONG_PTR); i++)
+            if (ptr[i] != (ULONG_PTR)&ptr[i]) break;
+        ok( i == data_size / sizeof(ULONG_PTR), "wrong relocated pointer at %p\n", &ptr[i] );
+
+        status = pNtQueryInformationProcess( GetCurrentProcess(), ProcessVmCounters, &after, sizeof(after), NULL );
+        ok( !status, "NtQueryInformationProcess failed %x\n", status );
+
+        if (!*shared)
+        {
+            /* first child, keep the dll loaded until the second one is done */
+            *shared = (ULONG_PTR)mod;
+            ready = OpenEventA( EVENT_MODIFY_STATE, FALSE, "winetest_loader_reloc_ready" );
+            done = OpenEventA( SYNCHRONIZE, FALSE, "winetest_loader_reloc_done" );
+            SetEvent( ready );
+            WaitForSingleObject( done, 10000 );
+            CloseHandle( ready );
+            CloseHandle( done );
+        }
+        else
+        {
+            ok( (ULONG_PTR)mod == *shared, "dll loaded at %p instead of %p\n", mod, (void *)*shared );
+            /* the relocated pages are mapped from the shared copy */
+            if ((ULONG_PTR)mod == *shared)
+                ok( after.PagefileUsage - before.PagefileUsage < data_size / 2,
+                    "private usage grew by %u kB\n", (ULONG)(after.PagefileUsage - before.PagefileUsage) / 1024 );
+        }
+        FreeLibrary( mod );
+    }
+
+    if (reserved) VirtualFree( reserved, 0, MEM_RELEASE );
+    UnmapViewOfFile( shared );
+    CloseHandle( mapping );
+}
+
+static void test_relocated_image(void)
+{
+    char temp_path[MAX_PATH];
+    char dll_name[MAX_PATH];
+    char cmdline[2 * MAX_PATH + 32], **argv;
+    IMAGE_NT_HEADERS nt;
+    IMAGE_SECTION_HEADER sections[2];
+    IMAGE_BASE_RELOCATION *rel;
+    VM_COUNTERS before, after;
+    PROCESS_INFORMATION pi[2];
+    STARTUPINFOA si = { sizeof(si) };
+    ULONG_PTR *data, *ptr;
+    WORD *relocs, *entry;
+    DWORD dummy, i, j, count, data_size, relocs_size, ret;
+    NTSTATUS status;
+    HANDLE hfile, mapping, ready, done, handles[2];
+    HMODULE mod;
+    void *reserved;
+
+    count = page_size / sizeof(ULONG_PTR);
+    data_size = DATA_PAGES * page_size;
+    relocs_size = DATA_PAGES * (sizeof(*rel) + count * sizeof(WORD));
+
+    nt = nt_header_template;
+    nt.FileHeader.NumberOfSections = 2;
+    nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    nt.OptionalHeader.SectionAlignment = page_size;
+    nt.OptionalHeader.FileAlignment = 0x200;
+    nt.OptionalHeader.ImageBase = 0x12340000;
+    nt.OptionalHeader.SizeOfImage = (2 + DATA_PAGES) * page_size + ((relocs_size + page_size - 1) & ~(page_size - 1));
+    nt.OptionalHeader.SizeOfHeaders = nt.OptionalHeader.FileAlignment;
+    nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = (1 + DATA_PAGES) * page_size;
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = relocs_size;
+
+    memset( sections, 0, sizeof(sections) );
+    memcpy( sections[0].Name, ".data", sizeof(".data") );
+    sections[0].PointerToRawData = nt.OptionalHeader.FileAlignment;
+    sections[0].VirtualAddress = page_size;
+    sections[0].Misc.VirtualSize = data_size;
+    sections[0].SizeOfRawData = data_size;
+    sections[0].Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+    memcpy( sections[1].Name, ".reloc", sizeof(".reloc") );
+    sections[1].PointerToRawData = sections[0].PointerToRawData + data_size;
+    sections[1].VirtualAddress = (1 + DATA_PAGES) * page_size;
+    sections[1].Misc.VirtualSize = relocs_size;
+    sections[1].SizeOfRawData = relocs_size;
+    sections[1].Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_DISCARDABLE;
+
+    /* every pointer points to itself */
+    data = HeapAlloc( GetProcessHeap(), 0, data_size );
+    for (i = 0; i < data_size / sizeof(ULONG_PTR); i++)
+        data[i] = nt.OptionalHeader.ImageBase + page_size + i * sizeof(ULONG_PTR);
+
+    relocs = HeapAlloc( GetProcessHeap(), 0, relocs_size );
+    rel = (IMAGE_BASE_RELOCATION *)relocs;
+    for (i = 0; i < DATA_PAGES; i++)
+    {
+        rel->VirtualAddress = (1 + i) * page_size;
+        rel->SizeOfBlock = sizeof(*rel) + count * sizeof(WORD);
+        entry = (WORD *)(rel + 1);
+#ifdef _WIN64
+        for (j = 0; j < count; j++) entry[j] = (IMAGE_REL_BASED_DIR64 << 12) | (j * sizeof(ULONG_PTR));
+#else
+        for (j = 0; j < count; j++) entry[j] = (IMAGE_REL_BASED_HIGHLOW << 12) | (j * sizeof(ULONG_PTR));
+#endif
+        rel = (IMAGE_BASE_RELOCATION *)(entry + count);
+    }
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "ldr", 0, dll_name);
+
+    hfile = CreateFileA(dll_name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, 0);
+    ok( hfile != INVALID_HANDLE_VALUE, "creation failed\n" );
+
+    WriteFile(hfile, &dos_header, sizeof(dos_header), &dummy, NULL);
+    WriteFile(hfile, &nt, sizeof(nt), &dummy, NULL);
+    WriteFile(hfile, sections, sizeof(sections), &dummy, NULL);
+    SetFilePointer( hfile, sections[0].PointerToRawData, NULL, SEEK_SET );
+    WriteFile(hfile, data, data_size, &dummy, NULL);
+    WriteFile(hfile, relocs, relocs_size, &dummy, NULL);
+    CloseHandle( hfile );
+
+    /* make sure that the dll can't be loaded at its preferred address */
+    reserved = VirtualAlloc( (void *)nt.OptionalHeader.ImageBase, page_size, MEM_RESERVE, PAGE_NOACCESS );
+    ok( reserved != NULL, "failed to reserve %p err %u\n", (void *)nt.OptionalHeader.ImageBase, GetLastError() );
+
+    status = pNtQueryInformationProcess( GetCurrentProcess(), ProcessVmCounters, &before, sizeof(before), NULL );
+    ok( !status, "NtQueryInformationProcess failed %x\n", status );
+
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "failed to load err %u\n", GetLastError() );
+    if (mod)
+    {
+        ok( mod != (HMODULE)nt.OptionalHeader.ImageBase || !reserved, "dll loaded at %p\n", mod );
+        ptr = (ULONG_PTR *)((char *)mod + page_size);
+        for (i = 0; i < data_size / sizeof(ULONG_PTR); i++)
+            if (ptr[i] != (ULONG_PTR)&ptr[i]) break;
+        ok( i == data_size / sizeof(ULONG_PTR), "wrong relocated pointer at %p\n", &ptr[i] );
+
+        status = pNtQueryInformationProcess( GetCurrentProcess(), ProcessVmCounters, &after, sizeof(after), NULL );
+        ok( !status, "NtQueryInformationProcess failed %x\n", status );
+        /* private memory used by the relocated pages, none if they are shared with other processes */
+        trace( "relocated %u pages at %p, private usage grew by %u kB\n", DATA_PAGES, mod,
+               (ULONG)(after.PagefileUsage - before.PagefileUsage) / 1024 );
+        FreeLibrary( mod );
+    }
+    if (reserved) VirtualFree( reserved, 0, MEM_RELEASE );
+
+    /* load it in two processes that share the relocated copy */
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(ULONG_PTR),
+                                  "winetest_loader_reloc" );
+    ok( mapping != 0, "CreateFileMapping failed %u\n", GetLastError() );
+    ready = CreateEventA( NULL, TRUE, FALSE, "winetest_loader_reloc_ready" );
+    done = CreateEventA( NULL, TRUE, FALSE, "winetest_loader_reloc_done" );
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" loader relocated %s", argv[0], dll_name );
+    SetEnvironmentVariableA( "WINESHAREDRELOCS", "1" );
+
+    ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi[0] );
+    ok( ret, "CreateProcess(%s) error %d\n", cmdline, GetLastError() );
+    handles[0] = ready;
+    handles[1] = pi[0].hProcess;
+    ret = WaitForMultipleObjects( 2, handles, FALSE, 10000 );
+    ok( ret == WAIT_OBJECT_0, "first child failed to load the dll %u\n", ret );
+    if (ret == WAIT_OBJECT_0)
+    {
+        ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi[1] );
+        ok( ret, "CreateProcess(%s) error %d\n", cmdline, GetLastError() );
+        winetest_wait_child_process( pi[1].hProcess );
+        CloseHandle( pi[1].hThread );
+        CloseHandle( pi[1].hProcess );
+    }
+    SetEvent( done );
+    winetest_wait_child_process( pi[0].hProcess );
+    CloseHandle( pi[0].hThread );
+    CloseHandle( pi[0].hProcess );
+
+    SetEnvironmentVariableA( "WINESHAREDRELOCS", NULL );
+    CloseHandle( ready );
+    CloseHandle( done );
+    CloseHandle( mapping );
+    HeapFree( GetProcessHeap(), 0, data );
+    HeapFree( GetProcessHeap(), 0, relocs );
+    DeleteFileA( dll_name );
+}
+
+#undef DATA_PAGES
+
+static void test_many_dlls(void)
+{
+#define DLL_COUNT 256
+    static const char * const functions[] =
+    {
+        "CreateEventA", "CreateFileA", "CloseHandle", "GetCurrentThreadId",
+        "GetModuleHandleA", "LoadLibraryA", "FreeLibrary", "VirtualAlloc"
+    };
+#define FUNC_COUNT (sizeof(functions) / sizeof(functions[0]))
+    char temp_path[MAX_PATH];
+    char dir_name[MAX_PATH];
+    char dll_name[MAX_PATH + 16];
+    char src_name[MAX_PATH + 16];
+    HMODULE *mods, mod, kernel32;
+    DWORD dummy, start, load_time, lookup_time;
+    struct imports
+    {
+        IMAGE_IMPORT_DESCRIPTOR descr[2];
+        IMAGE_THUNK_DATA original_thunks[FUNC_COUNT + 1];
+        IMAGE_THUNK_DATA thunks[FUNC_COUNT + 1];
+        char module[16];
+        struct { WORD hint; char name[32]; } function[FUNC_COUNT];
+    } data, *ptr;
+    IMAGE_NT_HEADERS nt;
+    IMAGE_SECTION_HEADER section;
+    HANDLE hfile;
+    BOOL ret;
+    UINT i, j;
+
+#define DATA_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&data))
+    nt = nt_header_template;
+    nt.FileHeader.NumberOfSections = 1;
+    nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    nt.FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_32BIT_MACHINE | IMAGE_FILE_DLL;
+    nt.OptionalHeader.SectionAlignment = page_size;
+    nt.OptionalHeader.FileAlignment = 0x200;
+    nt.OptionalHeader.ImageBase = 0x12340000;
+    nt.OptionalHeader.SizeOfImage = 2 * page_size;
+    nt.OptionalHeader.SizeOfHeaders = nt.OptionalHeader.FileAlignment;
+    nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = sizeof(data.descr);
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = DATA_RVA(data.descr);
+
+    memset( &data, 0, sizeof(data) );
+    data.descr[0].u.OriginalFirstThunk = DATA_RVA( data.original_thunks );
+    data.descr[0].FirstThunk = DATA_RVA( data.thunks );
+    data.descr[0].Name = DATA_RVA( data.module );
+    strcpy( data.module, "kernel32.dll" );
+    for (i = 0; i < FUNC_COUNT; i++)
+    {
+        strcpy( data.function[i].name, functions[i] );
+        data.original_thunks[i].u1.AddressOfData = DATA_RVA( &data.function[i] );
+        data.thunks[i].u1.AddressOfData = 0xdeadbeef;
+    }
+
+    memset( &section, 0, sizeof(section) );
+    memcpy( section.Name, ".data", sizeof(".data") );
+    section.PointerToRawData = nt.OptionalHeader.FileAlignment;
+    section.VirtualAddress = nt.OptionalHeader.SectionAlignment;
+    section.Misc.VirtualSize = sizeof(data);
+    section.SizeOfRawData = sizeof(data);
+    section.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+#undef DATA_RVA
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "ldr", 0, dir_name);
+    DeleteFileA( dir_name );
+    ret = CreateDirectoryA( dir_name, NULL );
+    ok( ret, "CreateDirectory failed err %u\n", GetLastError() );
+    if (!ret) return;
+
+    sprintf( src_name, "%s\\src.dll", dir_name );
+    hfile = CreateFileA(src_name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, 0);
+    ok( hfile != INVALID_HANDLE_VALUE, "creation failed\n" );
+    WriteFile(hfile, &dos_header, sizeof(dos_header), &dummy, NULL);
+    WriteFile(hfile, &nt, sizeof(nt), &dummy, NULL);
+    WriteFile(hfile, &section, sizeof(section), &dummy, NULL);
+    SetFilePointer( hfile, section.PointerToRawData, NULL, SEEK_SET );
+    WriteFile(hfile, &data, sizeof(data), &dummy, NULL);
+    CloseHandle( hfile );
+
+    for (i = 0; i < DLL_COUNT; i++)
+    {
+        sprintf( dll_name, "%s\\many%03u.dll", dir_name, i );
+        ret = CopyFileA( src_name, dll_name, FALSE );
+        ok( ret, "CopyFile failed err %u\n", GetLastError() );
+    }
+
+    /* a process importing this many dlls spends its startup in the loader lookups */
+    mods = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, DLL_COUNT * sizeof(*mods) );
+    start = GetTickCount();
+    for (i = 0; i < DLL_COUNT; i++)
+    {
+        sprintf( dll_name, "%s\\many%03u.dll", dir_name, i );
+        mods[i] = LoadLibraryA( dll_name );
+        ok( mods[i] != NULL, "failed to load %s err %u\n", dll_name, GetLastError() );
+    }
+    load_time = GetTickCount() - start;
+
+    start = GetTickCount();
+    for (i = 0; i < DLL_COUNT; i++)
+    {
+        if (!mods[i]) continue;
+        sprintf( dll_name, "many%03u.dll", i );
+        ok( GetModuleHandleA( dll_name ) == mods[i], "wrong module for %s\n", dll_name );
+        sprintf( dll_name, "%s\\MANY%03u.DLL", dir_name, i );
+        ok( GetModuleHandleA( dll_name ) == mods[i], "wrong module for %s\n", dll_name );
+    }
+    lookup_time = GetTickCount() - start;
+    trace( "loaded %u dlls in %u ms, looked them up in %u ms\n", DLL_COUNT, load_time, lookup_time );
+
+    /* a module with the same base name loaded from another directory doesn't hide the first one */
+    sprintf( dll_name, "%s\\sub", dir_name );
+    CreateDirectoryA( dll_name, NULL );
+    sprintf( dll_name, "%s\\sub\\many000.dll", dir_name );
+    ret = CopyFileA( src_name, dll_name, FALSE );
+    ok( ret, "CopyFile failed err %u\n", GetLastError() );
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "failed to load %s err %u\n", dll_name, GetLastError() );
+    ok( mod != mods[0], "got the same module for both paths\n" );
+    ok( GetModuleHandleA( "many000.dll" ) == mods[0], "got %p instead of %p\n",
+        GetModuleHandleA( "many000.dll" ), mods[0] );
+    ok( GetModuleHandleA( dll_name ) == mod, "got %p instead of %p\n", GetModuleHandleA( dll_name ), mod );
+    if (mod) FreeLibrary( mod );
+    ok( GetModuleHandleA( "many000.dll" ) == mods[0], "got %p instead of %p\n",
+        GetModuleHandleA( "many000.dll" ), mods[0] );
+    DeleteFileA( dll_name );
+    sprintf( dll_name, "%s\\sub", dir_name );
+    RemoveDirectoryA( dll_name );
+
+    kernel32 = GetModuleHandleA( "kernel32.dll" );
+    for (i = 0; i < DLL_COUNT; i++)
+    {
+        if (!mods[i]) continue;
+        ptr = (struct imports *)((char *)mods[i] + page_size);
+        for (j = 0; j < FUNC_COUNT; j++)
+        {
+            void *expect = GetProcAddress( kernel32, functions[j] );
+            ok( (void *)ptr->thunks[j].u1.Function == expect, "%u: thunk %p instead of %p for %s\n",
+                i, (void *)ptr->thunks[j].u1.Function, expect, functions[j] );
+        }
+    }
+    ok( !GetProcAddress( kernel32, "NoSuchFunction" ), "found a missing export\n" );
+
+    for (i = 0; i < DLL_COUNT; i++)
+    {
+        if (mods[i]) FreeLibrary( mods[i] );
+        sprintf( dll_name, "many%03u.dll", i );
+        ok( !GetModuleHandleA( dll_name ), "%s still loaded\n", dll_name );
+        sprintf( dll_name, "%s\\many%03u.dll", dir_name, i );
+        DeleteFileA( dll_name );
+    }
+    HeapFree( GetProcessHeap(), 0, mods );
+    DeleteFileA( src_name );
+    RemoveDirectoryA( dir_name );
+#undef FUNC_COUNT
+#undef DLL_COUNT
+}
+
 #define MAX_COUNT 10
 static HANDLE attached_thread[MAX_COUNT];
 static DWORD attached_thread_count;
@@ -3082,6 +3456,11 @@ START_TEST(loader)
         *child_failures = -1;
 
     argc = winetest_get_mainargs(&argv);
+    if (argc > 3 && !strcmp(argv[2], "relocated"))
+    {
+        relocated_image_child(argv[3]);
+        return;
+    }
     if (argc > 4)
     {
         test_dll_phase = atoi(argv[4]);
@@ -3094,6 +3473,8 @@ START_TEST(loader)
     test_ImportDescriptors();
     test_section_access();
     test_import_resolution();
+    test_relocated_image();
+    test_many_dlls();
     test_ExitProcess();
     test_InMemoryOrderModuleList();
 }
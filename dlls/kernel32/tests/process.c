@@ -3615,6 +3615,35 @@ static void test_largepages(void)
     ok((size == 0) || (size == 2*1024*1024) || (size == 4*1024*1024), "GetLargePageMinimum reports %ld size\n", size);
 }
 
+static void test_startup_time(void)
+{
+    char cmdline[] = "cmd.exe /c exit";
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    DWORD start, first = 0, total = 0, exit_code, i;
+    BOOL ret;
+
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+
+    /* the first run populates the caches used by the next ones */
+    for (i = 0; i < 20; i++)
+    {
+        start = GetTickCount();
+        ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info);
+        ok(ret, "CreateProcess failed err %u\n", GetLastError());
+        if (!ret) return;
+        ok(WaitForSingleObject(info.hProcess, 30000) == WAIT_OBJECT_0, "Child process termination\n");
+        ret = GetExitCodeProcess(info.hProcess, &exit_code);
+        ok(ret && !exit_code, "exit code %u\n", exit_code);
+        CloseHandle(info.hThread);
+        CloseHandle(info.hProcess);
+        if (!i) first = GetTickCount() - start;
+        else total += GetTickCount() - start;
+    }
+    trace("cmd /c exit: first run %u ms, next runs %u ms on average\n", first, total / (i - 1));
+}
+
 struct proc_thread_attr
 {
     DWORD_PTR attr;
@@ -3806,6 +3835,7 @@ START_TEST(process)
     test_session_info();
     test_GetLogicalProcessorInformationEx();
     test_largepages();
+    test_startup_time();
     test_ProcThreadAttributeList();
     test_SuspendProcessState();
     test_SuspendProcessNewThread();
@@ -60,6 +60,12 @@ static VOID   (WINAPI *pReleaseSRWLockShared)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockExclusive)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockShared)(PSRWLOCK);
 
+static BOOL   (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE,OVERLAPPED_ENTRY*,ULONG,ULONG*,DWORD,BOOL);
+
+static BOOL   (WINAPI *pWaitOnAddress)(volatile void *,void *,SIZE_T,DWORD);
+static VOID   (WINAPI *pWakeByAddressAll)(void *);
+static VOID   (WINAPI *pWakeByAddressSingle)(void *);
+
 static NTSTATUS (WINAPI *pNtAllocateVirtualMemory)(HANDLE, PVOID *, ULONG, SIZE_T *, ULONG, ULONG);
 static NTSTATUS (WINAPI *pNtFreeVirtualMemory)(HANDLE, PVOID *, SIZE_T *, ULONG);
 static NTSTATUS (WINAPI *pNtWaitForSingleObject)(HANDLE, BOOLEAN, const LARGE_INTEGER *);
@@ -654,6 +660,77 @@ static void test_waitable_timer(void)
     CloseHandle( handle );
 }
 
+static void test_many_timers(void)
+{
+#define TIMER_COUNT 100000
+    LARGE_INTEGER freq, start, end, due;
+    HANDLE *timers, early;
+    double set_time, cancel_time;
+    unsigned int seed = 1;
+    DWORD ret;
+    BOOL res;
+    int i;
+
+    if (!pCreateWaitableTimerA)
+    {
+        win_skip("CreateWaitableTimerA() is not available\n");
+        return;
+    }
+
+    timers = HeapAlloc(GetProcessHeap(), 0, TIMER_COUNT * sizeof(*timers));
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        timers[i] = pCreateWaitableTimerA(NULL, TRUE, NULL);
+        ok(timers[i] != NULL, "CreateWaitableTimer failed with error %u\n", GetLastError());
+        if (!timers[i]) break;
+    }
+    if (i < TIMER_COUNT)
+    {
+        while (i > 0) CloseHandle(timers[--i]);
+        HeapFree(GetProcessHeap(), 0, timers);
+        return;
+    }
+
+    /* all the timers are pending at the same time, expiring in random order */
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        due.QuadPart = -(LONGLONG)(60 + (seed >> 16) % 600) * 10000000;
+        res = SetWaitableTimer(timers[i], &due, 0, NULL, NULL, FALSE);
+        ok(res, "SetWaitableTimer failed with error %u\n", GetLastError());
+    }
+    QueryPerformanceCounter(&end);
+    set_time = (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / TIMER_COUNT;
+
+    /* a timer added behind all of them still fires in time */
+    early = pCreateWaitableTimerA(NULL, TRUE, NULL);
+    due.QuadPart = -50 * 10000;
+    res = SetWaitableTimer(early, &due, 0, NULL, NULL, FALSE);
+    ok(res, "SetWaitableTimer failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(early, 5000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForMultipleObjects(MAXIMUM_WAIT_OBJECTS, timers, FALSE, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    CloseHandle(early);
+
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        res = CancelWaitableTimer(timers[i]);
+        ok(res, "CancelWaitableTimer failed with error %u\n", GetLastError());
+    }
+    QueryPerformanceCounter(&end);
+    cancel_time = (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / TIMER_COUNT;
+
+    trace("%u pending timers: %.2f us per set, %.2f us per cancel\n", TIMER_COUNT, set_time, cancel_time);
+
+    for (i = 0; i < TIMER_COUNT; i++) CloseHandle(timers[i]);
+    HeapFree(GetProcessHeap(), 0, timers);
+#undef TIMER_COUNT
+}
+
 static HANDLE sem = 0;
 
 static void CALLBACK iocp_callback(DWORD dwErrorCode, DWORD dwNumberOfBytesTransferred, LPOVERLAPPED lpOverlapped)
@@ -857,6 +934,291 @@ static void CALLBACK timer_queue_cb6(PVOID p, BOOLEAN timedOut)
     }
 }
 
+static void test_iocp_batch(void)
+{
+    static const ULONG batch_sizes[] = {1, 4, 16, 64, 256};
+    OVERLAPPED_ENTRY entries[256];
+    ULONG written, total, calls;
+    DWORD ticks;
+    HANDLE port;
+    BOOL ret;
+    int i, j;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip("GetQueuedCompletionStatusEx not supported\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed with %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    written = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx(port, entries, 1, &written, 0, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "got error %u\n", GetLastError());
+    ok(!written, "got %u entries\n", written);
+
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 0, &written, 0, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+
+    /* packets are returned in order, up to the requested count */
+    for (i = 0; i < 5; i++)
+    {
+        ret = PostQueuedCompletionStatus(port, i * 10, 100 + i, (OVERLAPPED *)(ULONG_PTR)(200 + i));
+        ok(ret, "PostQueuedCompletionStatus failed with %u\n", GetLastError());
+    }
+    ret = pGetQueuedCompletionStatusEx(port, entries, 3, &written, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed with %u\n", GetLastError());
+    ok(written == 3, "got %u entries\n", written);
+    ret = pGetQueuedCompletionStatusEx(port, entries + 3, 10, &written, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed with %u\n", GetLastError());
+    ok(written == 2, "got %u entries\n", written);
+    for (i = 0; i < 5; i++)
+    {
+        ok(entries[i].lpCompletionKey == 100 + i, "%u: got key %lu\n", i, entries[i].lpCompletionKey);
+        ok(entries[i].lpOverlapped == (OVERLAPPED *)(ULONG_PTR)(200 + i), "%u: got overlapped %p\n",
+           i, entries[i].lpOverlapped);
+        ok(entries[i].dwNumberOfBytesTransferred == i * 10, "%u: got %u bytes\n",
+           i, entries[i].dwNumberOfBytesTransferred);
+    }
+
+    /* drain the same number of packets with growing batch sizes */
+    for (i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++)
+    {
+        for (j = 0; j < 4096; j++)
+            PostQueuedCompletionStatus(port, 0, j, NULL);
+
+        ticks = GetTickCount();
+        for (total = calls = 0; total < 4096; total += written, calls++)
+        {
+            ret = pGetQueuedCompletionStatusEx(port, entries, batch_sizes[i], &written, 0, FALSE);
+            ok(ret, "GetQueuedCompletionStatusEx failed with %u\n", GetLastError());
+            if (!ret) break;
+            ok(entries[0].lpCompletionKey == total, "got key %lu, expected %u\n",
+               entries[0].lpCompletionKey, total);
+        }
+        ok(total == 4096, "got %u packets\n", total);
+        trace("batch size %u: %u calls for %u packets (%.3f calls/packet), %u ms\n",
+              batch_sizes[i], calls, total, (double)calls / total, GetTickCount() - ticks);
+    }
+
+    CloseHandle(port);
+}
+
+static DWORD WINAPI pingpong_thread(void *arg)
+{
+    HANDLE *events = arg;
+    DWORD ret;
+
+    for (;;)
+    {
+        ret = WaitForSingleObject(events[0], 5000);
+        if (ret != WAIT_OBJECT_0 || !events[2]) break;
+        SetEvent(events[1]);
+    }
+    return ret;
+}
+
+static void test_pingpong_latency(void)
+{
+    static const int rounds = 20000;
+    LARGE_INTEGER freq, start, end;
+    HANDLE events[3], thread;
+    DWORD ret;
+    int i;
+
+    events[0] = CreateEventW(NULL, FALSE, FALSE, NULL);
+    events[1] = CreateEventW(NULL, FALSE, FALSE, NULL);
+    events[2] = (HANDLE)1;  /* keep running */
+    thread = CreateThread(NULL, 0, pingpong_thread, events, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with %u\n", GetLastError());
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < rounds; i++)
+    {
+        SetEvent(events[0]);
+        ret = WaitForSingleObject(events[1], 5000);
+        ok(ret == WAIT_OBJECT_0, "round %d: got %u\n", i, ret);
+        if (ret != WAIT_OBJECT_0) break;
+    }
+    QueryPerformanceCounter(&end);
+    trace("event ping-pong: %d round trips, %.2f us per round trip\n", i,
+          (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / (i ? i : 1));
+
+    events[2] = NULL;
+    SetEvent(events[0]);
+    ret = WaitForSingleObject(thread, 5000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    CloseHandle(thread);
+    CloseHandle(events[0]);
+    CloseHandle(events[1]);
+}
+
+struct wait_all_info
+{
+    HANDLE objects[3];  /* mutex, semaphore, auto-reset event */
+    LONG inside;
+    LONG total;
+    LONG errors;
+};
+
+static DWORD WINAPI wait_all_thread(void *arg)
+{
+    struct wait_all_info *info = arg;
+    DWORD ret;
+    LONG prev;
+    int i;
+
+    for (i = 0; i < 2000; i++)
+    {
+        ret = WaitForMultipleObjects(3, info->objects, TRUE, 5000);
+        if (ret != WAIT_OBJECT_0)
+        {
+            InterlockedIncrement(&info->errors);
+            break;
+        }
+        /* each object on its own guarantees exclusive access */
+        if (InterlockedIncrement(&info->inside) != 1) InterlockedIncrement(&info->errors);
+        info->total++;
+        InterlockedDecrement(&info->inside);
+        SetEvent(info->objects[2]);
+        if (!ReleaseSemaphore(info->objects[1], 1, &prev) || prev) InterlockedIncrement(&info->errors);
+        if (!ReleaseMutex(info->objects[0])) InterlockedIncrement(&info->errors);
+    }
+    return 0;
+}
+
+static DWORD WINAPI abandon_mutex_thread(void *arg)
+{
+    return WaitForSingleObject(arg, 0);
+}
+
+static void test_wait_all_contention(void)
+{
+    LARGE_INTEGER freq, start, end;
+    struct wait_all_info info;
+    HANDLE threads[4];
+    DWORD ret;
+    int i;
+
+    info.objects[0] = CreateMutexW(NULL, FALSE, NULL);
+    info.objects[1] = CreateSemaphoreW(NULL, 1, 1, NULL);
+    info.objects[2] = CreateEventW(NULL, FALSE, TRUE, NULL);
+    info.inside = info.total = info.errors = 0;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 4; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, wait_all_thread, &info, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with %u\n", GetLastError());
+    }
+    ret = WaitForMultipleObjects(4, threads, TRUE, 60000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    QueryPerformanceCounter(&end);
+    for (i = 0; i < 4; i++) CloseHandle(threads[i]);
+
+    ok(!info.errors, "got %d errors\n", info.errors);
+    ok(info.total == 4 * 2000, "got %d acquisitions\n", info.total);
+    trace("wait-all contention: %d acquisitions by 4 threads, %.2f us per acquisition\n", info.total,
+          (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / (info.total ? info.total : 1));
+
+    /* all objects are back to their initial state */
+    ret = WaitForMultipleObjects(3, info.objects, TRUE, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(info.objects[1], 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    ret = WaitForSingleObject(info.objects[2], 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    ok(ReleaseMutex(info.objects[0]), "ReleaseMutex failed with %u\n", GetLastError());
+    ok(ReleaseSemaphore(info.objects[1], 1, NULL), "ReleaseSemaphore failed with %u\n", GetLastError());
+    ok(!ReleaseSemaphore(info.objects[1], 1, NULL), "ReleaseSemaphore succeeded\n");
+    ok(GetLastError() == ERROR_TOO_MANY_POSTS, "got error %u\n", GetLastError());
+    SetEvent(info.objects[2]);
+
+    /* a mutex abandoned by its owner is reported by a wait for all objects */
+    threads[0] = CreateThread(NULL, 0, abandon_mutex_thread, info.objects[0], 0, NULL);
+    ret = WaitForSingleObject(threads[0], 5000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    GetExitCodeThread(threads[0], &ret);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    CloseHandle(threads[0]);
+    ret = WaitForMultipleObjects(3, info.objects, TRUE, 1000);
+    ok(ret == WAIT_ABANDONED_0, "got %u\n", ret);
+    ret = WaitForSingleObject(info.objects[0], 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ok(ReleaseMutex(info.objects[0]), "ReleaseMutex failed with %u\n", GetLastError());
+    ok(ReleaseMutex(info.objects[0]), "ReleaseMutex failed with %u\n", GetLastError());
+    ok(!ReleaseMutex(info.objects[0]), "ReleaseMutex succeeded\n");
+
+    for (i = 0; i < 3; i++) CloseHandle(info.objects[i]);
+}
+
+static DWORD WINAPI pulse_wait_thread(void *arg)
+{
+    return WaitForSingleObject(arg, 5000);
+}
+
+static void test_pulse_event(void)
+{
+    HANDLE event, threads[2];
+    DWORD ret, code;
+    int i;
+
+    /* all the waiters of a manual-reset event are released */
+    event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    for (i = 0; i < 2; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, pulse_wait_thread, event, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with %u\n", GetLastError());
+    }
+    Sleep(100);  /* let them block */
+    ok(PulseEvent(event), "PulseEvent failed with %u\n", GetLastError());
+    ret = WaitForMultipleObjects(2, threads, TRUE, 1000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    for (i = 0; i < 2; i++)
+    {
+        GetExitCodeThread(threads[i], &code);
+        ok(code == WAIT_OBJECT_0, "thread %d got %u\n", i, code);
+        CloseHandle(threads[i]);
+    }
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    CloseHandle(event);
+
+    /* a single waiter of an auto-reset event is released per pulse */
+    event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    for (i = 0; i < 2; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, pulse_wait_thread, event, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with %u\n", GetLastError());
+    }
+    Sleep(100);
+    ok(PulseEvent(event), "PulseEvent failed with %u\n", GetLastError());
+    ret = WaitForMultipleObjects(2, threads, FALSE, 1000);
+    ok(ret == WAIT_OBJECT_0 || ret == WAIT_OBJECT_0 + 1, "got %u\n", ret);
+    i = (ret == WAIT_OBJECT_0) ? 1 : 0;
+    ret = WaitForSingleObject(threads[i], 100);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    ok(PulseEvent(event), "PulseEvent failed with %u\n", GetLastError());
+    ret = WaitForSingleObject(threads[i], 1000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    for (i = 0; i < 2; i++)
+    {
+        GetExitCodeThread(threads[i], &code);
+        ok(code == WAIT_OBJECT_0, "thread %d got %u\n", i, code);
+        CloseHandle(threads[i]);
+    }
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    CloseHandle(event);
+}
+
 static void test_timer_queue(void)
 {
     HANDLE q, t0, t1, t2, t3, t4, t5;
@@ -2467,6 +2829,354 @@ static void test_srwlock_example(void)
     trace("number of total exclusive accesses is %d\n", srwlock_protected_value);
 }
 
+struct srwlock_contention_info
+{
+    SRWLOCK lock;
+    unsigned int shared_percent;
+    unsigned int iterations;
+    LONG writers;       /* threads inside the exclusive section */
+    LONG readers;       /* threads inside the shared section */
+    LONG value;         /* protected by the lock, incremented by writers */
+    LONG exclusive;     /* number of exclusive acquisitions */
+    LONG errors;
+};
+
+static DWORD WINAPI srwlock_contention_thread(void *arg)
+{
+    struct srwlock_contention_info *info = arg;
+    unsigned int i, seed = GetCurrentThreadId();
+    LONG old;
+
+    for (i = 0; i < info->iterations; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 100 < info->shared_percent)
+        {
+            pAcquireSRWLockShared(&info->lock);
+            InterlockedIncrement(&info->readers);
+            if (info->writers) InterlockedIncrement(&info->errors);
+            old = info->value;
+            if (old != info->value) InterlockedIncrement(&info->errors);
+            InterlockedDecrement(&info->readers);
+            pReleaseSRWLockShared(&info->lock);
+        }
+        else
+        {
+            pAcquireSRWLockExclusive(&info->lock);
+            if (InterlockedIncrement(&info->writers) != 1 || info->readers)
+                InterlockedIncrement(&info->errors);
+            info->value++;
+            info->exclusive++;
+            InterlockedDecrement(&info->writers);
+            pReleaseSRWLockExclusive(&info->lock);
+        }
+    }
+    return 0;
+}
+
+static void test_srwlock_contention(void)
+{
+    static const unsigned int thread_counts[] = {1, 2, 4, 8, 16, 32};
+    static const struct
+    {
+        const char *name;
+        unsigned int shared_percent;
+    }
+    workloads[] =
+    {
+        { "reader-heavy", 95 },
+        { "writer-heavy", 20 },
+    };
+    struct srwlock_contention_info info;
+    LARGE_INTEGER freq, start, end;
+    HANDLE threads[32];
+    unsigned int i, j, k, ops;
+    DWORD ret;
+
+    if (!pInitializeSRWLock)
+    {
+        win_skip("no srw lock support.\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&freq);
+
+    for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        for (j = 0; j < sizeof(thread_counts) / sizeof(thread_counts[0]); j++)
+        {
+            memset(&info, 0, sizeof(info));
+            pInitializeSRWLock(&info.lock);
+            info.shared_percent = workloads[i].shared_percent;
+            info.iterations = 64000 / thread_counts[j];
+            ops = info.iterations * thread_counts[j];
+
+            /* hold the lock so that all threads start contending together */
+            pAcquireSRWLockExclusive(&info.lock);
+            for (k = 0; k < thread_counts[j]; k++)
+            {
+                threads[k] = CreateThread(NULL, 0, srwlock_contention_thread, &info, 0, NULL);
+                ok(threads[k] != NULL, "CreateThread failed with %u\n", GetLastError());
+            }
+            QueryPerformanceCounter(&start);
+            pReleaseSRWLockExclusive(&info.lock);
+
+            for (k = 0; k < thread_counts[j]; k++)
+            {
+                ret = WaitForSingleObject(threads[k], 30000);
+                ok(ret == WAIT_OBJECT_0, "%s, %u threads: got %u\n", workloads[i].name, thread_counts[j], ret);
+                CloseHandle(threads[k]);
+            }
+            QueryPerformanceCounter(&end);
+
+            ok(!info.errors, "%s, %u threads: %d errors\n", workloads[i].name, thread_counts[j], info.errors);
+            ok(info.value == info.exclusive, "%s, %u threads: value %d, expected %d\n",
+               workloads[i].name, thread_counts[j], info.value, info.exclusive);
+            ok(!info.readers && !info.writers, "%s, %u threads: %d readers, %d writers left\n",
+               workloads[i].name, thread_counts[j], info.readers, info.writers);
+            ok(pTryAcquireSRWLockExclusive(&info.lock), "%s, %u threads: lock still held\n",
+               workloads[i].name, thread_counts[j]);
+            pReleaseSRWLockExclusive(&info.lock);
+
+            trace("%s, %2u threads: %u ops (%d exclusive), %.3f us per op\n",
+                  workloads[i].name, thread_counts[j], ops, info.exclusive,
+                  (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / ops);
+        }
+    }
+}
+
+static LONG64 address_value;
+
+static DWORD WINAPI wait_on_address_thread(void *arg)
+{
+    SIZE_T size = (SIZE_T)arg;
+    LONG64 compare = 0;
+    BOOL ret;
+
+    /* the value may change between the start of the thread and the wait */
+    while (!memcmp((void *)&address_value, &compare, size))
+    {
+        ret = pWaitOnAddress(&address_value, &compare, size, 5000);
+        ok(ret, "size %u: WaitOnAddress failed with %u\n", (DWORD)size, GetLastError());
+        if (!ret) break;
+    }
+    return 0;
+}
+
+static void test_wait_on_address(void)
+{
+    static const SIZE_T sizes[] = {1, 2, 4, 8};
+    LONG64 compare;
+    HANDLE thread;
+    unsigned int i;
+    DWORD ticks;
+    BOOL ret;
+
+    if (!pWaitOnAddress)
+    {
+        win_skip("WaitOnAddress not supported\n");
+        return;
+    }
+
+    address_value = 0;
+    compare = 0;
+    SetLastError(0xdeadbeef);
+    ret = pWaitOnAddress(&address_value, &compare, 3, 0);
+    ok(!ret, "WaitOnAddress succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ret = pWaitOnAddress(&address_value, &compare, 8, 0);
+    ok(!ret, "WaitOnAddress succeeded\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+
+    ticks = GetTickCount();
+    ret = pWaitOnAddress(&address_value, &compare, 4, 100);
+    ticks = GetTickCount() - ticks;
+    ok(!ret, "WaitOnAddress succeeded\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+    ok(ticks >= 80, "WaitOnAddress returned after %u ms\n", ticks);
+
+    /* values that differ return immediately */
+    compare = 1;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        ret = pWaitOnAddress(&address_value, &compare, sizes[i], INFINITE);
+        ok(ret, "size %u: WaitOnAddress failed with %u\n", (DWORD)sizes[i], GetLastError());
+    }
+
+    /* waking an address without waiters is a no-op */
+    pWakeByAddressSingle(&address_value);
+    pWakeByAddressAll(&address_value);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        address_value = 0;
+        thread = CreateThread(NULL, 0, wait_on_address_thread, (void *)sizes[i], 0, NULL);
+        ok(thread != NULL, "CreateThread failed with %u\n", GetLastError());
+        Sleep(50);
+        ok(WaitForSingleObject(thread, 0) == WAIT_TIMEOUT, "size %u: thread didn't wait\n", (DWORD)sizes[i]);
+
+        /* change the highest byte covered by the compared size */
+        address_value = (LONG64)1 << ((sizes[i] - 1) * 8);
+        pWakeByAddressSingle(&address_value);
+        ok(WaitForSingleObject(thread, 5000) == WAIT_OBJECT_0, "size %u: thread wasn't woken\n", (DWORD)sizes[i]);
+        CloseHandle(thread);
+    }
+}
+
+static DWORD WINAPI address_pingpong_thread(void *arg)
+{
+    LONG *value = arg;
+    LONG compare;
+    int i;
+
+    /* odd values are ours to answer, even values belong to the main thread */
+    for (i = 0; i < 20000; i++)
+    {
+        while ((compare = *value) % 2 == 0)
+            pWaitOnAddress(value, &compare, sizeof(compare), 5000);
+        InterlockedIncrement(value);
+        pWakeByAddressSingle(value);
+    }
+    return 0;
+}
+
+static void test_wait_on_address_latency(void)
+{
+    static const int rounds = 20000;
+    LARGE_INTEGER freq, start, end;
+    LONG value = 0, compare;
+    HANDLE thread;
+    int i;
+
+    if (!pWaitOnAddress)
+    {
+        win_skip("WaitOnAddress not supported\n");
+        return;
+    }
+
+    thread = CreateThread(NULL, 0, address_pingpong_thread, &value, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with %u\n", GetLastError());
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < rounds; i++)
+    {
+        InterlockedIncrement(&value);
+        pWakeByAddressSingle(&value);
+        while ((compare = value) % 2)
+            pWaitOnAddress(&value, &compare, sizeof(compare), 5000);
+    }
+    QueryPerformanceCounter(&end);
+    ok(value == rounds * 2, "got value %d\n", value);
+    trace("WaitOnAddress ping-pong: %d round trips, %.2f us per round trip\n", rounds,
+          (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / rounds);
+
+    ok(WaitForSingleObject(thread, 5000) == WAIT_OBJECT_0, "thread didn't exit\n");
+    CloseHandle(thread);
+}
+
+struct address_ticket_info
+{
+    LONG ticket;    /* number of the thread allowed to run */
+    LONG threads;
+    LONG rounds;
+    LONG errors;
+};
+
+struct address_ticket_thread_info
+{
+    struct address_ticket_info *info;
+    LONG index;
+};
+
+static DWORD WINAPI address_ticket_thread(void *arg)
+{
+    struct address_ticket_thread_info *thread_info = arg;
+    struct address_ticket_info *info = thread_info->info;
+    LONG compare, next;
+    int i;
+
+    /* the threads take turns, waking each other through a single address */
+    for (i = 0; i < info->rounds; i++)
+    {
+        next = i * info->threads + thread_info->index;
+        while ((compare = info->ticket) != next)
+        {
+            if (compare > next)
+            {
+                InterlockedIncrement(&info->errors);
+                return 0;
+            }
+            if (!pWaitOnAddress(&info->ticket, &compare, sizeof(compare), 10000))
+            {
+                InterlockedIncrement(&info->errors);
+                return 0;
+            }
+        }
+        InterlockedIncrement(&info->ticket);
+        pWakeByAddressAll(&info->ticket);
+    }
+    return 0;
+}
+
+static void test_wait_on_address_throughput(void)
+{
+    static const unsigned int thread_counts[] = {2, 4, 8};
+    struct address_ticket_thread_info thread_info[8];
+    struct address_ticket_info info;
+    LARGE_INTEGER freq, start, end;
+    HANDLE threads[8];
+    unsigned int i, j;
+    LONG value = 0;
+
+    if (!pWaitOnAddress)
+    {
+        win_skip("WaitOnAddress not supported\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&freq);
+
+    /* waking an address nobody waits on should be cheap */
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 1000000; i++) pWakeByAddressSingle(&value);
+    QueryPerformanceCounter(&end);
+    trace("WakeByAddressSingle without waiters: %.1f ns per call\n",
+          (end.QuadPart - start.QuadPart) * 1000000000.0 / freq.QuadPart / 1000000);
+
+    for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+    {
+        info.ticket = 0;
+        info.threads = thread_counts[i];
+        info.rounds = 4000 / thread_counts[i];
+        info.errors = 0;
+
+        QueryPerformanceCounter(&start);
+        for (j = 0; j < thread_counts[i]; j++)
+        {
+            thread_info[j].info = &info;
+            thread_info[j].index = j;
+            threads[j] = CreateThread(NULL, 0, address_ticket_thread, &thread_info[j], 0, NULL);
+            ok(threads[j] != NULL, "CreateThread failed with %u\n", GetLastError());
+        }
+        for (j = 0; j < thread_counts[i]; j++)
+        {
+            ok(WaitForSingleObject(threads[j], 30000) == WAIT_OBJECT_0, "thread %u didn't exit\n", j);
+            CloseHandle(threads[j]);
+        }
+        QueryPerformanceCounter(&end);
+
+        ok(!info.errors, "%u threads: %d errors\n", thread_counts[i], info.errors);
+        ok(info.ticket == info.rounds * info.threads, "%u threads: got ticket %d, expected %d\n",
+           thread_counts[i], info.ticket, info.rounds * info.threads);
+        trace("WaitOnAddress hand-off, %u threads: %d hand-offs, %.2f us per hand-off\n",
+              thread_counts[i], info.ticket,
+              (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / (info.ticket ? info.ticket : 1));
+    }
+}
+
 static DWORD WINAPI alertable_wait_thread(void *param)
 {
     HANDLE *semaphores = param;
@@ -2654,6 +3364,7 @@ START_TEST(sync)
     int argc;
     HMODULE hdll = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+    HMODULE hkernelbase = LoadLibraryA("kernelbase.dll");
 
     pChangeTimerQueueTimer = (void*)GetProcAddress(hdll, "ChangeTimerQueueTimer");
     pCreateTimerQueue = (void*)GetProcAddress(hdll, "CreateTimerQueue");
@@ -2680,6 +3391,10 @@ START_TEST(sync)
     pReleaseSRWLockShared = (void *)GetProcAddress(hdll, "ReleaseSRWLockShared");
     pTryAcquireSRWLockExclusive = (void *)GetProcAddress(hdll, "TryAcquireSRWLockExclusive");
     pTryAcquireSRWLockShared = (void *)GetProcAddress(hdll, "TryAcquireSRWLockShared");
+    pGetQueuedCompletionStatusEx = (void *)GetProcAddress(hdll, "GetQueuedCompletionStatusEx");
+    pWaitOnAddress = (void *)GetProcAddress(hkernelbase, "WaitOnAddress");
+    pWakeByAddressAll = (void *)GetProcAddress(hkernelbase, "WakeByAddressAll");
+    pWakeByAddressSingle = (void *)GetProcAddress(hkernelbase, "WakeByAddressSingle");
     pNtAllocateVirtualMemory = (void *)GetProcAddress(hntdll, "NtAllocateVirtualMemory");
     pNtFreeVirtualMemory = (void *)GetProcAddress(hntdll, "NtFreeVirtualMemory");
     pNtWaitForSingleObject = (void *)GetProcAddress(hntdll, "NtWaitForSingleObject");
@@ -2704,7 +3419,12 @@ START_TEST(sync)
     test_event();
     test_semaphore();
     test_waitable_timer();
+    test_many_timers();
     test_iocp_callback();
+    test_iocp_batch();
+    test_pingpong_latency();
+    test_wait_all_contention();
+    test_pulse_event();
     test_timer_queue();
     test_WaitForSingleObject();
     test_WaitForMultipleObjects();
@@ -2713,6 +3433,10 @@ START_TEST(sync)
     test_condvars_consumer_producer();
     test_srwlock_base();
     test_srwlock_example();
+    test_srwlock_contention();
+    test_wait_on_address();
+    test_wait_on_address_latency();
+    test_wait_on_address_throughput();
     test_alertable_wait();
     test_apc_deadlock();
 }
@@ -41,6 +41,7 @@ static LPVOID (WINAPI *pVirtualAllocEx)(HANDLE, LPVOID, SIZE_T, DWORD, DWORD);
 static BOOL   (WINAPI *pVirtualFreeEx)(HANDLE, LPVOID, SIZE_T, DWORD);
 static UINT   (WINAPI *pGetWriteWatch)(DWORD,LPVOID,SIZE_T,LPVOID*,ULONG_PTR*,ULONG*);
 static UINT   (WINAPI *pResetWriteWatch)(LPVOID,SIZE_T);
+static SIZE_T (WINAPI *pGetLargePageMinimum)(void);
 static NTSTATUS (WINAPI *pNtAreMappedFilesTheSame)(PVOID,PVOID);
 static NTSTATUS (WINAPI *pNtCreateSection)(HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *,
                                            const LARGE_INTEGER *, ULONG, ULONG, HANDLE );
@@ -225,6 +226,83 @@ static void test_VirtualAllocEx(void)
     CloseHandle(hProcess);
 }
 
+static void test_process_memory_bulk(void)
+{
+    const SIZE_T size = 16 * 1024 * 1024, block = 0x10000;
+    LARGE_INTEGER freq, start, end;
+    SIZE_T i, count;
+    char *src, *dst, *addr;
+    HANDLE hProcess;
+    double elapsed;
+    DWORD val;
+    BOOL b;
+
+    if (!pVirtualAllocEx || !pVirtualFreeEx)
+    {
+        win_skip("Virtual{Alloc,Free}Ex not available\n");
+        return;
+    }
+
+    hProcess = create_target_process("sleep");
+    ok(hProcess != NULL, "Can't start process\n");
+
+    addr = pVirtualAllocEx(hProcess, NULL, size, MEM_COMMIT, PAGE_READWRITE);
+    ok(addr != NULL, "VirtualAllocEx error %u\n", GetLastError());
+    src = VirtualAlloc( NULL, size, MEM_COMMIT, PAGE_READWRITE );
+    dst = VirtualAlloc( NULL, size, MEM_COMMIT, PAGE_READWRITE );
+    for (i = 0; i < size / sizeof(DWORD); i++) ((DWORD *)src)[i] = i;
+
+    b = WriteProcessMemory(hProcess, addr, src, size, &count);
+    ok(b && count == size, "%lu bytes written\n", count);
+
+    /* bulk reads, as done when dumping a process */
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < size; i += block)
+    {
+        b = ReadProcessMemory(hProcess, addr + i, dst + i, block, &count);
+        if (!b || count != block) break;
+    }
+    QueryPerformanceCounter(&end);
+    ok(i == size, "read failed at offset %lx, error %u\n", i, GetLastError());
+    ok(!memcmp(src, dst, size), "Data from remote process differs\n");
+    elapsed = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+    trace("read %lu MB in %lu kB blocks: %.1f MB/s\n", size >> 20, block >> 10,
+          elapsed > 0 ? (size >> 20) / elapsed : 0.0);
+
+    /* small reads, as done by debuggers */
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 10000; i++)
+    {
+        b = ReadProcessMemory(hProcess, addr + i * sizeof(DWORD), &val, sizeof(val), &count);
+        if (!b || val != i) break;
+    }
+    QueryPerformanceCounter(&end);
+    ok(i == 10000, "read failed at %lu, error %u\n", i, GetLastError());
+    trace("%.2f us per %u-byte read\n",
+          (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / 10000, (UINT)sizeof(val));
+
+    val = 0xdeadbeef;
+    b = WriteProcessMemory(hProcess, addr + 8, &val, sizeof(val), &count);
+    ok(b && count == sizeof(val), "%lu bytes written\n", count);
+    val = 0;
+    b = ReadProcessMemory(hProcess, addr + 8, &val, sizeof(val), &count);
+    ok(b && count == sizeof(val), "%lu bytes read\n", count);
+    ok(val == 0xdeadbeef, "got %08x\n", val);
+
+    TerminateProcess(hProcess, 0);
+    WaitForSingleObject(hProcess, INFINITE);
+
+    /* the memory of a dead process can't be read anymore */
+    b = ReadProcessMemory(hProcess, addr, dst, block, &count);
+    ok(!b, "ReadProcessMemory succeeded\n");
+    ok(count == 0, "%lu bytes read\n", count);
+
+    CloseHandle(hProcess);
+    VirtualFree( src, 0, MEM_RELEASE );
+    VirtualFree( dst, 0, MEM_RELEASE );
+}
+
 static void test_VirtualAlloc(void)
 {
     void *addr1, *addr2;
@@ -2296,6 +2374,306 @@ static void test_write_watch(void)
     VirtualFree( base, 0, MEM_RELEASE );
 }
 
+static void test_write_watch_cycles(void)
+{
+    static const ULONG pages = 256, cycles = 200;
+    void *results[256];
+    ULONG_PTR count;
+    ULONG i, j, pagesize;
+    DWORD start, ret;
+    char *base, *other;
+
+    if (!pGetWriteWatch || !pResetWriteWatch)
+    {
+        win_skip( "GetWriteWatch not supported\n" );
+        return;
+    }
+
+    base = VirtualAlloc( 0, pages * si.dwPageSize, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE );
+    other = VirtualAlloc( 0, pages * si.dwPageSize, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE );
+    if (!base || !other)
+    {
+        win_skip( "MEM_WRITE_WATCH not supported\n" );
+        VirtualFree( base, 0, MEM_RELEASE );
+        VirtualFree( other, 0, MEM_RELEASE );
+        return;
+    }
+
+    /* a reset of one range must not lose the writes to another one */
+    other[5 * si.dwPageSize] = 1;
+    ret = pResetWriteWatch( base, pages * si.dwPageSize );
+    ok( !ret, "ResetWriteWatch failed %u\n", GetLastError() );
+    count = pages;
+    ret = pGetWriteWatch( WRITE_WATCH_FLAG_RESET, other, pages * si.dwPageSize, results, &count, &pagesize );
+    ok( !ret, "GetWriteWatch failed %u\n", GetLastError() );
+    ok( count == 1, "wrong count %lu\n", count );
+    ok( count && results[0] == other + 5 * si.dwPageSize, "wrong result %p\n", results[0] );
+
+    /* allocate/scan cycles, as done by a garbage collector */
+    start = GetTickCount();
+    for (i = 0; i < cycles; i++)
+    {
+        for (j = i % 4; j < pages; j += 4) base[j * si.dwPageSize + i] = i;
+        count = pages;
+        ret = pGetWriteWatch( WRITE_WATCH_FLAG_RESET, base, pages * si.dwPageSize, results, &count, &pagesize );
+        ok( !ret, "GetWriteWatch failed %u\n", GetLastError() );
+        if (count != pages / 4) break;
+    }
+    ok( i == cycles, "cycle %u: wrong count %lu\n", i, count );
+    trace( "%u write watch cycles of %u pages in %u ms\n", cycles, pages, GetTickCount() - start );
+
+    VirtualFree( base, 0, MEM_RELEASE );
+    VirtualFree( other, 0, MEM_RELEASE );
+}
+
+struct write_watch_thread_args
+{
+    char *base;
+    ULONG pages;
+    BYTE *written;
+    volatile LONG stop;
+};
+
+static DWORD WINAPI write_watch_thread( void *arg )
+{
+    struct write_watch_thread_args *args = arg;
+    ULONG i;
+
+    for (i = 0; !args->stop; i = (i + 1) % args->pages)
+    {
+        args->base[i * si.dwPageSize] = 1;
+        args->written[i] = 1;
+    }
+    return 0;
+}
+
+static void test_write_watch_threads(void)
+{
+    static const ULONG pages = 64;
+    struct write_watch_thread_args args;
+    void *results[64];
+    BYTE written[64];
+    ULONG_PTR count;
+    ULONG i, j, pagesize;
+    HANDLE thread;
+    DWORD ret;
+    char *base;
+
+    if (!pGetWriteWatch || !pResetWriteWatch)
+    {
+        win_skip( "GetWriteWatch not supported\n" );
+        return;
+    }
+
+    base = VirtualAlloc( 0, pages * si.dwPageSize, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE );
+    args.base = VirtualAlloc( 0, pages * si.dwPageSize, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE );
+    if (!base || !args.base)
+    {
+        win_skip( "MEM_WRITE_WATCH not supported\n" );
+        VirtualFree( base, 0, MEM_RELEASE );
+        VirtualFree( args.base, 0, MEM_RELEASE );
+        return;
+    }
+    ret = pResetWriteWatch( args.base, pages * si.dwPageSize );
+    ok( !ret, "ResetWriteWatch failed %u\n", GetLastError() );
+
+    /* resetting one range while another thread writes to a second one must not lose any write */
+    memset( written, 0, sizeof(written) );
+    args.pages = pages;
+    args.written = written;
+    args.stop = 0;
+    thread = CreateThread( NULL, 0, write_watch_thread, &args, 0, NULL );
+    ok( thread != NULL, "CreateThread failed %u\n", GetLastError() );
+    for (i = 0; i < 500; i++)
+    {
+        base[(i % pages) * si.dwPageSize] = 1;
+        ret = pResetWriteWatch( base, pages * si.dwPageSize );
+        ok( !ret, "ResetWriteWatch failed %u\n", GetLastError() );
+    }
+    args.stop = 1;
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+
+    count = pages;
+    ret = pGetWriteWatch( 0, args.base, pages * si.dwPageSize, results, &count, &pagesize );
+    ok( !ret, "GetWriteWatch failed %u\n", GetLastError() );
+    for (i = j = 0; i < count; i++)
+    {
+        ULONG page = ((char *)results[i] - args.base) / si.dwPageSize;
+        ok( page < pages, "wrong result %p\n", results[i] );
+        if (page < pages) written[page] = 0;
+    }
+    for (i = 0; i < pages; i++) if (written[i]) j++;
+    ok( !j, "%u written pages not reported, count %lu\n", j, count );
+
+    VirtualFree( base, 0, MEM_RELEASE );
+    VirtualFree( args.base, 0, MEM_RELEASE );
+}
+
+static void test_write_watch_soft_dirty(void)
+{
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = { sizeof(si) };
+    char cmdline[MAX_PATH], **argv;
+    DWORD ret;
+
+    /* run the write watch tests again with the soft-dirty backend, if the kernel supports it */
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" virtual softdirty", argv[0] );
+    SetEnvironmentVariableA( "WINESOFTDIRTY", "1" );
+    ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    SetEnvironmentVariableA( "WINESOFTDIRTY", NULL );
+    ok( ret, "CreateProcess(%s) error %d\n", cmdline, GetLastError() );
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hThread );
+    CloseHandle( pi.hProcess );
+}
+
+static ULONG random_access( char *base, SIZE_T size, ULONG count )
+{
+    ULONG i, seed = 12345, sum = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sum += base[(seed % (size / 64)) * 64]++;
+    }
+    return sum;
+}
+
+static void test_large_pages(void)
+{
+    static const ULONG count = 4000000;
+    SIZE_T large_size, size;
+    DWORD start, small_time, large_time, old_prot;
+    char *base, *large;
+    BOOL ret;
+
+    if (!pGetLargePageMinimum)
+    {
+        win_skip( "large pages not supported\n" );
+        return;
+    }
+    if (!(large_size = pGetLargePageMinimum()))
+    {
+        SetLastError( 0xdeadbeef );
+        large = VirtualAlloc( NULL, 0x400000, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+        ok( !large, "VirtualAlloc succeeded without large page support\n" );
+        ok( GetLastError() == ERROR_INVALID_PARAMETER, "wrong error %u\n", GetLastError() );
+        win_skip( "large pages not supported\n" );
+        return;
+    }
+
+    SetLastError( 0xdeadbeef );
+    large = VirtualAlloc( NULL, large_size / 2, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+    ok( !large, "VirtualAlloc succeeded for a partial large page\n" );
+    large = VirtualAlloc( NULL, large_size, MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE );
+    ok( !large, "VirtualAlloc succeeded without MEM_COMMIT\n" );
+
+    size = 16 * large_size;
+    large = VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+    if (!large)
+    {
+        /* requires SeLockMemoryPrivilege on Windows */
+        win_skip( "MEM_LARGE_PAGES not available %u\n", GetLastError() );
+        return;
+    }
+    ok( !((ULONG_PTR)large & (large_size - 1)), "%p not aligned to %lx\n", large, large_size );
+
+    /* random accesses over a range that doesn't fit in the TLB with small pages */
+    base = VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+    ok( base != NULL, "VirtualAlloc failed %u\n", GetLastError() );
+    memset( base, 0, size );
+    memset( large, 0, size );
+
+    start = GetTickCount();
+    random_access( base, size, count );
+    small_time = GetTickCount() - start;
+    start = GetTickCount();
+    random_access( large, size, count );
+    large_time = GetTickCount() - start;
+    trace( "%u random accesses over %lu MB: %u ms with small pages, %u ms with large pages\n",
+           count, size >> 20, small_time, large_time );
+
+    /* large pages can't be split */
+    SetLastError( 0xdeadbeef );
+    ret = VirtualFree( large + large_size, large_size, MEM_DECOMMIT );
+    ok( !ret, "VirtualFree succeeded on part of a large page allocation\n" );
+    ok( GetLastError() == ERROR_INVALID_PARAMETER, "wrong error %u\n", GetLastError() );
+    SetLastError( 0xdeadbeef );
+    ret = VirtualProtect( large + large_size, 0x1000, PAGE_READONLY, &old_prot );
+    ok( !ret, "VirtualProtect succeeded on part of a large page allocation\n" );
+    ok( GetLastError() == ERROR_INVALID_PARAMETER, "wrong error %u\n", GetLastError() );
+    ret = VirtualProtect( large, size, PAGE_READONLY, &old_prot );
+    ok( ret, "VirtualProtect failed %u\n", GetLastError() );
+    ok( old_prot == PAGE_READWRITE, "wrong old protection %x\n", old_prot );
+    ok( large[size - 1] == 0, "wrong data %x\n", large[size - 1] );
+
+    VirtualFree( base, 0, MEM_RELEASE );
+    VirtualFree( large, 0, MEM_RELEASE );
+}
+
+static void test_alloc_patterns(void)
+{
+    static const ULONG count = 10000;
+    MEMORY_BASIC_INFORMATION info;
+    SIZE_T reserve_size, step, size;
+    DWORD start, old_prot;
+    char *base, *ptr, **blocks;
+    ULONG i;
+    BOOL ret;
+
+    /* a large sparse reservation, committed and protected in small pieces */
+    reserve_size = (SIZE_T)1 << (sizeof(void *) > sizeof(int) ? 40 : 28);
+    step = (reserve_size / count) & ~(SIZE_T)(si.dwPageSize - 1);
+    start = GetTickCount();
+    base = VirtualAlloc( NULL, reserve_size, MEM_RESERVE, PAGE_NOACCESS );
+    if (!base)
+    {
+        skip( "failed to reserve %lx bytes\n", reserve_size );
+        return;
+    }
+    for (i = 0; i < count; i++)
+    {
+        ptr = base + step * i;
+        ok( VirtualAlloc( ptr, 2 * si.dwPageSize, MEM_COMMIT, PAGE_READWRITE ) == ptr,
+            "commit failed at %p err %u\n", ptr, GetLastError() );
+        ptr[0] = 1;
+        ret = VirtualProtect( ptr, si.dwPageSize, PAGE_EXECUTE_READ, &old_prot );
+        ok( ret, "VirtualProtect failed at %p err %u\n", ptr, GetLastError() );
+    }
+    ptr = base + step * (count / 2);
+    VirtualQuery( ptr, &info, sizeof(info) );
+    ok( info.Protect == PAGE_EXECUTE_READ, "wrong Protect %x\n", info.Protect );
+    ok( info.RegionSize == si.dwPageSize, "wrong RegionSize %lx\n", info.RegionSize );
+    VirtualQuery( ptr + si.dwPageSize, &info, sizeof(info) );
+    ok( info.Protect == PAGE_READWRITE, "wrong Protect %x\n", info.Protect );
+    ok( info.RegionSize == si.dwPageSize, "wrong RegionSize %lx\n", info.RegionSize );
+    VirtualQuery( ptr + 2 * si.dwPageSize, &info, sizeof(info) );
+    ok( info.State == MEM_RESERVE, "wrong State %x\n", info.State );
+    ok( info.RegionSize == step - 2 * si.dwPageSize, "wrong RegionSize %lx\n", info.RegionSize );
+    ret = VirtualFree( base, 0, MEM_RELEASE );
+    ok( ret, "VirtualFree failed %u\n", GetLastError() );
+    trace( "reserve %lu MB, commit/protect %u pieces, free: %u ms\n",
+           reserve_size >> 20, count, GetTickCount() - start );
+
+    /* many small allocations, freed in a different order */
+    blocks = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*blocks) );
+    size = 0x10000;
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        blocks[i] = VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+        if (!blocks[i]) break;
+    }
+    ok( i == count, "allocation %u failed err %u\n", i, GetLastError() );
+    for (i = 0; i < count; i += 2) if (blocks[i]) VirtualFree( blocks[i], 0, MEM_RELEASE );
+    for (i = 0; i < count; i += 2) blocks[i] = VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+    for (i = 0; i < count; i++) if (blocks[i]) VirtualFree( blocks[i], 0, MEM_RELEASE );
+    trace( "%u allocations of %lu bytes: %u ms\n", 2 * count, size, GetTickCount() - start );
+    HeapFree( GetProcessHeap(), 0, blocks );
+}
+
 #if defined(__i386__) || defined(__x86_64__)
 
 static DWORD WINAPI stack_commit_func( void *arg )
@@ -4331,7 +4709,7 @@ START_TEST(virtual)
     char **argv;
     argc = winetest_get_mainargs( &argv );
 
-    if (argc >= 3)
+    if (argc >= 3 && strcmp(argv[2], "softdirty"))
     {
         if (!strcmp(argv[2], "sleep"))
         {
@@ -4369,6 +4747,7 @@ START_TEST(virtual)
     pVirtualAllocEx = (void *) GetProcAddress(hkernel32, "VirtualAllocEx");
     pVirtualFreeEx = (void *) GetProcAddress(hkernel32, "VirtualFreeEx");
     pGetWriteWatch = (void *) GetProcAddress(hkernel32, "GetWriteWatch");
+    pGetLargePageMinimum = (void *) GetProcAddress(hkernel32, "GetLargePageMinimum");
     pResetWriteWatch = (void *) GetProcAddress(hkernel32, "ResetWriteWatch");
     pGetProcessDEPPolicy = (void *)GetProcAddress( hkernel32, "GetProcessDEPPolicy" );
     pIsWow64Process = (void *)GetProcAddress( hkernel32, "IsWow64Process" );
@@ -4386,6 +4765,14 @@ START_TEST(virtual)
     GetSystemInfo(&si);
     trace("system page size %#x\n", si.dwPageSize);
 
+    if (argc >= 3)  /* softdirty */
+    {
+        test_write_watch();
+        test_write_watch_cycles();
+        test_write_watch_threads();
+        return;
+    }
+
     test_shared_memory(FALSE);
     test_shared_memory_ro(FALSE, FILE_MAP_READ|FILE_MAP_WRITE);
     test_shared_memory_ro(FALSE, FILE_MAP_COPY);
@@ -4395,6 +4782,7 @@ START_TEST(virtual)
     test_VirtualAlloc_protection();
     test_VirtualProtect();
     test_VirtualAllocEx();
+    test_process_memory_bulk();
     test_VirtualAlloc();
     test_MapViewOfFile();
     test_NtMapViewOfSection();
@@ -4404,6 +4792,11 @@ START_TEST(virtual)
     test_IsBadWritePtr();
     test_IsBadCodePtr();
     test_write_watch();
+    test_write_watch_cycles();
+    test_write_watch_threads();
+    test_write_watch_soft_dirty();
+    test_large_pages();
+    test_alloc_patterns();
 #if defined(__i386__) || defined(__x86_64__)
     test_stack_commit();
 #endif
@@ -1000,14 +1000,35 @@ PTP_CLEANUP_GROUP WINAPI CreateThreadpoolCleanupGroup( void )
     return group;
 }
 
+/* callback wrapper translating the native io status into Win32 error codes */
+static void CALLBACK tp_io_callback( TP_CALLBACK_INSTANCE *instance, void *userdata, void *cvalue,
+                                     IO_STATUS_BLOCK *iosb, TP_IO *io )
+{
+    PTP_WIN32_IO_CALLBACK callback = *(void **)io;
+    callback( instance, userdata, cvalue, RtlNtStatusToDosError( iosb->Status ),
+              iosb->Information, io );
+}
+
 /***********************************************************************
  *              CreateThreadpoolIo (KERNEL32.@)
  */
 PTP_IO WINAPI CreateThreadpoolIo( HANDLE handle, PTP_WIN32_IO_CALLBACK callback,
                                   PVOID userdata, TP_CALLBACK_ENVIRON *environment )
 {
-    FIXME("(%p, %p, %p, %p): stub\n", handle, callback, userdata, environment);
-    return FALSE;
+    TP_IO *io;
+    NTSTATUS status;
+
+    TRACE( "%p, %p, %p, %p\n", handle, callback, userdata, environment );
+
+    status = TpAllocIoCompletion( &io, handle, tp_io_callback, userdata, environment );
+    if (status)
+    {
+        SetLastError( RtlNtStatusToDosError(status) );
+        return NULL;
+    }
+
+    *(void **)io = callback;
+    return io;
 }
 
 /***********************************************************************
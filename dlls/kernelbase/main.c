@@ -16,8 +16,11 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
 #include "windows.h"
 #include "appmodel.h"
+#include "winternl.h"
 
 #include "wine/debug.h"
 
@@ -83,3 +86,21 @@ BOOL WINAPI QuirkIsEnabled3(void *unk1, void *unk2)
     FIXME("(%p, %p) stub!\n", unk1, unk2);
     return FALSE;
 }
+
+/***********************************************************************
+ *          WaitOnAddress (KERNELBASE.@)
+ */
+BOOL WINAPI WaitOnAddress(volatile void *addr, void *cmp, SIZE_T size, DWORD timeout)
+{
+    LARGE_INTEGER time;
+    NTSTATUS status;
+
+    if (timeout != INFINITE)
+        time.QuadPart = -(LONGLONG)timeout * 10000;
+
+    status = RtlWaitOnAddress((const void *)addr, cmp, size, timeout != INFINITE ? &time : NULL);
+    if (status == STATUS_SUCCESS) return TRUE;
+
+    SetLastError(RtlNtStatusToDosError(status));
+    return FALSE;
+}
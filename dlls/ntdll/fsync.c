@@ -0,0 +1,678 @@
+/*
+ * In-process synchronization for events, semaphores and mutexes
+ *
+ * Copyright 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When WINEFSYNC=1 is set, the server keeps the state of events, semaphores
+ * and mutexes in a shared memory area (see server/fsync.c).  The functions
+ * below operate on that state directly and sleep on it with futexes, so that
+ * signaling and waiting don't need a server round trip.  They return
+ * STATUS_NOT_IMPLEMENTED whenever the operation has to go through the server,
+ * e.g. for waits involving other object types.
+ *
+ * Waits for all of several objects always go through the server, since they
+ * can't be satisfied atomically client-side.  Objects that have server-side
+ * waiters are flagged with FSYNC_SERVER_WAITING, and are then only acquired
+ * by the server; clients waiting for them fall back to a server wait too.
+ *
+ * NtPulseEvent goes through the server, which resets the state before the
+ * woken waiters get to check it; they notice the pulse through the pulse
+ * generation of the entry instead.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#include <time.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/library.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(fsync);
+
+#define TICKSPERSEC 10000000
+
+static struct fsync_entry *shm_entries;
+static unsigned int shm_count;
+static BOOL have_futex_waitv;
+
+#ifdef __linux__
+
+#define FUTEX_WAKE_OP_SHARED         1   /* FUTEX_WAKE */
+#define FUTEX_WAIT_BITSET_OP_SHARED  9   /* FUTEX_WAIT_BITSET */
+#define FUTEX_BITSET_MATCH_ANY       0xffffffff
+#define FUTEX_SIZE_U32               2   /* FUTEX2_SIZE_U32 */
+
+#ifndef __NR_futex_waitv
+#define __NR_futex_waitv 449
+#endif
+
+struct futex_waitv
+{
+    ULONGLONG    val;
+    ULONGLONG    uaddr;
+    unsigned int flags;
+    unsigned int reserved;
+};
+
+static inline int futex_wake( int *addr )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAKE_OP_SHARED, INT_MAX, NULL, 0, 0 );
+}
+
+static inline int futex_wait( int *addr, int val, const struct timespec *end )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAIT_BITSET_OP_SHARED, val, end, 0, FUTEX_BITSET_MATCH_ANY );
+}
+
+static inline int futex_waitv( struct futex_waitv *waiters, unsigned int count, const struct timespec *end )
+{
+    return syscall( __NR_futex_waitv, waiters, count, 0, end, CLOCK_MONOTONIC );
+}
+
+#else
+
+static inline int futex_wake( int *addr )
+{
+    return 0;
+}
+
+static inline int futex_wait( int *addr, int val, const struct timespec *end )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static inline int futex_waitv( void *waiters, unsigned int count, const struct timespec *end )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+
+/***********************************************************************
+ *           fsync_init
+ *
+ * Map the shared memory if in-process synchronization is enabled.
+ */
+void fsync_init(void)
+{
+#ifdef __linux__
+    const char *env = getenv( "WINEFSYNC" );
+    data_size_t size;
+    void *ptr;
+    int fd;
+
+    if (!env || !atoi( env )) return;
+
+    if ((fd = server_get_fsync_shm( &size )) == -1)
+    {
+        WARN( "in-process synchronization not supported by the server\n" );
+        return;
+    }
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return;
+
+    /* an empty wait list is rejected with EINVAL if the syscall exists */
+    have_futex_waitv = (futex_waitv( NULL, 0, NULL ) == -1 && errno != ENOSYS);
+    shm_count = size / sizeof(struct fsync_entry);
+    shm_entries = ptr;
+    TRACE( "enabled, %u entries, futex_waitv %ssupported\n", shm_count, have_futex_waitv ? "" : "not " );
+#endif
+}
+
+int do_fsync(void)
+{
+    return shm_entries != NULL;
+}
+
+
+/***********************************************************************/
+/* handle cache */
+
+union fsync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int    idx;
+        unsigned int    type : 7;
+        unsigned int    valid : 1;
+        unsigned int    access : 24;   /* SYNCHRONIZE is the highest right we care about */
+    } s;
+};
+
+C_ASSERT( sizeof(union fsync_cache_entry) == sizeof(LONG64) );
+
+#define FSYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(union fsync_cache_entry))
+#define FSYNC_CACHE_ENTRIES     128
+
+static union fsync_cache_entry *fsync_cache[FSYNC_CACHE_ENTRIES];
+static union fsync_cache_entry fsync_cache_initial_block[FSYNC_CACHE_BLOCK_SIZE];
+
+/* atomically exchange a 64-bit value */
+static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
+{
+#ifdef _WIN64
+    return (LONG64)interlocked_xchg_ptr( (void **)dest, (void *)val );
+#else
+    LONG64 tmp = *dest;
+    while (interlocked_cmpxchg64( dest, val, tmp ) != tmp) tmp = *dest;
+    return tmp;
+#endif
+}
+
+static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / FSYNC_CACHE_BLOCK_SIZE;
+    return idx % FSYNC_CACHE_BLOCK_SIZE;
+}
+
+struct fsync_obj
+{
+    HANDLE              handle;
+    enum fsync_type     type;
+    unsigned int        access;
+    struct fsync_entry *entry;
+};
+
+/* retrieve the shared entry of a handle, asking the server the first time */
+static NTSTATUS get_object( HANDLE handle, struct fsync_obj *obj )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fsync_cache_entry cache;
+    NTSTATUS ret;
+
+    if (entry >= FSYNC_CACHE_ENTRIES) return STATUS_NOT_IMPLEMENTED;  /* also pseudo-handles */
+
+    if (!fsync_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        void *ptr = fsync_cache_initial_block;
+
+        if (entry)
+        {
+            ptr = wine_anon_mmap( NULL, FSYNC_CACHE_BLOCK_SIZE * sizeof(union fsync_cache_entry),
+                                  PROT_READ | PROT_WRITE, 0 );
+            if (ptr == MAP_FAILED) return STATUS_NOT_IMPLEMENTED;
+        }
+        if (interlocked_cmpxchg_ptr( (void **)&fsync_cache[entry], ptr, NULL ) && entry)
+            munmap( ptr, FSYNC_CACHE_BLOCK_SIZE * sizeof(union fsync_cache_entry) );
+    }
+
+    cache.data = interlocked_cmpxchg64( &fsync_cache[entry][idx].data, 0, 0 );
+    if (!cache.data)
+    {
+        SERVER_START_REQ( get_fsync_idx )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            if (!(ret = wine_server_call( req )))
+            {
+                cache.s.idx    = reply->idx;
+                cache.s.type   = reply->type;
+                cache.s.valid  = 1;
+                cache.s.access = reply->access;
+            }
+        }
+        SERVER_END_REQ;
+        if (ret) return STATUS_NOT_IMPLEMENTED;  /* let the server report the error */
+        if (cache.s.idx >= shm_count) cache.s.type = FSYNC_NONE;
+        interlocked_xchg64( &fsync_cache[entry][idx].data, cache.data );
+    }
+
+    if (cache.s.type == FSYNC_NONE) return STATUS_NOT_IMPLEMENTED;
+    obj->handle = handle;
+    obj->type   = cache.s.type;
+    obj->access = cache.s.access;
+    obj->entry  = &shm_entries[cache.s.idx];
+    return STATUS_SUCCESS;
+}
+
+/* look up an object and check its type and access rights, like get_handle_obj() does */
+static NTSTATUS get_typed_object( HANDLE handle, enum fsync_type type, unsigned int access,
+                                  struct fsync_obj *obj )
+{
+    if (!do_fsync() || get_object( handle, obj )) return STATUS_NOT_IMPLEMENTED;
+    if ((obj->access & access) != access) return STATUS_ACCESS_DENIED;
+    if (obj->type == type) return STATUS_SUCCESS;
+    if (type == FSYNC_AUTO_EVENT && obj->type == FSYNC_MANUAL_EVENT) return STATUS_SUCCESS;
+    return STATUS_OBJECT_TYPE_MISMATCH;
+}
+
+
+/***********************************************************************
+ *           fsync_close
+ */
+void fsync_close( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry < FSYNC_CACHE_ENTRIES && fsync_cache[entry])
+        interlocked_xchg64( &fsync_cache[entry][idx].data, 0 );
+}
+
+
+/***********************************************************************/
+/* object state */
+
+/* wake up everybody waiting on an object after it has been signaled; old is the
+ * state replaced by the signaling operation, which tells whether the server had
+ * waiters at that time, otherwise the server sees the new state when it gets one */
+static void wake_object( const struct fsync_obj *obj, int old )
+{
+    futex_wake( &obj->entry->state );
+
+    if (!(old & FSYNC_SERVER_WAITING)) return;
+    SERVER_START_REQ( fsync_wake )
+    {
+        req->handle = wine_server_obj_handle( obj->handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+static inline int get_tid(void)
+{
+    return HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+}
+
+/* raw state, including the server waiting flag */
+static inline int get_state( const struct fsync_obj *obj )
+{
+    return *(volatile int *)&obj->entry->state;
+}
+
+/* atomically set the value of the state, keeping the server waiting flag; returns the previous state */
+static int set_state( const struct fsync_obj *obj, int value )
+{
+    int cur, old = get_state( obj );
+
+    while ((cur = interlocked_cmpxchg( &obj->entry->state, (old & FSYNC_SERVER_WAITING) | value, old )) != old)
+        old = cur;
+    return old;
+}
+
+static inline BOOL is_signaled( const struct fsync_obj *obj, int state )
+{
+    state &= ~FSYNC_SERVER_WAITING;
+    if (obj->type == FSYNC_MUTEX) return !state || state == get_tid();
+    return state > 0;
+}
+
+/* make sure that the server abandons a mutex acquired client-side if the thread dies */
+static void set_mutex_owner( const struct fsync_obj *obj )
+{
+    SERVER_START_REQ( fsync_own_mutex )
+    {
+        req->handle = wine_server_obj_handle( obj->handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+/* check whether an event has been pulsed since the generation in *pulse was read;
+ * the pulse of an auto-reset event only releases the waiter that claims it first */
+static BOOL check_pulse( const struct fsync_obj *obj, int *pulse )
+{
+    int cur = *(volatile int *)&obj->entry->pulse, prev;
+
+    if ((cur | 1) == (*pulse | 1)) return FALSE;
+    if (obj->type == FSYNC_MANUAL_EVENT) return TRUE;
+    while (cur & 1)
+    {
+        if ((prev = interlocked_cmpxchg( &obj->entry->pulse, cur & ~1, cur )) == cur) return TRUE;
+        cur = prev;
+    }
+    *pulse = cur;
+    return FALSE;
+}
+
+/* try to acquire an object whose state is old; returns FALSE if it isn't signaled,
+ * or if the server has waiters for it */
+static BOOL try_acquire( const struct fsync_obj *obj, int old, BOOL *abandoned )
+{
+    struct fsync_entry *entry = obj->entry;
+    int tid, cur;
+
+    switch (obj->type)
+    {
+    case FSYNC_MANUAL_EVENT:
+        return (old & ~FSYNC_SERVER_WAITING) != 0;
+
+    case FSYNC_AUTO_EVENT:
+        return old > 0 && interlocked_cmpxchg( &entry->state, 0, old ) == old;
+
+    case FSYNC_SEMAPHORE:
+        while (old > 0)
+        {
+            if ((cur = interlocked_cmpxchg( &entry->state, old - 1, old )) == old) return TRUE;
+            old = cur;
+        }
+        return FALSE;
+
+    case FSYNC_MUTEX:
+        tid = get_tid();
+        if ((old & ~FSYNC_SERVER_WAITING) == tid)
+        {
+            /* nobody else can change it while we own it */
+            entry->param++;
+            return TRUE;
+        }
+        if (old || interlocked_cmpxchg( &entry->state, tid, 0 )) return FALSE;
+        entry->param = 1;
+        if (interlocked_xchg( &entry->abandoned, 0 )) *abandoned = TRUE;
+        if (*(volatile int *)&entry->owner != tid) set_mutex_owner( obj );
+        return TRUE;
+
+    default:
+        assert( 0 );
+        return FALSE;
+    }
+}
+
+
+/***********************************************************************
+ *           fsync_set_event
+ */
+NTSTATUS fsync_set_event( HANDLE handle )
+{
+    struct fsync_obj obj;
+    NTSTATUS ret;
+    int old;
+
+    if ((ret = get_typed_object( handle, FSYNC_AUTO_EVENT, EVENT_MODIFY_STATE, &obj ))) return ret;
+    old = set_state( &obj, 1 );
+    if (!(old & ~FSYNC_SERVER_WAITING)) wake_object( &obj, old );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_reset_event
+ */
+NTSTATUS fsync_reset_event( HANDLE handle )
+{
+    struct fsync_obj obj;
+    NTSTATUS ret;
+
+    if ((ret = get_typed_object( handle, FSYNC_AUTO_EVENT, EVENT_MODIFY_STATE, &obj ))) return ret;
+    set_state( &obj, 0 );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_query_event
+ */
+NTSTATUS fsync_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info )
+{
+    struct fsync_obj obj;
+    NTSTATUS ret;
+
+    if ((ret = get_typed_object( handle, FSYNC_AUTO_EVENT, EVENT_QUERY_STATE, &obj ))) return ret;
+    info->EventType  = obj.type == FSYNC_MANUAL_EVENT ? NotificationEvent : SynchronizationEvent;
+    info->EventState = get_state( &obj ) & ~FSYNC_SERVER_WAITING;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_release_semaphore
+ */
+NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev )
+{
+    struct fsync_obj obj;
+    unsigned int old, cur, value;
+    NTSTATUS ret;
+
+    if ((ret = get_typed_object( handle, FSYNC_SEMAPHORE, SEMAPHORE_MODIFY_STATE, &obj ))) return ret;
+
+    old = get_state( &obj );
+    for (;;)
+    {
+        value = old & ~FSYNC_SERVER_WAITING;
+        if (value + count < value || value + count > (unsigned int)obj.entry->param)
+            return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+        if ((cur = interlocked_cmpxchg( &obj.entry->state, old + count, old )) == old) break;
+        old = cur;
+    }
+    if (prev) *prev = value;
+    if (!value) wake_object( &obj, old );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_query_semaphore
+ */
+NTSTATUS fsync_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info )
+{
+    struct fsync_obj obj;
+    NTSTATUS ret;
+
+    if ((ret = get_typed_object( handle, FSYNC_SEMAPHORE, SEMAPHORE_QUERY_STATE, &obj ))) return ret;
+    info->CurrentCount = get_state( &obj ) & ~FSYNC_SERVER_WAITING;
+    info->MaximumCount = obj.entry->param;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_release_mutex
+ *
+ * Returns the recursion count before the release in prev.
+ */
+NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev )
+{
+    struct fsync_obj obj;
+    NTSTATUS ret;
+
+    if ((ret = get_typed_object( handle, FSYNC_MUTEX, 0, &obj ))) return ret;
+    if ((get_state( &obj ) & ~FSYNC_SERVER_WAITING) != get_tid()) return STATUS_MUTANT_NOT_OWNED;
+
+    *prev = obj.entry->param;
+    if (--obj.entry->param) return STATUS_SUCCESS;
+    wake_object( &obj, set_state( &obj, 0 ));
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_query_mutex
+ */
+NTSTATUS fsync_query_mutex( HANDLE handle, MUTANT_BASIC_INFORMATION *info )
+{
+    struct fsync_obj obj;
+    NTSTATUS ret;
+    int owner;
+
+    if ((ret = get_typed_object( handle, FSYNC_MUTEX, MUTANT_QUERY_STATE, &obj ))) return ret;
+    owner = get_state( &obj ) & ~FSYNC_SERVER_WAITING;
+    info->CurrentCount   = 1 - (owner ? obj.entry->param : 0);
+    info->OwnedByCaller  = (owner == get_tid());
+    info->AbandonedState = (obj.entry->abandoned != 0);
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************/
+/* waits */
+
+/* shared entry signaling pending user APCs for the current thread */
+static struct fsync_entry *get_apc_entry(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+
+    if (!thread_data->fsync_apc_idx)
+    {
+        unsigned int idx = 0;
+
+        SERVER_START_REQ( get_fsync_apc_idx )
+        {
+            if (!wine_server_call( req )) idx = reply->idx;
+        }
+        SERVER_END_REQ;
+        thread_data->fsync_apc_idx = (idx && idx < shm_count) ? idx : -1;
+    }
+    if (thread_data->fsync_apc_idx == -1) return NULL;
+    return &shm_entries[thread_data->fsync_apc_idx];
+}
+
+/* convert a NT timeout to an absolute CLOCK_MONOTONIC time */
+static void get_end_time( const LARGE_INTEGER *timeout, struct timespec *end )
+{
+    LONGLONG rel = timeout->QuadPart;
+
+    if (rel >= 0)  /* absolute system time */
+    {
+        LARGE_INTEGER now;
+        NtQuerySystemTime( &now );
+        rel = now.QuadPart - rel;
+        if (rel > 0) rel = 0;
+    }
+    clock_gettime( CLOCK_MONOTONIC, end );
+    end->tv_sec  += -rel / TICKSPERSEC;
+    end->tv_nsec += (-rel % TICKSPERSEC) * 100;
+    if (end->tv_nsec >= 1000000000)
+    {
+        end->tv_sec++;
+        end->tv_nsec -= 1000000000;
+    }
+}
+
+/***********************************************************************
+ *           fsync_wait_objects
+ */
+NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                             BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    static const LARGE_INTEGER zero_timeout;
+    struct fsync_obj objs[MAXIMUM_WAIT_OBJECTS];
+#ifdef __linux__
+    struct futex_waitv waiters[MAXIMUM_WAIT_OBJECTS + 1];
+#endif
+    int values[MAXIMUM_WAIT_OBJECTS];
+    int pulses[MAXIMUM_WAIT_OBJECTS];
+    struct fsync_entry *apc = NULL;
+    struct timespec end, *end_ptr = NULL;
+    BOOL poll = FALSE, abandoned;
+    DWORD i, waits;
+    NTSTATUS ret;
+
+    if (!do_fsync() || !count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_NOT_IMPLEMENTED;
+    if (!wait_any && count > 1) return STATUS_NOT_IMPLEMENTED;
+
+    for (i = 0; i < count; i++)
+    {
+        if (get_object( handles[i], &objs[i] )) return STATUS_NOT_IMPLEMENTED;
+        if (!(objs[i].access & SYNCHRONIZE)) return STATUS_NOT_IMPLEMENTED;
+        pulses[i] = *(volatile int *)&objs[i].entry->pulse;
+    }
+    if (alertable && !(apc = get_apc_entry())) return STATUS_NOT_IMPLEMENTED;
+    if (count + (apc != NULL) > 1 && !have_futex_waitv) return STATUS_NOT_IMPLEMENTED;
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        if (!timeout->QuadPart) poll = TRUE;
+        else
+        {
+            get_end_time( timeout, &end );
+            end_ptr = &end;
+        }
+    }
+
+    for (;;)
+    {
+        if (apc && *(volatile int *)&apc->state)
+        {
+            /* let the server run the APCs */
+            ret = server_select( NULL, 0, SELECT_INTERRUPTIBLE | SELECT_ALERTABLE, &zero_timeout );
+            if (ret == STATUS_USER_APC) return ret;
+        }
+
+        abandoned = FALSE;
+        for (i = 0; i < count; i++)
+        {
+            if (check_pulse( &objs[i], &pulses[i] )) return STATUS_WAIT_0 + i;
+            values[i] = get_state( &objs[i] );
+            if (!is_signaled( &objs[i], values[i] )) continue;
+            if (try_acquire( &objs[i], values[i], &abandoned ))
+                return abandoned ? STATUS_ABANDONED_WAIT_0 + i : STATUS_WAIT_0 + i;
+            values[i] = get_state( &objs[i] );
+            /* the server has waiters for it, let it decide who gets it */
+            if (values[i] & FSYNC_SERVER_WAITING) return STATUS_NOT_IMPLEMENTED;
+        }
+
+        if (poll)
+        {
+            NtYieldExecution();
+            return STATUS_TIMEOUT;
+        }
+
+#ifdef __linux__
+        if (count == 1 && !apc)
+            ret = futex_wait( &objs[0].entry->state, values[0], end_ptr );
+        else
+        {
+            for (i = waits = 0; i < count; i++)
+            {
+                waiters[waits].val      = values[i];
+                waiters[waits].uaddr    = (ULONG_PTR)&objs[i].entry->state;
+                waiters[waits].flags    = FUTEX_SIZE_U32;
+                waiters[waits].reserved = 0;
+                waits++;
+            }
+            if (apc)
+            {
+                waiters[waits].val      = 0;
+                waiters[waits].uaddr    = (ULONG_PTR)&apc->state;
+                waiters[waits].flags    = FUTEX_SIZE_U32;
+                waiters[waits].reserved = 0;
+                waits++;
+            }
+            ret = futex_waitv( waiters, waits, end_ptr );
+        }
+        if (ret == -1 && errno == ETIMEDOUT)
+        {
+            NtYieldExecution();
+            return STATUS_TIMEOUT;
+        }
+#else
+        return STATUS_NOT_IMPLEMENTED;
+#endif
+    }
+}
@@ -83,6 +83,7 @@ typedef struct
 /* Value for arena 'magic' field */
 #define ARENA_INUSE_MAGIC      0x455355
 #define ARENA_PENDING_MAGIC    0xbedead
+#define ARENA_LFH_MAGIC        0x48464c
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
 
@@ -148,6 +149,32 @@ typedef struct tagSUBHEAP
 
 #define SUBHEAP_MAGIC    ((DWORD)('S' | ('U'<<8) | ('B'<<16) | ('H'<<24)))
 
+/* Low-fragmentation heap front-end: freed blocks of a given size class are
+ * kept in lock-free lists, spread over a few thread affinity slots, and
+ * handed out again without taking the heap critical section. */
+
+#define LFH_SMALL_LIMIT      0x200   /* size classes are ALIGNMENT apart up to this size */
+#define LFH_MAX_BLOCK_SIZE   0x1000  /* and LFH_LARGE_GRANULARITY apart up to this one */
+#define LFH_LARGE_GRANULARITY 0x80
+#define LFH_NB_CLASSES       (LFH_SMALL_LIMIT / ALIGNMENT + \
+                              (LFH_MAX_BLOCK_SIZE - LFH_SMALL_LIMIT) / LFH_LARGE_GRANULARITY)
+#define LFH_AFFINITY_SLOTS   8       /* number of per-thread cache sets */
+#define LFH_MAX_DEPTH        128     /* max number of cached blocks per class and slot */
+#define LFH_MAX_CACHED       0x100000 /* max total size of the cached blocks */
+
+struct lfh_slot
+{
+    SLIST_HEADER     bins[LFH_NB_CLASSES];
+};
+
+struct lfh_cache
+{
+    struct lfh_slot  slots[LFH_AFFINITY_SLOTS];
+    LONG             cached;        /* total size of the cached blocks */
+    LONG             lookups;       /* lock-free sub-heap lookups in progress */
+    struct list      retired;       /* empty sub-heaps waiting for the lookups to finish */
+};
+
 typedef struct tagHEAP
 {
     DWORD_PTR        unknown1[2];
@@ -164,6 +191,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_cache *lfh;          /* Low-fragmentation front-end, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -296,7 +324,8 @@ static void subheap_notify_free_all(SUBHEAP const *subheap)
         {
             ARENA_INUSE const *pArena = (ARENA_INUSE const *)ptr;
             if (pArena->magic == ARENA_INUSE_MAGIC) notify_free(pArena + 1);
-            else if (pArena->magic != ARENA_PENDING_MAGIC) ERR("bad inuse_magic @%p\n", pArena);
+            else if (pArena->magic != ARENA_PENDING_MAGIC && pArena->magic != ARENA_LFH_MAGIC)
+                ERR("bad inuse_magic @%p\n", pArena);
             ptr += sizeof(*pArena) + (pArena->size & ARENA_SIZE_MASK);
         }
     }
@@ -317,6 +346,30 @@ static inline unsigned int get_freelist_index( SIZE_T size )
     return i;
 }
 
+/* get the LFH size class for a given arena size, and round the size up to that class */
+/* returns FALSE if the block is too large to be handled by the LFH */
+static inline BOOL lfh_get_class( SIZE_T *size, unsigned int *index )
+{
+    SIZE_T data = *size - ARENA_OFFSET;
+
+    if (data > LFH_MAX_BLOCK_SIZE) return FALSE;
+    if (data <= LFH_SMALL_LIMIT)
+        *index = data / ALIGNMENT - 1;
+    else
+    {
+        data = (data + LFH_LARGE_GRANULARITY - 1) & ~(LFH_LARGE_GRANULARITY - 1);
+        *index = LFH_SMALL_LIMIT / ALIGNMENT + (data - LFH_SMALL_LIMIT) / LFH_LARGE_GRANULARITY - 1;
+    }
+    *size = data + ARENA_OFFSET;
+    return TRUE;
+}
+
+/* get the LFH affinity slot of the current thread */
+static inline unsigned int lfh_thread_slot(void)
+{
+    return (ULONG_PTR)NtCurrentTeb()->ClientId.UniqueThread % LFH_AFFINITY_SLOTS;
+}
+
 /* get the memory protection type to use for a given heap */
 static inline ULONG get_protection_type( DWORD flags )
 {
@@ -387,7 +440,8 @@ static void HEAP_Dump( HEAP *heap )
             {
                 ARENA_INUSE *pArena = (ARENA_INUSE *)ptr;
                 DPRINTF( "%p %08x %s %08x\n",
-                         pArena, pArena->magic, pArena->magic == ARENA_INUSE_MAGIC ? "used" : "pend",
+                         pArena, pArena->magic, pArena->magic == ARENA_INUSE_MAGIC ? "used" :
+                         pArena->magic == ARENA_LFH_MAGIC ? "lfh " : "pend",
                          pArena->size & ARENA_SIZE_MASK );
                 ptr += sizeof(*pArena) + (pArena->size & ARENA_SIZE_MASK);
                 arenaSize += sizeof(ARENA_INUSE);
@@ -680,8 +734,15 @@ static void HEAP_MakeInUseBlockFree( SUBHEAP *subheap, ARENA_INUSE *pArena )
         list_remove( &pFree->entry );
         /* Remove the subheap from the list */
         list_remove( &subheap->entry );
-        /* Free the memory */
         subheap->magic = 0;
+        /* the LFH looks up sub-heaps without holding the lock, lfh_release_subheaps()
+         * frees it once nobody can see it anymore */
+        if (heap->lfh)
+        {
+            list_add_tail( &heap->lfh->retired, &subheap->entry );
+            return;
+        }
+        /* Free the memory */
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
         return;
     }
@@ -870,6 +931,180 @@ static BOOL validate_large_arena( HEAP *heap, const ARENA_LARGE *arena, BOOL qui
 }
 
 
+/***********************************************************************
+ *           lfh_alloc_block
+ *
+ * Fetch a cached block of the given size class from the LFH, looking
+ * at the affinity slot of the current thread first.
+ */
+static ARENA_INUSE *lfh_alloc_block( struct lfh_cache *lfh, unsigned int index )
+{
+    unsigned int i, slot = lfh_thread_slot();
+    SLIST_ENTRY *entry;
+    ARENA_INUSE *arena = NULL;
+
+    /* the pop reads the link of a block that another thread may free meanwhile,
+     * its sub-heap must stay mapped until we are done */
+    interlocked_xchg_add( &lfh->lookups, 1 );
+    for (i = 0; i < LFH_AFFINITY_SLOTS; i++)
+    {
+        SLIST_HEADER *bin = &lfh->slots[(slot + i) % LFH_AFFINITY_SLOTS].bins[index];
+
+        if (!RtlFirstEntrySList( bin )) continue;
+        if (!(entry = RtlInterlockedPopEntrySList( bin ))) continue;
+        arena = (ARENA_INUSE *)entry - 1;
+        interlocked_xchg_add( &lfh->cached, -(LONG)(arena->size & ARENA_SIZE_MASK) );
+        break;
+    }
+    interlocked_xchg_add( &lfh->lookups, -1 );
+    return arena;
+}
+
+
+/***********************************************************************
+ *           lfh_free_block
+ *
+ * Put a block back into the LFH cache without taking the heap lock.
+ * Returns FALSE if the block has to go through the normal free path.
+ */
+static BOOL lfh_free_block( HEAP *heap, ARENA_INUSE *arena )
+{
+    struct lfh_cache *lfh = heap->lfh;
+    SUBHEAP *subheap;
+    SLIST_HEADER *bin;
+    SIZE_T size;
+    unsigned int index;
+    BOOL ret = FALSE;
+
+    if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET) return FALSE;
+
+    /* empty sub-heaps are only freed once no lookup is in progress */
+    interlocked_xchg_add( &lfh->lookups, 1 );
+    if (!(subheap = HEAP_FindSubHeap( heap, arena ))) goto done;
+    if ((const char *)arena < (char *)subheap->base + subheap->headerSize) goto done;
+    if (arena->magic != ARENA_INUSE_MAGIC || (arena->size & ARENA_FLAG_FREE)) goto done;
+
+    size = arena->size & ARENA_SIZE_MASK;
+    if (!lfh_get_class( &size, &index ) || size != (arena->size & ARENA_SIZE_MASK)) goto done;
+
+    bin = &lfh->slots[lfh_thread_slot()].bins[index];
+    if (RtlQueryDepthSList( bin ) >= LFH_MAX_DEPTH) goto done;
+    if (lfh->cached + size > LFH_MAX_CACHED) goto done;
+
+    interlocked_xchg_add( &lfh->cached, size );
+    arena->magic = ARENA_LFH_MAGIC;
+    RtlInterlockedPushEntrySList( bin, (SLIST_ENTRY *)(arena + 1) );
+    ret = TRUE;
+done:
+    interlocked_xchg_add( &lfh->lookups, -1 );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           lfh_release_subheaps
+ *
+ * Free the empty sub-heaps retired by HEAP_MakeInUseBlockFree. They are
+ * kept for a later call while lookups are in progress, since those may
+ * have started before the sub-heaps were removed from the list.
+ * The heap lock must be held.
+ */
+static void lfh_release_subheaps( HEAP *heap )
+{
+    struct lfh_cache *lfh = heap->lfh;
+    SUBHEAP *subheap, *next;
+    SIZE_T size;
+    void *addr;
+
+    if (list_empty( &lfh->retired ) || interlocked_cmpxchg( &lfh->lookups, 0, 0 )) return;
+
+    LIST_FOR_EACH_ENTRY_SAFE( subheap, next, &lfh->retired, SUBHEAP, entry )
+    {
+        list_remove( &subheap->entry );
+        size = 0;
+        addr = subheap->base;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
+}
+
+
+/***********************************************************************
+ *           lfh_flush
+ *
+ * Return all the blocks cached by the LFH to the free lists.
+ * The heap lock must be held. Returns TRUE if any block was freed.
+ */
+static BOOL lfh_flush( HEAP *heap )
+{
+    struct lfh_cache *lfh = heap->lfh;
+    SLIST_ENTRY *entry, *next;
+    ARENA_INUSE *arena;
+    unsigned int i, j;
+    BOOL ret = FALSE;
+
+    for (i = 0; i < LFH_AFFINITY_SLOTS; i++)
+    {
+        for (j = 0; j < LFH_NB_CLASSES; j++)
+        {
+            if (!RtlFirstEntrySList( &lfh->slots[i].bins[j] )) continue;
+            for (entry = RtlInterlockedFlushSList( &lfh->slots[i].bins[j] ); entry; entry = next)
+            {
+                next = entry->Next;
+                arena = (ARENA_INUSE *)entry - 1;
+                interlocked_xchg_add( &lfh->cached, -(LONG)(arena->size & ARENA_SIZE_MASK) );
+                arena->magic = ARENA_INUSE_MAGIC;
+                HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+                ret = TRUE;
+            }
+        }
+    }
+    lfh_release_subheaps( heap );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           heap_enable_lfh
+ */
+static NTSTATUS heap_enable_lfh( HEAP *heap )
+{
+    struct lfh_cache *lfh = NULL;
+    SIZE_T size = sizeof(*lfh);
+    unsigned int i, j;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED)) return STATUS_UNSUCCESSFUL;
+    if ((heap->flags & (HEAP_VALIDATE | HEAP_PAGE_ALLOCS | HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)) || RUNNING_ON_VALGRIND)
+    {
+        WARN( "not enabling LFH on debug heap %p\n", heap );
+        return STATUS_SUCCESS;
+    }
+
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), (void **)&lfh, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+        return STATUS_NO_MEMORY;
+    for (i = 0; i < LFH_AFFINITY_SLOTS; i++)
+        for (j = 0; j < LFH_NB_CLASSES; j++) RtlInitializeSListHead( &lfh->slots[i].bins[j] );
+    list_init( &lfh->retired );
+
+    RtlEnterCriticalSection( &heap->critSection );
+    if (!heap->lfh)
+    {
+        heap->lfh = lfh;
+        lfh = NULL;
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+
+    if (lfh)  /* somebody else was faster */
+    {
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), (void **)&lfh, &size, MEM_RELEASE );
+    }
+    TRACE( "enabled LFH for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           HEAP_CreateSubHeap
  */
@@ -1024,6 +1259,9 @@ static ARENA_FREE *HEAP_FindFreeBlock( HEAP *heap, SIZE_T size,
 
     /* If no block was found, attempt to grow the heap */
 
+    /* return the blocks cached by the LFH first, they may be enough */
+    if (heap->lfh && lfh_flush( heap )) return HEAP_FindFreeBlock( heap, size, ppSubHeap );
+
     if (!(heap->flags & HEAP_GROWABLE))
     {
         WARN("Not enough space in heap %p for %08lx bytes\n", heap, size );
@@ -1214,7 +1452,8 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
     }
 
     /* Check magic number */
-    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC)
+    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC &&
+        pArena->magic != ARENA_LFH_MAGIC)
     {
         if (quiet == NOISY) {
             ERR("Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, pArena->magic, pArena );
@@ -1301,7 +1540,7 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
             ptr++;
         }
     }
-    else if (flags & HEAP_TAIL_CHECKING_ENABLED)
+    else if ((flags & HEAP_TAIL_CHECKING_ENABLED) && pArena->magic == ARENA_INUSE_MAGIC)
     {
         const unsigned char *data = (const unsigned char *)(pArena + 1) + size - pArena->unused_bytes;
 
@@ -1429,7 +1668,7 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
         ret = HEAP_ValidateInUseArena( subheap, arena, QUIET );
     else if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET)
         WARN( "Heap %p: unaligned arena pointer %p\n", subheap->heap, arena );
-    else if (arena->magic == ARENA_PENDING_MAGIC)
+    else if (arena->magic == ARENA_PENDING_MAGIC || arena->magic == ARENA_LFH_MAGIC)
         WARN( "Heap %p: block %p used after free\n", subheap->heap, arena + 1 );
     else if (arena->magic != ARENA_INUSE_MAGIC)
         WARN( "Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, arena->magic, arena );
@@ -1638,6 +1877,18 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
         addr = heapPtr->pending_free;
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
+    if (heapPtr->lfh)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( subheap, next, &heapPtr->lfh->retired, SUBHEAP, entry )
+        {
+            size = 0;
+            addr = subheap->base;
+            NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+        }
+        size = 0;
+        addr = heapPtr->lfh;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
     size = 0;
     addr = heapPtr->subheap.base;
     NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
@@ -1669,6 +1920,7 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
     SIZE_T rounded_size;
+    unsigned int lfh_index;
 
     /* Validate the parameters */
 
@@ -1683,6 +1935,20 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    /* Try the low-fragmentation front-end first; on a miss the block
+     * gets allocated from the free lists with the size of its class */
+
+    if (heapPtr->lfh && lfh_get_class( &rounded_size, &lfh_index ) &&
+        (pInUse = lfh_alloc_block( heapPtr->lfh, lfh_index )))
+    {
+        pInUse->magic = ARENA_INUSE_MAGIC;
+        pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
+        notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
+        initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
+        return pInUse + 1;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1766,13 +2032,20 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+    pInUse  = (ARENA_INUSE *)ptr - 1;
+
+    if (heapPtr->lfh && lfh_free_block( heapPtr, pInUse ))
+    {
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
     notify_free( ptr );
 
     /* Some sanity checks */
-    pInUse  = (ARENA_INUSE *)ptr - 1;
     if (!validate_block_pointer( heapPtr, &subheap, pInUse )) goto error;
 
     if (!subheap)
@@ -1780,6 +2053,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
     else
         HEAP_MakeInUseBlockFree( subheap, pInUse );
 
+    if (heapPtr->lfh) lfh_release_subheaps( heapPtr );
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
     TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
     return TRUE;
@@ -1958,7 +2232,17 @@ error:
 ULONG WINAPI RtlCompactHeap( HANDLE heap, ULONG flags )
 {
     static BOOL reported;
-    if (!reported++) FIXME( "(%p, 0x%x) stub\n", heap, flags );
+    HEAP *heapPtr = HEAP_GetPtr( heap );
+
+    if (!reported++) FIXME( "(%p, 0x%x) semi-stub\n", heap, flags );
+
+    /* at least trim the LFH cache */
+    if (heapPtr && heapPtr->lfh)
+    {
+        RtlEnterCriticalSection( &heapPtr->critSection );
+        lfh_flush( heapPtr );
+        RtlLeaveCriticalSection( &heapPtr->critSection );
+    }
     return 0;
 }
 
@@ -2133,7 +2417,8 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         }
 
         if (((ARENA_INUSE *)ptr - 1)->magic == ARENA_INUSE_MAGIC ||
-            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC)
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC ||
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_LFH_MAGIC)
         {
             ARENA_INUSE *pArena = (ARENA_INUSE *)ptr - 1;
             ptr += pArena->size & ARENA_SIZE_MASK;
@@ -2181,8 +2466,8 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         entry->lpData = pArena + 1;
         entry->cbData = pArena->size & ARENA_SIZE_MASK;
         entry->cbOverhead = sizeof(ARENA_INUSE);
-        entry->wFlags = (pArena->magic == ARENA_PENDING_MAGIC) ?
-                        PROCESS_HEAP_UNCOMMITTED_RANGE : PROCESS_HEAP_ENTRY_BUSY;
+        entry->wFlags = (pArena->magic == ARENA_INUSE_MAGIC) ?
+                        PROCESS_HEAP_ENTRY_BUSY : PROCESS_HEAP_UNCOMMITTED_RANGE;
         /* FIXME: can't handle PROCESS_HEAP_ENTRY_MOVEABLE
         and PROCESS_HEAP_ENTRY_DDESHARE yet */
     }
@@ -2246,6 +2531,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2254,7 +2541,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 : 0;  /* low-fragmentation or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2268,6 +2556,28 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        TRACE("%p HeapCompatibilityInformation %p %ld\n", heap, info, size);
+
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* the LFH cannot be turned off again */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:
+            return heap_enable_lfh( heapPtr );
+        default:
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
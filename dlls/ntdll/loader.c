@@ -23,10 +23,17 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #ifdef HAVE_SYS_MMAN_H
 # include <sys/mman.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -50,6 +57,10 @@ WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
 
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
 #ifdef _WIN64
 #define DEFAULT_SECURITY_COOKIE_64  (((ULONGLONG)0x00002b99 << 32) | 0x2ddfa232)
 #endif
@@ -85,8 +96,26 @@ typedef struct _wine_modref
     LDR_MODULE            ldr;
     int                   nDeps;
     struct _wine_modref **deps;
+    struct _wine_modref  *next_base;      /* next modref in the base address hash chain */
+    struct _wine_modref  *next_basename;  /* next modref in the base name hash chain */
+    struct _wine_modref  *next_fullname;  /* next modref in the full name hash chain */
+    unsigned int          basename_hash;  /* hash of the base name when it was indexed */
+    unsigned int          fullname_hash;  /* hash of the full name when it was indexed */
+    DWORD                *export_hash;    /* hash table of export name indices, built on demand */
+    DWORD                 export_hash_mask;
+    DWORD                 export_lookups; /* number of named export lookups in this module */
 } WINE_MODREF;
 
+/* modules are indexed by base address, base name and full name */
+#define MODREF_HASH_SIZE 256
+static WINE_MODREF *modref_base_hash[MODREF_HASH_SIZE];
+static WINE_MODREF *modref_basename_hash[MODREF_HASH_SIZE];
+static WINE_MODREF *modref_fullname_hash[MODREF_HASH_SIZE];
+
+/* the export names hash is only worth building for modules that get used a lot */
+#define EXPORT_HASH_MIN_NAMES   64
+#define EXPORT_HASH_MIN_LOOKUPS 16
+
 /* info about the current builtin dll load */
 /* used to keep track of things across the register_dll constructor call */
 struct builtin_load_info
@@ -118,6 +147,10 @@ static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
 
+static BOOL use_prefetch;          /* remember the files loaded by the process for the next runs */
+static char *prefetch_files;       /* files prefetched at startup */
+static data_size_t prefetch_size;  /* size of the prefetched file names */
+
 static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_MODREF** pwm );
 static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved );
 static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
@@ -363,6 +396,78 @@ static inline ULONG_PTR allocate_stub( const char *dll, const char *name ) { ret
 #endif  /* __i386__ */
 
 
+/* hash a module name, case-insensitively */
+static unsigned int hash_module_name( const WCHAR *name )
+{
+    unsigned int hash = 0;
+
+    while (*name) hash = hash * 65599 + tolowerW( *name++ );
+    return hash;
+}
+
+/* modules are aligned on 64k boundaries */
+static inline unsigned int hash_module_base( HMODULE module )
+{
+    return ((ULONG_PTR)module >> 16) % MODREF_HASH_SIZE;
+}
+
+/*************************************************************************
+ *		insert_modref_hash
+ *
+ * Add a modref to the hash indices.
+ * The loader_section must be locked while calling this function.
+ */
+static void insert_modref_hash( WINE_MODREF *wm )
+{
+    unsigned int base = hash_module_base( wm->ldr.BaseAddress );
+    WINE_MODREF **ptr;
+
+    wm->basename_hash = hash_module_name( wm->ldr.BaseDllName.Buffer ) % MODREF_HASH_SIZE;
+    wm->fullname_hash = hash_module_name( wm->ldr.FullDllName.Buffer ) % MODREF_HASH_SIZE;
+
+    /* append to the chains, so that lookups find the first loaded of several modules of the same name */
+    for (ptr = &modref_base_hash[base]; *ptr; ptr = &(*ptr)->next_base) /* nothing */;
+    wm->next_base = NULL;
+    *ptr = wm;
+    for (ptr = &modref_basename_hash[wm->basename_hash]; *ptr; ptr = &(*ptr)->next_basename) /* nothing */;
+    wm->next_basename = NULL;
+    *ptr = wm;
+    for (ptr = &modref_fullname_hash[wm->fullname_hash]; *ptr; ptr = &(*ptr)->next_fullname) /* nothing */;
+    wm->next_fullname = NULL;
+    *ptr = wm;
+}
+
+/*************************************************************************
+ *		remove_modref_hash
+ *
+ * Remove a modref from the hash indices.
+ * The loader_section must be locked while calling this function.
+ */
+static void remove_modref_hash( WINE_MODREF *wm )
+{
+    WINE_MODREF **ptr;
+
+    for (ptr = &modref_base_hash[hash_module_base( wm->ldr.BaseAddress )]; *ptr; ptr = &(*ptr)->next_base)
+        if (*ptr == wm)
+        {
+            *ptr = wm->next_base;
+            break;
+        }
+    for (ptr = &modref_basename_hash[wm->basename_hash]; *ptr; ptr = &(*ptr)->next_basename)
+        if (*ptr == wm)
+        {
+            *ptr = wm->next_basename;
+            break;
+        }
+    for (ptr = &modref_fullname_hash[wm->fullname_hash]; *ptr; ptr = &(*ptr)->next_fullname)
+        if (*ptr == wm)
+        {
+            *ptr = wm->next_fullname;
+            break;
+        }
+}
+
+
 /*************************************************************************
  *		get_modref
  *
@@ -371,18 +476,12 @@ static inline ULONG_PTR allocate_stub( const char *dll, const char *name ) { ret
  */
 static WINE_MODREF *get_modref( HMODULE hmod )
 {
-    PLIST_ENTRY mark, entry;
-    PLDR_MODULE mod;
+    WINE_MODREF *wm;
 
     if (cached_modref && cached_modref->ldr.BaseAddress == hmod) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        mod = CONTAINING_RECORD(entry, LDR_MODULE, InMemoryOrderModuleList);
-        if (mod->BaseAddress == hmod)
-            return cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-    }
+    for (wm = modref_base_hash[hash_module_base( hmod )]; wm; wm = wm->next_base)
+        if (wm->ldr.BaseAddress == hmod) return cached_modref = wm;
     return NULL;
 }
 
@@ -395,21 +494,11 @@ static WINE_MODREF *get_modref( HMODULE hmod )
  */
 static WINE_MODREF *find_basename_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
-
-    if (cached_modref && !strcmpiW( name, cached_modref->ldr.BaseDllName.Buffer ))
-        return cached_modref;
+    WINE_MODREF *wm;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->BaseDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
-    }
+    /* the cached modref may be a later module with the same base name, don't use it here */
+    for (wm = modref_basename_hash[hash_module_name( name ) % MODREF_HASH_SIZE]; wm; wm = wm->next_basename)
+        if (!strcmpiW( name, wm->ldr.BaseDllName.Buffer )) return cached_modref = wm;
     return NULL;
 }
 
@@ -422,21 +511,13 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
  */
 static WINE_MODREF *find_fullname_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.FullDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->FullDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
-    }
+    for (wm = modref_fullname_hash[hash_module_name( name ) % MODREF_HASH_SIZE]; wm; wm = wm->next_fullname)
+        if (!strcmpiW( name, wm->ldr.FullDllName.Buffer )) return cached_modref = wm;
     return NULL;
 }
 
@@ -562,6 +643,51 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 0;
+
+    while (*name) hash = hash * 65599 + (unsigned char)*name++;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		build_export_hash
+ *
+ * Build the hash table of the export names of a module, once it has been
+ * looked up often enough to make it worthwhile.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL build_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.BaseAddress, exports->AddressOfNames );
+    DWORD i, pos, size = 1;
+
+    if (++wm->export_lookups < EXPORT_HASH_MIN_LOOKUPS) return FALSE;
+
+    /* keep the table at most half full */
+    while (size < 2 * exports->NumberOfNames) size *= 2;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             size * sizeof(*wm->export_hash) )))
+        return FALSE;
+    wm->export_hash_mask = size - 1;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( wm->ldr.BaseAddress, names[i] ));
+        while (wm->export_hash[pos & wm->export_hash_mask]) pos++;
+        wm->export_hash[pos & wm->export_hash_mask] = i + 1;
+    }
+    TRACE( "built hash of %u exports for %s\n", exports->NumberOfNames,
+           debugstr_w(wm->ldr.BaseDllName.Buffer) );
+    return TRUE;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -574,6 +700,7 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int min = 0, max = exports->NumberOfNames - 1;
+    WINE_MODREF *wm;
 
     /* first check the hint */
     if (hint >= 0 && hint <= max)
@@ -583,6 +710,21 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
+    /* then look in the names hash, if the module has one */
+    if (exports->NumberOfNames >= EXPORT_HASH_MIN_NAMES && (wm = get_modref( module )) &&
+        (wm->export_hash || build_export_hash( wm, exports )))
+    {
+        DWORD pos, idx;
+
+        for (pos = hash_export_name( name ); (idx = wm->export_hash[pos & wm->export_hash_mask]); pos++)
+        {
+            char *ename = get_rva( module, names[idx - 1] );
+            if (!strcmp( ename, name ))
+                return find_ordinal_export( module, exports, exp_size, ordinals[idx - 1], load_path );
+        }
+        return NULL;
+    }
+
     /* then do a binary search */
     while (min <= max)
     {
@@ -982,6 +1124,9 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
 
     wm->nDeps    = 0;
     wm->deps     = NULL;
+    wm->export_hash = NULL;
+    wm->export_hash_mask = 0;
+    wm->export_lookups = 0;
 
     wm->ldr.BaseAddress   = hModule;
     wm->ldr.EntryPoint    = NULL;
@@ -1011,6 +1156,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
                    &wm->ldr.InLoadOrderModuleList);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderModuleList);
+    insert_modref_hash( wm );
 
     /* wait until init is called for inserting into this list */
     wm->ldr.InInitializationOrderModuleList.Flink = NULL;
@@ -1635,6 +1781,7 @@ static void load_builtin_callback( void *module, const char *filename )
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_modref_hash( wm );
             /* FIXME: free the modref */
             builtin_load_info->status = STATUS_DLL_NOT_FOUND;
             return;
@@ -1723,7 +1870,8 @@ static NTSTATUS perform_relocations( void *module, SIZE_T len )
     nt = RtlImageNtHeader( module );
     base = (char *)nt->OptionalHeader.ImageBase;
 
-    assert( module != base );
+    /* the image may have been mapped from a copy already relocated to this address */
+    if (module == base) return STATUS_SUCCESS;
 
     /* no relocations are performed on non page-aligned binaries */
     if (nt->OptionalHeader.SectionAlignment < page_size)
@@ -1848,6 +1996,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_modref_hash( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2744,6 +2893,160 @@ fail:
     return dllhook(4, &delayinfo);
 }
 
+/***********************************************************************
+ *           append_prefetch_file
+ */
+static BOOL append_prefetch_file( char **files, data_size_t *size, data_size_t *max_size, const char *name )
+{
+    data_size_t len = strlen( name ) + 1;
+    char *new_files;
+
+    if (*size + len > *max_size)
+    {
+        data_size_t new_size = max( *max_size * 2, *size + len );
+        if (!(new_files = RtlReAllocateHeap( GetProcessHeap(), 0, *files, new_size ))) return FALSE;
+        *files = new_files;
+        *max_size = new_size;
+    }
+    memcpy( *files + *size, name, len );
+    *size += len;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           get_prefetch_files
+ *
+ * Build the list of the unix files of the loaded modules, both the
+ * builtin libraries and the dll files.
+ * The loader_section must be locked while calling this function.
+ */
+static char *get_prefetch_files( data_size_t *ret_size )
+{
+    PLIST_ENTRY mark, entry;
+    UNICODE_STRING nt_name;
+    ANSI_STRING unix_name;
+    data_size_t size = 0, max_size = 4096;
+    BOOL ret = TRUE;
+    char *files;
+
+    if (!(files = RtlAllocateHeap( GetProcessHeap(), 0, max_size ))) return NULL;
+
+    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    for (entry = mark->Flink; ret && entry != mark; entry = entry->Flink)
+    {
+        LDR_MODULE *mod = CONTAINING_RECORD( entry, LDR_MODULE, InLoadOrderModuleList );
+
+#ifdef HAVE_DLADDR
+        if (mod->Flags & LDR_WINE_INTERNAL)
+        {
+            Dl_info info;
+            if (dladdr( mod->BaseAddress, &info ) && info.dli_fname && info.dli_fname[0] == '/')
+                ret = append_prefetch_file( &files, &size, &max_size, info.dli_fname );
+        }
+#endif
+        if (!RtlDosPathNameToNtPathName_U( mod->FullDllName.Buffer, &nt_name, NULL, NULL )) continue;
+        if (!wine_nt_to_unix_file_name( &nt_name, &unix_name, FILE_OPEN, FALSE ))
+        {
+            ret = append_prefetch_file( &files, &size, &max_size, unix_name.Buffer );
+            RtlFreeAnsiString( &unix_name );
+        }
+        RtlFreeUnicodeString( &nt_name );
+    }
+    if (!ret || !size)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, files );
+        return NULL;
+    }
+    *ret_size = size;
+    return files;
+}
+
+
+/***********************************************************************
+ *           prefetch_modules
+ *
+ * Start reading the files that the previous runs of the main exe have
+ * loaded, so that they are in the page cache by the time they are mapped.
+ */
+static void prefetch_modules( WINE_MODREF *wm )
+{
+    const char *env = getenv( "WINEPREFETCH" );
+    data_size_t size = 4096;
+    NTSTATUS status;
+    struct stat st;
+    char *p, *end;
+    int fd;
+
+    if (!env || !atoi( env )) return;
+    use_prefetch = TRUE;
+
+    for (;;)
+    {
+        if (!(prefetch_files = RtlAllocateHeap( GetProcessHeap(), 0, size ))) return;
+        SERVER_START_REQ( get_prefetch_list )
+        {
+            wine_server_add_data( req, wm->ldr.FullDllName.Buffer, wm->ldr.FullDllName.Length );
+            wine_server_set_reply( req, prefetch_files, size );
+            if (!(status = wine_server_call( req ))) prefetch_size = wine_server_reply_size( reply );
+            size = reply->total;
+        }
+        SERVER_END_REQ;
+        if (status != STATUS_BUFFER_OVERFLOW) break;
+        RtlFreeHeap( GetProcessHeap(), 0, prefetch_files );
+    }
+    /* the list must be made of null-terminated names */
+    if (status || (prefetch_size && prefetch_files[prefetch_size - 1])) prefetch_size = 0;
+
+    for (p = prefetch_files, end = p + prefetch_size; p < end; p += strlen( p ) + 1)
+    {
+        /* the list comes from earlier runs, don't block on whatever is at that path now */
+        if ((fd = open( p, O_RDONLY | O_NONBLOCK | O_CLOEXEC )) == -1) continue;
+        if (!fstat( fd, &st ) && S_ISREG( st.st_mode ))
+        {
+#ifdef POSIX_FADV_WILLNEED
+            posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED );
+#endif
+        }
+        close( fd );
+    }
+    TRACE( "prefetched %u bytes of file names for %s\n", prefetch_size,
+           debugstr_w(wm->ldr.FullDllName.Buffer) );
+}
+
+
+/***********************************************************************
+ *           save_prefetch_list
+ *
+ * Store the files loaded by the process for the next runs of the main exe.
+ * The loader_section must be locked while calling this function.
+ */
+static void save_prefetch_list(void)
+{
+    WINE_MODREF *wm;
+    data_size_t size;
+    char *files;
+
+    if (!use_prefetch) return;
+    if (!(wm = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress ))) return;
+    if (!(files = get_prefetch_files( &size ))) return;
+
+    /* nothing to do if the same files were loaded */
+    if (size != prefetch_size || memcmp( files, prefetch_files, size ))
+    {
+        SERVER_START_REQ( set_prefetch_list )
+        {
+            req->exe_len = wm->ldr.FullDllName.Length;
+            wine_server_add_data( req, wm->ldr.FullDllName.Buffer, wm->ldr.FullDllName.Length );
+            wine_server_add_data( req, files, size );
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, files );
+}
+
+
 /******************************************************************
  *		LdrShutdownProcess (NTDLL.@)
  *
@@ -2751,6 +3054,7 @@ fail:
 void WINAPI LdrShutdownProcess(void)
 {
     TRACE("()\n");
+    save_prefetch_list();
     process_detaching = TRUE;
     process_detach();
 }
@@ -2824,6 +3128,7 @@ static void free_modref( WINE_MODREF *wm )
 {
     RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
     RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+    remove_modref_hash( wm );
     if (wm->ldr.InInitializationOrderModuleList.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderModuleList);
 
@@ -2847,6 +3152,7 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -3007,6 +3313,7 @@ NTSTATUS attach_dlls( void *reserved )
 
     if (!imports_fixup_done)
     {
+        prefetch_modules( wm );
         actctx_init();
         if ((status = fixup_imports( wm, load_path )) != STATUS_SUCCESS)
         {
@@ -3303,6 +3610,7 @@ void CDECL __wine_init_windows_dir( const WCHAR *windir, const WCHAR *sysdir )
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
         LDR_MODULE *mod = CONTAINING_RECORD( entry, LDR_MODULE, InLoadOrderModuleList );
+        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
 
         assert( mod->Flags & LDR_WINE_INTERNAL );
 
@@ -3313,8 +3621,10 @@ void CDECL __wine_init_windows_dir( const WCHAR *windir, const WCHAR *sysdir )
         p = buffer + strlenW( buffer );
         if (p > buffer && p[-1] != '\\') *p++ = '\\';
         strcpyW( p, mod->FullDllName.Buffer );
+        remove_modref_hash( wm );
         RtlInitUnicodeString( &mod->FullDllName, buffer );
         RtlInitUnicodeString( &mod->BaseDllName, p );
+        insert_modref_hash( wm );
     }
 }
 
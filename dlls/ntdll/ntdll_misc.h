@@ -97,6 +97,13 @@ extern unsigned int server_select( const select_op_t *select_op, data_size_t siz
                                    UINT flags, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *call, apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_remove_fd_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
+extern unsigned int server_get_completion_flags( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void server_set_completion_flags( HANDLE handle, unsigned int flags ) DECLSPEC_HIDDEN;
+extern int server_get_fsync_shm( data_size_t *size ) DECLSPEC_HIDDEN;
+extern int server_get_registry_shm( data_size_t *size ) DECLSPEC_HIDDEN;
+extern int server_get_image_reloc_fd( HANDLE mapping, void *base ) DECLSPEC_HIDDEN;
+extern NTSTATUS server_get_process_vm_pid( HANDLE process, unsigned int access, int *unix_pid ) DECLSPEC_HIDDEN;
+extern void server_free_request_shm(void) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
 extern int server_pipe( int fd[2] ) DECLSPEC_HIDDEN;
@@ -166,6 +173,7 @@ extern NTSTATUS nt_to_unix_file_name_attr( const OBJECT_ATTRIBUTES *attr, ANSI_S
 
 /* virtual memory */
 extern void virtual_get_system_info( SYSTEM_BASIC_INFORMATION *info ) DECLSPEC_HIDDEN;
+extern SIZE_T virtual_get_large_page_size(void) DECLSPEC_HIDDEN;
 extern NTSTATUS virtual_create_builtin_view( void *base ) DECLSPEC_HIDDEN;
 extern NTSTATUS virtual_alloc_thread_stack( TEB *teb, SIZE_T reserve_size,
                                             SIZE_T commit_size, SIZE_T extra_size ) DECLSPEC_HIDDEN;
@@ -187,7 +195,24 @@ extern struct _KUSER_SHARED_DATA *user_shared_data DECLSPEC_HIDDEN;
 
 /* completion */
 extern NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
-                                     NTSTATUS CompletionStatus, ULONG Information ) DECLSPEC_HIDDEN;
+                                     NTSTATUS CompletionStatus, ULONG Information, BOOL async ) DECLSPEC_HIDDEN;
+
+/* registry */
+extern void reg_cache_close( HANDLE handle ) DECLSPEC_HIDDEN;
+
+/* in-process synchronization */
+extern void fsync_init(void) DECLSPEC_HIDDEN;
+extern int do_fsync(void) DECLSPEC_HIDDEN;
+extern void fsync_close( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_set_event( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_reset_event( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_query_mutex( HANDLE handle, MUTANT_BASIC_INFORMATION *info ) DECLSPEC_HIDDEN;
+extern NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                                    BOOLEAN alertable, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 
 /* code pages */
 extern int ntdll_umbstowcs(DWORD flags, const char* src, int srclen, WCHAR* dst, int dstlen) DECLSPEC_HIDDEN;
@@ -233,6 +258,8 @@ struct ntdll_thread_data
     int                wait_fd[2];    /* fd for sleeping server requests */
     BOOL               wow64_redir;   /* Wow64 filesystem redirection flag */
     pthread_t          pthread_id;    /* pthread thread id */
+    int                fsync_apc_idx; /* shared entry for user APCs, -1 if unavailable */
+    struct request_shm *request_shm;  /* shared memory for small server requests */
 };
 
 C_ASSERT( sizeof(struct ntdll_thread_data) <= sizeof(((TEB *)0)->GdiTebBatch) );
@@ -370,6 +370,8 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             {
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                fsync_close( source );
+                reg_cache_close( source );
             }
         }
     }
@@ -383,6 +385,7 @@ NTSTATUS close_handle( HANDLE handle )
     NTSTATUS ret;
     int fd = server_remove_fd_from_cache( handle );
 
+    fsync_close( handle );
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -390,6 +393,8 @@ NTSTATUS close_handle( HANDLE handle )
     }
     SERVER_END_REQ;
     if (fd != -1) close( fd );
+    /* only once the handle can't be used anymore, see reg_cache_store */
+    if (!ret) reg_cache_close( handle );
     return ret;
 }
 
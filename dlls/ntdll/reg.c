@@ -31,7 +31,14 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -45,6 +52,167 @@ WINE_DEFAULT_DEBUG_CHANNEL(reg);
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
 
+/*
+ * Value lookups can be cached client-side.  The server increments a
+ * generation counter in shared memory on every registry change, which
+ * invalidates all the cached entries at once; closing a handle removes
+ * its entries, since the handle value can be reused for another key.
+ */
+#define REG_CACHE_SIZE      256     /* number of cache slots */
+#define REG_CACHE_MAX_DATA  4096    /* larger values are never cached */
+
+struct reg_cache_entry
+{
+    HANDLE       handle;      /* key handle */
+    unsigned int generation;  /* registry generation when the value was retrieved */
+    NTSTATUS     status;      /* STATUS_SUCCESS or STATUS_OBJECT_NAME_NOT_FOUND */
+    int          type;        /* value type */
+    USHORT       name_len;    /* length of the value name in bytes */
+    DWORD        data_len;    /* length of the value data in bytes */
+    WCHAR        name[1];     /* value name, followed by the data */
+};
+
+static struct reg_cache_entry *reg_cache[REG_CACHE_SIZE];
+static const struct registry_shm *reg_cache_shm;
+static unsigned int reg_cache_closes;  /* count of handles closed, to discard racing lookups */
+static int reg_cache_enabled = -1;
+
+static RTL_CRITICAL_SECTION reg_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG reg_cache_critsect_debug =
+{
+    0, 0, &reg_cache_section,
+    { &reg_cache_critsect_debug.ProcessLocksList, &reg_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": reg_cache_section") }
+};
+static RTL_CRITICAL_SECTION reg_cache_section = { &reg_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+/* check if the cache is enabled, and map the generation counter if needed; cache section must be held */
+static BOOL reg_cache_init(void)
+{
+    const char *env;
+    data_size_t size;
+    void *ptr;
+    int fd;
+
+    if (reg_cache_enabled != -1) return reg_cache_enabled;
+
+    reg_cache_enabled = 0;
+    if (!(env = getenv( "WINEREGISTRYCACHE" )) || !atoi( env )) return FALSE;
+    if ((fd = server_get_registry_shm( &size )) == -1) return FALSE;
+    ptr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return FALSE;
+    reg_cache_shm = ptr;
+    reg_cache_enabled = 1;
+    return TRUE;
+}
+
+static inline unsigned int reg_cache_generation(void)
+{
+    return *(volatile const unsigned int *)&reg_cache_shm->generation;
+}
+
+static unsigned int reg_cache_hash( HANDLE handle, const UNICODE_STRING *name )
+{
+    unsigned int i, hash = (ULONG_PTR)handle >> 2;
+
+    for (i = 0; i < name->Length / sizeof(WCHAR); i++) hash = hash * 31 + toupperW( name->Buffer[i] );
+    return hash % REG_CACHE_SIZE;
+}
+
+/* look up a value in the cache and return it in the server reply format */
+static BOOL reg_cache_lookup( HANDLE handle, const UNICODE_STRING *name, void *data, DWORD length,
+                              NTSTATUS *status, int *type, DWORD *total )
+{
+    struct reg_cache_entry *entry;
+    BOOL ret = FALSE;
+
+    RtlEnterCriticalSection( &reg_cache_section );
+    if (reg_cache_init() && (entry = reg_cache[reg_cache_hash( handle, name )]) &&
+        entry->handle == handle && entry->generation == reg_cache_generation() &&
+        entry->name_len == name->Length &&
+        !memicmpW( entry->name, name->Buffer, name->Length / sizeof(WCHAR) ))
+    {
+        *status = entry->status;
+        *type   = entry->type;
+        *total  = entry->data_len;
+        if (data) memcpy( data, (char *)entry->name + entry->name_len, min( length, entry->data_len ));
+        ret = TRUE;
+    }
+    RtlLeaveCriticalSection( &reg_cache_section );
+    return ret;
+}
+
+/* retrieve the current state before a server lookup, to validate its result later */
+static BOOL reg_cache_start( unsigned int *generation, unsigned int *closes )
+{
+    BOOL ret;
+
+    RtlEnterCriticalSection( &reg_cache_section );
+    if ((ret = reg_cache_init()))
+    {
+        *generation = reg_cache_generation();
+        *closes = reg_cache_closes;
+    }
+    RtlLeaveCriticalSection( &reg_cache_section );
+    return ret;
+}
+
+/* store the result of a server lookup */
+static void reg_cache_store( HANDLE handle, const UNICODE_STRING *name, unsigned int generation,
+                             unsigned int closes, NTSTATUS status, int type,
+                             const void *data, DWORD data_len )
+{
+    struct reg_cache_entry *entry, **slot;
+
+    if (data_len > REG_CACHE_MAX_DATA) return;
+    if (!(entry = RtlAllocateHeap( GetProcessHeap(), 0, FIELD_OFFSET( struct reg_cache_entry, name ) +
+                                   name->Length + data_len )))
+        return;
+    entry->handle     = handle;
+    entry->generation = generation;
+    entry->status     = status;
+    entry->type       = type;
+    entry->name_len   = name->Length;
+    entry->data_len   = data_len;
+    memcpy( entry->name, name->Buffer, name->Length );
+    memcpy( (char *)entry->name + name->Length, data, data_len );
+
+    RtlEnterCriticalSection( &reg_cache_section );
+    /* the handle may have been closed while the request was in progress */
+    if (closes == reg_cache_closes)
+    {
+        slot = &reg_cache[reg_cache_hash( handle, name )];
+        RtlFreeHeap( GetProcessHeap(), 0, *slot );
+        *slot = entry;
+        entry = NULL;
+    }
+    RtlLeaveCriticalSection( &reg_cache_section );
+    RtlFreeHeap( GetProcessHeap(), 0, entry );
+}
+
+/***********************************************************************
+ *           reg_cache_close
+ *
+ * Remove the cached values of a handle, once it has been closed.
+ */
+void reg_cache_close( HANDLE handle )
+{
+    unsigned int i;
+
+    if (!reg_cache_enabled) return;
+
+    RtlEnterCriticalSection( &reg_cache_section );
+    reg_cache_closes++;
+    for (i = 0; i < REG_CACHE_SIZE; i++)
+    {
+        if (!reg_cache[i] || reg_cache[i]->handle != handle) continue;
+        RtlFreeHeap( GetProcessHeap(), 0, reg_cache[i] );
+        reg_cache[i] = NULL;
+    }
+    RtlLeaveCriticalSection( &reg_cache_section );
+}
+
 /******************************************************************************
  * NtCreateKey [NTDLL.@]
  * ZwCreateKey [NTDLL.@]
@@ -536,7 +704,10 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
 {
     NTSTATUS ret;
     UCHAR *data_ptr;
-    unsigned int fixed_size, min_size;
+    unsigned int fixed_size, min_size, generation, closes;
+    DWORD total;
+    BOOL use_cache;
+    int type;
 
     TRACE( "(%p,%s,%d,%p,%d)\n", handle, debugstr_us(name), info_class, info, length );
 
@@ -574,21 +745,40 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
+    if (reg_cache_lookup( handle, name, length > fixed_size ? data_ptr : NULL, length - fixed_size,
+                          &ret, &type, &total ))
+    {
+        if (ret) return ret;
+        goto done;
+    }
+    use_cache = reg_cache_start( &generation, &closes );
+
     SERVER_START_REQ( get_key_value )
     {
         req->hkey = wine_server_obj_handle( handle );
         wine_server_add_data( req, name->Buffer, name->Length );
         if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
-        {
-            copy_key_value_info( info_class, info, length, reply->type,
-                                 name->Length, reply->total );
-            *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
-            if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
-            else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
-        }
+        ret = wine_server_call( req );
+        type  = reply->type;
+        total = reply->total;
     }
     SERVER_END_REQ;
+
+    if (use_cache)
+    {
+        /* only complete values can be cached */
+        if (ret == STATUS_OBJECT_NAME_NOT_FOUND)
+            reg_cache_store( handle, name, generation, closes, ret, 0, NULL, 0 );
+        else if (!ret && data_ptr && length > fixed_size && total <= length - fixed_size)
+            reg_cache_store( handle, name, generation, closes, ret, type, data_ptr, total );
+    }
+    if (ret) return ret;
+
+done:
+    copy_key_value_info( info_class, info, length, type, name->Length, total );
+    *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+    if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+    else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
     return ret;
 }
 
@@ -814,25 +1004,34 @@ NTSTATUS WINAPI NtRestoreKey(
 	return STATUS_SUCCESS;
 }
 /******************************************************************************
- * NtSaveKey [NTDLL.@]
- * ZwSaveKey [NTDLL.@]
+ * NtSaveKeyEx [NTDLL.@]
+ * ZwSaveKeyEx [NTDLL.@]
  */
-NTSTATUS WINAPI NtSaveKey(IN HANDLE KeyHandle, IN HANDLE FileHandle)
+NTSTATUS WINAPI NtSaveKeyEx(IN HANDLE KeyHandle, IN HANDLE FileHandle, IN ULONG Format)
 {
     NTSTATUS ret;
 
-    TRACE("(%p,%p)\n", KeyHandle, FileHandle);
+    TRACE("(%p,%p,%x)\n", KeyHandle, FileHandle, Format);
 
     SERVER_START_REQ( save_registry )
     {
-        req->hkey = wine_server_obj_handle( KeyHandle );
-        req->file = wine_server_obj_handle( FileHandle );
+        req->hkey   = wine_server_obj_handle( KeyHandle );
+        req->file   = wine_server_obj_handle( FileHandle );
+        req->format = Format;
         ret = wine_server_call( req );
     }
     SERVER_END_REQ;
 
     return ret;
 }
+/******************************************************************************
+ * NtSaveKey [NTDLL.@]
+ * ZwSaveKey [NTDLL.@]
+ */
+NTSTATUS WINAPI NtSaveKey(IN HANDLE KeyHandle, IN HANDLE FileHandle)
+{
+    return NtSaveKeyEx( KeyHandle, FileHandle, REG_STANDARD_FORMAT );
+}
 /******************************************************************************
  * NtSetInformationKey [NTDLL.@]
  * ZwSetInformationKey [NTDLL.@]
@@ -34,6 +34,9 @@
 #ifdef HAVE_PTHREAD_NP_H
 # include <pthread_np.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -80,6 +83,7 @@
 #include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/exception.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
@@ -277,14 +281,140 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+#ifdef __linux__
+
+static inline int request_futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+#else
+
+static inline int request_futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+
+/***********************************************************************
+ *           send_shm_request
+ *
+ * Send a request through the thread shared memory; only the header
+ * goes through the pipe, to wake up the server.
+ */
+static unsigned int send_shm_request( const struct __server_request_info *req, struct request_shm *shm )
+{
+    union generic_request header = req->u.req;
+    unsigned int i, status = STATUS_SUCCESS;
+    char *ptr = shm->req_data;
+    int ret;
+
+    if (req->data_count)
+    {
+        __TRY
+        {
+            for (i = 0; i < req->data_count; i++)
+            {
+                memcpy( ptr, req->data[i].ptr, req->data[i].size );
+                ptr += req->data[i].size;
+            }
+        }
+        __EXCEPT_PAGE_FAULT
+        {
+            status = STATUS_ACCESS_VIOLATION;
+        }
+        __ENDTRY
+        if (status) return status;
+    }
+
+    interlocked_xchg( &shm->state, REQUEST_SHM_POSTED );
+
+    header.request_header.req |= REQUEST_SHM_FLAG;
+    if ((ret = write( ntdll_get_thread_data()->request_fd, &header, sizeof(header) )) == sizeof(header))
+        return STATUS_SUCCESS;
+
+    shm->state = REQUEST_SHM_IDLE;
+    if (ret >= 0) server_protocol_error( "partial write %d\n", ret );
+    if (errno == EPIPE) abort_thread(0);
+    server_protocol_perror( "write" );
+}
+
+
+/***********************************************************************
+ *           wait_shm_reply
+ *
+ * Wait for a reply in the thread shared memory.
+ */
+static unsigned int wait_shm_reply( struct __server_request_info *req, struct request_shm *shm )
+{
+    static const int spin_count = 4000;
+    struct timespec timeout;
+    struct pollfd pfd;
+    int i;
+
+    /* the server usually replies quickly, so spin a bit before sleeping */
+    if (NtCurrentTeb()->Peb->NumberOfProcessors > 1)
+    {
+        for (i = 0; i < spin_count; i++)
+        {
+            if (*(volatile int *)&shm->state == REQUEST_SHM_REPLIED) goto done;
+            small_pause();
+        }
+    }
+
+    if (interlocked_cmpxchg( &shm->state, REQUEST_SHM_SLEEPING, REQUEST_SHM_POSTED ) == REQUEST_SHM_POSTED)
+    {
+        while (*(volatile int *)&shm->state == REQUEST_SHM_SLEEPING)
+        {
+            timeout.tv_sec  = 1;
+            timeout.tv_nsec = 0;
+            if (request_futex_wait( &shm->state, REQUEST_SHM_SLEEPING, &timeout ) != -1 ||
+                errno != ETIMEDOUT) continue;
+
+            /* make sure the server didn't die under us */
+            pfd.fd = ntdll_get_thread_data()->reply_fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll( &pfd, 1, 0 ) == 1) abort_thread(0);
+        }
+    }
+
+done:
+    memcpy( &req->u.reply, shm->reply, sizeof(req->u.reply) );
+    shm->state = REQUEST_SHM_IDLE;
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, shm->reply_data, req->u.reply.reply_header.reply_size );
+    return req->u.reply.reply_header.error;
+}
+
+
 /***********************************************************************
  *           server_call_unlocked
  */
 unsigned int server_call_unlocked( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
     unsigned int ret;
 
+    if (shm && req->u.req.request_header.request_size <= REQUEST_SHM_DATA_SIZE &&
+        req->u.req.request_header.reply_size <= REQUEST_SHM_DATA_SIZE)
+    {
+        if ((ret = send_shm_request( req, shm ))) return ret;
+        return wait_shm_reply( req, shm );
+    }
     if ((ret = send_request( req ))) return ret;
     return wait_reply( req );
 }
@@ -813,14 +943,22 @@ union fd_cache_entry
     LONG64 data;
     struct
     {
-        int fd;
+        unsigned int        fd : 29;        /* fd + 1, or error status + 1 for FD_TYPE_INVALID */
+        unsigned int        comp_flags : 3;
         enum server_fd_type type : 5;
         unsigned int        access : 3;
         unsigned int        options : 24;
     } s;
 };
 
+#define FD_CACHE_MAX_FD      ((1 << 29) - 2)
+#define FD_CACHE_ERROR_BITS  0xc0000000   /* severity bits of error statuses, not stored */
+
 C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
+C_ASSERT( FD_TYPE_NB_TYPES <= 1 << 5 );
+C_ASSERT( FILE_OPEN_FOR_FREE_SPACE_QUERY < 1 << 24 );
+C_ASSERT( (FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE |
+           FILE_SKIP_SET_USER_EVENT_ON_FAST_IO) < 1 << 3 );
 
 #define FD_CACHE_BLOCK_SIZE  (65536 / sizeof(union fd_cache_entry))
 #define FD_CACHE_ENTRIES     128
@@ -842,7 +980,7 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
  * Caller must hold fd_cache_section.
  */
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
-                            unsigned int access, unsigned int options )
+                            unsigned int access, unsigned int options, unsigned int comp_flags )
 {
     unsigned int entry, idx = handle_to_index( handle, &entry );
     union fd_cache_entry cache;
@@ -852,6 +990,13 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
         FIXME( "too many allocated handles, not caching %p\n", handle );
         return FALSE;
     }
+    if (type == FD_TYPE_INVALID)
+    {
+        /* fd is an error status here, it needs to fit without its severity bits */
+        if (((unsigned int)fd & (FD_CACHE_ERROR_BITS | 0x20000000)) != FD_CACHE_ERROR_BITS) return FALSE;
+        fd &= ~FD_CACHE_ERROR_BITS;
+    }
+    else if (fd > FD_CACHE_MAX_FD) return FALSE;
 
     if (!fd_cache[entry])  /* do we need to allocate a new block of entries? */
     {
@@ -870,6 +1015,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
+    cache.s.comp_flags = comp_flags;
     cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
     assert( !cache.s.fd );
     return TRUE;
@@ -891,7 +1037,7 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
     /* if fd type is invalid, fd stores an error value */
-    if (cache.s.type == FD_TYPE_INVALID) return cache.s.fd - 1;
+    if (cache.s.type == FD_TYPE_INVALID) return (cache.s.fd - 1) | FD_CACHE_ERROR_BITS;
 
     *fd = cache.s.fd - 1;
     if (type) *type = cache.s.type;
@@ -901,6 +1047,46 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 }
 
 
+/***********************************************************************/
+/* process memory access support */
+
+struct vm_pid_cache_entry
+{
+    obj_handle_t handle;    /* process handle, 0 if the entry is unused */
+    int          unix_pid;  /* unix pid of the process */
+    int          proc_fd;   /* /proc/<pid> directory, to detect the death of the process */
+    unsigned int access;    /* granted PROCESS_VM_READ/PROCESS_VM_WRITE access */
+};
+
+#define VM_PID_CACHE_SIZE 16
+
+static struct vm_pid_cache_entry vm_pid_cache[VM_PID_CACHE_SIZE];
+
+static inline struct vm_pid_cache_entry *get_vm_pid_cache_entry( obj_handle_t handle )
+{
+    return &vm_pid_cache[(handle >> 2) % VM_PID_CACHE_SIZE];
+}
+
+/* caller must hold fd_cache_section */
+static void free_vm_pid_cache_entry( struct vm_pid_cache_entry *entry )
+{
+    close( entry->proc_fd );
+    entry->handle = 0;
+}
+
+static void remove_vm_pid_from_cache( obj_handle_t handle )
+{
+    struct vm_pid_cache_entry *entry = get_vm_pid_cache_entry( handle );
+    sigset_t sigset;
+
+    if (entry->handle != handle) return;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    if (entry->handle == handle) free_vm_pid_cache_entry( entry );
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
 /***********************************************************************
  *           server_remove_fd_from_cache
  */
@@ -916,10 +1102,244 @@ int server_remove_fd_from_cache( HANDLE handle )
         if (cache.s.type != FD_TYPE_INVALID) fd = cache.s.fd - 1;
     }
 
+    /* the process handle may be in the process memory access cache too */
+    remove_vm_pid_from_cache( wine_server_obj_handle( handle ));
+
     return fd;
 }
 
 
+/***********************************************************************
+ *           server_get_completion_flags
+ *
+ * Return the completion notification flags of a cached fd, 0 if unknown.
+ */
+unsigned int server_get_completion_flags( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache;
+
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return 0;
+    cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    if (!cache.data || cache.s.type == FD_TYPE_INVALID) return 0;
+    return cache.s.comp_flags;
+}
+
+
+/***********************************************************************
+ *           server_set_completion_flags
+ *
+ * Add completion notification flags to a cached fd.
+ */
+void server_set_completion_flags( HANDLE handle, unsigned int flags )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache, old;
+
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return;
+
+    old.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    for (;;)
+    {
+        if (!old.data || old.s.type == FD_TYPE_INVALID) return;
+        cache = old;
+        cache.s.comp_flags |= flags;
+        cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, cache.data, old.data );
+        if (cache.data == old.data) return;
+        old = cache;
+    }
+}
+
+
+/***********************************************************************
+ *           server_get_process_vm_pid
+ *
+ * Retrieve the unix pid of a process, to access its memory directly.
+ * The pid is cached along with the handle, until the handle is closed
+ * or the process dies.
+ */
+NTSTATUS server_get_process_vm_pid( HANDLE process, unsigned int access, int *unix_pid )
+{
+#ifdef __linux__
+    obj_handle_t handle = wine_server_obj_handle( process );
+    struct vm_pid_cache_entry *entry = get_vm_pid_cache_entry( handle );
+    NTSTATUS status = STATUS_SUCCESS;
+    unsigned int granted = 0;
+    char path[32];
+    sigset_t sigset;
+    int pid = -1, fd;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+
+    /* the /proc directory of a dead process can't be accessed anymore, even if its pid got reused */
+    if (entry->handle == handle && faccessat( entry->proc_fd, "stat", R_OK, 0 ) == -1)
+        free_vm_pid_cache_entry( entry );
+
+    if (entry->handle != handle)
+    {
+        SERVER_START_REQ( get_process_vm_pid )
+        {
+            req->handle = handle;
+            if (!(status = wine_server_call( req )))
+            {
+                pid = reply->unix_pid;
+                granted = reply->access;
+            }
+        }
+        SERVER_END_REQ;
+
+        if (!status)
+        {
+            sprintf( path, "/proc/%u", pid );
+            if ((fd = open( path, O_RDONLY | O_DIRECTORY )) != -1)
+            {
+                if (entry->handle) free_vm_pid_cache_entry( entry );
+                entry->handle   = handle;
+                entry->unix_pid = pid;
+                entry->proc_fd  = fd;
+                entry->access   = granted;
+            }
+            else status = STATUS_NOT_SUPPORTED;
+        }
+    }
+
+    if (!status)
+    {
+        if ((entry->access & access) == access) *unix_pid = entry->unix_pid;
+        else status = STATUS_ACCESS_DENIED;
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return status;
+#else
+    return STATUS_NOT_SUPPORTED;
+#endif
+}
+
+
+/***********************************************************************
+ *           server_get_fsync_shm
+ *
+ * Retrieve the shared memory used for in-process synchronization.
+ */
+int server_get_fsync_shm( data_size_t *size )
+{
+    obj_handle_t dummy;
+    sigset_t sigset;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( get_fsync_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            *size = reply->size;
+            fd = receive_fd( &dummy );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return fd;
+}
+
+
+/***********************************************************************
+ *           server_get_registry_shm
+ *
+ * Retrieve the shared memory holding the registry generation counter.
+ */
+int server_get_registry_shm( data_size_t *size )
+{
+    obj_handle_t dummy;
+    sigset_t sigset;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( get_registry_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            *size = reply->size;
+            fd = receive_fd( &dummy );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return fd;
+}
+
+
+/***********************************************************************
+ *           server_get_image_reloc_fd
+ *
+ * Retrieve the file holding a copy of an image relocated to a given address.
+ */
+int server_get_image_reloc_fd( HANDLE mapping, void *base )
+{
+    obj_handle_t dummy;
+    sigset_t sigset;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( get_image_reloc_fd )
+    {
+        req->mapping = wine_server_obj_handle( mapping );
+        req->base    = wine_server_client_ptr( base );
+        if (!wine_server_call( req )) fd = receive_fd( &dummy );
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return fd;
+}
+
+
+/***********************************************************************
+ *           server_init_request_shm
+ *
+ * Map the shared memory used to exchange small requests with the server.
+ */
+static void server_init_request_shm(void)
+{
+    struct request_shm *shm;
+    obj_handle_t dummy;
+    data_size_t size = 0;
+    sigset_t sigset;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( get_request_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &dummy );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (fd == -1) return;
+    if (size == sizeof(*shm))
+    {
+        shm = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        if (shm != MAP_FAILED) ntdll_get_thread_data()->request_shm = shm;
+    }
+    close( fd );
+}
+
+
+/***********************************************************************
+ *           server_free_request_shm
+ */
+void server_free_request_shm(void)
+{
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
+
+    if (!shm) return;
+    ntdll_get_thread_data()->request_shm = NULL;
+    munmap( shm, sizeof(*shm) );
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -956,14 +1376,14 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                 {
                     assert( wine_server_ptr_handle(fd_handle) == handle );
                     *needs_close = (!reply->cacheable ||
-                                    !add_fd_to_cache( handle, fd, reply->type,
-                                                      reply->access, reply->options ));
+                                    !add_fd_to_cache( handle, fd, reply->type, reply->access,
+                                                      reply->options, reply->comp_flags ));
                 }
                 else ret = STATUS_TOO_MANY_OPENED_FILES;
             }
             else if (reply->cacheable)
             {
-                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0 );
+                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0, 0 );
             }
         }
         SERVER_END_REQ;
@@ -1521,6 +1941,7 @@ size_t server_init_thread( void *entry_point, BOOL *suspend )
     switch (ret)
     {
     case STATUS_SUCCESS:
+        server_init_request_shm();
         if (arch)
         {
             if (!strcmp( arch, "win32" ) && (is_win64 || is_wow64))
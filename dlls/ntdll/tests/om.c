@@ -1979,6 +1979,131 @@ static void test_mutant(void)
     NtClose( mutant );
 }
 
+static HANDLE latency_event, latency_key;
+
+static NTSTATUS latency_dup_close(void)
+{
+    HANDLE handle;
+    NTSTATUS status;
+
+    status = NtDuplicateObject( GetCurrentProcess(), latency_event, GetCurrentProcess(), &handle,
+                                0, 0, DUPLICATE_SAME_ACCESS );
+    if (!status) status = pNtClose( handle );
+    return status;
+}
+
+static NTSTATUS latency_query_object(void)
+{
+    OBJECT_BASIC_INFORMATION info;
+
+    return pNtQueryObject( latency_event, ObjectBasicInformation, &info, sizeof(info), NULL );
+}
+
+static NTSTATUS latency_query_thread(void)
+{
+    THREAD_BASIC_INFORMATION info;
+
+    return NtQueryInformationThread( GetCurrentThread(), ThreadBasicInformation, &info, sizeof(info), NULL );
+}
+
+static NTSTATUS latency_create_named(void)
+{
+    static const WCHAR name[] = {'\\','B','a','s','e','N','a','m','e','d','O','b','j','e','c','t','s',
+                                 '\\','l','a','t','e','n','c','y','_','e','v','e','n','t',0};
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    HANDLE handle;
+    NTSTATUS status;
+
+    pRtlInitUnicodeString( &str, name );
+    InitializeObjectAttributes( &attr, &str, 0, 0, NULL );
+    status = pNtCreateEvent( &handle, EVENT_ALL_ACCESS, &attr, NotificationEvent, FALSE );
+    if (!status) status = pNtClose( handle );
+    return status;
+}
+
+static NTSTATUS latency_open_key(void)
+{
+    static const WCHAR name[] = {'\\','R','e','g','i','s','t','r','y','\\','M','a','c','h','i','n','e',
+                                 '\\','S','o','f','t','w','a','r','e',0};
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    HANDLE key;
+    NTSTATUS status;
+
+    pRtlInitUnicodeString( &str, name );
+    InitializeObjectAttributes( &attr, &str, 0, 0, NULL );
+    status = pNtOpenKey( &key, KEY_READ, &attr );
+    if (!status) status = pNtClose( key );
+    return status;
+}
+
+static NTSTATUS latency_query_value(void)
+{
+    static const WCHAR name[] = {'P','r','o','g','r','a','m','F','i','l','e','s','D','i','r',0};
+    char buffer[sizeof(KEY_VALUE_PARTIAL_INFORMATION) + MAX_PATH * sizeof(WCHAR)];
+    UNICODE_STRING str;
+    ULONG len;
+
+    pRtlInitUnicodeString( &str, name );
+    return NtQueryValueKey( latency_key, &str, KeyValuePartialInformation, buffer, sizeof(buffer), &len );
+}
+
+/* measure the round trip time of some of the most frequent server requests */
+static void test_request_latency(void)
+{
+    static const WCHAR keyname[] = {'\\','R','e','g','i','s','t','r','y','\\','M','a','c','h','i','n','e',
+                                    '\\','S','o','f','t','w','a','r','e','\\','M','i','c','r','o','s','o','f','t',
+                                    '\\','W','i','n','d','o','w','s','\\','C','u','r','r','e','n','t',
+                                    'V','e','r','s','i','o','n',0};
+    static const struct
+    {
+        const char *name;
+        NTSTATUS (*func)(void);
+    }
+    tests[] =
+    {
+        { "dup_handle+close_handle", latency_dup_close },
+        { "get_object_info", latency_query_object },
+        { "get_thread_info", latency_query_thread },
+        { "create_event (named)+close_handle", latency_create_named },
+        { "open_key+close_handle", latency_open_key },
+        { "get_key_value", latency_query_value },
+    };
+    static const int iterations = 10000;
+    LARGE_INTEGER freq, start, end;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    NTSTATUS status;
+    unsigned int i;
+    int j;
+
+    status = pNtCreateEvent( &latency_event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    ok( status == STATUS_SUCCESS, "NtCreateEvent failed %08x\n", status );
+    pRtlInitUnicodeString( &str, keyname );
+    InitializeObjectAttributes( &attr, &str, 0, 0, NULL );
+    status = pNtOpenKey( &latency_key, KEY_READ, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed %08x\n", status );
+
+    QueryPerformanceFrequency( &freq );
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < iterations; j++)
+        {
+            status = tests[i].func();
+            if (status) break;
+        }
+        QueryPerformanceCounter( &end );
+        ok( status == STATUS_SUCCESS, "%s failed %08x\n", tests[i].name, status );
+        trace( "%s: %.2f us per call\n", tests[i].name,
+               (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / (j ? j : 1) );
+    }
+
+    pNtClose( latency_key );
+    pNtClose( latency_event );
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
@@ -2044,4 +2169,5 @@ START_TEST(om)
     test_mutant();
     test_keyed_events();
     test_null_device();
+    test_request_latency();
 }
@@ -823,6 +823,196 @@ static void test_NtQueryValueKey(void)
     pNtClose(key);
 }
 
+struct query_value_thread_params
+{
+    HANDLE key;
+    UNICODE_STRING *name;
+    volatile LONG *stop;
+    LONG calls;
+    NTSTATUS status;
+};
+
+static DWORD WINAPI query_value_thread(void *arg)
+{
+    struct query_value_thread_params *params = arg;
+    char buffer[256];
+    DWORD len;
+
+    while (!*params->stop)
+    {
+        params->status = pNtQueryValueKey(params->key, params->name, KeyValuePartialInformation,
+                                          buffer, sizeof(buffer), &len);
+        if (params->status) break;
+        params->calls++;
+    }
+    return 0;
+}
+
+/* measure how the server copes with concurrent registry reads */
+static void test_query_value_scalability(void)
+{
+    static const int thread_counts[] = { 1, 2, 4, 8, 16 };
+    struct query_value_thread_params params[16];
+    HANDLE threads[16];
+    volatile LONG stop;
+    LARGE_INTEGER freq, start, end;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    NTSTATUS status;
+    HANDLE key;
+    LONG total;
+    int i, j;
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+    if (status) return;
+    pRtlCreateUnicodeStringFromAsciiz(&name, "deletetest");
+
+    QueryPerformanceFrequency(&freq);
+    for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+    {
+        stop = 0;
+        for (j = 0; j < thread_counts[i]; j++)
+        {
+            params[j].key = key;
+            params[j].name = &name;
+            params[j].stop = &stop;
+            params[j].calls = 0;
+            params[j].status = STATUS_SUCCESS;
+            threads[j] = CreateThread(NULL, 0, query_value_thread, &params[j], 0, NULL);
+            ok(threads[j] != NULL, "CreateThread failed %u\n", GetLastError());
+        }
+        QueryPerformanceCounter(&start);
+        Sleep(250);
+        stop = 1;
+        WaitForMultipleObjects(thread_counts[i], threads, TRUE, INFINITE);
+        QueryPerformanceCounter(&end);
+
+        for (j = total = 0; j < thread_counts[i]; j++)
+        {
+            ok(params[j].status == STATUS_SUCCESS, "NtQueryValueKey failed: 0x%08x\n", params[j].status);
+            total += params[j].calls;
+            CloseHandle(threads[j]);
+        }
+        trace("%2d threads: %.0f NtQueryValueKey calls per second\n", thread_counts[i],
+              total * (double)freq.QuadPart / (end.QuadPart - start.QuadPart));
+    }
+
+    pRtlFreeUnicodeString(&name);
+    pNtClose(key);
+}
+
+static DWORD query_dword_value(HANDLE key, UNICODE_STRING *name, NTSTATUS *status)
+{
+    char buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(DWORD)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    DWORD len;
+
+    *status = pNtQueryValueKey(key, name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    return *status ? 0 : *(DWORD *)info->Data;
+}
+
+/* check that cached lookups (WINEREGISTRYCACHE=1) see all the changes, and time them */
+static void test_query_value_cache(void)
+{
+    static const WCHAR cachetestW[] = {'c','a','c','h','e','t','e','s','t',0};
+    char buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(DWORD)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    UNICODE_STRING name, upper_name, missing, subkey;
+    LARGE_INTEGER freq, start, end;
+    OBJECT_ATTRIBUTES attr;
+    HANDLE parent, key, key2;
+    NTSTATUS status;
+    DWORD value, len;
+    int i;
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&parent, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08x\n", status);
+    if (status) return;
+
+    pRtlInitUnicodeString(&subkey, cachetestW);
+    InitializeObjectAttributes(&attr, &subkey, 0, parent, 0);
+    status = pNtCreateKey(&key, KEY_ALL_ACCESS, &attr, 0, 0, 0, 0);
+    ok(status == STATUS_SUCCESS, "NtCreateKey failed: 0x%08x\n", status);
+    status = pNtOpenKey(&key2, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08x\n", status);
+
+    pRtlCreateUnicodeStringFromAsciiz(&name, "value");
+    pRtlCreateUnicodeStringFromAsciiz(&upper_name, "VALUE");
+    pRtlCreateUnicodeStringFromAsciiz(&missing, "missing");
+
+    value = 1;
+    status = pNtSetValueKey(key, &name, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08x\n", status);
+    value = query_dword_value(key, &name, &status);
+    ok(status == STATUS_SUCCESS && value == 1, "got 0x%08x, %u\n", status, value);
+    value = query_dword_value(key, &upper_name, &status);
+    ok(status == STATUS_SUCCESS && value == 1, "got 0x%08x, %u\n", status, value);
+
+    /* changes through another handle are seen */
+    value = 2;
+    status = pNtSetValueKey(key2, &name, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08x\n", status);
+    value = query_dword_value(key, &name, &status);
+    ok(status == STATUS_SUCCESS && value == 2, "got 0x%08x, %u\n", status, value);
+
+    query_dword_value(key, &missing, &status);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08x\n", status);
+    value = 3;
+    status = pNtSetValueKey(key2, &missing, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08x\n", status);
+    value = query_dword_value(key, &missing, &status);
+    ok(status == STATUS_SUCCESS && value == 3, "got 0x%08x, %u\n", status, value);
+
+    /* a cached value still reports a short buffer */
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer,
+                              FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data), &len);
+    ok(status == STATUS_BUFFER_OVERFLOW, "got 0x%08x\n", status);
+    ok(len == sizeof(buffer), "got len %u\n", len);
+    ok(info->Type == REG_DWORD && info->DataLength == sizeof(DWORD), "got type %u len %u\n",
+       info->Type, info->DataLength);
+
+    /* the handle value may be reused for another key once closed */
+    pNtClose(key);
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08x\n", status);
+    query_dword_value(key, &missing, &status);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08x\n", status);
+    pNtClose(key);
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 10000; i++) query_dword_value(key2, &name, &status);
+    QueryPerformanceCounter(&end);
+    trace("repeated lookups: %.2f us per call\n",
+          (end.QuadPart - start.QuadPart) * 1e6 / freq.QuadPart / 10000);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 10000; i++)
+    {
+        /* every change invalidates the cache */
+        value = i;
+        pNtSetValueKey(key2, &missing, 0, REG_DWORD, &value, sizeof(value));
+        query_dword_value(key2, &name, &status);
+    }
+    QueryPerformanceCounter(&end);
+    trace("lookups after a change: %.2f us per call\n",
+          (end.QuadPart - start.QuadPart) * 1e6 / freq.QuadPart / 10000);
+
+    status = pNtDeleteKey(key2);
+    ok(status == STATUS_SUCCESS, "NtDeleteKey failed: 0x%08x\n", status);
+    query_dword_value(key2, &name, &status);
+    ok(status == STATUS_KEY_DELETED, "got 0x%08x\n", status);
+
+    pRtlFreeUnicodeString(&name);
+    pRtlFreeUnicodeString(&upper_name);
+    pRtlFreeUnicodeString(&missing);
+    pNtClose(key2);
+    pNtClose(parent);
+}
+
 static void test_NtDeleteKey(void)
 {
     NTSTATUS status;
@@ -1950,6 +2140,8 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_query_value_scalability();
+    test_query_value_cache();
     test_long_value_name();
     test_notify();
     test_NtDeleteKey();
@@ -22,18 +22,21 @@
 
 static HMODULE hntdll = 0;
 static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
+static NTSTATUS (WINAPI *pTpAllocIoCompletion)(TP_IO **,HANDLE,PTP_IO_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocPool)(TP_POOL **,PVOID);
 static NTSTATUS (WINAPI *pTpAllocTimer)(TP_TIMER **,PTP_TIMER_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocWait)(TP_WAIT **,PTP_WAIT_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocWork)(TP_WORK **,PTP_WORK_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpCallbackMayRunLong)(TP_CALLBACK_INSTANCE *);
 static VOID     (WINAPI *pTpCallbackReleaseSemaphoreOnCompletion)(TP_CALLBACK_INSTANCE *,HANDLE,DWORD);
+static VOID     (WINAPI *pTpCancelAsyncIoOperation)(TP_IO *);
 static VOID     (WINAPI *pTpDisassociateCallback)(TP_CALLBACK_INSTANCE *);
 static BOOL     (WINAPI *pTpIsTimerSet)(TP_TIMER *);
 static VOID     (WINAPI *pTpReleaseWait)(TP_WAIT *);
 static VOID     (WINAPI *pTpPostWork)(TP_WORK *);
 static VOID     (WINAPI *pTpReleaseCleanupGroup)(TP_CLEANUP_GROUP *);
 static VOID     (WINAPI *pTpReleaseCleanupGroupMembers)(TP_CLEANUP_GROUP *,BOOL,PVOID);
+static VOID     (WINAPI *pTpReleaseIoCompletion)(TP_IO *);
 static VOID     (WINAPI *pTpReleasePool)(TP_POOL *);
 static VOID     (WINAPI *pTpReleaseTimer)(TP_TIMER *);
 static VOID     (WINAPI *pTpReleaseWork)(TP_WORK *);
@@ -41,6 +44,8 @@ static VOID     (WINAPI *pTpSetPoolMaxThreads)(TP_POOL *,DWORD);
 static VOID     (WINAPI *pTpSetTimer)(TP_TIMER *,LARGE_INTEGER *,LONG,LONG);
 static VOID     (WINAPI *pTpSetWait)(TP_WAIT *,HANDLE,LARGE_INTEGER *);
 static NTSTATUS (WINAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static VOID     (WINAPI *pTpStartAsyncIoOperation)(TP_IO *);
+static VOID     (WINAPI *pTpWaitForIoCompletion)(TP_IO *,BOOL);
 static VOID     (WINAPI *pTpWaitForTimer)(TP_TIMER *,BOOL);
 static VOID     (WINAPI *pTpWaitForWait)(TP_WAIT *,BOOL);
 static VOID     (WINAPI *pTpWaitForWork)(TP_WORK *,BOOL);
@@ -63,17 +68,20 @@ static BOOL init_threadpool(void)
     }
 
     NTDLL_GET_PROC(TpAllocCleanupGroup);
+    NTDLL_GET_PROC(TpAllocIoCompletion);
     NTDLL_GET_PROC(TpAllocPool);
     NTDLL_GET_PROC(TpAllocTimer);
     NTDLL_GET_PROC(TpAllocWait);
     NTDLL_GET_PROC(TpAllocWork);
     NTDLL_GET_PROC(TpCallbackMayRunLong);
     NTDLL_GET_PROC(TpCallbackReleaseSemaphoreOnCompletion);
+    NTDLL_GET_PROC(TpCancelAsyncIoOperation);
     NTDLL_GET_PROC(TpDisassociateCallback);
     NTDLL_GET_PROC(TpIsTimerSet);
     NTDLL_GET_PROC(TpPostWork);
     NTDLL_GET_PROC(TpReleaseCleanupGroup);
     NTDLL_GET_PROC(TpReleaseCleanupGroupMembers);
+    NTDLL_GET_PROC(TpReleaseIoCompletion);
     NTDLL_GET_PROC(TpReleasePool);
     NTDLL_GET_PROC(TpReleaseTimer);
     NTDLL_GET_PROC(TpReleaseWait);
@@ -82,6 +90,8 @@ static BOOL init_threadpool(void)
     NTDLL_GET_PROC(TpSetTimer);
     NTDLL_GET_PROC(TpSetWait);
     NTDLL_GET_PROC(TpSimpleTryPost);
+    NTDLL_GET_PROC(TpStartAsyncIoOperation);
+    NTDLL_GET_PROC(TpWaitForIoCompletion);
     NTDLL_GET_PROC(TpWaitForTimer);
     NTDLL_GET_PROC(TpWaitForWait);
     NTDLL_GET_PROC(TpWaitForWork);
@@ -1897,6 +1907,130 @@ static void test_tp_multi_wait(void)
     CloseHandle(semaphore);
 }
 
+struct io_cb_context
+{
+    LONG count;
+    LONG errors;
+    ULONG_PTR bytes;
+    HANDLE event;
+    LONG target;
+};
+
+static void CALLBACK io_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, void *cvalue,
+                           IO_STATUS_BLOCK *iosb, TP_IO *io)
+{
+    struct io_cb_context *context = userdata;
+
+    if (iosb->Status) InterlockedIncrement(&context->errors);
+    InterlockedExchangeAdd((LONG *)&context->bytes, iosb->Information);
+    if (InterlockedIncrement(&context->count) == context->target)
+        SetEvent(context->event);
+}
+
+static void test_tp_io(void)
+{
+    static const char pipe_name[] = "\\\\.\\pipe\\wine_tp_io_test";
+    struct io_cb_context context;
+    OVERLAPPED ovl[64];
+    char in[64][16], out[16];
+    HANDLE server, client;
+    DWORD result, size, ticks;
+    TP_IO *io;
+    NTSTATUS status;
+    BOOL ret;
+    int i, rounds;
+
+    if (!pTpAllocIoCompletion)
+    {
+        win_skip("TpAllocIoCompletion not supported, skipping tests\n");
+        return;
+    }
+
+    server = CreateNamedPipeA(pipe_name, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+                              PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE, 1, 4096, 4096, 0, NULL);
+    ok(server != INVALID_HANDLE_VALUE, "CreateNamedPipe failed with %u\n", GetLastError());
+    client = CreateFileA(pipe_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(client != INVALID_HANDLE_VALUE, "CreateFile failed with %u\n", GetLastError());
+
+    memset(&context, 0, sizeof(context));
+    context.event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ok(context.event != NULL, "CreateEvent failed with %u\n", GetLastError());
+
+    io = NULL;
+    status = pTpAllocIoCompletion(&io, server, io_cb, &context, NULL);
+    ok(!status, "TpAllocIoCompletion failed with status %x\n", status);
+    ok(io != NULL, "expected io != NULL\n");
+
+    /* a single operation completes through the threadpool */
+    context.target = 1;
+    memset(&ovl[0], 0, sizeof(ovl[0]));
+    pTpStartAsyncIoOperation(io);
+    ret = ReadFile(server, in[0], sizeof(in[0]), NULL, &ovl[0]);
+    ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %u, error %u\n", ret, GetLastError());
+    ret = WriteFile(client, "test", 4, &size, NULL);
+    ok(ret, "WriteFile failed with %u\n", GetLastError());
+    result = WaitForSingleObject(context.event, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(context.count == 1, "expected count = 1, got %u\n", context.count);
+    ok(context.bytes == 4, "expected 4 bytes, got %lu\n", context.bytes);
+    ok(!context.errors, "got %u errors\n", context.errors);
+
+    /* many outstanding operations are dispatched to the pool workers */
+    ticks = GetTickCount();
+    for (rounds = 0; rounds < 50; rounds++)
+    {
+        context.count = 0;
+        context.bytes = 0;
+        context.target = sizeof(ovl) / sizeof(ovl[0]);
+        for (i = 0; i < context.target; i++)
+        {
+            memset(&ovl[i], 0, sizeof(ovl[i]));
+            pTpStartAsyncIoOperation(io);
+            ret = ReadFile(server, in[i], sizeof(in[i]), NULL, &ovl[i]);
+            ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %u, error %u\n",
+               ret, GetLastError());
+        }
+        memset(out, 'x', sizeof(out));
+        for (i = 0; i < context.target; i++)
+        {
+            ret = WriteFile(client, out, sizeof(out), &size, NULL);
+            ok(ret, "WriteFile failed with %u\n", GetLastError());
+        }
+        result = WaitForSingleObject(context.event, 5000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+        pTpWaitForIoCompletion(io, FALSE);
+        ok(context.count == context.target, "expected count = %u, got %u\n", context.target, context.count);
+        ok(context.bytes == context.target * sizeof(out), "got %lu bytes\n", context.bytes);
+        if (context.count != context.target) break;
+    }
+    trace("%u rounds of %u operations took %u ms\n", rounds, context.target, GetTickCount() - ticks);
+    ok(!context.errors, "got %u errors\n", context.errors);
+
+    /* canceled operations don't block TpWaitForIoCompletion */
+    context.count = 0;
+    pTpStartAsyncIoOperation(io);
+    pTpCancelAsyncIoOperation(io);
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(context.count == 0, "expected count = 0, got %u\n", context.count);
+
+    /* completions of canceled operations may be dropped */
+    context.target = 1;
+    memset(&ovl[0], 0, sizeof(ovl[0]));
+    pTpStartAsyncIoOperation(io);
+    ret = ReadFile(server, in[0], sizeof(in[0]), NULL, &ovl[0]);
+    ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %u, error %u\n", ret, GetLastError());
+    ret = CancelIo(server);
+    ok(ret, "CancelIo failed with %u\n", GetLastError());
+    pTpWaitForIoCompletion(io, TRUE);
+    ok(context.count <= 1, "expected count <= 1, got %u\n", context.count);
+
+    pTpReleaseIoCompletion(io);
+    CloseHandle(context.event);
+    CloseHandle(client);
+    CloseHandle(server);
+}
+
 START_TEST(threadpool)
 {
     test_RtlQueueWorkItem();
@@ -1916,4 +2050,5 @@ START_TEST(threadpool)
     test_tp_window_length();
     test_tp_wait();
     test_tp_multi_wait();
+    test_tp_io();
 }
@@ -361,6 +361,7 @@ HANDLE thread_init(void)
     /* setup the server connection */
     server_init_process();
     info_size = server_init_thread( peb, &suspend );
+    fsync_init();
 
     /* create the process heap */
     if (!(peb->ProcessHeap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL )))
@@ -394,6 +395,7 @@ HANDLE thread_init(void)
     user_shared_data->u.TickCount.High2Time = user_shared_data->u.TickCount.High1Time;
     user_shared_data->TickCountLowDeprecated = user_shared_data->u.TickCount.LowPart;
     user_shared_data->TickCountMultiplier = 1 << 24;
+    user_shared_data->LargePageMinimum = virtual_get_large_page_size();
 
     fill_cpu_info();
 
@@ -433,6 +435,7 @@ void terminate_thread( int status )
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
     if (interlocked_xchg_add( &nb_threads, -1 ) <= 1) _exit( status );
 
+    server_free_request_shm();
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
@@ -482,6 +485,7 @@ void exit_thread( int status )
         }
     }
 
+    server_free_request_shm();
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
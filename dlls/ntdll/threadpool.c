@@ -138,12 +138,20 @@ enum threadpool_objtype
     TP_OBJECT_TYPE_SIMPLE,
     TP_OBJECT_TYPE_WORK,
     TP_OBJECT_TYPE_TIMER,
-    TP_OBJECT_TYPE_WAIT
+    TP_OBJECT_TYPE_WAIT,
+    TP_OBJECT_TYPE_IO
+};
+
+struct io_completion
+{
+    IO_STATUS_BLOCK         iosb;
+    ULONG_PTR               cvalue;
 };
 
 /* internal threadpool object representation */
 struct threadpool_object
 {
+    void                   *win32_callback; /* leave space for kernel32 to store the win32 callback */
     LONG                    refcount;
     BOOL                    shutdown;
     /* read-only information */
@@ -199,6 +207,16 @@ struct threadpool_object
             ULONGLONG       timeout;
             HANDLE          handle;
         } wait;
+        struct
+        {
+            PTP_IO_CALLBACK callback;
+            /* information about the I/O object, locked via .pool->cs */
+            unsigned int    pending_count;
+            unsigned int    skipped_count;
+            unsigned int    completion_count;
+            unsigned int    completion_max;
+            struct io_completion *completions;
+        } io;
     } u;
 };
 
@@ -280,6 +298,33 @@ static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue.cs") }
 };
 
+/* global I/O completion queue object */
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug;
+
+static struct
+{
+    CRITICAL_SECTION        cs;
+    LONG                    objcount;
+    BOOL                    thread_running;
+    HANDLE                  port;
+    RTL_CONDITION_VARIABLE  update_event;
+}
+ioqueue =
+{
+    { &ioqueue_debug, -1, 0, 0, 0, 0 },         /* cs */
+    0,                                          /* objcount */
+    FALSE,                                      /* thread_running */
+    NULL,                                       /* port */
+    RTL_CONDITION_VARIABLE_INIT                 /* update_event */
+};
+
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug =
+{
+    0, 0, &ioqueue.cs,
+    { &ioqueue_debug.ProcessLocksList, &ioqueue_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": ioqueue.cs") }
+};
+
 struct waitqueue_bucket
 {
     struct list             bucket_entry;
@@ -315,6 +360,13 @@ static inline struct threadpool_object *impl_from_TP_WAIT( TP_WAIT *wait )
     return object;
 }
 
+static inline struct threadpool_object *impl_from_TP_IO( TP_IO *io )
+{
+    struct threadpool_object *object = (struct threadpool_object *)io;
+    assert( object->type == TP_OBJECT_TYPE_IO );
+    return object;
+}
+
 static inline struct threadpool_group *impl_from_TP_CLEANUP_GROUP( TP_CLEANUP_GROUP *group )
 {
     return (struct threadpool_group *)group;
@@ -1631,6 +1683,189 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
     RtlLeaveCriticalSection( &waitqueue.cs );
 }
 
+/***********************************************************************
+ *           tp_io_alloc_completion    (internal)
+ *
+ * Appends an entry to the list of completions waiting for a callback.
+ * Must be called with the pool lock held.
+ */
+static struct io_completion *tp_io_alloc_completion( struct threadpool_object *io )
+{
+    struct io_completion *completions;
+    unsigned int max;
+
+    if (io->u.io.completion_count == io->u.io.completion_max)
+    {
+        max = io->u.io.completion_max ? 2 * io->u.io.completion_max : 8;
+        if (io->u.io.completions)
+            completions = RtlReAllocateHeap( GetProcessHeap(), 0, io->u.io.completions,
+                                             max * sizeof(*completions) );
+        else
+            completions = RtlAllocateHeap( GetProcessHeap(), 0, max * sizeof(*completions) );
+        if (!completions) return NULL;
+        io->u.io.completions    = completions;
+        io->u.io.completion_max = max;
+    }
+    return &io->u.io.completions[io->u.io.completion_count++];
+}
+
+/***********************************************************************
+ *           ioqueue_thread_proc    (internal)
+ *
+ * Dispatches the packets of the shared I/O completion port to the
+ * worker threads of the pool owning the I/O object.
+ */
+static void CALLBACK ioqueue_thread_proc( void *param )
+{
+    struct io_completion *completion;
+    struct threadpool_object *io;
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    LARGE_INTEGER timeout;
+    BOOL release;
+    NTSTATUS status;
+
+    TRACE( "starting I/O completion thread\n" );
+
+    RtlEnterCriticalSection( &ioqueue.cs );
+
+    for (;;)
+    {
+        RtlLeaveCriticalSection( &ioqueue.cs );
+        status = NtRemoveIoCompletion( ioqueue.port, &key, &value, &iosb, NULL );
+        RtlEnterCriticalSection( &ioqueue.cs );
+
+        if (status)
+        {
+            ERR( "NtRemoveIoCompletion failed: 0x%x\n", status );
+            break;
+        }
+
+        /* a NULL key is only used to wake up the thread */
+        if ((io = (struct threadpool_object *)key))
+        {
+            assert( io->type == TP_OBJECT_TYPE_IO );
+            release = FALSE;
+
+            RtlEnterCriticalSection( &io->pool->cs );
+            if (io->u.io.skipped_count)
+            {
+                TRACE( "skipping canceled completion for io %p\n", io );
+                io->u.io.skipped_count--;
+                release = TRUE;
+            }
+            else if (!io->u.io.pending_count)
+            {
+                WARN( "unexpected completion for io %p\n", io );
+            }
+            else
+            {
+                io->u.io.pending_count--;
+                release = TRUE;
+
+                if (io->shutdown)
+                    TRACE( "dropping completion for closed io %p\n", io );
+                else if (!(completion = tp_io_alloc_completion( io )))
+                    ERR( "failed to allocate completion for io %p\n", io );
+                else
+                {
+                    completion->iosb   = iosb;
+                    completion->cvalue = value;
+                    tp_object_submit( io, FALSE );
+                }
+
+                if (!io->u.io.pending_count && !io->num_pending_callbacks && !io->num_associated_callbacks)
+                    RtlWakeAllConditionVariable( &io->finished_event );
+            }
+            RtlLeaveCriticalSection( &io->pool->cs );
+
+            /* every started operation holds a reference to the I/O object */
+            if (release) tp_object_release( io );
+        }
+
+        if (!ioqueue.objcount)
+        {
+            /* All I/O objects have been destroyed, if no new objects are created
+             * within some amount of time, then we can shutdown this thread. */
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+            if (RtlSleepConditionVariableCS( &ioqueue.update_event, &ioqueue.cs,
+                                             &timeout ) == STATUS_TIMEOUT && !ioqueue.objcount)
+                break;
+        }
+    }
+
+    ioqueue.thread_running = FALSE;
+    RtlLeaveCriticalSection( &ioqueue.cs );
+
+    TRACE( "terminating I/O completion thread\n" );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           tp_ioqueue_lock    (internal)
+ *
+ * Associates a file with the global I/O completion port. When this
+ * succeeds, it is guaranteed that the dispatcher thread is running.
+ */
+static NTSTATUS tp_ioqueue_lock( struct threadpool_object *io, HANDLE file )
+{
+    FILE_COMPLETION_INFORMATION info;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status = STATUS_SUCCESS;
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    io->u.io.pending_count    = 0;
+    io->u.io.skipped_count    = 0;
+    io->u.io.completion_count = 0;
+    io->u.io.completion_max   = 0;
+    io->u.io.completions      = NULL;
+
+    RtlEnterCriticalSection( &ioqueue.cs );
+
+    if (!ioqueue.port)
+        status = NtCreateIoCompletion( &ioqueue.port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+
+    /* Make sure that the I/O completion thread is running. */
+    if (!status && !ioqueue.thread_running)
+    {
+        HANDLE thread;
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      ioqueue_thread_proc, NULL, &thread, NULL );
+        if (status == STATUS_SUCCESS)
+        {
+            ioqueue.thread_running = TRUE;
+            NtClose( thread );
+        }
+    }
+
+    if (!status)
+    {
+        info.CompletionPort = ioqueue.port;
+        info.CompletionKey  = (ULONG_PTR)io;
+        status = NtSetInformationFile( file, &iosb, &info, sizeof(info), FileCompletionInformation );
+    }
+
+    if (!status && !ioqueue.objcount++)
+        RtlWakeConditionVariable( &ioqueue.update_event );
+
+    RtlLeaveCriticalSection( &ioqueue.cs );
+    return status;
+}
+
+/***********************************************************************
+ *           tp_ioqueue_unlock    (internal)
+ */
+static void tp_ioqueue_unlock( struct threadpool_object *io )
+{
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    RtlEnterCriticalSection( &ioqueue.cs );
+    assert( ioqueue.objcount > 0 );
+    if (!--ioqueue.objcount)  /* wake up the thread so that it can start its shutdown timeout */
+        NtSetIoCompletion( ioqueue.port, 0, 0, STATUS_SUCCESS, 0 );
+    RtlLeaveCriticalSection( &ioqueue.cs );
+}
+
 /***********************************************************************
  *           tp_threadpool_alloc    (internal)
  *
@@ -1966,6 +2201,15 @@ static void tp_object_cancel( struct threadpool_object *object )
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
+        if (object->type == TP_OBJECT_TYPE_IO)
+            object->u.io.completion_count = 0;
+    }
+    if (object->type == TP_OBJECT_TYPE_IO && object->u.io.pending_count)
+    {
+        /* completions of the canceled operations will be dropped when they arrive */
+        object->u.io.skipped_count += object->u.io.pending_count;
+        object->u.io.pending_count = 0;
+        RtlWakeAllConditionVariable( &object->finished_event );
     }
     RtlLeaveCriticalSection( &pool->cs );
 
@@ -1991,7 +2235,8 @@ static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
     }
     else
     {
-        while (object->num_pending_callbacks || object->num_associated_callbacks)
+        while (object->num_pending_callbacks || object->num_associated_callbacks ||
+               (object->type == TP_OBJECT_TYPE_IO && object->u.io.pending_count))
             RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
     }
     RtlLeaveCriticalSection( &pool->cs );
@@ -2008,6 +2253,8 @@ static void tp_object_prepare_shutdown( struct threadpool_object *object )
         tp_timerqueue_unlock( object );
     else if (object->type == TP_OBJECT_TYPE_WAIT)
         tp_waitqueue_unlock( object );
+    else if (object->type == TP_OBJECT_TYPE_IO)
+        tp_ioqueue_unlock( object );
 }
 
 /***********************************************************************
@@ -2048,6 +2295,9 @@ static BOOL tp_object_release( struct threadpool_object *object )
     if (object->race_dll)
         LdrUnloadDll( object->race_dll );
 
+    if (object->type == TP_OBJECT_TYPE_IO)
+        RtlFreeHeap( GetProcessHeap(), 0, object->u.io.completions );
+
     RtlFreeHeap( GetProcessHeap(), 0, object );
     return TRUE;
 }
@@ -2061,6 +2311,7 @@ static void CALLBACK threadpool_worker_proc( void *param )
     struct threadpool_instance instance;
     struct threadpool *pool = param;
     TP_WAIT_RESULT wait_result = 0;
+    struct io_completion completion;
     LARGE_INTEGER timeout;
     struct list *ptr;
     NTSTATUS status;
@@ -2089,6 +2340,15 @@ static void CALLBACK threadpool_worker_proc( void *param )
                 if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
             }
 
+            /* For I/O objects fetch the oldest queued completion. */
+            if (object->type == TP_OBJECT_TYPE_IO)
+            {
+                assert( object->u.io.completion_count );
+                completion = object->u.io.completions[0];
+                memmove( object->u.io.completions, object->u.io.completions + 1,
+                         --object->u.io.completion_count * sizeof(completion) );
+            }
+
             /* Leave critical section and do the actual callback. */
             object->num_associated_callbacks++;
             object->num_running_callbacks++;
@@ -2146,6 +2406,17 @@ static void CALLBACK threadpool_worker_proc( void *param )
                     break;
                 }
 
+                case TP_OBJECT_TYPE_IO:
+                {
+                    TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
+                           object->u.io.callback, callback_instance, object->userdata,
+                           completion.cvalue, &completion.iosb, object );
+                    object->u.io.callback( callback_instance, object->userdata,
+                                           (void *)completion.cvalue, &completion.iosb, (TP_IO *)object );
+                    TRACE( "callback %p returned\n", object->u.io.callback );
+                    break;
+                }
+
                 default:
                     assert(0);
                     break;
@@ -2245,6 +2516,46 @@ NTSTATUS WINAPI TpAllocCleanupGroup( TP_CLEANUP_GROUP **out )
     return tp_group_alloc( (struct threadpool_group **)out );
 }
 
+/***********************************************************************
+ *           TpAllocIoCompletion    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocIoCompletion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                     void *userdata, TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p %p\n", out, file, callback, userdata, environment );
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_IO;
+    object->u.io.callback = callback;
+
+    status = tp_ioqueue_lock( object, file );
+    if (status)
+    {
+        tp_threadpool_unlock( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_IO *)object;
+    return STATUS_SUCCESS;
+}
+
 /***********************************************************************
  *           TpAllocPool    (NTDLL.@)
  */
@@ -2369,6 +2680,40 @@ NTSTATUS WINAPI TpAllocWork( TP_WORK **out, PTP_WORK_CALLBACK callback, PVOID us
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           TpCancelAsyncIoOperation    (NTDLL.@)
+ *
+ * Undoes a TpStartAsyncIoOperation call for an operation that failed
+ * without queuing a completion packet.
+ */
+VOID WINAPI TpCancelAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+    BOOL release = FALSE;
+
+    TRACE( "%p\n", io );
+
+    RtlEnterCriticalSection( &this->pool->cs );
+    if (this->u.io.pending_count)
+    {
+        this->u.io.pending_count--;
+        release = TRUE;
+    }
+    else if (this->u.io.skipped_count)
+    {
+        this->u.io.skipped_count--;
+        release = TRUE;
+    }
+    else
+        WARN( "no pending operation for io %p\n", io );
+
+    if (!this->u.io.pending_count && !this->num_pending_callbacks && !this->num_associated_callbacks)
+        RtlWakeAllConditionVariable( &this->finished_event );
+    RtlLeaveCriticalSection( &this->pool->cs );
+
+    if (release) tp_object_release( this );
+}
+
 /***********************************************************************
  *           TpCallbackLeaveCriticalSectionOnCompletion    (NTDLL.@)
  */
@@ -2620,6 +2965,20 @@ VOID WINAPI TpReleaseCleanupGroupMembers( TP_CLEANUP_GROUP *group, BOOL cancel_p
     }
 }
 
+/***********************************************************************
+ *           TpReleaseIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseIoCompletion( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    tp_object_prepare_shutdown( this );
+    this->shutdown = TRUE;
+    tp_object_release( this );
+}
+
 /***********************************************************************
  *           TpReleasePool    (NTDLL.@)
  */
@@ -2888,6 +3247,40 @@ NTSTATUS WINAPI TpSimpleTryPost( PTP_SIMPLE_CALLBACK callback, PVOID userdata,
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           TpStartAsyncIoOperation    (NTDLL.@)
+ *
+ * Announces an asynchronous operation on the file bound to the I/O
+ * object; has to be called before each operation is started.
+ */
+VOID WINAPI TpStartAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    /* keep the object alive until the completion has been dispatched */
+    interlocked_inc( &this->refcount );
+
+    RtlEnterCriticalSection( &this->pool->cs );
+    this->u.io.pending_count++;
+    RtlLeaveCriticalSection( &this->pool->cs );
+}
+
+/***********************************************************************
+ *           TpWaitForIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForIoCompletion( TP_IO *io, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p %d\n", io, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this );
+    tp_object_wait( this, FALSE );
+}
+
 /***********************************************************************
  *           TpWaitForTimer    (NTDLL.@)
  */
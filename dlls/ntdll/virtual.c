@@ -44,6 +44,12 @@
 #ifdef HAVE_SYS_SYSINFO_H
 # include <sys/sysinfo.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
 #endif
@@ -68,12 +74,21 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 #endif
 
 /* File view */
+/* range of address space between views */
+struct view_gap
+{
+    struct wine_rb_entry entry;  /* entry in gaps tree */
+    char         *base;          /* start of the gap */
+    char         *end;           /* end of the gap, NULL if not in use */
+};
+
 struct file_view
 {
     struct wine_rb_entry entry;  /* entry in global view tree */
     void         *base;          /* base address */
     size_t        size;          /* size in bytes */
     unsigned int  protect;       /* protection for all pages at allocation time and SEC_* flags */
+    struct view_gap gap;         /* gap following the view, so that gaps never need to be allocated */
 };
 
 /* per-page protection flags */
@@ -86,6 +101,8 @@ struct file_view
 #define VPROT_WRITEWATCH 0x40
 /* per-mapping protection flags */
 #define VPROT_SYSTEM     0x0200  /* system view (underlying mmap not under our control) */
+#define VPROT_NEWWATCH   0x0400  /* write watch view created since the last soft-dirty reset */
+#define VPROT_LARGEPAGES 0x0800  /* view backed by large pages, only usable as a whole */
 
 /* Conversion from VPROT_* to Win32 flags */
 static const BYTE VIRTUAL_Win32Flags[16] =
@@ -154,14 +171,20 @@ static const BOOL is_win64 = (sizeof(void *) > sizeof(int));
 #define VIRTUAL_DEBUG_DUMP_VIEW(view) \
     do { if (TRACE_ON(virtual)) VIRTUAL_DumpView(view); } while (0)
 
-#ifdef _WIN64  /* on 64-bit the page protection bytes use a 2-level table */
-static const size_t pages_vprot_shift = 20;
-static const size_t pages_vprot_mask = (1 << 20) - 1;
-static size_t pages_vprot_size;
-static BYTE **pages_vprot;
-#else  /* on 32-bit we use a simple array with one byte per page */
-static BYTE *pages_vprot;
-#endif
+/* range of pages with identical protections; pages outside of all ranges have no protection */
+struct vprot_range
+{
+    struct wine_rb_entry entry;  /* entry in vprot tree */
+    char         *base;          /* first page of the range */
+    char         *end;           /* end of the range */
+    BYTE          vprot;         /* protection of all the pages */
+};
+
+static struct wine_rb_tree vprot_tree;
+static struct vprot_range *vprot_block_start, *vprot_block_end, *next_free_vprot;
+static const size_t vprot_block_size = 0x10000;
+static struct wine_rb_tree view_gaps_tree;
+static struct view_gap first_gap;  /* gap before the first view */
 
 static struct file_view *view_block_start, *view_block_end, *next_free_view;
 static const size_t view_block_size = 0x100000;
@@ -169,12 +192,177 @@ static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL use_locks;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
+static SIZE_T large_page_size;  /* size of the pages used for MEM_LARGE_PAGES, 0 if not supported */
+static BOOL use_hugetlb;        /* whether large pages come from the hugetlb pool */
+static int pagemap_fd = -1;     /* /proc/self/pagemap when write watches use soft-dirty bits */
+static int clear_refs_fd = -1;  /* /proc/self/clear_refs to reset the soft-dirty bits */
+static BOOL block_watched_writes; /* write-protect watched pages while the soft-dirty bits are reset */
 
 static inline int is_view_valloc( const struct file_view *view )
 {
     return !(view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT));
 }
 
+/* the vprot array is tracked with small pages, but large page mappings can't be split */
+static inline BOOL is_partial_large_page_range( const struct file_view *view, const void *base, size_t size )
+{
+    return (view->protect & VPROT_LARGEPAGES) && (base != view->base || size != view->size);
+}
+
+/***********************************************************************
+ *           find_vprot_range
+ *
+ * Find the first protection range that ends after a given address.
+ */
+static struct vprot_range *find_vprot_range( const void *addr )
+{
+    struct wine_rb_entry *ptr = vprot_tree.root;
+    struct vprot_range *ret = NULL;
+
+    while (ptr)
+    {
+        struct vprot_range *range = WINE_RB_ENTRY_VALUE( ptr, struct vprot_range, entry );
+
+        if (range->end > (const char *)addr)
+        {
+            ret = range;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
+    }
+    return ret;
+}
+
+
+static inline struct vprot_range *next_vprot_range( struct vprot_range *range )
+{
+    struct wine_rb_entry *ptr = wine_rb_next( &range->entry );
+    return ptr ? WINE_RB_ENTRY_VALUE( ptr, struct vprot_range, entry ) : NULL;
+}
+
+
+/***********************************************************************
+ *           alloc_vprot_range
+ */
+static struct vprot_range *alloc_vprot_range( char *base, char *end, BYTE vprot )
+{
+    struct vprot_range *range;
+
+    if (next_free_vprot)
+    {
+        range = next_free_vprot;
+        next_free_vprot = *(struct vprot_range **)range;
+    }
+    else
+    {
+        if (vprot_block_start == vprot_block_end)
+        {
+            void *ptr = wine_anon_mmap( NULL, vprot_block_size, PROT_READ | PROT_WRITE, 0 );
+            if (ptr == (void *)-1)
+            {
+                ERR( "out of memory for protections of %p-%p\n", base, end );
+                return NULL;
+            }
+            vprot_block_start = ptr;
+            vprot_block_end = vprot_block_start + vprot_block_size / sizeof(*vprot_block_start);
+        }
+        range = vprot_block_start++;
+    }
+    range->base  = base;
+    range->end   = end;
+    range->vprot = vprot;
+    wine_rb_put( &vprot_tree, base, &range->entry );
+    return range;
+}
+
+
+/***********************************************************************
+ *           reserve_vprot_ranges
+ *
+ * Make sure that the given number of ranges can be allocated without failing.
+ */
+static BOOL reserve_vprot_ranges( SIZE_T count )
+{
+    struct vprot_range *range = next_free_vprot;
+    SIZE_T avail = vprot_block_end - vprot_block_start;
+    void *ptr;
+
+    while (range && avail < count)
+    {
+        range = *(struct vprot_range **)range;
+        avail++;
+    }
+    while (avail < count)
+    {
+        ptr = wine_anon_mmap( NULL, vprot_block_size, PROT_READ | PROT_WRITE, 0 );
+        if (ptr == (void *)-1) return FALSE;
+        /* keep the rest of the current block on the free list */
+        while (vprot_block_start < vprot_block_end)
+        {
+            range = vprot_block_start++;
+            *(struct vprot_range **)range = next_free_vprot;
+            next_free_vprot = range;
+        }
+        vprot_block_start = ptr;
+        vprot_block_end = vprot_block_start + vprot_block_size / sizeof(*vprot_block_start);
+        avail += vprot_block_size / sizeof(*vprot_block_start);
+    }
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           free_vprot_range
+ */
+static void free_vprot_range( struct vprot_range *range )
+{
+    wine_rb_remove( &vprot_tree, &range->entry );
+    *(struct vprot_range **)range = next_free_vprot;
+    next_free_vprot = range;
+}
+
+
+/***********************************************************************
+ *           split_vprot_range
+ *
+ * Make sure that no protection range crosses the given address.
+ */
+static BOOL split_vprot_range( char *addr )
+{
+    struct vprot_range *range = find_vprot_range( addr );
+
+    if (!range || range->base >= addr) return TRUE;
+    if (!alloc_vprot_range( addr, range->end, range->vprot )) return FALSE;
+    range->end = addr;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           merge_vprot_ranges
+ *
+ * Merge the adjacent ranges with identical protections around a modified area.
+ */
+static void merge_vprot_ranges( char *base, char *end )
+{
+    struct vprot_range *range, *next;
+    struct wine_rb_entry *ptr;
+
+    if (!(range = find_vprot_range( base ))) return;
+    if ((ptr = wine_rb_prev( &range->entry ))) range = WINE_RB_ENTRY_VALUE( ptr, struct vprot_range, entry );
+
+    while ((next = next_vprot_range( range )) && next->base <= end)
+    {
+        if (next->base == range->end && next->vprot == range->vprot)
+        {
+            range->end = next->end;
+            free_vprot_range( next );
+        }
+        else range = next;
+    }
+}
+
+
 /***********************************************************************
  *           get_page_vprot
  *
@@ -182,15 +370,42 @@ static inline int is_view_valloc( const struct file_view *view )
  */
 static BYTE get_page_vprot( const void *addr )
 {
-    size_t idx = (size_t)addr >> page_shift;
+    struct vprot_range *range = find_vprot_range( addr );
 
-#ifdef _WIN64
-    if ((idx >> pages_vprot_shift) >= pages_vprot_size) return 0;
-    if (!pages_vprot[idx >> pages_vprot_shift]) return 0;
-    return pages_vprot[idx >> pages_vprot_shift][idx & pages_vprot_mask];
-#else
-    return pages_vprot[idx];
-#endif
+    return (range && range->base <= (const char *)addr) ? range->vprot : 0;
+}
+
+
+/***********************************************************************
+ *           get_vprot_range_size
+ *
+ * Return the size of the range starting at base whose pages have the same
+ * protection bits in mask as the first one, and the protection of the first page.
+ */
+static SIZE_T get_vprot_range_size( char *base, SIZE_T size, BYTE mask, BYTE *vprot )
+{
+    struct vprot_range *range = find_vprot_range( base );
+    char *addr = base, *end = base + size, *next;
+    BYTE prot;
+
+    *vprot = (range && range->base <= base) ? range->vprot : 0;
+    while (addr < end)
+    {
+        if (range && range->base <= addr)
+        {
+            prot = range->vprot;
+            next = range->end;
+            range = next_vprot_range( range );
+        }
+        else
+        {
+            prot = 0;
+            next = range ? range->base : end;
+        }
+        if ((prot ^ *vprot) & mask) break;
+        addr = next;
+    }
+    return min( addr, end ) - base;
 }
 
 
@@ -198,23 +413,32 @@ static BYTE get_page_vprot( const void *addr )
  *           set_page_vprot
  *
  * Set a range of page protection bytes.
+ * Returns FALSE, without changing anything, if out of memory.
  */
-static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
+static BOOL set_page_vprot( const void *addr, size_t size, BYTE vprot )
 {
-    size_t idx = (size_t)addr >> page_shift;
-    size_t end = ((size_t)addr + size + page_mask) >> page_shift;
+    char *base = ROUND_ADDR( addr, page_mask );
+    char *end = base + ROUND_SIZE( addr, size );
+    struct vprot_range *range, *next;
 
-#ifdef _WIN64
-    while (idx >> pages_vprot_shift != end >> pages_vprot_shift)
+    if (base >= end) return TRUE;
+    /* two splits and the new range */
+    if (!reserve_vprot_ranges( 3 ))
     {
-        size_t dir_size = pages_vprot_mask + 1 - (idx & pages_vprot_mask);
-        memset( pages_vprot[idx >> pages_vprot_shift] + (idx & pages_vprot_mask), vprot, dir_size );
-        idx += dir_size;
+        ERR( "out of memory for protections of %p-%p\n", base, end );
+        return FALSE;
     }
-    memset( pages_vprot[idx >> pages_vprot_shift] + (idx & pages_vprot_mask), vprot, end - idx );
-#else
-    memset( pages_vprot + idx, vprot, end - idx );
-#endif
+    split_vprot_range( base );
+    split_vprot_range( end );
+
+    for (range = find_vprot_range( base ); range && range->base < end; range = next)
+    {
+        next = next_vprot_range( range );
+        free_vprot_range( range );
+    }
+    if (vprot) alloc_vprot_range( base, end, vprot );
+    merge_vprot_ranges( base, end );
+    return TRUE;
 }
 
 
@@ -222,47 +446,159 @@ static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
  *           set_page_vprot_bits
  *
  * Set or clear bits in a range of page protection bytes.
+ * Returns FALSE, without changing anything, if out of memory.
  */
-static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE clear )
+static BOOL set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE clear )
 {
-    size_t idx = (size_t)addr >> page_shift;
-    size_t end = ((size_t)addr + size + page_mask) >> page_shift;
+    char *base = ROUND_ADDR( addr, page_mask );
+    char *end = base + ROUND_SIZE( addr, size );
+    char *ptr = base, *next_ptr;
+    struct vprot_range *range, *next;
+    SIZE_T count = 2;  /* two splits, and a new range for each hole if setting bits */
+
+    if (base >= end) return TRUE;
+    if (set)
+    {
+        for (range = find_vprot_range( base ); range && range->base < end; range = next_vprot_range( range ))
+        {
+            if (range->base > ptr) count++;
+            ptr = range->end;
+        }
+        if (ptr < end) count++;
+        ptr = base;
+    }
+    if (!reserve_vprot_ranges( count ))
+    {
+        ERR( "out of memory for protections of %p-%p\n", base, end );
+        return FALSE;
+    }
+    split_vprot_range( base );
+    split_vprot_range( end );
 
-#ifdef _WIN64
-    for ( ; idx < end; idx++)
+    range = find_vprot_range( base );
+    while (ptr < end)
     {
-        BYTE *ptr = pages_vprot[idx >> pages_vprot_shift] + (idx & pages_vprot_mask);
-        *ptr = (*ptr & ~clear) | set;
+        if (range && range->base <= ptr)
+        {
+            next = next_vprot_range( range );
+            range->vprot = (range->vprot & ~clear) | set;
+            ptr = range->end;
+            if (!range->vprot) free_vprot_range( range );
+            range = next;
+        }
+        else
+        {
+            /* pages without protection in the middle of the range */
+            next_ptr = range ? min( range->base, end ) : end;
+            if (set) alloc_vprot_range( ptr, next_ptr, set );
+            ptr = next_ptr;
+        }
     }
-#else
-    for ( ; idx < end; idx++) pages_vprot[idx] = (pages_vprot[idx] & ~clear) | set;
-#endif
+    merge_vprot_ranges( base, end );
+    return TRUE;
 }
 
 
 /***********************************************************************
- *           alloc_pages_vprot
+ *           find_view_gap
  *
- * Allocate the page protection bytes for a given range.
+ * Find the first gap between views that ends after a given address.
  */
-static BOOL alloc_pages_vprot( const void *addr, size_t size )
+static struct view_gap *find_view_gap( const void *addr )
 {
-#ifdef _WIN64
-    size_t idx = (size_t)addr >> page_shift;
-    size_t end = ((size_t)addr + size + page_mask) >> page_shift;
-    size_t i;
-    void *ptr;
+    struct wine_rb_entry *ptr = view_gaps_tree.root;
+    struct view_gap *ret = NULL;
 
-    assert( end <= pages_vprot_size << pages_vprot_shift );
-    for (i = idx >> pages_vprot_shift; i < (end + pages_vprot_mask) >> pages_vprot_shift; i++)
+    while (ptr)
     {
-        if (pages_vprot[i]) continue;
-        if ((ptr = wine_anon_mmap( NULL, pages_vprot_mask + 1, PROT_READ | PROT_WRITE, 0 )) == (void *)-1)
-            return FALSE;
-        pages_vprot[i] = ptr;
+        struct view_gap *gap = WINE_RB_ENTRY_VALUE( ptr, struct view_gap, entry );
+
+        if (gap->end > (const char *)addr)
+        {
+            ret = gap;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
     }
-#endif
-    return TRUE;
+    return ret;
+}
+
+
+static inline struct view_gap *next_view_gap( struct view_gap *gap )
+{
+    struct wine_rb_entry *ptr = wine_rb_next( &gap->entry );
+    return ptr ? WINE_RB_ENTRY_VALUE( ptr, struct view_gap, entry ) : NULL;
+}
+
+
+static inline struct view_gap *prev_view_gap( struct view_gap *gap )
+{
+    struct wine_rb_entry *ptr = wine_rb_prev( &gap->entry );
+    return ptr ? WINE_RB_ENTRY_VALUE( ptr, struct view_gap, entry ) : NULL;
+}
+
+
+/***********************************************************************
+ *           set_view_gap
+ *
+ * Set the range of a gap, adding it to the tree or moving it if needed.
+ */
+static void set_view_gap( struct view_gap *gap, char *base, char *end )
+{
+    if (gap->end && gap->base == base && base != end)
+    {
+        gap->end = end;
+        return;
+    }
+    if (gap->end) wine_rb_remove( &view_gaps_tree, &gap->entry );
+    gap->base = base;
+    gap->end = NULL;
+    if (base == end) return;
+    gap->end = end;
+    wine_rb_put( &view_gaps_tree, base, &gap->entry );
+}
+
+
+/***********************************************************************
+ *           view_gaps_insert_view
+ *
+ * Remove the space used by a new view from the gaps.
+ */
+static void view_gaps_insert_view( struct file_view *view )
+{
+    char *base = view->base, *end = base + view->size;
+    struct view_gap *gap = find_view_gap( base );
+    char *gap_end;
+
+    view->gap.end = NULL;
+    if (!gap || gap->base > base || gap->end < end)
+    {
+        ERR( "view %p-%p is not inside a gap\n", base, end );
+        return;
+    }
+    /* the part of the gap after the view now follows the new view */
+    gap_end = gap->end;
+    set_view_gap( gap, gap->base, base );
+    set_view_gap( &view->gap, end, gap_end );
+}
+
+
+/***********************************************************************
+ *           view_gaps_remove_view
+ *
+ * Give back the space used by a deleted view to the gaps.
+ * The view must still be in the views tree.
+ */
+static void view_gaps_remove_view( struct file_view *view )
+{
+    char *base = view->base, *end = view->gap.end ? view->gap.end : base + view->size;
+    struct wine_rb_entry *ptr = wine_rb_prev( &view->entry );
+    struct view_gap *prev;
+
+    /* the gap before the view belongs to the previous view, or to the first gap */
+    prev = ptr ? &WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry )->gap : &first_gap;
+    set_view_gap( &view->gap, NULL, NULL );
+    set_view_gap( prev, prev->end ? prev->base : base, end );
 }
 
 
@@ -281,6 +617,36 @@ static int compare_view( const void *addr, const struct wine_rb_entry *entry )
 }
 
 
+/***********************************************************************
+ *           compare_vprot_range
+ *
+ * Protection range comparison function used for the rb tree.
+ */
+static int compare_vprot_range( const void *addr, const struct wine_rb_entry *entry )
+{
+    struct vprot_range *range = WINE_RB_ENTRY_VALUE( entry, struct vprot_range, entry );
+
+    if ((const char *)addr < range->base) return -1;
+    if ((const char *)addr > range->base) return 1;
+    return 0;
+}
+
+
+/***********************************************************************
+ *           compare_view_gap
+ *
+ * Gap comparison function used for the rb tree.
+ */
+static int compare_view_gap( const void *addr, const struct wine_rb_entry *entry )
+{
+    struct view_gap *gap = WINE_RB_ENTRY_VALUE( entry, struct view_gap, entry );
+
+    if ((const char *)addr < gap->base) return -1;
+    if ((const char *)addr > gap->base) return 1;
+    return 0;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_GetProtStr
  */
@@ -311,7 +677,7 @@ static int VIRTUAL_GetUnixProt( BYTE vprot )
         if (vprot & VPROT_WRITE) prot |= PROT_WRITE | PROT_READ;
         if (vprot & VPROT_WRITECOPY) prot |= PROT_WRITE | PROT_READ;
         if (vprot & VPROT_EXEC) prot |= PROT_EXEC | PROT_READ;
-        if (vprot & VPROT_WRITEWATCH) prot &= ~PROT_WRITE;
+        if ((vprot & VPROT_WRITEWATCH) && (pagemap_fd == -1 || block_watched_writes)) prot &= ~PROT_WRITE;
     }
     if (!prot) prot = PROT_NONE;
     return prot;
@@ -323,9 +689,9 @@ static int VIRTUAL_GetUnixProt( BYTE vprot )
  */
 static void VIRTUAL_DumpView( struct file_view *view )
 {
-    UINT i, count;
-    char *addr = view->base;
-    BYTE prot = get_page_vprot( addr );
+    char *addr = view->base, *end = addr + view->size;
+    SIZE_T size;
+    BYTE prot;
 
     TRACE( "View: %p - %p", addr, addr + view->size - 1 );
     if (view->protect & VPROT_SYSTEM)
@@ -339,19 +705,11 @@ static void VIRTUAL_DumpView( struct file_view *view )
     else
         TRACE( " (valloc)\n");
 
-    for (count = i = 1; i < view->size >> page_shift; i++, count++)
+    for ( ; addr < end; addr += size)
     {
-        BYTE next = get_page_vprot( addr + (count << page_shift) );
-        if (next == prot) continue;
-        TRACE( "      %p - %p %s\n",
-                 addr, addr + (count << page_shift) - 1, VIRTUAL_GetProtStr(prot) );
-        addr += (count << page_shift);
-        prot = next;
-        count = 0;
+        size = get_vprot_range_size( addr, end - addr, 0xff, &prot );
+        TRACE( "      %p - %p %s\n", addr, addr + size - 1, VIRTUAL_GetProtStr(prot) );
     }
-    if (count)
-        TRACE( "      %p - %p %s\n",
-                 addr, addr + (count << page_shift) - 1, VIRTUAL_GetProtStr(prot) );
 }
 
 
@@ -458,63 +816,41 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
-    struct wine_rb_entry *first = NULL, *ptr = views_tree.root;
-    void *start;
+    struct view_gap *range;
+    char *start, *range_base, *range_end;
 
-    /* find the first (resp. last) view inside the range */
-    while (ptr)
+    if (top_down)
     {
-        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
-        if ((char *)view->base + view->size >= (char *)end)
-        {
-            end = min( end, view->base );
-            ptr = ptr->left;
-        }
-        else if (view->base <= base)
+        /* walk down from the last gap that starts below the end */
+        if ((range = find_view_gap( (char *)end - 1 )))
         {
-            base = max( (char *)base, (char *)view->base + view->size );
-            ptr = ptr->right;
-        }
-        else
-        {
-            first = ptr;
-            ptr = top_down ? ptr->right : ptr->left;
+            if (range->base >= (char *)end) range = prev_view_gap( range );
         }
-    }
-
-    if (top_down)
-    {
-        start = ROUND_ADDR( (char *)end - size, mask );
-        if (start >= end || start < base) return NULL;
-
-        while (first)
+        else if (view_gaps_tree.root)
+            range = WINE_RB_ENTRY_VALUE( wine_rb_tail( view_gaps_tree.root ), struct view_gap, entry );
+        for ( ; range; range = prev_view_gap( range ))
         {
-            struct file_view *view = WINE_RB_ENTRY_VALUE( first, struct file_view, entry );
-
-            if ((char *)view->base + view->size <= (char *)start) break;
-            start = ROUND_ADDR( (char *)view->base - size, mask );
-            /* stop if remaining space is not large enough */
-            if (!start || start >= end || start < base) return NULL;
-            first = wine_rb_prev( first );
+            if (range->end <= (char *)base) break;
+            range_base = max( range->base, (char *)base );
+            range_end = min( range->end, (char *)end );
+            if (range_end - range_base < size) continue;
+            start = ROUND_ADDR( range_end - size, mask );
+            if (start && start >= range_base) return start;
         }
     }
     else
     {
-        start = ROUND_ADDR( (char *)base + mask, mask );
-        if (!start || start >= end || (char *)end - (char *)start < size) return NULL;
-
-        while (first)
+        for (range = find_view_gap( base ); range; range = next_view_gap( range ))
         {
-            struct file_view *view = WINE_RB_ENTRY_VALUE( first, struct file_view, entry );
-
-            if ((char *)view->base >= (char *)start + size) break;
-            start = ROUND_ADDR( (char *)view->base + view->size + mask, mask );
-            /* stop if remaining space is not large enough */
-            if (!start || start >= end || (char *)end - (char *)start < size) return NULL;
-            first = wine_rb_next( first );
+            if (range->base >= (char *)end) break;
+            range_base = max( range->base, (char *)base );
+            range_end = min( range->end, (char *)end );
+            start = ROUND_ADDR( range_base + mask, mask );
+            if (!start || start < range_base || start >= range_end) continue;
+            if (range_end - start >= size) return start;
         }
     }
-    return start;
+    return NULL;
 }
 
 
@@ -686,6 +1022,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
     set_page_vprot( view->base, view->size, 0 );
+    view_gaps_remove_view( view );
     wine_rb_remove( &views_tree, &view->entry );
     *(struct file_view **)view = next_free_view;
     next_free_view = view;
@@ -717,8 +1054,6 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
         delete_view( view );
     }
 
-    if (!alloc_pages_vprot( base, size )) return STATUS_NO_MEMORY;
-
     /* Create the view structure */
 
     if (!(view = alloc_view()))
@@ -730,7 +1065,13 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->base    = base;
     view->size    = size;
     view->protect = vprot;
-    set_page_vprot( base, size, vprot );
+    if (!set_page_vprot( base, size, vprot ))
+    {
+        *(struct file_view **)view = next_free_view;
+        next_free_view = view;
+        return STATUS_NO_MEMORY;
+    }
+    view_gaps_insert_view( view );
 
     wine_rb_put( &views_tree, view->base, &view->entry );
 
@@ -838,22 +1179,24 @@ static inline int mprotect_exec( void *base, size_t size, int unix_prot )
  */
 static void mprotect_range( void *base, size_t size, BYTE set, BYTE clear )
 {
-    size_t i, count;
-    char *addr = ROUND_ADDR( base, page_mask );
-    int prot, next;
+    char *addr = ROUND_ADDR( base, page_mask ), *start = addr, *end;
+    int prot = -1, next;
+    BYTE vprot;
 
-    size = ROUND_SIZE( base, size );
-    prot = VIRTUAL_GetUnixProt( (get_page_vprot( addr ) & ~clear ) | set );
-    for (count = i = 1; i < size >> page_shift; i++, count++)
+    end = addr + ROUND_SIZE( base, size );
+    while (addr < end)
     {
-        next = VIRTUAL_GetUnixProt( (get_page_vprot( addr + (count << page_shift) ) & ~clear) | set );
-        if (next == prot) continue;
-        mprotect_exec( addr, count << page_shift, prot );
-        addr += count << page_shift;
-        prot = next;
-        count = 0;
+        size = get_vprot_range_size( addr, end - addr, 0xff, &vprot );
+        next = VIRTUAL_GetUnixProt( (vprot & ~clear) | set );
+        if (next != prot)
+        {
+            if (addr > start) mprotect_exec( start, addr - start, prot );
+            start = addr;
+            prot = next;
+        }
+        addr += size;
     }
-    if (count) mprotect_exec( addr, count << page_shift, prot );
+    if (addr > start) mprotect_exec( start, addr - start, prot );
 }
 
 
@@ -876,7 +1219,8 @@ static BOOL VIRTUAL_SetProt( struct file_view *view, /* [in] Pointer to view */
     if (view->protect & VPROT_WRITEWATCH)
     {
         /* each page may need different protections depending on write watch flag */
-        set_page_vprot_bits( base, size, vprot & ~VPROT_WRITEWATCH, ~vprot & ~VPROT_WRITEWATCH );
+        if (!set_page_vprot_bits( base, size, vprot & ~VPROT_WRITEWATCH, ~vprot & ~VPROT_WRITEWATCH ))
+            return FALSE;
         mprotect_range( base, size, 0, 0 );
         return TRUE;
     }
@@ -887,7 +1231,7 @@ static BOOL VIRTUAL_SetProt( struct file_view *view, /* [in] Pointer to view */
         (base >= NtCurrentTeb()->DeallocationStack) &&
         (base < NtCurrentTeb()->Tib.StackBase))
     {
-        set_page_vprot( base, size, vprot );
+        if (!set_page_vprot( base, size, vprot )) return FALSE;
         mprotect( base, size, unix_prot );
         return TRUE;
     }
@@ -895,8 +1239,7 @@ static BOOL VIRTUAL_SetProt( struct file_view *view, /* [in] Pointer to view */
     if (mprotect_exec( base, size, unix_prot )) /* FIXME: last error */
         return FALSE;
 
-    set_page_vprot( base, size, vprot );
-    return TRUE;
+    return set_page_vprot( base, size, vprot );
 }
 
 
@@ -926,6 +1269,196 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
 }
 
 
+/***********************************************************************
+ *           get_soft_dirty_pages
+ *
+ * Clear the write watch flag on the pages that the kernel reports as soft-dirty.
+ * The pages of a new view are all soft-dirty until the next reset, so the ones
+ * that are present or swapped out are reported instead; this includes pages
+ * that have only been read, which is harmless.
+ */
+static void get_soft_dirty_pages( struct file_view *view, char *base, size_t size )
+{
+#ifdef __linux__
+    static const ULONGLONG present = (ULONGLONG)3 << 62, soft_dirty = (ULONGLONG)1 << 55;
+    ULONGLONG written = (view->protect & VPROT_NEWWATCH) ? present : soft_dirty;
+    ULONGLONG entries[512];
+    size_t i, count, pages = size >> page_shift;
+    off_t offset = ((UINT_PTR)base >> page_shift) * sizeof(entries[0]);
+
+    while (pages)
+    {
+        count = min( pages, sizeof(entries) / sizeof(entries[0]) );
+        if (pread( pagemap_fd, entries, count * sizeof(entries[0]), offset ) != count * sizeof(entries[0]))
+        {
+            /* report the whole range as written rather than missing a write */
+            set_page_vprot_bits( base, pages << page_shift, 0, VPROT_WRITEWATCH );
+            return;
+        }
+        for (i = 0; i < count; i++)
+            if ((entries[i] & written) && (get_page_vprot( base + (i << page_shift) ) & VPROT_WRITEWATCH))
+                set_page_vprot_bits( base + (i << page_shift), page_size, 0, VPROT_WRITEWATCH );
+        base += count << page_shift;
+        offset += count * sizeof(entries[0]);
+        pages -= count;
+    }
+#endif
+}
+
+
+/***********************************************************************
+ *           clear_soft_dirty_pages
+ *
+ * Reset the soft-dirty bits. This can only be done for the whole process,
+ * so the writes to the other watched ranges have to be collected first.
+ * The watched pages are write-protected meanwhile, so that a write between
+ * the collection and the reset faults and gets recorded by virtual_handle_fault
+ * once we are done, instead of being lost.
+ */
+static void clear_soft_dirty_pages(void)
+{
+    struct file_view *view;
+
+    block_watched_writes = TRUE;
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
+        if (view->protect & VPROT_WRITEWATCH) mprotect_range( view->base, view->size, 0, 0 );
+
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
+        if (view->protect & VPROT_WRITEWATCH) get_soft_dirty_pages( view, view->base, view->size );
+
+    if (write( clear_refs_fd, "4", 1 ) != 1) ERR( "failed to reset soft-dirty bits\n" );
+
+    block_watched_writes = FALSE;
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
+    {
+        if (!(view->protect & VPROT_WRITEWATCH)) continue;
+        view->protect &= ~VPROT_NEWWATCH;
+        mprotect_range( view->base, view->size, 0, 0 );
+    }
+}
+
+
+/***********************************************************************
+ *           init_soft_dirty
+ *
+ * Check if the kernel supports tracking writes with soft-dirty bits.
+ */
+static void init_soft_dirty(void)
+{
+#ifdef __linux__
+    const char *env = getenv( "WINESOFTDIRTY" );
+    ULONGLONG entry;
+    off_t offset;
+    char *page;
+
+    if (!env || !atoi( env )) return;
+    if ((pagemap_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1) goto failed;
+    if ((clear_refs_fd = open( "/proc/self/clear_refs", O_WRONLY | O_CLOEXEC )) == -1) goto failed;
+
+    /* make sure that a write after a reset is noticed */
+    if ((page = wine_anon_mmap( NULL, page_size, PROT_READ | PROT_WRITE, 0 )) == (char *)-1) goto failed;
+    offset = ((UINT_PTR)page >> page_shift) * sizeof(entry);
+    page[0] = 1;
+    if (write( clear_refs_fd, "4", 1 ) != 1 ||
+        pread( pagemap_fd, &entry, sizeof(entry), offset ) != sizeof(entry) || (entry >> 55) & 1)
+    {
+        munmap( page, page_size );
+        goto failed;
+    }
+    page[0] = 2;
+    if (pread( pagemap_fd, &entry, sizeof(entry), offset ) != sizeof(entry)) entry = 0;
+    munmap( page, page_size );
+    if ((entry >> 55) & 1)
+    {
+        TRACE( "using soft-dirty bits for write watches\n" );
+        return;
+    }
+
+failed:
+    WARN( "soft-dirty bits not supported, using page protections for write watches\n" );
+    if (pagemap_fd != -1) close( pagemap_fd );
+    if (clear_refs_fd != -1) close( clear_refs_fd );
+    pagemap_fd = clear_refs_fd = -1;
+#endif
+}
+
+
+/***********************************************************************
+ *           init_large_pages
+ *
+ * Find out which huge pages can be used for large page allocations.
+ */
+static void init_large_pages(void)
+{
+#ifdef __linux__
+    const char *env = getenv( "WINEHUGETLB" );
+    char buffer[256];
+    unsigned long size;
+    FILE *f;
+
+    /* the hugetlb pool has to be set up by the administrator, so only use it when asked to */
+    if (env && atoi( env ) && (f = fopen( "/proc/meminfo", "r" )))
+    {
+        while (fgets( buffer, sizeof(buffer), f ))
+        {
+            if (sscanf( buffer, "Hugepagesize: %lu kB", &size ) != 1) continue;
+            large_page_size = size * 1024;
+            use_hugetlb = TRUE;
+            break;
+        }
+        fclose( f );
+    }
+    if (!large_page_size && (f = fopen( "/sys/kernel/mm/transparent_hugepage/enabled", "r" )))
+    {
+        if (fgets( buffer, sizeof(buffer), f ) && !strstr( buffer, "[never]" ))
+        {
+            FILE *f2 = fopen( "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r" );
+            if (f2)
+            {
+                if (fscanf( f2, "%lu", &size ) == 1) large_page_size = size;
+                fclose( f2 );
+            }
+        }
+        fclose( f );
+    }
+    if (large_page_size & (large_page_size - 1) || large_page_size <= page_size) large_page_size = 0;
+    TRACE( "large page size %lx%s\n", large_page_size, use_hugetlb ? " (hugetlb)" : "" );
+#endif
+}
+
+
+/***********************************************************************
+ *           map_large_pages
+ *
+ * Back a range with huge pages; the range must be aligned on the large page size.
+ */
+static void map_large_pages( void *base, size_t size, unsigned int vprot )
+{
+#ifdef MAP_HUGETLB
+    if (use_hugetlb)
+    {
+        if (mmap( base, size, VIRTUAL_GetUnixProt( vprot ),
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0 ) != MAP_FAILED)
+            return;
+        WARN( "hugetlb mapping failed for %p-%p, falling back to transparent huge pages\n",
+              base, (char *)base + size );
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    madvise( base, size, MADV_HUGEPAGE );
+#endif
+}
+
+
+/***********************************************************************
+ *           virtual_get_large_page_size
+ */
+SIZE_T virtual_get_large_page_size(void)
+{
+    return large_page_size;
+}
+
+
 /***********************************************************************
  *           update_write_watches
  */
@@ -946,6 +1479,7 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
  */
 static void reset_write_watches( void *base, SIZE_T size )
 {
+    if (pagemap_fd != -1) clear_soft_dirty_pages();
     set_page_vprot_bits( base, size, VPROT_WRITEWATCH, 0 );
     mprotect_range( base, size, 0, 0 );
 }
@@ -1198,7 +1732,7 @@ static NTSTATUS map_file_into_view( struct file_view *view, int fd, size_t start
     pread( fd, ptr, size, offset );
     if (prot != (PROT_READ|PROT_WRITE)) mprotect( ptr, size, prot );  /* Set the right protection */
 done:
-    set_page_vprot( (char *)view->base + start, size, vprot );
+    if (!set_page_vprot( (char *)view->base + start, size, vprot )) return STATUS_NO_MEMORY;
     return STATUS_SUCCESS;
 }
 
@@ -1211,7 +1745,7 @@ done:
  */
 static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vprot )
 {
-    SIZE_T i, start;
+    SIZE_T start;
 
     start = ((char *)base - (char *)view->base) >> page_shift;
     *vprot = get_page_vprot( base );
@@ -1236,9 +1770,7 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
         SERVER_END_REQ;
         return ret;
     }
-    for (i = start + 1; i < view->size >> page_shift; i++)
-        if ((*vprot ^ get_page_vprot( (char *)view->base + (i << page_shift) )) & VPROT_COMMITTED) break;
-    return (i - start) << page_shift;
+    return get_vprot_range_size( base, view->size - (start << page_shift), VPROT_COMMITTED, vprot );
 }
 
 
@@ -1252,7 +1784,8 @@ static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t siz
 {
     if (wine_anon_mmap( (char *)view->base + start, size, PROT_NONE, MAP_FIXED ) != (void *)-1)
     {
-        set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
+        if (!set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED ))
+            return STATUS_NO_MEMORY;
         return STATUS_SUCCESS;
     }
     return FILE_GetNtStatus();
@@ -1352,13 +1885,32 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
 }
 
 
+/***********************************************************************
+ *           use_shared_relocs
+ *
+ * Check whether relocated images should be mapped from a copy shared with other processes.
+ */
+static BOOL use_shared_relocs(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINESHAREDRELOCS" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+
 /***********************************************************************
  *           map_image
  *
  * Map an executable (PE format) image into memory.
  */
-static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *base, SIZE_T total_size,
-                           SIZE_T mask, SIZE_T header_size, int shared_fd, BOOL removable, PVOID *addr_ptr )
+static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *base, char *reloc_base,
+                           SIZE_T total_size, SIZE_T mask, SIZE_T header_size, int shared_fd,
+                           BOOL removable, PVOID *addr_ptr )
 {
     IMAGE_DOS_HEADER *dos;
     IMAGE_NT_HEADERS *nt;
@@ -1366,7 +1918,7 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
     IMAGE_SECTION_HEADER *sec;
     IMAGE_DATA_DIRECTORY *imports;
     NTSTATUS status = STATUS_CONFLICTING_ADDRESSES;
-    int i;
+    int i, reloc_fd = -1;
     off_t pos;
     sigset_t sigset;
     struct stat st;
@@ -1381,6 +1933,11 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
         status = map_view( &view, base, total_size, mask, FALSE, SEC_IMAGE | SEC_FILE |
                            VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY );
 
+    /* try the address where another process has already relocated the image */
+    if (status != STATUS_SUCCESS && reloc_base && reloc_base >= (char *)address_space_start)
+        status = map_view( &view, reloc_base, total_size, mask, FALSE, SEC_IMAGE | SEC_FILE |
+                           VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY );
+
     if (status != STATUS_SUCCESS)
         status = map_view( &view, NULL, total_size, mask, FALSE, SEC_IMAGE | SEC_FILE |
                            VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY );
@@ -1390,6 +1947,13 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
     ptr = view->base;
     TRACE_(module)( "mapped PE file at %p-%p\n", ptr, ptr + total_size );
 
+    /* the server keeps a copy of the image relocated to that address, laid out as in memory */
+    if (ptr != base && shared_fd == -1 && use_shared_relocs())
+    {
+        reloc_fd = server_get_image_reloc_fd( hmapping, ptr );
+        if (reloc_fd != -1) TRACE_(module)( "using shared relocated image at %p\n", ptr );
+    }
+
     /* map the header */
 
     if (fstat( fd, &st ) == -1)
@@ -1398,7 +1962,8 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
         goto error;
     }
     header_size = min( header_size, st.st_size );
-    if ((status = map_pe_header( view->base, header_size, fd, &removable )) != STATUS_SUCCESS) goto error;
+    if ((status = map_pe_header( view->base, header_size, reloc_fd != -1 ? reloc_fd : fd,
+                                 &removable )) != STATUS_SUCCESS) goto error;
 
     status = STATUS_INVALID_IMAGE_FORMAT;  /* generic error */
     dos = (IMAGE_DOS_HEADER *)ptr;
@@ -1513,8 +2078,27 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
         end = file_start + file_size;
         if (sec->PointerToRawData >= st.st_size ||
             end > ((st.st_size + sector_align) & ~sector_align) ||
-            end < file_start ||
-            map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
+            end < file_start)
+        {
+            ERR_(module)( "Could not map section %.8s, file probably truncated\n", sec->Name );
+            goto error;
+        }
+
+        if (reloc_fd != -1)
+        {
+            /* the relocated copy is already zero-filled past the end of the file data */
+            end = min( ROUND_SIZE( 0, file_size ), map_size );
+            if (map_file_into_view( view, reloc_fd, sec->VirtualAddress, end, sec->VirtualAddress,
+                                    VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
+                                    FALSE ) != STATUS_SUCCESS)
+            {
+                ERR_(module)( "Could not map relocated section %.8s\n", sec->Name );
+                goto error;
+            }
+            continue;
+        }
+
+        if (map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
                                 VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
                                 removable ) != STATUS_SUCCESS)
         {
@@ -1578,6 +2162,7 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
 
     VIRTUAL_DEBUG_DUMP_VIEW( view );
     server_leave_uninterrupted_section( &csVirtual, &sigset );
+    if (reloc_fd != -1) close( reloc_fd );
 
     *addr_ptr = ptr;
 #ifdef VALGRIND_LOAD_PDB_DEBUGINFO
@@ -1589,6 +2174,7 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, char *ba
  error:
     if (view) delete_view( view );
     server_leave_uninterrupted_section( &csVirtual, &sigset );
+    if (reloc_fd != -1) close( reloc_fd );
     return status;
 }
 
@@ -1648,13 +2234,8 @@ void virtual_init(void)
         }
     }
 
-    /* try to find space in a reserved area for the views and pages protection table */
-#ifdef _WIN64
-    pages_vprot_size = ((size_t)address_space_limit >> page_shift >> pages_vprot_shift) + 1;
-    alloc_views.size = view_block_size + pages_vprot_size * sizeof(*pages_vprot);
-#else
-    alloc_views.size = view_block_size + (1U << (32 - page_shift));
-#endif
+    /* try to find space in a reserved area for the views and page protections */
+    alloc_views.size = view_block_size + vprot_block_size;
     if (wine_mmap_enum_reserved_areas( alloc_virtual_heap, &alloc_views, 1 ))
         wine_mmap_remove_reserved_area( alloc_views.base, alloc_views.size, 0 );
     else
@@ -1663,13 +2244,22 @@ void virtual_init(void)
     assert( alloc_views.base != (void *)-1 );
     view_block_start = alloc_views.base;
     view_block_end = view_block_start + view_block_size / sizeof(*view_block_start);
-    pages_vprot = (void *)((char *)alloc_views.base + view_block_size);
+    vprot_block_start = (void *)((char *)alloc_views.base + view_block_size);
+    vprot_block_end = vprot_block_start + vprot_block_size / sizeof(*vprot_block_start);
     wine_rb_init( &views_tree, compare_view );
+    wine_rb_init( &vprot_tree, compare_vprot_range );
+    wine_rb_init( &view_gaps_tree, compare_view_gap );
+    first_gap.base = (char *)0;
+    first_gap.end = (char *)~(UINT_PTR)0;
+    wine_rb_put( &view_gaps_tree, first_gap.base, &first_gap.entry );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
     size = (char *)address_space_start - (char *)0x10000;
     if (size && wine_mmap_is_in_reserved_area( (void*)0x10000, size ) == 1)
         wine_anon_mmap( (void *)0x10000, size, PROT_READ | PROT_WRITE, MAP_FIXED );
+
+    init_soft_dirty();
+    init_large_pages();
 }
 
 
@@ -1799,7 +2389,9 @@ NTSTATUS virtual_alloc_thread_stack( TEB *teb, SIZE_T reserve_size, SIZE_T commi
 
         /* shrink the first view and create a second one for the extra size */
         /* this allows the app to free the stack without freeing the thread start portion */
+        view_gaps_remove_view( view );
         view->size -= extra_size;
+        view_gaps_insert_view( view );
         status = create_view( &extra_view, (char *)view->base + view->size, extra_size,
                               VPROT_READ | VPROT_WRITE | VPROT_COMMITTED );
         if (status != STATUS_SUCCESS)
@@ -1879,13 +2471,14 @@ NTSTATUS virtual_handle_fault( LPCVOID addr, DWORD err, BOOL on_signal_stack )
  */
 static NTSTATUS check_write_access( void *base, size_t size, BOOL *has_write_watch )
 {
-    size_t i;
+    size_t i, range_size;
     char *addr = ROUND_ADDR( base, page_mask );
+    BYTE vprot;
 
     size = ROUND_SIZE( base, size );
-    for (i = 0; i < size; i += page_size)
+    for (i = 0; i < size; i += range_size)
     {
-        BYTE vprot = get_page_vprot( addr + i );
+        range_size = get_vprot_range_size( addr + i, size - i, 0xff, &vprot );
         if (vprot & VPROT_WRITEWATCH) *has_write_watch = TRUE;
         if (!(VIRTUAL_GetUnixProt( vprot & ~VPROT_WRITEWATCH ) & PROT_WRITE))
             return STATUS_INVALID_USER_BUFFER;
@@ -2357,12 +2950,21 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG zero_
     /* Compute the alloc type flags */
 
     if (!(type & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) ||
-        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET)))
+        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET | MEM_LARGE_PAGES)))
     {
         WARN("called with wrong alloc type flags (%08x) !\n", type);
         return STATUS_INVALID_PARAMETER;
     }
 
+    /* large pages are committed at once, in multiples of the large page size */
+    if (type & MEM_LARGE_PAGES)
+    {
+        if (!large_page_size || (type & (MEM_COMMIT | MEM_RESERVE)) != (MEM_COMMIT | MEM_RESERVE) ||
+            (size & (large_page_size - 1)) || ((UINT_PTR)base & (large_page_size - 1)))
+            return STATUS_INVALID_PARAMETER;
+        mask |= large_page_size - 1;
+    }
+
     /* Reserve the memory */
 
     if (use_locks) server_enter_uninterrupted_section( &csVirtual, &sigset );
@@ -2380,6 +2982,14 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG zero_
             else status = map_view( &view, base, size, mask, type & MEM_TOP_DOWN, vprot );
 
             if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS && (type & MEM_LARGE_PAGES))
+            {
+                map_large_pages( base, size, vprot );
+                view->protect |= VPROT_LARGEPAGES;
+            }
+            /* new mappings are reported as soft-dirty until the next reset */
+            if (status == STATUS_SUCCESS && (vprot & VPROT_WRITEWATCH) && pagemap_fd != -1)
+                view->protect |= VPROT_NEWWATCH;
         }
     }
     else if (type & MEM_RESET)
@@ -2391,6 +3001,7 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG zero_
     {
         if (!(view = VIRTUAL_FindView( base, size ))) status = STATUS_NOT_MAPPED_VIEW;
         else if (view->protect & SEC_FILE) status = STATUS_ALREADY_COMMITTED;
+        else if (is_partial_large_page_range( view, base, size )) status = STATUS_INVALID_PARAMETER;
         else if (!(status = set_protection( view, base, size, protect )) && (view->protect & SEC_RESERVE))
         {
             SERVER_START_REQ( add_mapping_committed_range )
@@ -2482,7 +3093,8 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     }
     else if (type == MEM_DECOMMIT)
     {
-        status = decommit_pages( view, base - (char *)view->base, size );
+        if (is_partial_large_page_range( view, base, size )) status = STATUS_INVALID_PARAMETER;
+        else status = decommit_pages( view, base - (char *)view->base, size );
         if (status == STATUS_SUCCESS)
         {
             *addr_ptr = base;
@@ -2553,8 +3165,10 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if ((view = VIRTUAL_FindView( base, size )))
     {
+        /* large pages can only be reprotected as a whole */
+        if (is_partial_large_page_range( view, base, size )) status = STATUS_INVALID_PARAMETER;
         /* Make sure all the pages are committed */
-        if (get_committed_size( view, base, &vprot ) >= size && (vprot & VPROT_COMMITTED))
+        else if (get_committed_size( view, base, &vprot ) >= size && (vprot & VPROT_COMMITTED))
         {
             old = VIRTUAL_GetWin32Prot( vprot, view->protect );
             status = set_protection( view, base, size, new_prot );
@@ -2737,8 +3351,7 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     }
     else
     {
-        BYTE vprot;
-        char *ptr;
+        BYTE vprot, dummy;
         SIZE_T range_size = get_committed_size( view, base, &vprot );
 
         info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
@@ -2747,9 +3360,7 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
         if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
         else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
         else info->Type = MEM_PRIVATE;
-        for (ptr = base; ptr < base + range_size; ptr += page_size)
-            if ((get_page_vprot( ptr ) ^ vprot) & ~VPROT_WRITEWATCH) break;
-        info->RegionSize = ptr - base;
+        info->RegionSize = get_vprot_range_size( base, range_size, ~VPROT_WRITEWATCH, &dummy );
     }
     server_leave_uninterrupted_section( &csVirtual, &sigset );
 
@@ -2911,6 +3522,7 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     struct file_view *view;
     pe_image_info_t image_info;
     HANDLE shared_file;
+    client_ptr_t reloc_base;
     LARGE_INTEGER offset;
     sigset_t sigset;
 
@@ -2992,6 +3604,7 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
         sec_flags   = reply->flags;
         full_size   = reply->size;
         shared_file = wine_server_ptr_handle( reply->shared_file );
+        reloc_base  = reply->reloc_base;
     }
     SERVER_END_REQ;
     if (res) return res;
@@ -3001,8 +3614,10 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     if (sec_flags & SEC_IMAGE)
     {
         void *base = wine_server_get_ptr( image_info.base );
+        void *shared_base = NULL;
 
         if ((ULONG_PTR)base != image_info.base) base = NULL;
+        if (use_shared_relocs()) shared_base = wine_server_get_ptr( reloc_base );
         size = image_info.map_size;
         if (size != image_info.map_size)  /* truncated */
         {
@@ -3017,15 +3632,15 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
 
             if ((res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
                                            &shared_fd, &shared_needs_close, NULL, NULL ))) goto done;
-            res = map_image( handle, access, unix_handle, base, size, mask, image_info.header_size,
+            res = map_image( handle, access, unix_handle, base, NULL, size, mask, image_info.header_size,
                              shared_fd, needs_close, addr_ptr );
             if (shared_needs_close) close( shared_fd );
             close_handle( shared_file );
         }
         else
         {
-            res = map_image( handle, access, unix_handle, base, size, mask, image_info.header_size,
-                             -1, needs_close, addr_ptr );
+            res = map_image( handle, access, unix_handle, base, shared_base, size, mask,
+                             image_info.header_size, -1, needs_close, addr_ptr );
         }
         if (needs_close) close( unix_handle );
         if (res >= 0) *size_ptr = size;
@@ -3062,6 +3677,7 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     get_vprot_flags( protect, &vprot, sec_flags & SEC_IMAGE );
     vprot |= sec_flags;
     if (!(sec_flags & SEC_RESERVE)) vprot |= VPROT_COMMITTED;
+    if ((sec_flags & SEC_LARGE_PAGES) && large_page_size) mask |= large_page_size - 1;
     res = map_view( &view, *addr_ptr, size, mask, FALSE, vprot );
     if (res)
     {
@@ -3075,6 +3691,11 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
           handle, size, offset.u.HighPart, offset.u.LowPart );
 
     res = map_file_into_view( view, unix_handle, 0, size, offset.QuadPart, vprot, needs_close );
+#ifdef MADV_HUGEPAGE
+    /* shared memory can only use transparent huge pages */
+    if (res == STATUS_SUCCESS && (sec_flags & SEC_LARGE_PAGES) && large_page_size)
+        madvise( view->base, size, MADV_HUGEPAGE );
+#endif
     if (res == STATUS_SUCCESS)
     {
         SERVER_START_REQ( map_view )
@@ -3302,10 +3923,15 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
         char *addr = base;
         char *end = addr + size;
 
+        if (pagemap_fd != -1) get_soft_dirty_pages( VIRTUAL_FindView( base, size ), base, size );
         while (pos < *count && addr < end)
         {
-            if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
-            addr += page_size;
+            BYTE vprot;
+            SIZE_T range_size = get_vprot_range_size( addr, end - addr, VPROT_WRITEWATCH, &vprot );
+
+            if (vprot & VPROT_WRITEWATCH) addr += range_size;
+            else for ( ; range_size && pos < *count; range_size -= page_size, addr += page_size)
+                addresses[pos++] = addr;
         }
         if (flags & WRITE_WATCH_FLAG_RESET) reset_write_watches( base, addr - (char *)base );
         *count = pos;
@@ -3346,6 +3972,38 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 }
 
 
+/***********************************************************************
+ *             direct_process_vm_access
+ *
+ * Transfer memory to or from another process with process_vm_readv/writev,
+ * without going through the server. Fails unless the whole range could be
+ * transferred, so that the server can handle the partial cases.
+ */
+static BOOL direct_process_vm_access( HANDLE process, void *addr, void *buffer, SIZE_T size, BOOL write )
+{
+#if defined(__linux__) && defined(__NR_process_vm_readv) && defined(__NR_process_vm_writev)
+    static int disabled;
+    struct iovec local, remote;
+    int unix_pid;
+    ssize_t ret;
+
+    if (disabled || !size) return FALSE;
+    if (server_get_process_vm_pid( process, write ? PROCESS_VM_WRITE : PROCESS_VM_READ, &unix_pid ))
+        return FALSE;
+
+    local.iov_base  = buffer;
+    local.iov_len   = size;
+    remote.iov_base = addr;
+    remote.iov_len  = size;
+    ret = syscall( write ? __NR_process_vm_writev : __NR_process_vm_readv, unix_pid, &local, 1, &remote, 1, 0 );
+    if (ret == -1 && errno == ENOSYS) disabled = 1;
+    return ret == (ssize_t)size;
+#else
+    return FALSE;
+#endif
+}
+
+
 /***********************************************************************
  *             NtReadVirtualMemory   (NTDLL.@)
  *             ZwReadVirtualMemory   (NTDLL.@)
@@ -3357,6 +4015,11 @@ NTSTATUS WINAPI NtReadVirtualMemory( HANDLE process, const void *addr, void *buf
 
     if (virtual_check_buffer_for_write( buffer, size ))
     {
+        if (direct_process_vm_access( process, (void *)addr, buffer, size, FALSE ))
+        {
+            if (bytes_read) *bytes_read = size;
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( read_process_memory )
         {
             req->handle = wine_server_obj_handle( process );
@@ -3387,6 +4050,11 @@ NTSTATUS WINAPI NtWriteVirtualMemory( HANDLE process, void *addr, const void *bu
 
     if (virtual_check_buffer_for_read( buffer, size ))
     {
+        if (direct_process_vm_access( process, addr, (void *)buffer, size, TRUE ))
+        {
+            if (bytes_written) *bytes_written = size;
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( write_process_memory )
         {
             req->handle     = wine_server_obj_handle( process );
@@ -1369,7 +1369,7 @@
 @ stdcall -private ZwResetEvent(long ptr) ntdll.ZwResetEvent
 @ stdcall -private ZwRestoreKey(long long long) ntdll.ZwRestoreKey
 @ stdcall -private ZwSaveKey(long long) ntdll.ZwSaveKey
-@ stub ZwSaveKeyEx
+@ stdcall -private ZwSaveKeyEx(long long long) ntdll.ZwSaveKeyEx
 @ stub ZwSetBootEntryOrder
 @ stub ZwSetBootOptions
 @ stdcall -private ZwSetDefaultLocale(long long) ntdll.ZwSetDefaultLocale
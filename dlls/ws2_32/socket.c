@@ -67,6 +67,12 @@
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 #ifdef HAVE_NETINET_IN_H
 # include <netinet/in.h>
 #endif
@@ -157,6 +163,7 @@
 #include "wine/server.h"
 #include "wine/debug.h"
 #include "wine/exception.h"
+#include "wine/list.h"
 #include "wine/unicode.h"
 
 #if defined(linux) && !defined(IP_UNICAST_IF)
@@ -506,6 +513,9 @@ struct ws2_async
     WSABUF                             *control;
     unsigned int                        n_iovecs;
     unsigned int                        first_iovec;
+    int                                 batch_type;    /* async type if in the batch list of the socket */
+    NTSTATUS                            batch_status;  /* status once carried out along with another operation */
+    struct list                         batch_entry;
     struct iovec                        iovec[1];
 };
 
@@ -534,9 +544,25 @@ struct ws2_transmitfile_async
     TRANSMIT_FILE_BUFFERS buffers;
     DWORD                 flags;
     LARGE_INTEGER         offset;
+    TRANSMIT_PACKETS_ELEMENT *elements;   /* TransmitPackets elements that remain to be sent */
+    DWORD                 n_elements;
     struct ws2_async      write;
 };
 
+/* overlapped datagram operations waiting on the sockets, so that the following
+ * ones can be carried out with a single call when one of them is woken up */
+
+#define BATCH_HASH_SIZE  64
+#define BATCH_MAX_COUNT  32
+
+struct ws2_batch_list
+{
+    CRITICAL_SECTION cs;
+    struct list      asyncs;
+};
+
+static struct ws2_batch_list batch_lists[BATCH_HASH_SIZE];
+
 static struct ws2_async_io *async_io_freelist;
 
 static void release_async_io( struct ws2_async_io *io )
@@ -588,6 +614,54 @@ static NTSTATUS register_async( int type, HANDLE handle, struct ws2_async_io *as
     return status;
 }
 
+static inline struct ws2_batch_list *get_batch_list( HANDLE socket )
+{
+    return &batch_lists[((ULONG_PTR)socket >> 2) % BATCH_HASH_SIZE];
+}
+
+/* check whether an overlapped operation can be carried out along with other ones */
+static BOOL batch_allowed( int fd, const struct ws2_async *wsa )
+{
+    int type;
+    socklen_t len = sizeof(type);
+
+    if (wsa->flags || wsa->control || wsa->first_iovec) return FALSE;
+    return !getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &len ) && type == SOCK_DGRAM;
+}
+
+/* add an overlapped operation to the batch list of its socket before registering it;
+ * the list stays locked so that it isn't carried out until the server knows about it */
+static void batch_add( struct ws2_async *wsa, int type )
+{
+    struct ws2_batch_list *batch = get_batch_list( wsa->hSocket );
+
+    EnterCriticalSection( &batch->cs );
+    wsa->batch_type = type;
+    wsa->batch_status = STATUS_PENDING;
+    list_add_tail( &batch->asyncs, &wsa->batch_entry );
+}
+
+/* unlock the batch list once the operation is registered, removing it if that failed */
+static void batch_registered( struct ws2_async *wsa, NTSTATUS status )
+{
+    struct ws2_batch_list *batch = get_batch_list( wsa->hSocket );
+
+    if (status != STATUS_PENDING)
+    {
+        list_remove( &wsa->batch_entry );
+        wsa->batch_type = 0;
+    }
+    LeaveCriticalSection( &batch->cs );
+}
+
+/* unlock the batch list at the end of an async callback, removing the operation if it is done */
+static void batch_leave( struct ws2_batch_list *batch, struct ws2_async *wsa, NTSTATUS status )
+{
+    if (status != STATUS_PENDING && wsa->batch_status == STATUS_PENDING)
+        list_remove( &wsa->batch_entry );
+    LeaveCriticalSection( &batch->cs );
+}
+
 /****************************************************************/
 
 /* ----------------------------------- internal data */
@@ -642,7 +716,8 @@ static int ws_protocol_info(SOCKET s, int unicode, WSAPROTOCOL_INFOW *buffer, in
 int WSAIOCTL_GetInterfaceCount(void);
 int WSAIOCTL_GetInterfaceName(int intNumber, char *intName);
 
-static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus, ULONG Information );
+static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus,
+                              ULONG Information, BOOL async );
 
 #define MAP_OPTION(opt) { WS_##opt, opt }
 
@@ -1317,7 +1392,16 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID fImpLoad)
     TRACE("%p 0x%x %p\n", hInstDLL, fdwReason, fImpLoad);
     switch (fdwReason) {
     case DLL_PROCESS_ATTACH:
+    {
+        unsigned int i;
+
+        for (i = 0; i < BATCH_HASH_SIZE; i++)
+        {
+            InitializeCriticalSection( &batch_lists[i].cs );
+            list_init( &batch_lists[i].asyncs );
+        }
         break;
+    }
     case DLL_PROCESS_DETACH:
         if (fImpLoad) break;
         free_per_thread_data();
@@ -2323,6 +2407,130 @@ static void WINAPI ws2_async_apc( void *arg, IO_STATUS_BLOCK *iosb, ULONG reserv
     release_async_io( &wsa->io );
 }
 
+#ifndef HAVE_RECVMMSG
+struct mmsghdr
+{
+    struct msghdr msg_hdr;
+    unsigned int  msg_len;
+};
+#endif
+
+/* send or receive several datagrams, returns the number of them transferred */
+static int sendrecv_mmsg( int fd, struct mmsghdr *msgs, unsigned int count, BOOL send )
+{
+    unsigned int i;
+    ssize_t ret;
+
+#ifdef HAVE_SENDMMSG
+    if (send)
+    {
+        do ret = sendmmsg( fd, msgs, count, MSG_DONTWAIT );
+        while (ret == -1 && errno == EINTR);
+        return ret;
+    }
+#endif
+#ifdef HAVE_RECVMMSG
+    if (!send)
+    {
+        do ret = recvmmsg( fd, msgs, count, MSG_DONTWAIT, NULL );
+        while (ret == -1 && errno == EINTR);
+        if (ret != -1 || errno != EFAULT) return ret;
+        count = 1;  /* the buffer may be write watched, receive into it with the virtual lock held */
+    }
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        do
+        {
+            if (send) ret = sendmsg( fd, &msgs[i].msg_hdr, MSG_DONTWAIT );
+            else ret = __wine_locked_recvmsg( fd, &msgs[i].msg_hdr, MSG_DONTWAIT );
+        }
+        while (ret == -1 && errno == EINTR);
+        if (ret == -1) return i ? i : -1;
+        msgs[i].msg_len = ret;
+    }
+    return i;
+}
+
+/***********************************************************************
+ *              WS2_batch_io            (INTERNAL)
+ *
+ * Carry out the overlapped datagram operations waiting behind wsa on the
+ * same socket with a single recvmmsg or sendmmsg call, and complete them
+ * with a single server call. Called with the batch list locked.
+ */
+static void WS2_batch_io( int fd, struct ws2_async *wsa, struct ws2_batch_list *batch )
+{
+    struct ws2_async *asyncs[BATCH_MAX_COUNT];
+    union generic_unix_sockaddr addrs[BATCH_MAX_COUNT];
+    struct mmsghdr msgs[BATCH_MAX_COUNT];
+    async_result_t results[BATCH_MAX_COUNT];
+    char completed[BATCH_MAX_COUNT];
+    BOOL send = (wsa->batch_type == ASYNC_TYPE_WRITE);
+    struct list *ptr = &wsa->batch_entry;
+    unsigned int count = 0;
+    int i, n;
+
+    while (count < BATCH_MAX_COUNT && (ptr = list_next( &batch->asyncs, ptr )))
+    {
+        struct ws2_async *next = LIST_ENTRY( ptr, struct ws2_async, batch_entry );
+        struct msghdr *hdr = &msgs[count].msg_hdr;
+
+        /* the list is shared with other sockets, and sends don't need to be ordered with receives */
+        if (next->hSocket != wsa->hSocket || next->batch_type != wsa->batch_type) continue;
+
+        memset( hdr, 0, sizeof(*hdr) );
+        if (next->addr)
+        {
+            hdr->msg_name = &addrs[count];
+            if (!send) hdr->msg_namelen = sizeof(addrs[count]);
+            else if (!(hdr->msg_namelen = ws_sockaddr_ws2u( next->addr, next->addrlen.val, &addrs[count] )))
+                break;  /* let its own callback fail, the following ones have to wait for it */
+        }
+        hdr->msg_iov = next->iovec;
+        hdr->msg_iovlen = next->n_iovecs;
+        asyncs[count++] = next;
+    }
+    if (!count || (n = sendrecv_mmsg( fd, msgs, count, send )) <= 0) return;
+
+    for (i = 0; i < n; i++)
+    {
+        struct ws2_async *async = asyncs[i];
+        IO_STATUS_BLOCK *iosb = async->user_overlapped ? (IO_STATUS_BLOCK *)async->user_overlapped
+                                                       : &async->local_iosb;
+
+        if (send) async->first_iovec = async->n_iovecs;
+        else if (async->addr && msgs[i].msg_hdr.msg_namelen)
+            ws_sockaddr_u2ws( &addrs[i].addr, async->addr, async->addrlen.ptr );
+
+        iosb->u.Status = STATUS_SUCCESS;
+        iosb->Information = msgs[i].msg_len;
+        async->batch_status = STATUS_SUCCESS;
+        list_remove( &async->batch_entry );
+
+        results[i].user   = wine_server_client_ptr( &async->io );
+        results[i].total  = msgs[i].msg_len;
+        results[i].status = STATUS_SUCCESS;
+        results[i].__pad  = 0;
+    }
+
+    /* the operations already woken up by the server get their result from their own callback */
+    memset( completed, 0, n );
+    SERVER_START_REQ( complete_socket_asyncs )
+    {
+        req->handle = wine_server_obj_handle( wsa->hSocket );
+        req->type   = wsa->batch_type;
+        wine_server_add_data( req, results, n * sizeof(results[0]) );
+        wine_server_set_reply( req, completed, n );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+
+    for (i = 0; i < n; i++)
+        if (completed[i] && !asyncs[i]->completion_func) release_async_io( &asyncs[i]->io );
+}
+
 /***********************************************************************
  *              WS2_recv                (INTERNAL)
  *
@@ -2404,15 +2612,25 @@ static int WS2_recv( int fd, struct ws2_async *wsa, int flags )
 static NTSTATUS WS2_async_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS status )
 {
     struct ws2_async *wsa = user;
+    struct ws2_batch_list *batch = wsa->batch_type ? get_batch_list( wsa->hSocket ) : NULL;
     int result = 0, fd;
 
+    if (batch) EnterCriticalSection( &batch->cs );
     switch (status)
     {
     case STATUS_ALERTED:
+        if (batch && wsa->batch_status != STATUS_PENDING)
+        {
+            /* already carried out along with another operation */
+            status = wsa->batch_status;
+            result = iosb->Information;
+            break;
+        }
         if ((status = wine_server_handle_to_fd( wsa->hSocket, FILE_READ_DATA, &fd, NULL ) ))
             break;
 
         result = WS2_recv( fd, wsa, convert_flags(wsa->flags) );
+        if (result >= 0 && batch) WS2_batch_io( fd, wsa, batch );
         wine_server_release_fd( wsa->hSocket, fd );
         if (result >= 0)
         {
@@ -2434,6 +2652,7 @@ static NTSTATUS WS2_async_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
         }
         break;
     }
+    if (batch) batch_leave( batch, wsa, status );
     if (status != STATUS_PENDING)
     {
         iosb->u.Status = status;
@@ -2459,7 +2678,8 @@ static NTSTATUS WS2_async_accept_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTAT
         return status;
 
     if (wsa->cvalue)
-        WS_AddCompletion( HANDLE2SOCKET(wsa->listen_socket), wsa->cvalue, iosb->u.Status, iosb->Information );
+        WS_AddCompletion( HANDLE2SOCKET(wsa->listen_socket), wsa->cvalue, iosb->u.Status,
+                          iosb->Information, TRUE );
 
     release_async_io( &wsa->io );
     return status;
@@ -2617,14 +2837,16 @@ static int WS2_send( int fd, struct ws2_async *wsa, int flags )
 static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS status )
 {
     struct ws2_async *wsa = user;
+    struct ws2_batch_list *batch = wsa->batch_type ? get_batch_list( wsa->hSocket ) : NULL;
     int result = 0, fd;
 
+    if (batch) EnterCriticalSection( &batch->cs );
     switch (status)
     {
     case STATUS_ALERTED:
         if ( wsa->n_iovecs <= wsa->first_iovec )
         {
-            /* Nothing to do */
+            /* Nothing to do, or already carried out along with another operation */
             status = STATUS_SUCCESS;
             break;
         }
@@ -2633,6 +2855,7 @@ static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
 
         /* check to see if the data is ready (non-blocking) */
         result = WS2_send( fd, wsa, convert_flags(wsa->flags) );
+        if (result >= 0 && batch) WS2_batch_io( fd, wsa, batch );
         wine_server_release_fd( wsa->hSocket, fd );
 
         if (result >= 0)
@@ -2654,6 +2877,7 @@ static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
         }
         break;
     }
+    if (batch) batch_leave( batch, wsa, status );
     if (status != STATUS_PENDING)
     {
         iosb->u.Status = status;
@@ -2857,6 +3081,7 @@ static BOOL WINAPI WS2_AcceptEx(SOCKET listener, SOCKET acceptor, PVOID dest, DW
         wsa->read->control     = NULL;
         wsa->read->n_iovecs    = 1;
         wsa->read->first_iovec = 0;
+        wsa->read->batch_type  = 0;
         wsa->read->completion_func = NULL;
         wsa->read->iovec[0].iov_base = wsa->buf;
         wsa->read->iovec[0].iov_len  = wsa->data_len;
@@ -2922,6 +3147,79 @@ static NTSTATUS WS2_ReadFile(HANDLE hFile, PIO_STATUS_BLOCK io_status, char* buf
     return status;
 }
 
+/***********************************************************************
+ *     WS2_transmitfile_sendfile        (INTERNAL)
+ *
+ * Send the next part of a TransmitFile file straight from its unix fd,
+ * without copying it through the transfer buffer.  Returns
+ * STATUS_NOT_SUPPORTED when the caller has to read the file instead.
+ */
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa )
+{
+#ifdef HAVE_SYS_SENDFILE_H
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    DWORD bytes_per_send = wsa->bytes_per_send;
+    HANDLE file = wsa->file;
+    NTSTATUS status;
+    struct stat st;
+    off_t offset;
+    ssize_t n;
+    int file_fd;
+
+    if (wine_server_handle_to_fd( file, FILE_READ_DATA, &file_fd, NULL ))
+        return STATUS_NOT_SUPPORTED;
+
+    if (fstat( file_fd, &st ) || !S_ISREG( st.st_mode ))
+    {
+        wine_server_release_fd( file, file_fd );
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    /* when the size of the transfer is limited ensure that we don't go past that limit */
+    if (wsa->file_bytes != 0)
+        bytes_per_send = min(bytes_per_send, wsa->file_bytes - wsa->file_read);
+
+    do
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+        {
+            offset = wsa->offset.QuadPart;
+            n = sendfile( fd, file_fd, &offset, bytes_per_send );
+        }
+        else
+            n = sendfile( fd, file_fd, NULL, bytes_per_send );
+    }
+    while (n == -1 && errno == EINTR);
+
+    if (n > 0)
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            wsa->offset.QuadPart += n;
+        wsa->file_read += n;
+        if (iosb) iosb->Information += n;
+        if (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)
+            wsa->file = NULL;
+        status = STATUS_PENDING;
+    }
+    else if (!n)
+    {
+        wsa->file = NULL; /* end of file, continue on to the footer */
+        status = STATUS_SUCCESS;
+    }
+    else if (errno == EAGAIN)
+        status = STATUS_PENDING;
+    else if (errno == EINVAL || errno == ENOSYS || errno == EOVERFLOW)
+        status = STATUS_NOT_SUPPORTED;
+    else
+        status = wsaErrStatus();
+
+    wine_server_release_fd( file, file_fd );
+    return status;
+#else
+    return STATUS_NOT_SUPPORTED;
+#endif
+}
+
 /***********************************************************************
  *     WS2_transmitfile_getbuffer       (INTERNAL)
  *
@@ -2951,6 +3249,12 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
         IO_STATUS_BLOCK iosb;
         NTSTATUS status;
 
+        status = WS2_transmitfile_sendfile( fd, wsa );
+        if (status == STATUS_SUCCESS)
+            return WS2_transmitfile_getbuffer( fd, wsa ); /* continue on to the footer */
+        if (status != STATUS_NOT_SUPPORTED)
+            return status;
+
         iosb.Information = 0;
         /* when the size of the transfer is limited ensure that we don't go past that limit */
         if (wsa->file_bytes != 0)
@@ -2991,6 +3295,35 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
         return STATUS_PENDING;
     }
 
+    /* move on to the next TransmitPackets element */
+    while (wsa->n_elements)
+    {
+        TRANSMIT_PACKETS_ELEMENT *element = wsa->elements++;
+
+        wsa->n_elements--;
+        if (element->dwElFlags & TP_ELEMENT_MEMORY)
+        {
+            if (!element->cLength) continue;
+            wsa->write.first_iovec       = 0;
+            wsa->write.n_iovecs          = 1;
+            wsa->write.iovec[0].iov_base = element->u.pBuffer;
+            wsa->write.iovec[0].iov_len  = element->cLength;
+            return STATUS_PENDING;
+        }
+        if (element->dwElFlags & TP_ELEMENT_FILE)
+        {
+            wsa->file       = element->u.s.hFile;
+            wsa->file_read  = 0;
+            wsa->file_bytes = element->cLength;
+            /* an offset of -1 means the current file position */
+            if (element->u.s.nFileOffset.QuadPart == -1)
+                wsa->offset.QuadPart = FILE_USE_FILE_POINTER_POSITION;
+            else
+                wsa->offset = element->u.s.nFileOffset;
+            return WS2_transmitfile_getbuffer( fd, wsa );
+        }
+    }
+
     return STATUS_SUCCESS;
 }
 
@@ -3004,7 +3337,7 @@ static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *ws
     NTSTATUS status;
 
     status = WS2_transmitfile_getbuffer( fd, wsa );
-    if (status == STATUS_PENDING)
+    if (status == STATUS_PENDING && wsa->write.first_iovec < wsa->write.n_iovecs)
     {
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
         int n;
@@ -3040,6 +3373,8 @@ static NTSTATUS WS2_async_transmitfile( void *user, IO_STATUS_BLOCK *iosb, NTSTA
         }
         if (status == STATUS_PENDING)
             return status;
+        if (status == STATUS_SUCCESS && (wsa->flags & (TF_DISCONNECT | TF_REUSE_SOCKET)))
+            WS_shutdown( HANDLE2SOCKET(wsa->write.hSocket), SD_BOTH );
     }
 
     iosb->u.Status = status;
@@ -3047,6 +3382,64 @@ static NTSTATUS WS2_async_transmitfile( void *user, IO_STATUS_BLOCK *iosb, NTSTA
     return status;
 }
 
+/***********************************************************************
+ *     WS2_transmit                     (INTERNAL)
+ *
+ * Start a TransmitFile or TransmitPackets operation, and wait for it
+ * to complete if it isn't overlapped.
+ */
+static BOOL WS2_transmit( SOCKET s, int fd, struct ws2_transmitfile_async *wsa, LPOVERLAPPED overlapped )
+{
+    NTSTATUS status;
+
+    if (wsa->flags & TF_REUSE_SOCKET)
+        FIXME( "Reusing socket not supported yet\n" );
+
+    wsa->buffer                = (char *)(wsa + 1) + wsa->n_elements * sizeof(*wsa->elements);
+    wsa->write.hSocket         = SOCKET2HANDLE(s);
+    wsa->write.addr            = NULL;
+    wsa->write.addrlen.val     = 0;
+    wsa->write.flags           = 0;
+    wsa->write.lpFlags         = &wsa->flags;
+    wsa->write.control         = NULL;
+    wsa->write.n_iovecs        = 0;
+    wsa->write.first_iovec     = 0;
+    wsa->write.user_overlapped = overlapped;
+    if (overlapped)
+    {
+        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
+
+        iosb->u.Status = STATUS_PENDING;
+        iosb->Information = 0;
+        status = register_async( ASYNC_TYPE_WRITE, SOCKET2HANDLE(s), &wsa->io,
+                                 overlapped->hEvent, NULL, NULL, iosb );
+        if(status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
+        release_sock_fd( s, fd );
+        WSASetLastError( NtStatusToWSAError(status) );
+        return FALSE;
+    }
+
+    do
+    {
+        status = WS2_transmitfile_base( fd, wsa );
+        if (status == STATUS_PENDING)
+        {
+            /* block here */
+            do_block(fd, POLLOUT, -1);
+            _sync_sock_state(s); /* let wineserver notice connection */
+        }
+    }
+    while (status == STATUS_PENDING);
+    release_sock_fd( s, fd );
+
+    if (status == STATUS_SUCCESS && (wsa->flags & (TF_DISCONNECT | TF_REUSE_SOCKET)))
+        WS_shutdown( s, SD_BOTH );
+    if (status != STATUS_SUCCESS)
+        WSASetLastError( NtStatusToWSAError(status) );
+    HeapFree( GetProcessHeap(), 0, wsa );
+    return (status == STATUS_SUCCESS);
+}
+
 /***********************************************************************
  *     TransmitFile
  */
@@ -3057,7 +3450,6 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     union generic_unix_sockaddr uaddr;
     socklen_t uaddrlen = sizeof(uaddr);
     struct ws2_transmitfile_async *wsa;
-    NTSTATUS status;
     int fd;
 
     TRACE("(%lx, %p, %d, %d, %p, %p, %d)\n", s, h, file_bytes, bytes_per_send, overlapped,
@@ -3075,7 +3467,7 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
         WSASetLastError( WSAENOTCONN );
         return FALSE;
     }
-    if (flags)
+    if (flags & ~(TF_DISCONNECT | TF_REUSE_SOCKET | TF_WRITE_BEHIND | TF_USE_SYSTEM_THREAD | TF_USE_KERNEL_APC))
         FIXME("Flags are not currently supported (0x%x).\n", flags);
 
     if (h && GetFileType( h ) != FILE_TYPE_DISK)
@@ -3101,60 +3493,859 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
         wsa->buffers = *buffers;
     else
         memset(&wsa->buffers, 0x0, sizeof(wsa->buffers));
-    wsa->buffer                = (char *)(wsa + 1);
     wsa->file                  = h;
     wsa->file_read             = 0;
     wsa->file_bytes            = file_bytes;
     wsa->bytes_per_send        = bytes_per_send;
     wsa->flags                 = flags;
     wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
-    wsa->write.hSocket         = SOCKET2HANDLE(s);
-    wsa->write.addr            = NULL;
-    wsa->write.addrlen.val     = 0;
-    wsa->write.flags           = 0;
-    wsa->write.lpFlags         = &wsa->flags;
-    wsa->write.control         = NULL;
-    wsa->write.n_iovecs        = 0;
-    wsa->write.first_iovec     = 0;
-    wsa->write.user_overlapped = overlapped;
+    wsa->elements              = NULL;
+    wsa->n_elements            = 0;
     if (overlapped)
     {
-        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
-        int status;
-
         wsa->offset.u.LowPart  = overlapped->u.s.Offset;
         wsa->offset.u.HighPart = overlapped->u.s.OffsetHigh;
-        iosb->u.Status = STATUS_PENDING;
-        iosb->Information = 0;
-        status = register_async( ASYNC_TYPE_WRITE, SOCKET2HANDLE(s), &wsa->io,
-                                 overlapped->hEvent, NULL, NULL, iosb );
-        if(status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
+    }
+    return WS2_transmit( s, fd, wsa, overlapped );
+}
+
+/***********************************************************************
+ *     TransmitPackets
+ */
+static BOOL WINAPI WS2_TransmitPackets( SOCKET s, LPTRANSMIT_PACKETS_ELEMENT elements, DWORD count,
+                                        DWORD send_size, LPOVERLAPPED overlapped, DWORD flags )
+{
+    union generic_unix_sockaddr uaddr;
+    socklen_t uaddrlen = sizeof(uaddr);
+    struct ws2_transmitfile_async *wsa;
+    DWORD i;
+    int fd;
+
+    TRACE("(%lx, %p, %u, %u, %p, %#x)\n", s, elements, count, send_size, overlapped, flags );
+
+    fd = get_sock_fd( s, FILE_WRITE_DATA, NULL );
+    if (fd == -1)
+    {
+        WSASetLastError( WSAENOTSOCK );
+        return FALSE;
+    }
+    if (getpeername( fd, &uaddr.addr, &uaddrlen ) != 0)
+    {
         release_sock_fd( s, fd );
-        WSASetLastError( NtStatusToWSAError(status) );
+        WSASetLastError( WSAENOTCONN );
         return FALSE;
     }
+    if (count && !elements)
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & ~(TP_DISCONNECT | TP_REUSE_SOCKET | TP_USE_SYSTEM_THREAD | TP_USE_KERNEL_APC))
+        FIXME("Flags are not currently supported (0x%x).\n", flags);
 
-    do
+    for (i = 0; i < count; i++)
     {
-        status = WS2_transmitfile_base( fd, wsa );
-        if (status == STATUS_PENDING)
+        if (!(elements[i].dwElFlags & TP_ELEMENT_FILE) || (elements[i].dwElFlags & TP_ELEMENT_MEMORY))
+            continue;
+        if (GetFileType( elements[i].u.s.hFile ) != FILE_TYPE_DISK)
         {
-            /* block here */
-            do_block(fd, POLLOUT, -1);
-            _sync_sock_state(s); /* let wineserver notice connection */
+            FIXME("Non-disk file handles are not currently supported.\n");
+            release_sock_fd( s, fd );
+            WSASetLastError( WSAEOPNOTSUPP );
+            return FALSE;
         }
     }
-    while (status == STATUS_PENDING);
-    release_sock_fd( s, fd );
 
-    if (status != STATUS_SUCCESS)
-        WSASetLastError( NtStatusToWSAError(status) );
-    HeapFree( GetProcessHeap(), 0, wsa );
-    return (status == STATUS_SUCCESS);
+    /* set reasonable defaults when requested */
+    if (!send_size)
+        send_size = (1 << 16);
+
+    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( sizeof(*wsa) + count * sizeof(*elements)
+                                                                 + send_size, WS2_async_transmitfile )))
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEFAULT );
+        return FALSE;
+    }
+    memset(&wsa->buffers, 0x0, sizeof(wsa->buffers));
+    wsa->file                  = NULL;
+    wsa->file_read             = 0;
+    wsa->file_bytes            = 0;
+    wsa->bytes_per_send        = send_size;
+    wsa->flags                 = flags;
+    wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->elements              = (TRANSMIT_PACKETS_ELEMENT *)(wsa + 1);
+    wsa->n_elements            = count;
+    if (count) memcpy( wsa->elements, elements, count * sizeof(*elements) );
+    return WS2_transmit( s, fd, wsa, overlapped );
 }
 
 /***********************************************************************
- *     GetAcceptExSockaddrs
+ *     Registered I/O
+ *
+ * The registered buffers, request queues and completion queues all live
+ * in the client.  Queued requests are carried out with batched
+ * non-blocking recvmmsg/sendmmsg calls on the unix socket when sends are
+ * posted, when the completion queue is polled, and from a notification
+ * thread once RIONotify has been called, so that no server call is needed
+ * per packet.
+ */
+
+#define RIO_BATCH_SIZE 64
+
+struct rio_buffer
+{
+    char  *data;
+    DWORD  length;
+};
+
+struct rio_cq
+{
+    CRITICAL_SECTION            cs;
+    RIORESULT                  *results;      /* ring of completions */
+    DWORD                       size;
+    DWORD                       head;
+    DWORD                       count;
+    struct list                 queues;       /* request queues completing to this queue */
+    RIO_NOTIFICATION_COMPLETION notify;
+    BOOL                        has_notify;
+    BOOL                        notify_armed; /* RIONotify has been called */
+    BOOL                        closing;
+    HANDLE                      thread;       /* notification thread */
+    int                         wake_fd[2];   /* pipe to wake up the notification thread */
+};
+
+struct rio_request
+{
+    char                *data;
+    ULONG                length;
+    struct WS_sockaddr  *addr;       /* remote address for RIOSendEx/RIOReceiveEx */
+    int                  addr_len;
+    void                *context;
+    ULONG                sent;       /* bytes already sent on a stream socket */
+};
+
+struct rio_queue
+{
+    struct list          entry;      /* entry in the completion queue list */
+    struct rio_rq       *rq;
+    struct rio_cq       *cq;
+    struct rio_request  *requests;   /* ring of pending requests */
+    ULONG                max;
+    ULONG                head;
+    ULONG                count;
+    ULONG                deferred;   /* requests at the end of the ring posted with RIO_MSG_DEFER */
+    BOOL                 send;
+};
+
+struct rio_rq
+{
+    struct list          entry;      /* entry in rio_rqs */
+    CRITICAL_SECTION     cs;
+    SOCKET               socket;
+    ULONGLONG            context;
+    BOOL                 stream;     /* sends need to keep the order of the bytes */
+    struct rio_queue     recv;
+    struct rio_queue     send;
+};
+
+static struct list rio_rqs = LIST_INIT( rio_rqs );
+static SRWLOCK rio_lock = SRWLOCK_INIT;  /* protects the request queue lists */
+
+static inline struct rio_cq *get_rio_cq( RIO_CQ cq )
+{
+    return (struct rio_cq *)cq;
+}
+
+static inline struct rio_rq *get_rio_rq( RIO_RQ rq )
+{
+    return (struct rio_rq *)rq;
+}
+
+/* find the memory described by a RIO_BUF */
+static BOOL rio_get_buffer( const RIO_BUF *buf, char **data, ULONG *length )
+{
+    struct rio_buffer *buffer = (struct rio_buffer *)buf->BufferId;
+
+    if (!buffer || buf->BufferId == RIO_INVALID_BUFFERID) return FALSE;
+    if (buf->Offset > buffer->length || buf->Length > buffer->length - buf->Offset) return FALSE;
+    *data = buffer->data + buf->Offset;
+    *length = buf->Length;
+    return TRUE;
+}
+
+/* send the notification of a completion queue, called with the queue lock held */
+static void rio_signal( struct rio_cq *cq )
+{
+    cq->notify_armed = FALSE;
+    if (cq->notify.Type == RIO_EVENT_COMPLETION)
+        SetEvent( cq->notify.u.Event.EventHandle );
+    else
+        PostQueuedCompletionStatus( cq->notify.u.Iocp.IocpHandle, 0, (ULONG_PTR)cq->notify.u.Iocp.CompletionKey,
+                                    cq->notify.u.Iocp.Overlapped );
+}
+
+static void rio_wake( struct rio_cq *cq )
+{
+    char c = 0;
+
+    if (write( cq->wake_fd[1], &c, 1 ) == -1 && errno != EAGAIN)
+        WARN( "failed to wake up notification thread, errno %d\n", errno );
+}
+
+/* move the first request of a queue to its completion queue, called with both locks held */
+static void rio_complete( struct rio_queue *queue, LONG status, ULONG bytes )
+{
+    struct rio_request *req = &queue->requests[queue->head];
+    struct rio_cq *cq = queue->cq;
+    RIORESULT *result = &cq->results[(cq->head + cq->count) % cq->size];
+
+    result->Status           = status;
+    result->BytesTransferred = bytes;
+    result->SocketContext    = queue->rq->context;
+    result->RequestContext   = (ULONG_PTR)req->context;
+    cq->count++;
+
+    queue->head = (queue->head + 1) % queue->max;
+    queue->count--;
+}
+
+/* carry out as many of the committed requests of a queue as possible, called with the request queue lock held */
+static void rio_process_queue( struct rio_queue *queue )
+{
+    union generic_unix_sockaddr addrs[RIO_BATCH_SIZE];
+    struct mmsghdr msgs[RIO_BATCH_SIZE];
+    struct iovec iov[RIO_BATCH_SIZE];
+    struct rio_cq *cq = queue->cq;
+    unsigned int i, count;
+    int fd, ret;
+
+    if (!cq || queue->count == queue->deferred) return;
+    if ((fd = get_sock_fd( queue->rq->socket, 0, NULL )) == -1) return;
+
+    EnterCriticalSection( &cq->cs );
+    for (;;)
+    {
+        count = min( queue->count - queue->deferred, cq->size - cq->count );
+        if (!(count = min( count, RIO_BATCH_SIZE ))) break;
+
+        memset( msgs, 0, count * sizeof(msgs[0]) );
+        for (i = 0; i < count; i++)
+        {
+            struct rio_request *req = &queue->requests[(queue->head + i) % queue->max];
+
+            iov[i].iov_base = req->data + req->sent;
+            iov[i].iov_len  = req->length - req->sent;
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (!req->addr) continue;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            if (queue->send)
+                msgs[i].msg_hdr.msg_namelen = ws_sockaddr_ws2u( req->addr, req->addr_len, &addrs[i] );
+            else
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        if (queue->send && queue->rq->stream)
+        {
+            /* a short write would leave a gap before the following requests, so send
+             * them with a single call and keep the unsent remainder at the head */
+            struct msghdr hdr;
+
+            memset( &hdr, 0, sizeof(hdr) );
+            hdr.msg_iov    = iov;
+            hdr.msg_iovlen = count;
+            do ret = sendmsg( fd, &hdr, MSG_DONTWAIT );
+            while (ret == -1 && errno == EINTR);
+            if (ret == -1)
+            {
+                if (errno == EAGAIN) break;
+                rio_complete( queue, wsaErrno(), 0 );
+                continue;
+            }
+            for (i = 0; i < count; i++)
+            {
+                struct rio_request *req = &queue->requests[queue->head];
+
+                if ((ULONG)ret < req->length - req->sent)
+                {
+                    req->sent += ret;
+                    break;
+                }
+                ret -= req->length - req->sent;
+                rio_complete( queue, 0, req->length );
+            }
+            if (i < count) break;
+            continue;
+        }
+
+        if ((ret = sendrecv_mmsg( fd, msgs, count, queue->send )) == -1)
+        {
+            if (errno == EAGAIN) break;
+            rio_complete( queue, wsaErrno(), 0 );
+            continue;
+        }
+
+        for (i = 0; i < ret; i++)
+        {
+            struct rio_request *req = &queue->requests[queue->head];
+
+            if (!queue->send && req->addr && msgs[i].msg_hdr.msg_namelen)
+                ws_sockaddr_u2ws( &addrs[i].addr, req->addr, &req->addr_len );
+            rio_complete( queue, 0, msgs[i].msg_len );
+        }
+        if (ret < count) break;
+    }
+    if (cq->count && cq->notify_armed) rio_signal( cq );
+    LeaveCriticalSection( &cq->cs );
+
+    release_sock_fd( queue->rq->socket, fd );
+}
+
+/* carry out the pending requests of all the request queues that complete to a queue */
+static void rio_process_cq( struct rio_cq *cq )
+{
+    struct rio_queue *queue;
+
+    AcquireSRWLockShared( &rio_lock );
+    LIST_FOR_EACH_ENTRY( queue, &cq->queues, struct rio_queue, entry )
+    {
+        EnterCriticalSection( &queue->rq->cs );
+        rio_process_queue( queue );
+        LeaveCriticalSection( &queue->rq->cs );
+    }
+    ReleaseSRWLockShared( &rio_lock );
+}
+
+/* wait for the sockets of a completion queue until a request completes once RIONotify has been called */
+static DWORD CALLBACK rio_notify_thread( void *arg )
+{
+    struct rio_cq *cq = arg;
+    unsigned int i, count, size = 16;
+    struct pollfd *fds, *new_fds;
+    SOCKET *sockets, *new_sockets;
+    struct rio_queue *queue;
+    char buf[64];
+
+    fds = HeapAlloc( GetProcessHeap(), 0, (size + 1) * sizeof(*fds) );
+    sockets = HeapAlloc( GetProcessHeap(), 0, size * sizeof(*sockets) );
+    if (!fds || !sockets) goto done;
+
+    while (!cq->closing)
+    {
+        count = 0;
+        if (cq->notify_armed) rio_process_cq( cq );
+        if (cq->notify_armed)
+        {
+            AcquireSRWLockShared( &rio_lock );
+            LIST_FOR_EACH_ENTRY( queue, &cq->queues, struct rio_queue, entry )
+            {
+                if (queue->count == queue->deferred) continue;
+                if (count == size)
+                {
+                    if (!(new_fds = HeapReAlloc( GetProcessHeap(), 0, fds, (size * 2 + 1) * sizeof(*fds) ))) break;
+                    fds = new_fds;
+                    if (!(new_sockets = HeapReAlloc( GetProcessHeap(), 0, sockets, size * 2 * sizeof(*sockets) ))) break;
+                    sockets = new_sockets;
+                    size *= 2;
+                }
+                sockets[count] = queue->rq->socket;
+                if ((fds[count + 1].fd = get_sock_fd( sockets[count], 0, NULL )) == -1) continue;
+                fds[count + 1].events = queue->send ? POLLOUT : POLLIN;
+                count++;
+            }
+            ReleaseSRWLockShared( &rio_lock );
+        }
+
+        fds[0].fd = cq->wake_fd[0];
+        fds[0].events = POLLIN;
+        poll( fds, count + 1, -1 );
+        if (fds[0].revents & POLLIN)
+            while (read( cq->wake_fd[0], buf, sizeof(buf) ) > 0) /* nothing */;
+
+        for (i = 0; i < count; i++) release_sock_fd( sockets[i], fds[i + 1].fd );
+    }
+
+done:
+    HeapFree( GetProcessHeap(), 0, fds );
+    HeapFree( GetProcessHeap(), 0, sockets );
+    return 0;
+}
+
+static BOOL rio_resize_queue( struct rio_queue *queue, ULONG max )
+{
+    struct rio_request *requests;
+    ULONG i;
+
+    if (max < queue->count) return FALSE;
+    if (!(requests = HeapAlloc( GetProcessHeap(), 0, max(max, 1) * sizeof(*requests) ))) return FALSE;
+    for (i = 0; i < queue->count; i++)
+        requests[i] = queue->requests[(queue->head + i) % queue->max];
+    HeapFree( GetProcessHeap(), 0, queue->requests );
+    queue->requests = requests;
+    queue->max = max;
+    queue->head = 0;
+    return TRUE;
+}
+
+static BOOL rio_post( RIO_RQ handle, BOOL send, PRIO_BUF data, ULONG count, PRIO_BUF remote,
+                      DWORD flags, void *context )
+{
+    struct rio_rq *rq = get_rio_rq( handle );
+    struct rio_queue *queue;
+    struct rio_request *req;
+    DWORD err = 0;
+
+    if (!rq || count > 1 || (count && !data))
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & RIO_MSG_WAITALL)
+        FIXME( "RIO_MSG_WAITALL not supported\n" );
+
+    /* keep the socket from being closed under us */
+    AcquireSRWLockShared( &rio_lock );
+    EnterCriticalSection( &rq->cs );
+    queue = send ? &rq->send : &rq->recv;
+    if (flags & RIO_MSG_COMMIT_ONLY)
+    {
+        if (count) err = WSAEINVAL;
+        else queue->deferred = 0;
+    }
+    else if (queue->count >= queue->max)
+        err = WSAENOBUFS;
+    else
+    {
+        req = &queue->requests[(queue->head + queue->count) % queue->max];
+        req->data     = NULL;
+        req->length   = 0;
+        req->addr     = NULL;
+        req->addr_len = 0;
+        req->context  = context;
+        req->sent     = 0;
+        if (count && !rio_get_buffer( data, &req->data, &req->length ))
+            err = WSAEINVAL;
+        else if (remote)
+        {
+            char *addr;
+            ULONG len;
+
+            if (!rio_get_buffer( remote, &addr, &len )) err = WSAEINVAL;
+            else
+            {
+                req->addr = (struct WS_sockaddr *)addr;
+                req->addr_len = len;
+            }
+        }
+        if (!err)
+        {
+            queue->count++;
+            if (flags & RIO_MSG_DEFER) queue->deferred++;
+            else queue->deferred = 0;
+        }
+    }
+
+    if (!err && !queue->deferred && queue->cq)
+    {
+        /* sends are carried out right away, receives when the completion queue is polled */
+        if (send) rio_process_queue( queue );
+        if (queue->cq->notify_armed) rio_wake( queue->cq );
+    }
+    LeaveCriticalSection( &rq->cs );
+    ReleaseSRWLockShared( &rio_lock );
+
+    if (err) SetLastError( err );
+    return !err;
+}
+
+/* remove the request queues of a socket that is being closed */
+static void rio_close_socket( SOCKET s )
+{
+    struct rio_rq *rq, *next;
+    struct rio_queue *queue;
+    unsigned int i;
+
+    if (list_empty( &rio_rqs )) return;
+
+    AcquireSRWLockExclusive( &rio_lock );
+    LIST_FOR_EACH_ENTRY_SAFE( rq, next, &rio_rqs, struct rio_rq, entry )
+    {
+        if (rq->socket != s) continue;
+        list_remove( &rq->entry );
+        for (i = 0; i < 2; i++)
+        {
+            queue = i ? &rq->send : &rq->recv;
+            if (queue->cq)
+            {
+                list_remove( &queue->entry );
+
+                /* abort the pending requests */
+                EnterCriticalSection( &queue->cq->cs );
+                while (queue->count && queue->cq->count < queue->cq->size)
+                    rio_complete( queue, WSA_OPERATION_ABORTED, 0 );
+                if (queue->cq->count && queue->cq->notify_armed) rio_signal( queue->cq );
+                LeaveCriticalSection( &queue->cq->cs );
+            }
+            HeapFree( GetProcessHeap(), 0, queue->requests );
+        }
+        rq->cs.DebugInfo->Spare[0] = 0;
+        DeleteCriticalSection( &rq->cs );
+        HeapFree( GetProcessHeap(), 0, rq );
+    }
+    ReleaseSRWLockExclusive( &rio_lock );
+}
+
+/***********************************************************************
+ *     RIORegisterBuffer
+ */
+static RIO_BUFFERID WINAPI WS2_RIORegisterBuffer( PCHAR data, DWORD length )
+{
+    struct rio_buffer *buffer;
+
+    TRACE( "(%p, %u)\n", data, length );
+
+    if (!data)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_BUFFERID;
+    }
+    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, sizeof(*buffer) )))
+    {
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_BUFFERID;
+    }
+    buffer->data   = data;
+    buffer->length = length;
+    return (RIO_BUFFERID)buffer;
+}
+
+/***********************************************************************
+ *     RIODeregisterBuffer
+ */
+static void WINAPI WS2_RIODeregisterBuffer( RIO_BUFFERID id )
+{
+    TRACE( "(%p)\n", id );
+
+    if (id != RIO_INVALID_BUFFERID) HeapFree( GetProcessHeap(), 0, id );
+}
+
+/***********************************************************************
+ *     RIOCreateCompletionQueue
+ */
+static RIO_CQ WINAPI WS2_RIOCreateCompletionQueue( DWORD size, PRIO_NOTIFICATION_COMPLETION notify )
+{
+    struct rio_cq *cq;
+
+    TRACE( "(%u, %p)\n", size, notify );
+
+    if (!size || size > RIO_MAX_CQ_SIZE ||
+        (notify && notify->Type != RIO_EVENT_COMPLETION && notify->Type != RIO_IOCP_COMPLETION))
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_CQ;
+    }
+    if (!(cq = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cq) )) ||
+        !(cq->results = HeapAlloc( GetProcessHeap(), 0, size * sizeof(*cq->results) )))
+    {
+        HeapFree( GetProcessHeap(), 0, cq );
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_CQ;
+    }
+    cq->wake_fd[0] = cq->wake_fd[1] = -1;
+    if (notify)
+    {
+        if (pipe( cq->wake_fd ) == -1)
+        {
+            HeapFree( GetProcessHeap(), 0, cq->results );
+            HeapFree( GetProcessHeap(), 0, cq );
+            SetLastError( WSAENOBUFS );
+            return RIO_INVALID_CQ;
+        }
+        fcntl( cq->wake_fd[0], F_SETFL, O_NONBLOCK );
+        fcntl( cq->wake_fd[1], F_SETFL, O_NONBLOCK );
+        cq->notify = *notify;
+        cq->has_notify = TRUE;
+    }
+    cq->size = size;
+    list_init( &cq->queues );
+    InitializeCriticalSection( &cq->cs );
+    cq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": rio_cq.cs");
+    return (RIO_CQ)cq;
+}
+
+/***********************************************************************
+ *     RIOCloseCompletionQueue
+ */
+static void WINAPI WS2_RIOCloseCompletionQueue( RIO_CQ handle )
+{
+    struct rio_cq *cq = get_rio_cq( handle );
+    struct rio_queue *queue, *next;
+
+    TRACE( "(%p)\n", handle );
+
+    if (!cq) return;
+
+    if (cq->thread)
+    {
+        cq->closing = TRUE;
+        rio_wake( cq );
+        WaitForSingleObject( cq->thread, INFINITE );
+        CloseHandle( cq->thread );
+    }
+
+    AcquireSRWLockExclusive( &rio_lock );
+    LIST_FOR_EACH_ENTRY_SAFE( queue, next, &cq->queues, struct rio_queue, entry )
+    {
+        list_remove( &queue->entry );
+        queue->cq = NULL;
+    }
+    ReleaseSRWLockExclusive( &rio_lock );
+
+    if (cq->wake_fd[0] != -1) close( cq->wake_fd[0] );
+    if (cq->wake_fd[1] != -1) close( cq->wake_fd[1] );
+    cq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &cq->cs );
+    HeapFree( GetProcessHeap(), 0, cq->results );
+    HeapFree( GetProcessHeap(), 0, cq );
+}
+
+/***********************************************************************
+ *     RIOResizeCompletionQueue
+ */
+static BOOL WINAPI WS2_RIOResizeCompletionQueue( RIO_CQ handle, DWORD size )
+{
+    struct rio_cq *cq = get_rio_cq( handle );
+    RIORESULT *results;
+    DWORD i, err = 0;
+
+    TRACE( "(%p, %u)\n", handle, size );
+
+    if (!cq || !size || size > RIO_MAX_CQ_SIZE)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    EnterCriticalSection( &cq->cs );
+    if (size < cq->count)
+        err = WSAEINVAL;
+    else if (!(results = HeapAlloc( GetProcessHeap(), 0, size * sizeof(*results) )))
+        err = WSAENOBUFS;
+    else
+    {
+        for (i = 0; i < cq->count; i++)
+            results[i] = cq->results[(cq->head + i) % cq->size];
+        HeapFree( GetProcessHeap(), 0, cq->results );
+        cq->results = results;
+        cq->size = size;
+        cq->head = 0;
+    }
+    LeaveCriticalSection( &cq->cs );
+
+    if (err) SetLastError( err );
+    return !err;
+}
+
+/***********************************************************************
+ *     RIOCreateRequestQueue
+ */
+static RIO_RQ WINAPI WS2_RIOCreateRequestQueue( SOCKET s, ULONG max_recv, ULONG max_recv_buffers,
+                                                ULONG max_send, ULONG max_send_buffers,
+                                                RIO_CQ recv_cq, RIO_CQ send_cq, void *context )
+{
+    struct rio_rq *rq;
+    int fd, type = 0;
+    socklen_t len = sizeof(type);
+
+    TRACE( "(%04lx, %u, %u, %u, %u, %p, %p, %p)\n", s, max_recv, max_recv_buffers, max_send,
+           max_send_buffers, recv_cq, send_cq, context );
+
+    if (!recv_cq || !send_cq || max_recv_buffers > 1 || max_send_buffers > 1 || (!max_recv && !max_send))
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_RQ;
+    }
+    if ((fd = get_sock_fd( s, 0, NULL )) == -1) return RIO_INVALID_RQ;
+    getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &len );
+    release_sock_fd( s, fd );
+
+    if (!(rq = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*rq) )) ||
+        !rio_resize_queue( &rq->recv, max_recv ) || !rio_resize_queue( &rq->send, max_send ))
+    {
+        if (rq)
+        {
+            HeapFree( GetProcessHeap(), 0, rq->recv.requests );
+            HeapFree( GetProcessHeap(), 0, rq );
+        }
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_RQ;
+    }
+    rq->socket    = s;
+    rq->context   = (ULONG_PTR)context;
+    rq->stream    = (type == SOCK_STREAM);
+    rq->recv.rq   = rq;
+    rq->recv.cq   = get_rio_cq( recv_cq );
+    rq->send.rq   = rq;
+    rq->send.cq   = get_rio_cq( send_cq );
+    rq->send.send = TRUE;
+    InitializeCriticalSection( &rq->cs );
+    rq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": rio_rq.cs");
+
+    AcquireSRWLockExclusive( &rio_lock );
+    list_add_tail( &rio_rqs, &rq->entry );
+    list_add_tail( &rq->recv.cq->queues, &rq->recv.entry );
+    list_add_tail( &rq->send.cq->queues, &rq->send.entry );
+    ReleaseSRWLockExclusive( &rio_lock );
+    return (RIO_RQ)rq;
+}
+
+/***********************************************************************
+ *     RIOResizeRequestQueue
+ */
+static BOOL WINAPI WS2_RIOResizeRequestQueue( RIO_RQ handle, DWORD max_recv, DWORD max_send )
+{
+    struct rio_rq *rq = get_rio_rq( handle );
+    BOOL ret;
+
+    TRACE( "(%p, %u, %u)\n", handle, max_recv, max_send );
+
+    if (!rq || (!max_recv && !max_send))
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    AcquireSRWLockShared( &rio_lock );
+    EnterCriticalSection( &rq->cs );
+    ret = max_recv >= rq->recv.count && max_send >= rq->send.count &&
+          rio_resize_queue( &rq->recv, max_recv ) && rio_resize_queue( &rq->send, max_send );
+    LeaveCriticalSection( &rq->cs );
+    ReleaseSRWLockShared( &rio_lock );
+
+    if (!ret) SetLastError( WSAEINVAL );
+    return ret;
+}
+
+/***********************************************************************
+ *     RIOReceive
+ */
+static BOOL WINAPI WS2_RIOReceive( RIO_RQ rq, PRIO_BUF data, ULONG count, DWORD flags, void *context )
+{
+    TRACE( "(%p, %p, %u, %#x, %p)\n", rq, data, count, flags, context );
+
+    return rio_post( rq, FALSE, data, count, NULL, flags, context );
+}
+
+/***********************************************************************
+ *     RIOReceiveEx
+ */
+static int WINAPI WS2_RIOReceiveEx( RIO_RQ rq, PRIO_BUF data, ULONG count, PRIO_BUF local_addr,
+                                    PRIO_BUF remote_addr, PRIO_BUF control, PRIO_BUF flags_buf,
+                                    DWORD flags, void *context )
+{
+    TRACE( "(%p, %p, %u, %p, %p, %p, %p, %#x, %p)\n", rq, data, count, local_addr, remote_addr,
+           control, flags_buf, flags, context );
+
+    if (local_addr || control || flags_buf)
+        FIXME( "local address, control and flags buffers not supported\n" );
+
+    return rio_post( rq, FALSE, data, count, remote_addr, flags, context );
+}
+
+/***********************************************************************
+ *     RIOSend
+ */
+static BOOL WINAPI WS2_RIOSend( RIO_RQ rq, PRIO_BUF data, ULONG count, DWORD flags, void *context )
+{
+    TRACE( "(%p, %p, %u, %#x, %p)\n", rq, data, count, flags, context );
+
+    return rio_post( rq, TRUE, data, count, NULL, flags, context );
+}
+
+/***********************************************************************
+ *     RIOSendEx
+ */
+static BOOL WINAPI WS2_RIOSendEx( RIO_RQ rq, PRIO_BUF data, ULONG count, PRIO_BUF local_addr,
+                                  PRIO_BUF remote_addr, PRIO_BUF control, PRIO_BUF flags_buf,
+                                  DWORD flags, void *context )
+{
+    TRACE( "(%p, %p, %u, %p, %p, %p, %p, %#x, %p)\n", rq, data, count, local_addr, remote_addr,
+           control, flags_buf, flags, context );
+
+    if (local_addr || control || flags_buf)
+        FIXME( "local address, control and flags buffers not supported\n" );
+
+    return rio_post( rq, TRUE, data, count, remote_addr, flags, context );
+}
+
+/***********************************************************************
+ *     RIODequeueCompletion
+ */
+static ULONG WINAPI WS2_RIODequeueCompletion( RIO_CQ handle, PRIORESULT results, ULONG size )
+{
+    struct rio_cq *cq = get_rio_cq( handle );
+    ULONG i, count;
+
+    TRACE( "(%p, %p, %u)\n", handle, results, size );
+
+    if (!cq || !results)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_CORRUPT_CQ;
+    }
+
+    if (cq->count < size) rio_process_cq( cq );
+
+    EnterCriticalSection( &cq->cs );
+    count = min( size, cq->count );
+    for (i = 0; i < count; i++)
+        results[i] = cq->results[(cq->head + i) % cq->size];
+    cq->head = (cq->head + count) % cq->size;
+    cq->count -= count;
+    LeaveCriticalSection( &cq->cs );
+    return count;
+}
+
+/***********************************************************************
+ *     RIONotify
+ */
+static INT WINAPI WS2_RIONotify( RIO_CQ handle )
+{
+    struct rio_cq *cq = get_rio_cq( handle );
+    INT ret = ERROR_SUCCESS;
+
+    TRACE( "(%p)\n", handle );
+
+    if (!cq || !cq->has_notify) return WSAEINVAL;
+
+    EnterCriticalSection( &cq->cs );
+    if (cq->notify_armed)
+        ret = WSAEALREADY;
+    else
+    {
+        if (cq->notify.Type == RIO_EVENT_COMPLETION && cq->notify.u.Event.NotifyReset)
+            ResetEvent( cq->notify.u.Event.EventHandle );
+        if (cq->count)
+            rio_signal( cq );
+        else
+        {
+            cq->notify_armed = TRUE;
+            if (!cq->thread && !(cq->thread = CreateThread( NULL, 0, rio_notify_thread, cq, 0, NULL )))
+            {
+                cq->notify_armed = FALSE;
+                ret = WSAENOBUFS;
+            }
+            else rio_wake( cq );
+        }
+    }
+    LeaveCriticalSection( &cq->cs );
+    return ret;
+}
+
+/***********************************************************************
+ *     GetAcceptExSockaddrs
  */
 static void WINAPI WS2_GetAcceptExSockaddrs(PVOID buffer, DWORD data_size, DWORD local_size, DWORD remote_size,
                                      struct WS_sockaddr **local_addr, LPINT local_addr_len,
@@ -3384,6 +4575,7 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+            rio_close_socket(s);
             if (CloseHandle(SOCKET2HANDLE(s)))
                 res = 0;
         }
@@ -3578,6 +4770,7 @@ static BOOL WINAPI WS2_ConnectEx(SOCKET s, const struct WS_sockaddr* name, int n
             wsa->control     = NULL;
             wsa->n_iovecs    = sendBuf ? 1 : 0;
             wsa->first_iovec = 0;
+            wsa->batch_type  = 0;
             wsa->completion_func = NULL;
             wsa->iovec[0].iov_base = sendBuf;
             wsa->iovec[0].iov_len  = sendBufLen;
@@ -3591,7 +4784,7 @@ static BOOL WINAPI WS2_ConnectEx(SOCKET s, const struct WS_sockaddr* name, int n
             {
                 ov->Internal = _get_sock_error(s, FD_CONNECT_BIT);
                 ov->InternalHigh = 0;
-                if (cvalue) WS_AddCompletion( s, cvalue, ov->Internal, ov->InternalHigh );
+                if (cvalue) WS_AddCompletion( s, cvalue, ov->Internal, ov->InternalHigh, TRUE );
                 if (ov->hEvent) NtSetEvent( ov->hEvent, NULL );
                 status = STATUS_PENDING;
             }
@@ -4476,6 +5669,7 @@ static const char *debugstr_wsaioctl(DWORD code)
         IOCTL_NAME(WS_SIO_GET_EXTENSION_FUNCTION_POINTER);
         IOCTL_NAME(WS_SIO_GET_GROUP_QOS);
         IOCTL_NAME(WS_SIO_GET_INTERFACE_LIST);
+        IOCTL_NAME(WS_SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER);
         /* IOCTL_NAME(WS_SIO_GET_INTERFACE_LIST_EX); */
         IOCTL_NAME(WS_SIO_GET_QOS);
         /* IOCTL_NAME(WS_SIO_IDEAL_SEND_BACKLOG_CHANGE);
@@ -4894,7 +6088,7 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
             EXTENSION_FUNCTION(WSAID_ACCEPTEX, WS2_AcceptEx)
             EXTENSION_FUNCTION(WSAID_GETACCEPTEXSOCKADDRS, WS2_GetAcceptExSockaddrs)
             EXTENSION_FUNCTION(WSAID_TRANSMITFILE, WS2_TransmitFile)
-            /* EXTENSION_FUNCTION(WSAID_TRANSMITPACKETS, WS2_TransmitPackets) */
+            EXTENSION_FUNCTION(WSAID_TRANSMITPACKETS, WS2_TransmitPackets)
             EXTENSION_FUNCTION(WSAID_WSARECVMSG, WS2_WSARecvMsg)
             EXTENSION_FUNCTION(WSAID_WSASENDMSG, WSASendMsg)
         };
@@ -4923,6 +6117,44 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         status = WSAEOPNOTSUPP;
         break;
     }
+    case WS_SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER:
+    {
+        static const GUID rio_guid = WSAID_MULTIPLE_RIO;
+        static const RIO_EXTENSION_FUNCTION_TABLE rio_funcs =
+        {
+            sizeof(RIO_EXTENSION_FUNCTION_TABLE),
+            WS2_RIOReceive,
+            WS2_RIOReceiveEx,
+            WS2_RIOSend,
+            WS2_RIOSendEx,
+            WS2_RIOCloseCompletionQueue,
+            WS2_RIOCreateCompletionQueue,
+            WS2_RIOCreateRequestQueue,
+            WS2_RIODequeueCompletion,
+            WS2_RIODeregisterBuffer,
+            WS2_RIONotify,
+            WS2_RIORegisterBuffer,
+            WS2_RIOResizeCompletionQueue,
+            WS2_RIOResizeRequestQueue
+        };
+
+        if (!in_buff || in_size < sizeof(GUID) || !IsEqualGUID(&rio_guid, in_buff))
+        {
+            FIXME("SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER %s: stub\n",
+                  in_buff ? debugstr_guid(in_buff) : "(null)");
+            status = WSAEOPNOTSUPP;
+            break;
+        }
+        if (!out_buff || out_size < sizeof(rio_funcs))
+        {
+            status = WSAEFAULT;
+            break;
+        }
+        TRACE("-> got RIO function table\n");
+        memcpy(out_buff, &rio_funcs, sizeof(rio_funcs));
+        total = sizeof(rio_funcs);
+        break;
+    }
     case WS_SIO_KEEPALIVE_VALS:
     {
         struct tcp_keepalive *k;
@@ -5070,7 +6302,7 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         overlapped->Internal = status;
         overlapped->InternalHigh = total;
         if (overlapped->hEvent) NtSetEvent( overlapped->hEvent, NULL );
-        if (cvalue) WS_AddCompletion( HANDLE2SOCKET(s), cvalue, status, total );
+        if (cvalue) WS_AddCompletion( HANDLE2SOCKET(s), cvalue, status, total, FALSE );
     }
 
     if (!status)
@@ -5463,9 +6695,10 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
     return ret;
 }
 
-/* helper to send completion messages for client-only i/o operation case */
+/* helper to send completion messages for client-only i/o operation case;
+ * async is FALSE if the caller is being told the result synchronously */
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus,
-                              ULONG Information )
+                              ULONG Information, BOOL async )
 {
     SERVER_START_REQ( add_fd_completion )
     {
@@ -5473,6 +6706,7 @@ static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS C
         req->cvalue      = CompletionValue;
         req->status      = CompletionStatus;
         req->information = Information;
+        req->async       = async;
         wine_server_call( req );
     }
     SERVER_END_REQ;
@@ -5567,6 +6801,7 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     wsa->control     = NULL;
     wsa->n_iovecs    = dwBufferCount;
     wsa->first_iovec = 0;
+    wsa->batch_type  = 0;
     for ( i = 0; i < dwBufferCount; i++ )
     {
         wsa->iovec[i].iov_base = lpBuffers[i].buf;
@@ -5586,6 +6821,7 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     {
         IO_STATUS_BLOCK *iosb = lpOverlapped ? (IO_STATUS_BLOCK *)lpOverlapped : &wsa->local_iosb;
         ULONG_PTR cvalue = (lpOverlapped && ((ULONG_PTR)lpOverlapped->hEvent & 1) == 0) ? (ULONG_PTR)lpOverlapped : 0;
+        BOOL batch = (n == -1 && batch_allowed( fd, wsa ));
 
         wsa->user_overlapped = lpOverlapped;
         wsa->completion_func = lpCompletionRoutine;
@@ -5596,12 +6832,14 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->u.Status = STATUS_PENDING;
             iosb->Information = n == -1 ? 0 : n;
 
+            if (batch) batch_add( wsa, ASYNC_TYPE_WRITE );
             if (wsa->completion_func)
                 err = register_async( ASYNC_TYPE_WRITE, wsa->hSocket, &wsa->io, NULL,
                                       ws2_async_apc, wsa, iosb );
             else
                 err = register_async( ASYNC_TYPE_WRITE, wsa->hSocket, &wsa->io, lpOverlapped->hEvent,
                                       NULL, (void *)cvalue, iosb );
+            if (batch) batch_registered( wsa, err );
 
             /* Enable the event only after starting the async. The server will deliver it as soon as
                the async is done. */
@@ -5617,7 +6855,7 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
         if (lpNumberOfBytesSent) *lpNumberOfBytesSent = n;
         if (!wsa->completion_func)
         {
-            if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n );
+            if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, FALSE );
             if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
             HeapFree( GetProcessHeap(), 0, wsa );
         }
@@ -7884,6 +9122,7 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     wsa->control     = lpControlBuffer;
     wsa->n_iovecs    = dwBufferCount;
     wsa->first_iovec = 0;
+    wsa->batch_type  = 0;
     for (i = 0; i < dwBufferCount; i++)
     {
         /* check buffer first to trigger write watches */
@@ -7918,6 +9157,7 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
         if (overlapped)
         {
             IO_STATUS_BLOCK *iosb = lpOverlapped ? (IO_STATUS_BLOCK *)lpOverlapped : &wsa->local_iosb;
+            BOOL batch = (n == -1 && batch_allowed( fd, wsa ));
 
             wsa->user_overlapped = lpOverlapped;
             wsa->completion_func = lpCompletionRoutine;
@@ -7928,12 +9168,14 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                 iosb->u.Status = STATUS_PENDING;
                 iosb->Information = 0;
 
+                if (batch) batch_add( wsa, ASYNC_TYPE_READ );
                 if (wsa->completion_func)
                     err = register_async( ASYNC_TYPE_READ, wsa->hSocket, &wsa->io, NULL,
                                           ws2_async_apc, wsa, iosb );
                 else
                     err = register_async( ASYNC_TYPE_READ, wsa->hSocket, &wsa->io, lpOverlapped->hEvent,
                                           NULL, (void *)cvalue, iosb );
+                if (batch) batch_registered( wsa, err );
 
                 if (err != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
                 SetLastError(NtStatusToWSAError( err ));
@@ -7944,7 +9186,7 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->Information = n;
             if (!wsa->completion_func)
             {
-                if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n );
+                if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, FALSE );
                 if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
                 HeapFree( GetProcessHeap(), 0, wsa );
             }
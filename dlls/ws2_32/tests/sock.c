@@ -89,6 +89,9 @@ static int   (WINAPI *pWSAPoll)(WSAPOLLFD *,ULONG,INT);
 static DWORD (WINAPI *pGetAdaptersInfo)(PIP_ADAPTER_INFO,PULONG);
 static DWORD (WINAPI *pGetIpForwardTable)(PMIB_IPFORWARDTABLE,PULONG,BOOL);
 
+/* Function pointers from kernel32 */
+static BOOL  (WINAPI *pSetFileCompletionNotificationModes)(HANDLE,UCHAR);
+
 /* Function pointers from ntdll */
 static DWORD (WINAPI *pNtClose)(HANDLE);
 
@@ -1308,6 +1311,9 @@ static void Init (void)
         pGetAdaptersInfo = (void *)GetProcAddress(hiphlpapi, "GetAdaptersInfo");
     }
 
+    pSetFileCompletionNotificationModes = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"),
+                                                                 "SetFileCompletionNotificationModes");
+
     ntdll = LoadLibraryA("ntdll.dll");
     if (ntdll)
         pNtClose = (void *)GetProcAddress(ntdll, "NtClose");
@@ -9039,6 +9045,519 @@ cleanup:
     closesocket(server);
 }
 
+struct transmit_recv_info
+{
+    SOCKET sock;
+    char  *data;
+    DWORD  size;
+    DWORD  total;
+};
+
+static DWORD WINAPI transmit_recv_thread(void *arg)
+{
+    struct transmit_recv_info *info = arg;
+    char buf[65536];
+    int n;
+
+    while ((n = recv(info->sock, buf, sizeof(buf), 0)) > 0)
+    {
+        if (info->data && info->total < info->size)
+            memcpy(info->data + info->total, buf, min(n, info->size - info->total));
+        info->total += n;
+    }
+    return 0;
+}
+
+static HANDLE create_transmit_file(char *path, DWORD size)
+{
+    char temp_path[MAX_PATH], buf[4096];
+    HANDLE file;
+    DWORD i, written;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "wst", 0, path);
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (file == INVALID_HANDLE_VALUE) return file;
+
+    for (i = 0; i < size; i += written)
+    {
+        DWORD j;
+
+        for (j = 0; j < sizeof(buf); j++) buf[j] = (i + j) * 7;
+        if (!WriteFile(file, buf, min(sizeof(buf), size - i), &written, NULL) || !written) break;
+    }
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    return file;
+}
+
+static void test_TransmitPackets(void)
+{
+    static const DWORD file_size = 200000, bench_size = 64 << 20;
+    GUID transmitPacketsGuid = WSAID_TRANSMITPACKETS, transmitFileGuid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITPACKETS pTransmitPackets = NULL;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    struct transmit_recv_info info;
+    TRANSMIT_PACKETS_ELEMENT elements[4];
+    char header_msg[] = "hello world", footer_msg[] = "goodbye!!!";
+    char path[MAX_PATH], *expect, *buf;
+    DWORD num_bytes, ticks, i;
+    SOCKET src, dst;
+    HANDLE file, thread;
+    int iret;
+    BOOL bret;
+
+    if (tcp_socketpair(&src, &dst))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+    iret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitPacketsGuid, sizeof(transmitPacketsGuid),
+                    &pTransmitPackets, sizeof(pTransmitPackets), &num_bytes, NULL, NULL);
+    if (!iret)
+        iret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitFileGuid, sizeof(transmitFileGuid),
+                        &pTransmitFile, sizeof(pTransmitFile), &num_bytes, NULL, NULL);
+    if (iret)
+    {
+        skip("WSAIoctl failed to get TransmitPackets with ret %d + errno %d\n", iret, WSAGetLastError());
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+
+    file = create_transmit_file(path, file_size);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError());
+
+    /* memory, part of the file, the whole file, and memory again */
+    elements[0].dwElFlags = TP_ELEMENT_MEMORY;
+    elements[0].cLength = sizeof(header_msg);
+    elements[0].pBuffer = header_msg;
+    elements[1].dwElFlags = TP_ELEMENT_FILE;
+    elements[1].cLength = 5000;
+    elements[1].nFileOffset.QuadPart = 1000;
+    elements[1].hFile = file;
+    elements[2].dwElFlags = TP_ELEMENT_FILE;
+    elements[2].cLength = 0;
+    elements[2].nFileOffset.QuadPart = 0;
+    elements[2].hFile = file;
+    elements[3].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_EOP;
+    elements[3].cLength = sizeof(footer_msg);
+    elements[3].pBuffer = footer_msg;
+
+    num_bytes = sizeof(header_msg) + 5000 + file_size + sizeof(footer_msg);
+    expect = HeapAlloc(GetProcessHeap(), 0, num_bytes);
+    buf = HeapAlloc(GetProcessHeap(), 0, num_bytes);
+    memcpy(expect, header_msg, sizeof(header_msg));
+    for (i = 0; i < 5000; i++) expect[sizeof(header_msg) + i] = (1000 + i) * 7;
+    for (i = 0; i < file_size; i++) expect[sizeof(header_msg) + 5000 + i] = i * 7;
+    memcpy(expect + num_bytes - sizeof(footer_msg), footer_msg, sizeof(footer_msg));
+
+    info.sock = dst;
+    info.data = buf;
+    info.size = num_bytes;
+    info.total = 0;
+    thread = CreateThread(NULL, 0, transmit_recv_thread, &info, 0, NULL);
+    bret = pTransmitPackets(src, elements, 4, 0, NULL, TP_DISCONNECT);
+    ok(bret, "TransmitPackets failed, error %d\n", WSAGetLastError());
+    ok(!WaitForSingleObject(thread, 10000), "receiver thread did not finish\n");
+    CloseHandle(thread);
+    ok(info.total == num_bytes, "received %u bytes, expected %u\n", info.total, num_bytes);
+    ok(!memcmp(buf, expect, num_bytes), "TransmitPackets data did not match\n");
+    HeapFree(GetProcessHeap(), 0, expect);
+    HeapFree(GetProcessHeap(), 0, buf);
+    closesocket(src);
+    closesocket(dst);
+    CloseHandle(file);
+
+    /* loopback throughput of TransmitFile against a plain read and send loop */
+    file = create_transmit_file(path, bench_size);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        skip("failed to create %s, error %u\n", path, GetLastError());
+        return;
+    }
+    buf = HeapAlloc(GetProcessHeap(), 0, 65536);
+
+    for (i = 0; i < 2; i++)
+    {
+        if (tcp_socketpair(&src, &dst))
+        {
+            skip("failed to create sockets\n");
+            break;
+        }
+        SetFilePointer(file, 0, NULL, FILE_BEGIN);
+        info.sock = dst;
+        info.data = NULL;
+        info.total = 0;
+        thread = CreateThread(NULL, 0, transmit_recv_thread, &info, 0, NULL);
+
+        ticks = GetTickCount();
+        if (!i)
+        {
+            bret = pTransmitFile(src, file, 0, 0, NULL, NULL, TF_DISCONNECT);
+            ok(bret, "TransmitFile failed, error %d\n", WSAGetLastError());
+        }
+        else
+        {
+            while (ReadFile(file, buf, 65536, &num_bytes, NULL) && num_bytes)
+                if (send(src, buf, num_bytes, 0) != num_bytes) break;
+            shutdown(src, SD_BOTH);
+        }
+        ok(!WaitForSingleObject(thread, 60000), "receiver thread did not finish\n");
+        ticks = GetTickCount() - ticks;
+        CloseHandle(thread);
+        ok(info.total == bench_size, "received %u bytes, expected %u\n", info.total, bench_size);
+        trace("%s: %u MB in %u ms (%u MB/s)\n", i ? "ReadFile + send" : "TransmitFile",
+              bench_size >> 20, ticks, ticks ? (bench_size >> 20) * 1000 / ticks : 0);
+        closesocket(src);
+        closesocket(dst);
+    }
+
+    HeapFree(GetProcessHeap(), 0, buf);
+    CloseHandle(file);
+}
+
+static SOCKET create_rio_udp_socket(struct sockaddr_in *addr)
+{
+    SOCKET s;
+    int len = sizeof(*addr);
+
+    s = WSASocketW(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+    if (s == INVALID_SOCKET) return s;
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(s, (struct sockaddr *)addr, sizeof(*addr)) || getsockname(s, (struct sockaddr *)addr, &len))
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+static ULONG rio_dequeue_wait(RIO_EXTENSION_FUNCTION_TABLE *rio, RIO_CQ cq, RIORESULT *results, ULONG size)
+{
+    DWORD start = GetTickCount();
+    ULONG count;
+
+    while (!(count = rio->RIODequeueCompletion(cq, results, size)) && GetTickCount() - start < 2000)
+        Sleep(1);
+    return count;
+}
+
+static void test_rio(void)
+{
+    enum { packet_size = 64, window = 256, bench_ms = 1000 };
+    GUID rio_guid = WSAID_MULTIPLE_RIO;
+    RIO_EXTENSION_FUNCTION_TABLE rio;
+    RIO_NOTIFICATION_COMPLETION notify;
+    struct sockaddr_in src_addr, dst_addr;
+    RIO_BUFFERID src_id, dst_id;
+    RIO_CQ src_cq, dst_cq;
+    RIO_RQ src_rq, dst_rq;
+    RIORESULT results[window];
+    RIO_BUF buf;
+    char *src_buf, *dst_buf;
+    ULONG i, count, sent, received, pending;
+    DWORD num_bytes, start, ticks;
+    SOCKET src, dst;
+    HANDLE event;
+    BOOL bret;
+    int iret;
+
+    src = create_rio_udp_socket(&src_addr);
+    dst = create_rio_udp_socket(&dst_addr);
+    if (src == INVALID_SOCKET || dst == INVALID_SOCKET)
+    {
+        skip("failed to create sockets\n");
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+    memset(&rio, 0, sizeof(rio));
+    iret = WSAIoctl(src, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &rio_guid, sizeof(rio_guid),
+                    &rio, sizeof(rio), &num_bytes, NULL, NULL);
+    if (iret)
+    {
+        win_skip("RIO is not supported, error %d\n", WSAGetLastError());
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+    ok(num_bytes == sizeof(rio), "got size %u\n", num_bytes);
+    ok(rio.cbSize == sizeof(rio), "got cbSize %u\n", rio.cbSize);
+
+    iret = connect(src, (struct sockaddr *)&dst_addr, sizeof(dst_addr));
+    ok(!iret, "connect failed, error %d\n", WSAGetLastError());
+    iret = connect(dst, (struct sockaddr *)&src_addr, sizeof(src_addr));
+    ok(!iret, "connect failed, error %d\n", WSAGetLastError());
+
+    src_buf = VirtualAlloc(NULL, window * packet_size, MEM_COMMIT, PAGE_READWRITE);
+    dst_buf = VirtualAlloc(NULL, window * packet_size, MEM_COMMIT, PAGE_READWRITE);
+    src_id = rio.RIORegisterBuffer(src_buf, window * packet_size);
+    ok(src_id != RIO_INVALID_BUFFERID, "RIORegisterBuffer failed, error %d\n", WSAGetLastError());
+    dst_id = rio.RIORegisterBuffer(dst_buf, window * packet_size);
+    ok(dst_id != RIO_INVALID_BUFFERID, "RIORegisterBuffer failed, error %d\n", WSAGetLastError());
+
+    event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    notify.Type = RIO_EVENT_COMPLETION;
+    notify.Event.EventHandle = event;
+    notify.Event.NotifyReset = FALSE;
+    src_cq = rio.RIOCreateCompletionQueue(2 * window, NULL);
+    ok(src_cq != RIO_INVALID_CQ, "RIOCreateCompletionQueue failed, error %d\n", WSAGetLastError());
+    dst_cq = rio.RIOCreateCompletionQueue(2 * window, &notify);
+    ok(dst_cq != RIO_INVALID_CQ, "RIOCreateCompletionQueue failed, error %d\n", WSAGetLastError());
+
+    src_rq = rio.RIOCreateRequestQueue(src, window, 1, window, 1, src_cq, src_cq, (void *)0xdead);
+    ok(src_rq != RIO_INVALID_RQ, "RIOCreateRequestQueue failed, error %d\n", WSAGetLastError());
+    dst_rq = rio.RIOCreateRequestQueue(dst, window, 1, window, 1, dst_cq, dst_cq, (void *)0xbeef);
+    ok(dst_rq != RIO_INVALID_RQ, "RIOCreateRequestQueue failed, error %d\n", WSAGetLastError());
+
+    /* a buffer slice past the end of the registered buffer is rejected */
+    buf.BufferId = src_id;
+    buf.Offset = window * packet_size - 16;
+    buf.Length = 32;
+    SetLastError(0xdeadbeef);
+    bret = rio.RIOSend(src_rq, &buf, 1, 0, NULL);
+    ok(!bret, "RIOSend succeeded\n");
+    ok(WSAGetLastError() == WSAEINVAL, "got error %d\n", WSAGetLastError());
+
+    /* a single packet, with the completion found by polling */
+    buf.BufferId = dst_id;
+    buf.Offset = 0;
+    buf.Length = packet_size;
+    bret = rio.RIOReceive(dst_rq, &buf, 1, 0, (void *)0x1234);
+    ok(bret, "RIOReceive failed, error %d\n", WSAGetLastError());
+    memset(src_buf, 0x55, packet_size);
+    memcpy(src_buf, "hello", 5);
+    buf.BufferId = src_id;
+    buf.Length = 5;
+    bret = rio.RIOSend(src_rq, &buf, 1, 0, (void *)0x5678);
+    ok(bret, "RIOSend failed, error %d\n", WSAGetLastError());
+
+    count = rio_dequeue_wait(&rio, src_cq, results, window);
+    ok(count == 1, "got %u send completions\n", count);
+    ok(!results[0].Status, "got status %d\n", results[0].Status);
+    ok(results[0].BytesTransferred == 5, "got %u bytes\n", results[0].BytesTransferred);
+    ok(results[0].SocketContext == 0xdead, "got socket context %s\n", wine_dbgstr_longlong(results[0].SocketContext));
+    ok(results[0].RequestContext == 0x5678, "got request context %s\n", wine_dbgstr_longlong(results[0].RequestContext));
+
+    count = rio_dequeue_wait(&rio, dst_cq, results, window);
+    ok(count == 1, "got %u receive completions\n", count);
+    ok(!results[0].Status, "got status %d\n", results[0].Status);
+    ok(results[0].BytesTransferred == 5, "got %u bytes\n", results[0].BytesTransferred);
+    ok(results[0].SocketContext == 0xbeef, "got socket context %s\n", wine_dbgstr_longlong(results[0].SocketContext));
+    ok(results[0].RequestContext == 0x1234, "got request context %s\n", wine_dbgstr_longlong(results[0].RequestContext));
+    ok(!memcmp(dst_buf, "hello", 5), "got data %.5s\n", dst_buf);
+
+    /* event notification */
+    buf.BufferId = dst_id;
+    buf.Length = packet_size;
+    bret = rio.RIOReceive(dst_rq, &buf, 1, 0, NULL);
+    ok(bret, "RIOReceive failed, error %d\n", WSAGetLastError());
+    iret = rio.RIONotify(dst_cq);
+    ok(!iret, "RIONotify failed, error %d\n", iret);
+    iret = rio.RIONotify(dst_cq);
+    ok(iret == WSAEALREADY, "got %d\n", iret);
+    ok(WaitForSingleObject(event, 100) == WAIT_TIMEOUT, "event signaled\n");
+    buf.BufferId = src_id;
+    bret = rio.RIOSend(src_rq, &buf, 1, 0, NULL);
+    ok(bret, "RIOSend failed, error %d\n", WSAGetLastError());
+    ok(!WaitForSingleObject(event, 2000), "event not signaled\n");
+    count = rio.RIODequeueCompletion(dst_cq, results, window);
+    ok(count == 1, "got %u receive completions\n", count);
+    ok(results[0].BytesTransferred == packet_size, "got %u bytes\n", results[0].BytesTransferred);
+    rio_dequeue_wait(&rio, src_cq, results, window);
+
+    /* packets per second, with a window of receives and sends in flight */
+    for (i = 0; i < window; i++)
+    {
+        buf.BufferId = dst_id;
+        buf.Offset = i * packet_size;
+        buf.Length = packet_size;
+        rio.RIOReceive(dst_rq, &buf, 1, i < window - 1 ? RIO_MSG_DEFER : 0, NULL);
+    }
+    sent = received = pending = 0;
+    start = GetTickCount();
+    while ((ticks = GetTickCount() - start) < bench_ms)
+    {
+        for (; pending < window / 2; pending++, sent++)
+        {
+            buf.BufferId = src_id;
+            buf.Offset = (sent % window) * packet_size;
+            buf.Length = packet_size;
+            bret = rio.RIOSend(src_rq, &buf, 1, pending < window / 2 - 1 ? RIO_MSG_DEFER : 0, NULL);
+            if (!bret) break;
+        }
+        pending -= rio.RIODequeueCompletion(src_cq, results, window);
+
+        count = rio.RIODequeueCompletion(dst_cq, results, window);
+        for (i = 0; i < count; i++)
+        {
+            buf.BufferId = dst_id;
+            buf.Offset = ((received + i) % window) * packet_size;
+            buf.Length = packet_size;
+            rio.RIOReceive(dst_rq, &buf, 1, i < count - 1 ? RIO_MSG_DEFER : 0, NULL);
+        }
+        received += count;
+    }
+    ok(received > 0, "no packets received\n");
+    trace("RIO UDP: sent %u, received %u packets of %u bytes in %u ms (%u packets/s)\n",
+          sent, received, packet_size, ticks, ticks ? (ULONG)((ULONGLONG)received * 1000 / ticks) : 0);
+
+    rio.RIOCloseCompletionQueue(src_cq);
+    rio.RIOCloseCompletionQueue(dst_cq);
+    rio.RIODeregisterBuffer(src_id);
+    rio.RIODeregisterBuffer(dst_id);
+    closesocket(src);
+    closesocket(dst);
+    VirtualFree(src_buf, 0, MEM_RELEASE);
+    VirtualFree(dst_buf, 0, MEM_RELEASE);
+    CloseHandle(event);
+}
+
+static SOCKET create_overlapped_udp_socket(struct sockaddr_in *addr)
+{
+    SOCKET s;
+    int len = sizeof(*addr);
+
+    s = WSASocketW(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, WSA_FLAG_OVERLAPPED);
+    if (s == INVALID_SOCKET) return s;
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(s, (struct sockaddr *)addr, sizeof(*addr)) || getsockname(s, (struct sockaddr *)addr, &len))
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+static void test_overlapped_udp(void)
+{
+    enum { packet_size = 64, window = 64, bench_ms = 1000 };
+    struct sockaddr_in src_addr, dst_addr, from[window];
+    OVERLAPPED ovl[window], send_ovl[window], *povl;
+    char recv_buf[window][packet_size], send_buf[window][packet_size];
+    int from_len[window], seen[window];
+    DWORD flags[window], size, start, ticks, sent, received;
+    WSABUF wsabuf;
+    ULONG_PTR key;
+    HANDLE port;
+    SOCKET src, dst;
+    int i, iret;
+    BOOL bret;
+
+    src = create_overlapped_udp_socket(&src_addr);
+    dst = create_overlapped_udp_socket(&dst_addr);
+    if (src == INVALID_SOCKET || dst == INVALID_SOCKET)
+    {
+        skip("failed to create sockets\n");
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+    iret = connect(src, (struct sockaddr *)&dst_addr, sizeof(dst_addr));
+    ok(!iret, "connect failed, error %d\n", WSAGetLastError());
+    port = CreateIoCompletionPort((HANDLE)dst, NULL, 1, 0);
+    ok(port != NULL, "failed to create completion port %u\n", GetLastError());
+    port = CreateIoCompletionPort((HANDLE)src, port, 2, 0);
+    ok(port != NULL, "failed to associate completion port %u\n", GetLastError());
+
+    /* a window of pending receives, all completed by a burst of datagrams */
+    for (i = 0; i < window; i++)
+    {
+        memset(&ovl[i], 0, sizeof(ovl[i]));
+        wsabuf.buf = recv_buf[i];
+        wsabuf.len = packet_size;
+        flags[i] = 0;
+        from_len[i] = sizeof(from[i]);
+        iret = WSARecvFrom(dst, &wsabuf, 1, NULL, &flags[i], (struct sockaddr *)&from[i], &from_len[i],
+                           &ovl[i], NULL);
+        ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+           "WSARecvFrom returned %d, error %d\n", iret, WSAGetLastError());
+    }
+    for (i = 0; i < window; i++)
+    {
+        memset(send_buf[i], i, packet_size);
+        iret = send(src, send_buf[i], packet_size, 0);
+        ok(iret == packet_size, "send returned %d, error %d\n", iret, WSAGetLastError());
+    }
+    memset(seen, 0, sizeof(seen));
+    for (i = 0; i < window; i++)
+    {
+        povl = NULL;
+        bret = GetQueuedCompletionStatus(port, &size, &key, &povl, 2000);
+        ok(bret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError());
+        if (!bret) break;
+        ok(key == 1, "got key %lx\n", key);
+        ok(size == packet_size, "got size %u\n", size);
+        ok(povl >= ovl && povl < ovl + window, "got overlapped %p\n", povl);
+        if (povl < ovl || povl >= ovl + window) continue;
+        iret = povl - ovl;
+        ok(from_len[iret] == sizeof(src_addr), "got address length %d\n", from_len[iret]);
+        ok(from[iret].sin_port == src_addr.sin_port, "got port %u\n", ntohs(from[iret].sin_port));
+        seen[(unsigned char)recv_buf[iret][0]]++;
+    }
+    for (i = 0; i < window; i++) ok(seen[i] == 1, "datagram %d received %d times\n", i, seen[i]);
+
+    /* overlapped sends, all completed */
+    for (i = 0; i < window; i++)
+    {
+        memset(&send_ovl[i], 0, sizeof(send_ovl[i]));
+        wsabuf.buf = send_buf[i];
+        wsabuf.len = packet_size;
+        iret = WSASend(src, &wsabuf, 1, NULL, 0, &send_ovl[i], NULL);
+        ok(!iret || WSAGetLastError() == ERROR_IO_PENDING, "WSASend failed, error %d\n", WSAGetLastError());
+    }
+    for (i = 0; i < window; i++)
+    {
+        povl = NULL;
+        bret = GetQueuedCompletionStatus(port, &size, &key, &povl, 2000);
+        ok(bret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError());
+        if (!bret) break;
+        ok(key == 2, "got key %lx\n", key);
+        ok(size == packet_size, "got size %u\n", size);
+    }
+
+    /* packets per second, keeping the window of receives pending */
+    for (i = 0; i < window; i++)
+    {
+        memset(&ovl[i], 0, sizeof(ovl[i]));
+        wsabuf.buf = recv_buf[i];
+        wsabuf.len = packet_size;
+        flags[i] = 0;
+        WSARecv(dst, &wsabuf, 1, NULL, &flags[i], &ovl[i], NULL);
+    }
+    sent = received = 0;
+    start = GetTickCount();
+    while ((ticks = GetTickCount() - start) < bench_ms)
+    {
+        for (i = 0; i < window / 2; i++, sent++)
+            if (send(src, send_buf[0], packet_size, 0) != packet_size) break;
+
+        while (GetQueuedCompletionStatus(port, &size, &key, &povl, received < sent ? 10 : 0))
+        {
+            iret = povl - ovl;
+            received++;
+            memset(povl, 0, sizeof(*povl));
+            wsabuf.buf = recv_buf[iret];
+            wsabuf.len = packet_size;
+            flags[iret] = 0;
+            WSARecv(dst, &wsabuf, 1, NULL, &flags[iret], povl, NULL);
+            if (received == sent) break;
+        }
+    }
+    ok(received > 0, "no packets received\n");
+    trace("overlapped UDP: sent %u, received %u packets of %u bytes in %u ms (%u packets/s)\n",
+          sent, received, packet_size, ticks, ticks ? (DWORD)((ULONGLONG)received * 1000 / ticks) : 0);
+
+    closesocket(src);
+    closesocket(dst);
+    CloseHandle(port);
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -11454,6 +11973,80 @@ static void iocp_async_read_thread(SOCKET src, SOCKET dst)
     DestroyWindow(hwnd);
 }
 
+static void iocp_skip_on_success(SOCKET src, SOCKET dst)
+{
+    WSAOVERLAPPED ovl, *ovl_iocp;
+    DWORD flags, bytes, packets;
+    ULONG_PTR key;
+    HANDLE port;
+    WSABUF buf;
+    char data[12];
+    fd_set readfds;
+    struct timeval timeout = {1, 0};
+    BOOL bret;
+    int i, ret;
+
+    if (!pSetFileCompletionNotificationModes)
+    {
+        win_skip("SetFileCompletionNotificationModes is not supported\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort((HANDLE)src, 0, 0x12345678, 0);
+    ok(port != 0, "CreateIoCompletionPort error %u\n", GetLastError());
+
+    bret = pSetFileCompletionNotificationModes((HANDLE)src, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
+    ok(bret, "SetFileCompletionNotificationModes error %u\n", GetLastError());
+
+    /* operations completing synchronously don't queue completion packets */
+    buf.len = sizeof(data);
+    buf.buf = data;
+    for (i = 0; i < 16; i++)
+    {
+        memset(&ovl, 0, sizeof(ovl));
+        ret = WSASend(src, &buf, 1, &bytes, 0, &ovl, NULL);
+        ok(!ret, "WSASend returned %d, error %u\n", ret, WSAGetLastError());
+        ret = recv(dst, data, sizeof(data), 0);
+        ok(ret == sizeof(data), "recv returned %d\n", ret);
+
+        ret = send(dst, "Hello World!", 12, 0);
+        ok(ret == 12, "send returned %d\n", ret);
+        FD_ZERO(&readfds);
+        FD_SET(src, &readfds);
+        ret = select(0, &readfds, NULL, NULL, &timeout);
+        ok(ret == 1, "select returned %d\n", ret);
+        memset(&ovl, 0, sizeof(ovl));
+        flags = 0;
+        ret = WSARecv(src, &buf, 1, &bytes, &flags, &ovl, NULL);
+        ok(!ret, "WSARecv returned %d, error %u\n", ret, WSAGetLastError());
+        ok(bytes == 12, "got bytes %u\n", bytes);
+    }
+
+    packets = 0;
+    while (GetQueuedCompletionStatus(port, &bytes, &key, &ovl_iocp, 100)) packets++;
+    ok(!packets, "got %u completion packets\n", packets);
+
+    /* pending operations still report their completion */
+    memset(&ovl, 0, sizeof(ovl));
+    flags = 0;
+    SetLastError(0xdeadbeef);
+    ret = WSARecv(src, &buf, 1, &bytes, &flags, &ovl, NULL);
+    ok(ret == SOCKET_ERROR, "got %d\n", ret);
+    ok(GetLastError() == ERROR_IO_PENDING, "got %u\n", GetLastError());
+
+    ret = send(dst, "Hello World!", 12, 0);
+    ok(ret == 12, "send returned %d\n", ret);
+
+    ovl_iocp = NULL;
+    bret = GetQueuedCompletionStatus(port, &bytes, &key, &ovl_iocp, 1000);
+    ok(bret, "GetQueuedCompletionStatus error %u\n", GetLastError());
+    ok(key == 0x12345678, "got key %#lx\n", key);
+    ok(ovl_iocp == &ovl, "got ovl %p\n", ovl_iocp);
+    ok(bytes == 12, "got bytes %u\n", bytes);
+
+    CloseHandle(port);
+}
+
 static void test_iocp(void)
 {
     SOCKET src, dst;
@@ -11489,6 +12082,12 @@ static void test_iocp(void)
     ok(!ret, "creating socket pair failed\n");
     iocp_async_read_thread_closesocket(src);
     closesocket(dst);
+
+    ret = tcp_socketpair_ovl(&src, &dst);
+    ok(!ret, "creating socket pair failed\n");
+    iocp_skip_on_success(src, dst);
+    closesocket(src);
+    closesocket(dst);
 }
 
 START_TEST( sock )
@@ -11555,6 +12154,9 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_TransmitPackets();
+    test_rio();
+    test_overlapped_udp();
     test_GetAddrInfoW();
     test_GetAddrInfoExW();
     test_getaddrinfo();
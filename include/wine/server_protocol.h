@@ -259,6 +259,15 @@ typedef struct
 } async_data_t;
 
 
+typedef struct
+{
+    client_ptr_t    user;
+    apc_param_t     total;
+    unsigned int    status;
+    int             __pad;
+} async_result_t;
+
+
 
 struct hardware_msg_data
 {
@@ -1490,6 +1499,8 @@ struct get_handle_fd_reply
     int          cacheable;
     unsigned int access;
     unsigned int options;
+    unsigned int comp_flags;
+    char __pad_28[4];
 };
 enum server_fd_type
 {
@@ -2232,6 +2243,7 @@ struct get_mapping_info_reply
     mem_size_t   size;
     unsigned int flags;
     obj_handle_t shared_file;
+    client_ptr_t reloc_base;
     /* VARARG(image,pe_image_info); */
 };
 
@@ -2508,6 +2520,20 @@ struct write_process_memory_reply
 
 
 
+struct get_process_vm_pid_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_process_vm_pid_reply
+{
+    struct reply_header __header;
+    int          unix_pid;
+    unsigned int access;
+};
+
+
+
 struct create_key_request
 {
     struct request_header __header;
@@ -2686,7 +2712,7 @@ struct save_registry_request
     struct request_header __header;
     obj_handle_t hkey;
     obj_handle_t file;
-    char __pad_20[4];
+    unsigned int format;
 };
 struct save_registry_reply
 {
@@ -3269,6 +3295,22 @@ struct cancel_async_reply
 
 
 
+struct complete_socket_asyncs_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    int          type;
+    /* VARARG(results,async_results); */
+    char __pad_20[4];
+};
+struct complete_socket_asyncs_reply
+{
+    struct reply_header __header;
+    /* VARARG(completed,bytes); */
+};
+
+
+
 struct get_async_result_request
 {
     struct request_header __header;
@@ -5288,6 +5330,30 @@ struct remove_completion_reply
 };
 
 
+struct completion_msg
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    int           __pad;
+};
+
+
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    unsigned int  count;
+    /* VARARG(msgs,completion_msgs); */
+    char __pad_12[4];
+};
+
+
 
 struct query_completion_request
 {
@@ -5325,7 +5391,7 @@ struct add_fd_completion_request
     apc_param_t    cvalue;
     apc_param_t    information;
     unsigned int   status;
-    char __pad_36[4];
+    int            async;
 };
 struct add_fd_completion_reply
 {
@@ -5334,6 +5400,22 @@ struct add_fd_completion_reply
 
 
 
+struct set_fd_completion_mode_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+    unsigned int   flags;
+    char __pad_20[4];
+};
+struct set_fd_completion_mode_reply
+{
+    struct reply_header __header;
+    unsigned int   flags;
+    char __pad_12[4];
+};
+
+
+
 struct set_fd_disp_info_request
 {
     struct request_header __header;
@@ -5595,6 +5677,241 @@ struct terminate_job_reply
 };
 
 
+
+struct fsync_entry
+{
+    int           state;
+    int           param;
+    int           abandoned;
+    int           waiters;
+    int           owner;
+    int           pulse;
+};
+
+
+#define FSYNC_SERVER_WAITING 0x80000000
+
+enum fsync_type
+{
+    FSYNC_NONE,
+    FSYNC_AUTO_EVENT,
+    FSYNC_MANUAL_EVENT,
+    FSYNC_SEMAPHORE,
+    FSYNC_MUTEX,
+    FSYNC_APC
+};
+
+
+struct get_fsync_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fsync_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+struct get_fsync_idx_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fsync_idx_reply
+{
+    struct reply_header __header;
+    int          type;
+    unsigned int idx;
+    unsigned int access;
+    char __pad_20[4];
+};
+
+
+
+struct fsync_wake_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct fsync_wake_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct get_fsync_apc_idx_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fsync_apc_idx_reply
+{
+    struct reply_header __header;
+    unsigned int idx;
+    char __pad_12[4];
+};
+
+
+
+struct fsync_own_mutex_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct fsync_own_mutex_reply
+{
+    struct reply_header __header;
+};
+
+
+
+#define REQUEST_SHM_DATA_SIZE 0x4000
+
+
+#define REQUEST_SHM_FLAG 0x80000000
+
+enum request_shm_state
+{
+    REQUEST_SHM_IDLE,
+    REQUEST_SHM_POSTED,
+    REQUEST_SHM_SLEEPING,
+    REQUEST_SHM_REPLIED
+};
+
+struct request_shm
+{
+    int           state;
+    int           __pad[15];
+    char          reply[64];
+    char          req_data[REQUEST_SHM_DATA_SIZE];
+    char          reply_data[REQUEST_SHM_DATA_SIZE];
+};
+
+
+struct get_request_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_request_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+struct server_profile
+{
+    unsigned __int64 elapsed;
+    unsigned __int64 wait_time;
+    unsigned __int64 dispatch_time;
+    unsigned __int64 timeout_time;
+    unsigned __int64 max_dispatch;
+    unsigned __int64 max_timeout;
+    unsigned int     loops;
+    unsigned int     count;
+};
+
+struct request_profile
+{
+    unsigned int     req;
+    unsigned int     count;
+    unsigned __int64 total_time;
+    unsigned __int64 max_time;
+    unsigned __int64 bytes_in;
+    unsigned __int64 bytes_out;
+    char             name[32];
+};
+
+#define PROFILE_ENABLE   0x01
+#define PROFILE_DISABLE  0x02
+#define PROFILE_RESET    0x04
+
+
+struct get_server_profile_request
+{
+    struct request_header __header;
+    unsigned int flags;
+};
+struct get_server_profile_reply
+{
+    struct reply_header __header;
+    int          enabled;
+    data_size_t  total;
+    /* VARARG(profile,server_profile); */
+};
+
+
+
+struct registry_shm
+{
+    unsigned int generation;
+};
+
+
+struct get_registry_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_registry_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+struct get_image_reloc_fd_request
+{
+    struct request_header __header;
+    obj_handle_t mapping;
+    client_ptr_t base;
+};
+struct get_image_reloc_fd_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct get_prefetch_list_request
+{
+    struct request_header __header;
+    /* VARARG(exe,unicode_str); */
+    char __pad_12[4];
+};
+struct get_prefetch_list_reply
+{
+    struct reply_header __header;
+    data_size_t  total;
+    /* VARARG(files,bytes); */
+    char __pad_12[4];
+};
+
+
+
+struct set_prefetch_list_request
+{
+    struct request_header __header;
+    data_size_t  exe_len;
+    /* VARARG(exe,unicode_str,exe_len); */
+    /* VARARG(files,bytes); */
+};
+struct set_prefetch_list_reply
+{
+    struct reply_header __header;
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -5699,6 +6016,7 @@ enum request
     REQ_set_debugger_kill_on_exit,
     REQ_read_process_memory,
     REQ_write_process_memory,
+    REQ_get_process_vm_pid,
     REQ_create_key,
     REQ_open_key,
     REQ_delete_key,
@@ -5746,6 +6064,7 @@ enum request
     REQ_set_serial_info,
     REQ_register_async,
     REQ_cancel_async,
+    REQ_complete_socket_asyncs,
     REQ_get_async_result,
     REQ_read,
     REQ_write,
@@ -5865,9 +6184,11 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_set_fd_completion_mode,
     REQ_set_fd_disp_info,
     REQ_set_fd_name_info,
     REQ_get_window_layered_info,
@@ -5885,6 +6206,17 @@ enum request
     REQ_set_job_limits,
     REQ_set_job_completion_port,
     REQ_terminate_job,
+    REQ_get_fsync_shm,
+    REQ_get_fsync_idx,
+    REQ_fsync_wake,
+    REQ_get_fsync_apc_idx,
+    REQ_fsync_own_mutex,
+    REQ_get_request_shm,
+    REQ_get_server_profile,
+    REQ_get_registry_shm,
+    REQ_get_image_reloc_fd,
+    REQ_get_prefetch_list,
+    REQ_set_prefetch_list,
     REQ_NB_REQUESTS
 };
 
@@ -5994,6 +6326,7 @@ union generic_request
     struct set_debugger_kill_on_exit_request set_debugger_kill_on_exit_request;
     struct read_process_memory_request read_process_memory_request;
     struct write_process_memory_request write_process_memory_request;
+    struct get_process_vm_pid_request get_process_vm_pid_request;
     struct create_key_request create_key_request;
     struct open_key_request open_key_request;
     struct delete_key_request delete_key_request;
@@ -6041,6 +6374,7 @@ union generic_request
     struct set_serial_info_request set_serial_info_request;
     struct register_async_request register_async_request;
     struct cancel_async_request cancel_async_request;
+    struct complete_socket_asyncs_request complete_socket_asyncs_request;
     struct get_async_result_request get_async_result_request;
     struct read_request read_request;
     struct write_request write_request;
@@ -6160,9 +6494,11 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct set_fd_completion_mode_request set_fd_completion_mode_request;
     struct set_fd_disp_info_request set_fd_disp_info_request;
     struct set_fd_name_info_request set_fd_name_info_request;
     struct get_window_layered_info_request get_window_layered_info_request;
@@ -6180,6 +6516,17 @@ union generic_request
     struct set_job_limits_request set_job_limits_request;
     struct set_job_completion_port_request set_job_completion_port_request;
     struct terminate_job_request terminate_job_request;
+    struct get_fsync_shm_request get_fsync_shm_request;
+    struct get_fsync_idx_request get_fsync_idx_request;
+    struct fsync_wake_request fsync_wake_request;
+    struct get_fsync_apc_idx_request get_fsync_apc_idx_request;
+    struct fsync_own_mutex_request fsync_own_mutex_request;
+    struct get_request_shm_request get_request_shm_request;
+    struct get_server_profile_request get_server_profile_request;
+    struct get_registry_shm_request get_registry_shm_request;
+    struct get_image_reloc_fd_request get_image_reloc_fd_request;
+    struct get_prefetch_list_request get_prefetch_list_request;
+    struct set_prefetch_list_request set_prefetch_list_request;
 };
 union generic_reply
 {
@@ -6287,6 +6634,7 @@ union generic_reply
     struct set_debugger_kill_on_exit_reply set_debugger_kill_on_exit_reply;
     struct read_process_memory_reply read_process_memory_reply;
     struct write_process_memory_reply write_process_memory_reply;
+    struct get_process_vm_pid_reply get_process_vm_pid_reply;
     struct create_key_reply create_key_reply;
     struct open_key_reply open_key_reply;
     struct delete_key_reply delete_key_reply;
@@ -6334,6 +6682,7 @@ union generic_reply
     struct set_serial_info_reply set_serial_info_reply;
     struct register_async_reply register_async_reply;
     struct cancel_async_reply cancel_async_reply;
+    struct complete_socket_asyncs_reply complete_socket_asyncs_reply;
     struct get_async_result_reply get_async_result_reply;
     struct read_reply read_reply;
     struct write_reply write_reply;
@@ -6453,9 +6802,11 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
     struct set_fd_disp_info_reply set_fd_disp_info_reply;
     struct set_fd_name_info_reply set_fd_name_info_reply;
     struct get_window_layered_info_reply get_window_layered_info_reply;
@@ -6473,8 +6824,19 @@ union generic_reply
     struct set_job_limits_reply set_job_limits_reply;
     struct set_job_completion_port_reply set_job_completion_port_reply;
     struct terminate_job_reply terminate_job_reply;
-};
-
-#define SERVER_PROTOCOL_VERSION 544
+    struct get_fsync_shm_reply get_fsync_shm_reply;
+    struct get_fsync_idx_reply get_fsync_idx_reply;
+    struct fsync_wake_reply fsync_wake_reply;
+    struct get_fsync_apc_idx_reply get_fsync_apc_idx_reply;
+    struct fsync_own_mutex_reply fsync_own_mutex_reply;
+    struct get_request_shm_reply get_request_shm_reply;
+    struct get_server_profile_reply get_server_profile_reply;
+    struct get_registry_shm_reply get_registry_shm_reply;
+    struct get_image_reloc_fd_reply get_image_reloc_fd_reply;
+    struct get_prefetch_list_reply get_prefetch_list_reply;
+    struct set_prefetch_list_reply set_prefetch_list_reply;
+};
+
+#define SERVER_PROTOCOL_VERSION 559
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
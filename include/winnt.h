@@ -5356,6 +5356,11 @@ typedef struct _TAPE_GET_MEDIA_PARAMETERS {
 #define REG_NO_LAZY_FLUSH       0x00000004
 #define REG_FORCE_RESTORE       0x00000008
 
+/* for RegSaveKeyEx flags */
+#define REG_STANDARD_FORMAT     0x00000001
+#define REG_LATEST_FORMAT       0x00000002
+#define REG_NO_COMPRESSION      0x00000004
+
 #define KEY_READ	      ((STANDARD_RIGHTS_READ|  \
 				KEY_QUERY_VALUE|  \
 				KEY_ENUMERATE_SUB_KEYS|  \
@@ -0,0 +1,165 @@
+/*
+ * Dump the wineserver request profile
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/server.h"
+
+static const char progname[] = "wineserverprof";
+
+static void usage(void)
+{
+    printf( "Usage: %s [options]\n"
+            "Dump the request statistics collected by the wineserver.\n"
+            "\n"
+            "  -e, --enable   start collecting data (also resets it)\n"
+            "  -d, --disable  stop collecting data\n"
+            "  -r, --reset    clear the data after dumping it\n"
+            "  -q, --quiet    don't dump the data\n"
+            "  -h, --help     output this help message and exit\n"
+            "\n"
+            "Profiling can also be enabled at server startup by setting\n"
+            "WINESERVERPROFILE=1 in the environment.\n", progname );
+}
+
+static double ms( unsigned __int64 ns )
+{
+    return (double)(LONGLONG)ns / 1000000.0;
+}
+
+static double us( unsigned __int64 ns )
+{
+    return (double)(LONGLONG)ns / 1000.0;
+}
+
+static int compare_entries( const void *a, const void *b )
+{
+    const struct request_profile *e1 = a, *e2 = b;
+
+    if (e1->total_time > e2->total_time) return -1;
+    if (e1->total_time < e2->total_time) return 1;
+    return e2->count - e1->count;
+}
+
+static void dump_profile( const struct server_profile *profile, data_size_t size )
+{
+    struct request_profile *entries = (struct request_profile *)(profile + 1);
+    unsigned __int64 total = 0;
+    unsigned int i, count;
+
+    count = min( profile->count, (size - sizeof(*profile)) / sizeof(*entries) );
+    for (i = 0; i < count; i++) total += entries[i].total_time;
+    qsort( entries, count, sizeof(*entries), compare_entries );
+
+    printf( "elapsed   %12.3f ms\n", ms( profile->elapsed ));
+    printf( "wait      %12.3f ms\n", ms( profile->wait_time ));
+    printf( "dispatch  %12.3f ms  (max %.1f us)\n", ms( profile->dispatch_time ), us( profile->max_dispatch ));
+    printf( "timeouts  %12.3f ms  (max %.1f us)\n", ms( profile->timeout_time ), us( profile->max_timeout ));
+    printf( "requests  %12.3f ms\n", ms( total ));
+    printf( "loops     %12u\n\n", profile->loops );
+
+    printf( "%-32s %10s %12s %6s %10s %10s %12s %12s\n",
+            "request", "count", "total ms", "%", "avg us", "max us", "bytes in", "bytes out" );
+    for (i = 0; i < count; i++)
+    {
+        const struct request_profile *entry = &entries[i];
+
+        printf( "%-32.31s %10u %12.3f %6.2f %10.2f %10.1f %12.0f %12.0f\n",
+                entry->name, entry->count, ms( entry->total_time ),
+                total ? 100.0 * (double)(LONGLONG)entry->total_time / (double)(LONGLONG)total : 0.0,
+                entry->count ? us( entry->total_time ) / entry->count : 0.0,
+                us( entry->max_time ),
+                (double)(LONGLONG)entry->bytes_in, (double)(LONGLONG)entry->bytes_out );
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    struct server_profile *profile = NULL;
+    data_size_t size = 64 * 1024, total = 0;
+    unsigned int flags = 0;
+    int quiet = 0, enabled = 0, i;
+    NTSTATUS status;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp( argv[i], "-e" ) || !strcmp( argv[i], "--enable" )) flags |= PROFILE_ENABLE;
+        else if (!strcmp( argv[i], "-d" ) || !strcmp( argv[i], "--disable" )) flags |= PROFILE_DISABLE;
+        else if (!strcmp( argv[i], "-r" ) || !strcmp( argv[i], "--reset" )) flags |= PROFILE_RESET;
+        else if (!strcmp( argv[i], "-q" ) || !strcmp( argv[i], "--quiet" )) quiet = 1;
+        else if (!strcmp( argv[i], "-h" ) || !strcmp( argv[i], "--help" ))
+        {
+            usage();
+            return 0;
+        }
+        else
+        {
+            fprintf( stderr, "%s: unknown option '%s'\n", progname, argv[i] );
+            usage();
+            return 1;
+        }
+    }
+
+    for (;;)
+    {
+        if (!(profile = HeapAlloc( GetProcessHeap(), 0, size ))) return 1;
+
+        SERVER_START_REQ( get_server_profile )
+        {
+            /* a reset only applies if the data has been retrieved */
+            req->flags = flags;
+            if (!quiet) wine_server_set_reply( req, profile, size );
+            status = wine_server_call( req );
+            enabled = reply->enabled;
+            total = reply->total;
+            size = wine_server_reply_size( reply );
+        }
+        SERVER_END_REQ;
+
+        if (status != STATUS_BUFFER_TOO_SMALL) break;
+        HeapFree( GetProcessHeap(), 0, profile );
+        size = total;
+    }
+
+    if (status)
+    {
+        fprintf( stderr, "%s: failed to retrieve the server profile: %08x\n", progname, status );
+        HeapFree( GetProcessHeap(), 0, profile );
+        return 1;
+    }
+
+    if (!quiet)
+    {
+        if (size >= sizeof(*profile)) dump_profile( profile, size );
+        else if (!enabled) printf( "Profiling is disabled, use --enable to start it.\n" );
+    }
+    HeapFree( GetProcessHeap(), 0, profile );
+    return 0;
+}
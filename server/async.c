@@ -53,6 +53,7 @@ struct async
     int                  direct_result;   /* a flag if we're passing result directly from request instead of APC  */
     struct completion   *completion;      /* completion associated with fd */
     apc_param_t          comp_key;        /* completion key associated with fd */
+    unsigned int         comp_flags;      /* completion notification flags of the fd */
 };
 
 static void async_dump( struct object *obj, int verbose );
@@ -237,6 +238,7 @@ struct async *create_async( struct fd *fd, struct thread *thread, const async_da
     async->wait_handle   = 0;
     async->direct_result = 0;
     async->completion    = fd_get_completion( fd, &async->comp_key );
+    async->comp_flags    = fd_get_comp_flags( fd );
 
     if (iosb) async->iosb = (struct iosb *)grab_object( iosb );
     else async->iosb = NULL;
@@ -375,11 +377,17 @@ void async_set_result( struct object *obj, unsigned int status, apc_param_t tota
             data.user.args[2] = 0;
             thread_queue_apc( NULL, async->thread, NULL, &data );
         }
-        else if (async->data.apc_context)
+        else if (async->data.apc_context &&
+                 !(async->direct_result && skip_sync_completion( async->comp_flags, status )))
             add_async_completion( async, async->data.apc_context, status, total );
 
-        if (async->event) set_event( async->event );
-        else if (async->fd) set_fd_signaled( async->fd, 1 );
+        if (async->event)
+        {
+            if (!async->direct_result || !(async->comp_flags & FILE_SKIP_SET_USER_EVENT_ON_FAST_IO))
+                set_event( async->event );
+        }
+        else if (async->fd && !(async->comp_flags & FILE_SKIP_SET_EVENT_ON_HANDLE))
+            set_fd_signaled( async->fd, 1 );
         if (!async->signaled)
         {
             async->signaled = 1;
@@ -438,6 +446,30 @@ void async_wake_up( struct async_queue *queue, unsigned int status )
     }
 }
 
+/* complete a pending async of a queue whose I/O has already been carried out by the client */
+int async_complete_queued( struct async_queue *queue, struct process *process, client_ptr_t user,
+                           unsigned int status, apc_param_t total )
+{
+    struct async *async;
+
+    assert( status != STATUS_PENDING );
+
+    LIST_FOR_EACH_ENTRY( async, &queue->queue, struct async, queue_entry )
+    {
+        if (async->data.user != user || async->thread->process != process) continue;
+        /* if it has already been woken up the client gets the result through the APC */
+        if (async->status != STATUS_PENDING) return 0;
+
+        async->status = status;
+        if (async->iosb && async->iosb->status == STATUS_PENDING) async->iosb->status = status;
+        async_set_result( &async->obj, status, total );
+        async_reselect( async );
+        release_object( async );  /* so that it gets destroyed when the async is done */
+        return 1;
+    }
+    return 0;
+}
+
 static void iosb_dump( struct object *obj, int verbose );
 static void iosb_destroy( struct object *obj );
 
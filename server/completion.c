@@ -240,6 +240,40 @@ DECL_HANDLER(remove_completion)
     release_object( completion );
 }
 
+/* get multiple completions from completion port */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_msg *out;
+    struct list *entry;
+    struct comp_msg *msg;
+    data_size_t count;
+
+    if (!completion) return;
+
+    count = min( get_reply_max_size() / sizeof(*out), completion->depth );
+    if (!count)
+        set_error( list_empty( &completion->queue ) ? STATUS_PENDING : STATUS_BUFFER_TOO_SMALL );
+    else if ((out = set_reply_data_size( count * sizeof(*out) )))
+    {
+        for (reply->count = 0; reply->count < count; reply->count++, out++)
+        {
+            entry = list_head( &completion->queue );
+            list_remove( entry );
+            completion->depth--;
+            msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
+            out->ckey        = msg->ckey;
+            out->cvalue      = msg->cvalue;
+            out->information = msg->information;
+            out->status      = msg->status;
+            out->__pad       = 0;
+            free( msg );
+        }
+    }
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
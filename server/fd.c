@@ -194,6 +194,7 @@ struct fd
     struct async_queue   wait_q;      /* other async waiters of this fd */
     struct completion   *completion;  /* completion object attached to this fd */
     apc_param_t          comp_key;    /* completion key to set in completion events */
+    unsigned int         comp_flags;  /* completion notification flags (FILE_SKIP_*) */
 };
 
 static void fd_dump( struct object *obj, int verbose );
@@ -358,13 +359,22 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    unsigned int          index;      /* index in the timeouts heap, or EXPIRED_TIMEOUT */
+    unsigned int          seq;        /* insertion sequence number */
+    struct list           entry;      /* entry in the expired list, once expired */
     timeout_t             when;       /* timeout expiry (absolute time) */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+#define EXPIRED_TIMEOUT (~0u)
+
+/* binary min-heap of the pending timeouts, ordered by expiry time */
+static struct timeout_user **timeout_heap;
+static unsigned int timeout_count;
+static unsigned int timeout_heap_size;
+static unsigned int timeout_seq;
+static struct list expired_list = LIST_INIT(expired_list);   /* expired timeouts not yet called */
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -375,32 +385,97 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+/* check if a timeout expires before another one; for the same expiry time, the most
+ * recently added timeout comes first, as it did in the old sorted list */
+static inline int timeout_before( const struct timeout_user *a, const struct timeout_user *b )
+{
+    if (a->when != b->when) return a->when < b->when;
+    return (int)(a->seq - b->seq) > 0;
+}
+
+static inline void set_heap_timeout( unsigned int index, struct timeout_user *user )
+{
+    timeout_heap[index] = user;
+    user->index = index;
+}
+
+/* move a timeout up the heap to its place */
+static void timeout_heap_up( struct timeout_user *user, unsigned int index )
+{
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (!timeout_before( user, timeout_heap[parent] )) break;
+        set_heap_timeout( index, timeout_heap[parent] );
+        index = parent;
+    }
+    set_heap_timeout( index, user );
+}
+
+/* move a timeout down the heap to its place */
+static void timeout_heap_down( struct timeout_user *user, unsigned int index )
+{
+    unsigned int child;
+
+    while ((child = 2 * index + 1) < timeout_count)
+    {
+        if (child + 1 < timeout_count && timeout_before( timeout_heap[child + 1], timeout_heap[child] ))
+            child++;
+        if (!timeout_before( timeout_heap[child], user )) break;
+        set_heap_timeout( index, timeout_heap[child] );
+        index = child;
+    }
+    set_heap_timeout( index, user );
+}
+
+/* remove a timeout from the heap */
+static void timeout_heap_remove( struct timeout_user *user )
+{
+    unsigned int index = user->index;
+    struct timeout_user *last = timeout_heap[--timeout_count];
+
+    user->index = EXPIRED_TIMEOUT;
+    if (last == user) return;
+    if (index && timeout_before( last, timeout_heap[(index - 1) / 2] )) timeout_heap_up( last, index );
+    else timeout_heap_down( last, index );
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+
+    if (timeout_count == timeout_heap_size)
+    {
+        unsigned int new_size = max( 64, timeout_heap_size * 2 );
+        struct timeout_user **new_heap = realloc( timeout_heap, new_size * sizeof(*new_heap) );
+
+        if (!new_heap)
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        timeout_heap = new_heap;
+        timeout_heap_size = new_size;
+    }
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
+    user->seq      = timeout_seq++;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
+    /* Now insert it in the heap */
 
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    timeout_heap_up( user, timeout_count++ );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index == EXPIRED_TIMEOUT) list_remove( &user->entry );
+    else timeout_heap_remove( user );
     free( user );
 }
 
@@ -519,6 +594,7 @@ static inline void remove_epoll_user( struct fd *fd, int user )
 static inline void main_loop_epoll(void)
 {
     int i, ret, timeout;
+    unsigned __int64 start;
     struct epoll_event events[128];
 
     assert( POLLIN == EPOLLIN );
@@ -530,13 +606,18 @@ static inline void main_loop_epoll(void)
 
     while (active_users)
     {
+        start = profile_start();
         timeout = get_next_timeout();
+        start = profile_loop( PROFILE_LOOP_TIMEOUT, start );
 
         if (!active_users) break;  /* last user removed by a timeout */
         if (epoll_fd == -1) break;  /* an error occurred with epoll */
 
+        unlock_server();  /* let the workers run while we wait */
         ret = epoll_wait( epoll_fd, events, sizeof(events)/sizeof(events[0]), timeout );
+        lock_server();
         set_current_time();
+        start = profile_loop( PROFILE_LOOP_WAIT, start );
 
         /* put the events into the pollfd array first, like poll does */
         for (i = 0; i < ret; i++)
@@ -551,6 +632,7 @@ static inline void main_loop_epoll(void)
             int user = events[i].data.u32;
             if (pollfd[user].revents) fd_poll_event( poll_users[user], pollfd[user].revents );
         }
+        profile_loop( PROFILE_LOOP_DISPATCH, start );
     }
 }
 
@@ -629,17 +711,21 @@ static inline void remove_epoll_user( struct fd *fd, int user )
 static inline void main_loop_epoll(void)
 {
     int i, ret, timeout;
+    unsigned __int64 start;
     struct kevent events[128];
 
     if (kqueue_fd == -1) return;
 
     while (active_users)
     {
+        start = profile_start();
         timeout = get_next_timeout();
+        start = profile_loop( PROFILE_LOOP_TIMEOUT, start );
 
         if (!active_users) break;  /* last user removed by a timeout */
         if (kqueue_fd == -1) break;  /* an error occurred with kqueue */
 
+        unlock_server();  /* let the workers run while we wait */
         if (timeout != -1)
         {
             struct timespec ts;
@@ -649,8 +735,10 @@ static inline void main_loop_epoll(void)
             ret = kevent( kqueue_fd, NULL, 0, events, sizeof(events)/sizeof(events[0]), &ts );
         }
         else ret = kevent( kqueue_fd, NULL, 0, events, sizeof(events)/sizeof(events[0]), NULL );
+        lock_server();
 
         set_current_time();
+        start = profile_loop( PROFILE_LOOP_WAIT, start );
 
         /* put the events into the pollfd array first, like poll does */
         for (i = 0; i < ret; i++)
@@ -674,6 +762,7 @@ static inline void main_loop_epoll(void)
             if (pollfd[user].revents) fd_poll_event( poll_users[user], pollfd[user].revents );
             pollfd[user].revents = 0;
         }
+        profile_loop( PROFILE_LOOP_DISPATCH, start );
     }
 }
 
@@ -744,6 +833,7 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (port_fd == -1) break;  /* an error occurred with event completion */
 
+        unlock_server();  /* let the workers run while we wait */
         if (timeout != -1)
         {
             struct timespec ts;
@@ -753,6 +843,7 @@ static inline void main_loop_epoll(void)
             ret = port_getn( port_fd, events, sizeof(events)/sizeof(events[0]), &nget, &ts );
         }
         else ret = port_getn( port_fd, events, sizeof(events)/sizeof(events[0]), &nget, NULL );
+        lock_server();
 
 	if (ret == -1) break;  /* an error occurred with event completion */
 
@@ -846,23 +937,17 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
+    if (timeout_count)
     {
-        struct list expired_list, *ptr;
+        struct list *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heap */
 
-        list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
+        while (timeout_count && timeout_heap[0]->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            struct timeout_user *timeout = timeout_heap[0];
+            timeout_heap_remove( timeout );
+            list_add_tail( &expired_list, &timeout->entry );
         }
 
         /* now call the callback for all the removed timers */
@@ -875,9 +960,9 @@ static int get_next_timeout(void)
             free( timeout );
         }
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
+        if (timeout_count)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = timeout_heap[0];
             int diff = (timeout->when - current_time + 9999) / 10000;
             if (diff < 0) diff = 0;
             return diff;
@@ -890,6 +975,7 @@ static int get_next_timeout(void)
 void main_loop(void)
 {
     int i, ret, timeout;
+    unsigned __int64 start;
 
     set_current_time();
     server_start_time = current_time;
@@ -899,12 +985,17 @@ void main_loop(void)
 
     while (active_users)
     {
+        start = profile_start();
         timeout = get_next_timeout();
+        start = profile_loop( PROFILE_LOOP_TIMEOUT, start );
 
         if (!active_users) break;  /* last user removed by a timeout */
 
+        unlock_server();  /* let the workers run while we wait */
         ret = poll( pollfd, nb_users, timeout );
+        lock_server();
         set_current_time();
+        start = profile_loop( PROFILE_LOOP_WAIT, start );
 
         if (ret > 0)
         {
@@ -917,6 +1008,7 @@ void main_loop(void)
                 }
             }
         }
+        profile_loop( PROFILE_LOOP_DISPATCH, start );
     }
 }
 
@@ -1604,6 +1696,7 @@ static struct fd *alloc_fd_object(void)
     fd->fs_locks   = 1;
     fd->poll_index = -1;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     init_async_queue( &fd->read_q );
     init_async_queue( &fd->write_q );
     init_async_queue( &fd->wait_q );
@@ -1639,6 +1732,7 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     fd->fs_locks   = 0;
     fd->poll_index = -1;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     fd->no_fd_status = STATUS_BAD_DEVICE_TYPE;
     init_async_queue( &fd->read_q );
     init_async_queue( &fd->write_q );
@@ -2362,6 +2456,17 @@ struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key )
     return fd->completion ? (struct completion *)grab_object( fd->completion ) : NULL;
 }
 
+unsigned int fd_get_comp_flags( struct fd *fd )
+{
+    return fd->comp_flags;
+}
+
+/* check if a synchronously completed operation must not queue a completion packet */
+int skip_sync_completion( unsigned int comp_flags, unsigned int status )
+{
+    return (comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) && (status >> 30) != 3;  /* !NT_ERROR */
+}
+
 void fd_copy_completion( struct fd *src, struct fd *dst )
 {
     assert( !dst->completion );
@@ -2448,6 +2553,7 @@ DECL_HANDLER(get_handle_fd)
         {
             reply->type = fd->fd_ops->get_fd_type( fd );
             reply->options = fd->options;
+            reply->comp_flags = fd->comp_flags;
             reply->access = get_handle_access( current->process, req->handle );
             send_client_fd( current->process, unix_fd, req->handle );
         }
@@ -2561,12 +2667,32 @@ DECL_HANDLER(add_fd_completion)
     struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
     if (fd)
     {
-        if (fd->completion)
+        if (fd->completion && (req->async || !skip_sync_completion( fd->comp_flags, req->status )))
             add_completion( fd->completion, fd->comp_key, req->cvalue, req->status, req->information );
         release_object( fd );
     }
 }
 
+/* set fd completion notification mode */
+DECL_HANDLER(set_fd_completion_mode)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        if (req->flags & ~(FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE |
+                           FILE_SKIP_SET_USER_EVENT_ON_FAST_IO))
+            set_error( STATUS_INVALID_PARAMETER );
+        else if (req->flags && (fd->options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT)))
+            set_error( STATUS_INVALID_PARAMETER );
+        else
+        {
+            fd->comp_flags |= req->flags;  /* flags can't be cleared once set */
+            reply->flags = fd->comp_flags;
+        }
+        release_object( fd );
+    }
+}
+
 /* set fd disposition information */
 DECL_HANDLER(set_fd_disp_info)
 {
@@ -153,6 +153,7 @@ extern struct file *get_mapping_file( struct process *process, client_ptr_t base
                                       unsigned int access, unsigned int sharing );
 extern void free_mapped_views( struct process *process );
 extern int get_page_size(void);
+extern int create_temp_file( file_pos_t size );
 
 /* device functions */
 
@@ -190,7 +191,11 @@ extern void async_set_result( struct object *obj, unsigned int status, apc_param
 extern int async_waiting( struct async_queue *queue );
 extern void async_terminate( struct async *async, unsigned int status );
 extern void async_wake_up( struct async_queue *queue, unsigned int status );
+extern int async_complete_queued( struct async_queue *queue, struct process *process, client_ptr_t user,
+                                  unsigned int status, apc_param_t total );
 extern struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key );
+extern unsigned int fd_get_comp_flags( struct fd *fd );
+extern int skip_sync_completion( unsigned int comp_flags, unsigned int status );
 extern void fd_copy_completion( struct fd *src, struct fd *dst );
 extern struct iosb *create_iosb( const void *in_data, data_size_t in_size, data_size_t out_size );
 extern struct iosb *async_get_iosb( struct async *async );
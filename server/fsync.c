@@ -0,0 +1,278 @@
+/*
+ * Server-side in-process synchronization support
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Events, semaphores and mutexes keep their state in a shared memory
+ * area mapped by every client, so that uncontended operations and waits
+ * can be performed client-side with atomic operations and futexes.
+ * The server remains the owner of the objects: it allocates the entries,
+ * updates them when it changes the state itself, and still handles all
+ * waits that involve other object types, as well as waits for all objects.
+ * While an object has server-side waiters, FSYNC_SERVER_WAITING is set in
+ * its state: clients then leave its acquisition to the server, so that the
+ * server can check and satisfy a wait atomically, and they know that they
+ * need to wake up the server after changing the state.
+ * An event pulse resets the state before client-side waiters get to run,
+ * so the server also bumps a pulse generation that they check on wakeup.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "request.h"
+#include "fsync.h"
+
+#define FSYNC_SHM_ENTRIES  65536
+#define FSYNC_SHM_SIZE     (FSYNC_SHM_ENTRIES * sizeof(struct fsync_entry))
+
+static struct fsync_entry *shm_entries;
+static int shm_fd = -1;
+static unsigned int *free_next;          /* free list links, server-side only */
+static unsigned int free_head;           /* head of the free list */
+static unsigned int first_unused = 1;    /* entry 0 is never allocated */
+
+#ifdef __linux__
+
+static inline int futex_wake( int *addr, int count )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+}
+
+static int futexes_supported(void)
+{
+    int dummy = 0;
+
+    /* a wait on a mismatching value fails immediately with EAGAIN if futexes are available */
+    return syscall( __NR_futex, &dummy, 0 /* FUTEX_WAIT */, 1, NULL, 0, 0 ) != -1 || errno != ENOSYS;
+}
+
+#else
+
+static inline int futex_wake( int *addr, int count )
+{
+    return 0;
+}
+
+static int futexes_supported(void)
+{
+    return 0;
+}
+
+#endif
+
+/* check if in-process synchronization is enabled, and initialize it if needed */
+int do_fsync(void)
+{
+    static int enabled = -1;
+    const char *env;
+    void *ptr;
+
+    if (enabled != -1) return enabled;
+
+    enabled = 0;
+    if (!(env = getenv( "WINEFSYNC" )) || !atoi( env )) return 0;
+    if (!futexes_supported())
+    {
+        fprintf( stderr, "wineserver: futexes not supported, in-process synchronization disabled\n" );
+        return 0;
+    }
+    if ((shm_fd = create_temp_file( FSYNC_SHM_SIZE )) == -1) return 0;
+    ptr = mmap( NULL, FSYNC_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0 );
+    if (ptr == MAP_FAILED || !(free_next = calloc( FSYNC_SHM_ENTRIES, sizeof(*free_next) )))
+    {
+        if (ptr != MAP_FAILED) munmap( ptr, FSYNC_SHM_SIZE );
+        close( shm_fd );
+        shm_fd = -1;
+        return 0;
+    }
+    shm_entries = ptr;
+    enabled = 1;
+    return 1;
+}
+
+/* allocate a shared entry; returns 0 if none is available */
+unsigned int fsync_alloc( int state, int param )
+{
+    struct fsync_entry *entry;
+    unsigned int idx;
+
+    if (!do_fsync()) return 0;
+
+    if (free_head)
+    {
+        idx = free_head;
+        free_head = free_next[idx];
+    }
+    else if (first_unused < FSYNC_SHM_ENTRIES) idx = first_unused++;
+    else return 0;
+
+    entry = &shm_entries[idx];
+    entry->param = param;
+    entry->abandoned = 0;
+    entry->waiters = 0;
+    entry->owner = 0;
+    interlocked_xchg( &entry->state, state );
+    return idx;
+}
+
+void fsync_free( unsigned int idx )
+{
+    if (!idx) return;
+    free_next[idx] = free_head;
+    free_head = idx;
+}
+
+struct fsync_entry *fsync_get_entry( unsigned int idx )
+{
+    return &shm_entries[idx];
+}
+
+/* wake up the client-side waiters after a state change; all of them need to
+ * be woken since a waiter may be satisfied by another object of its wait */
+void fsync_wake_futex( unsigned int idx )
+{
+    futex_wake( &shm_entries[idx].state, INT_MAX );
+}
+
+/* record a pulse of an event whose state has already been reset, and wake up
+ * the client-side waiters; the low bit lets a single auto-reset waiter claim it */
+void fsync_pulse( unsigned int idx )
+{
+    struct fsync_entry *entry = &shm_entries[idx];
+    int old = entry->pulse, cur;
+
+    while ((cur = interlocked_cmpxchg( &entry->pulse, (int)(((unsigned int)old | 1) + 2), old )) != old)
+        old = cur;
+    futex_wake( &entry->state, INT_MAX );
+}
+
+/* retrieve the value of the state, without the server waiting flag */
+int fsync_get_state( unsigned int idx )
+{
+    return shm_entries[idx].state & ~FSYNC_SERVER_WAITING;
+}
+
+/* atomically set the value of the state, keeping the server waiting flag; returns the previous value */
+int fsync_set_state( unsigned int idx, int value )
+{
+    struct fsync_entry *entry = &shm_entries[idx];
+    int old = entry->state, cur;
+
+    while ((cur = interlocked_cmpxchg( &entry->state, (old & FSYNC_SERVER_WAITING) | value, old )) != old)
+        old = cur;
+    return old & ~FSYNC_SERVER_WAITING;
+}
+
+static void set_server_waiting( struct fsync_entry *entry, int waiting )
+{
+    int old = entry->state, cur, value;
+
+    for (;;)
+    {
+        value = waiting ? (old | FSYNC_SERVER_WAITING) : (old & ~FSYNC_SERVER_WAITING);
+        if ((cur = interlocked_cmpxchg( &entry->state, value, old )) == old) break;
+        old = cur;
+    }
+}
+
+/* add_queue/remove_queue helpers keeping the count of server-side waiters */
+int fsync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int idx )
+{
+    if (idx && !shm_entries[idx].waiters++) set_server_waiting( &shm_entries[idx], 1 );
+    return add_queue( obj, entry );
+}
+
+void fsync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int idx )
+{
+    remove_queue( obj, entry );
+    if (idx && !--shm_entries[idx].waiters) set_server_waiting( &shm_entries[idx], 0 );
+}
+
+/* retrieve the shared memory */
+DECL_HANDLER(get_fsync_shm)
+{
+    if (!do_fsync())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->size = FSYNC_SHM_SIZE;
+    send_client_fd( current->process, shm_fd, 0 );
+}
+
+/* retrieve the shared entry of an object */
+DECL_HANDLER(get_fsync_idx)
+{
+    struct object *obj;
+    enum fsync_type type = FSYNC_NONE;
+    unsigned int idx = 0;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if (do_fsync())
+    {
+        if (!(type = event_get_fsync_idx( obj, &idx )) &&
+            !(type = semaphore_get_fsync_idx( obj, &idx )))
+            type = mutex_get_fsync_idx( obj, &idx );
+    }
+    if (!idx) type = FSYNC_NONE;
+
+    reply->type   = type;
+    reply->idx    = idx;
+    reply->access = get_handle_access( current->process, req->handle );
+    release_object( obj );
+}
+
+/* wake up the server-side waiters after a client-side state change */
+DECL_HANDLER(fsync_wake)
+{
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+    wake_up( obj, 0 );
+    release_object( obj );
+}
+
+/* retrieve the user APC entry of the current thread */
+DECL_HANDLER(get_fsync_apc_idx)
+{
+    reply->idx = current->fsync_apc_idx;
+}
@@ -0,0 +1,43 @@
+/*
+ * Server-side in-process synchronization support
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_SERVER_FSYNC_H
+#define __WINE_SERVER_FSYNC_H
+
+struct object;
+struct wait_queue_entry;
+
+extern int do_fsync(void);
+extern unsigned int fsync_alloc( int state, int param );
+extern void fsync_free( unsigned int idx );
+extern struct fsync_entry *fsync_get_entry( unsigned int idx );
+extern int fsync_get_state( unsigned int idx );
+extern int fsync_set_state( unsigned int idx, int value );
+extern void fsync_wake_futex( unsigned int idx );
+extern void fsync_pulse( unsigned int idx );
+extern int fsync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int idx );
+extern void fsync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int idx );
+
+/* per-type accessors, implemented along with the objects */
+extern enum fsync_type event_get_fsync_idx( struct object *obj, unsigned int *idx );
+extern enum fsync_type semaphore_get_fsync_idx( struct object *obj, unsigned int *idx );
+extern enum fsync_type mutex_get_fsync_idx( struct object *obj, unsigned int *idx );
+
+#endif  /* __WINE_SERVER_FSYNC_H */
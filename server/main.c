@@ -145,6 +145,8 @@ int main( int argc, char *argv[] )
     init_signals();
     init_directories();
     init_registry();
+    init_profile();
+    init_workers();
     main_loop();
     return 0;
 }
@@ -117,6 +117,47 @@ static const struct object_ops shared_map_ops =
 
 static struct list shared_map_list = LIST_INIT( shared_map_list );
 
+/* relocated copy of a PE image, shared by the processes that map it at the same address */
+struct reloc_map
+{
+    struct object   obj;             /* object header */
+    struct fd      *fd;              /* file descriptor of the mapped PE file */
+    file_pos_t      size;            /* size of the PE file when the copy was made */
+    time_t          mtime;           /* modification time of the PE file when the copy was made */
+    client_ptr_t    base;            /* address of the relocated image */
+    struct file    *file;            /* temp file holding the relocated image */
+    struct list     entry;           /* entry in global reloc maps list */
+};
+
+static void reloc_map_dump( struct object *obj, int verbose );
+static void reloc_map_destroy( struct object *obj );
+
+static const struct object_ops reloc_map_ops =
+{
+    sizeof(struct reloc_map),  /* size */
+    reloc_map_dump,            /* dump */
+    no_get_type,               /* get_type */
+    no_add_queue,              /* add_queue */
+    NULL,                      /* remove_queue */
+    NULL,                      /* signaled */
+    NULL,                      /* satisfied */
+    no_signal,                 /* signal */
+    no_get_fd,                 /* get_fd */
+    no_map_access,             /* map_access */
+    default_get_sd,            /* get_sd */
+    default_set_sd,            /* set_sd */
+    no_lookup_name,            /* lookup_name */
+    no_link_name,              /* link_name */
+    NULL,                      /* unlink_name */
+    no_open_file,              /* open_file */
+    no_close_handle,           /* close_handle */
+    reloc_map_destroy          /* destroy */
+};
+
+static struct list reloc_map_list = LIST_INIT( reloc_map_list );
+
+#define MAX_RELOC_MAP_SIZE (1024 * 1024)  /* max. size of a shared relocated image */
+
 /* memory view mapped in client address space */
 struct memory_view
 {
@@ -124,6 +165,7 @@ struct memory_view
     struct fd      *fd;              /* fd for mapped file */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct reloc_map *reloc;         /* relocated copy of the PE image */
     unsigned int    flags;           /* SEC_* flags */
     client_ptr_t    base;            /* view base address (in process addr space) */
     mem_size_t      size;            /* view size */
@@ -140,6 +182,7 @@ struct mapping
     pe_image_info_t image;           /* image info (for PE image mapping) */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct reloc_map *reloc;         /* last relocated copy of the PE image */
 };
 
 static void mapping_dump( struct object *obj, int verbose );
@@ -217,6 +260,22 @@ static void shared_map_destroy( struct object *obj )
     list_remove( &shared->entry );
 }
 
+static void reloc_map_dump( struct object *obj, int verbose )
+{
+    struct reloc_map *reloc = (struct reloc_map *)obj;
+    fprintf( stderr, "Relocated mapping fd=%p base=%08x%08x file=%p\n",
+             reloc->fd, (unsigned int)(reloc->base >> 32), (unsigned int)reloc->base, reloc->file );
+}
+
+static void reloc_map_destroy( struct object *obj )
+{
+    struct reloc_map *reloc = (struct reloc_map *)obj;
+
+    release_object( reloc->fd );
+    release_object( reloc->file );
+    list_remove( &reloc->entry );
+}
+
 /* extend a file beyond the current end of file */
 static int grow_file( int unix_fd, file_pos_t new_size )
 {
@@ -258,8 +317,8 @@ static int check_current_dir_for_exec(void)
     return (ret != MAP_FAILED);
 }
 
-/* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+/* create a temp file, optionally also opened read-only through a separate file description */
+static int create_temp_file_fds( file_pos_t size, int *read_fd )
 {
     static int temp_dir_fd = -1;
     char tmpfn[] = "anonmap.XXXXXX";
@@ -288,6 +347,12 @@ static int create_temp_file( file_pos_t size )
             close( fd );
             fd = -1;
         }
+        else if (read_fd && (*read_fd = open( tmpfn, O_RDONLY )) == -1)
+        {
+            file_set_error();
+            close( fd );
+            fd = -1;
+        }
         unlink( tmpfn );
     }
     else file_set_error();
@@ -296,6 +361,12 @@ static int create_temp_file( file_pos_t size )
     return fd;
 }
 
+/* create a temp file for anonymous mappings */
+int create_temp_file( file_pos_t size )
+{
+    return create_temp_file_fds( size, NULL );
+}
+
 /* find a memory view from its base address */
 static struct memory_view *find_mapped_view( struct process *process, client_ptr_t base )
 {
@@ -313,6 +384,7 @@ static void free_memory_view( struct memory_view *view )
     if (view->fd) release_object( view->fd );
     if (view->committed) release_object( view->committed );
     if (view->shared) release_object( view->shared );
+    if (view->reloc) release_object( view->reloc );
     list_remove( &view->entry );
     free( view );
 }
@@ -522,6 +594,212 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     return 0;
 }
 
+/* check if a relocated copy was made from the current contents of the mapped file */
+static int is_same_reloc_file( struct reloc_map *reloc, struct mapping *mapping )
+{
+    struct stat st;
+    int unix_fd;
+
+    if (!is_same_file_fd( reloc->fd, mapping->fd )) return 0;
+    /* the file may have been rewritten in place since the copy was made */
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1 || fstat( unix_fd, &st ) == -1)
+    {
+        clear_error();
+        return 0;
+    }
+    return st.st_size == reloc->size && st.st_mtime == reloc->mtime;
+}
+
+/* return the address of an existing relocated copy of the image, to share it if possible */
+static client_ptr_t get_reloc_base( struct mapping *mapping )
+{
+    struct reloc_map *reloc;
+
+    LIST_FOR_EACH_ENTRY( reloc, &reloc_map_list, struct reloc_map, entry )
+        if (is_same_reloc_file( reloc, mapping )) return reloc->base;
+    return 0;
+}
+
+static inline void add_reloc_value( char *ptr, size_t size, ULONGLONG delta )
+{
+    ULONGLONG val = 0;
+
+    memcpy( &val, ptr, size );  /* little-endian, possibly unaligned */
+    val += delta;
+    memcpy( ptr, &val, size );
+}
+
+/* apply the base relocations to an image laid out as in memory */
+static int apply_relocations( char *ptr, mem_size_t map_size, const IMAGE_DATA_DIRECTORY *relocs,
+                              ULONGLONG delta )
+{
+    const IMAGE_BASE_RELOCATION *rel;
+    const USHORT *entry;
+    mem_size_t pos, end, addr;
+    unsigned int i, count;
+
+    pos = relocs->VirtualAddress;
+    end = pos + relocs->Size;
+    if (end > map_size) return 0;
+
+    while (pos + sizeof(*rel) <= end)
+    {
+        rel = (const IMAGE_BASE_RELOCATION *)(ptr + pos);
+        if (!rel->SizeOfBlock) break;
+        if (rel->SizeOfBlock < sizeof(*rel) || rel->SizeOfBlock > end - pos) return 0;
+        count = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
+        entry = (const USHORT *)(rel + 1);
+        for (i = 0; i < count; i++)
+        {
+            addr = (mem_size_t)rel->VirtualAddress + (entry[i] & 0xfff);
+            if (addr + sizeof(ULONGLONG) > map_size && (entry[i] >> 12) != IMAGE_REL_BASED_ABSOLUTE)
+                return 0;
+            switch (entry[i] >> 12)
+            {
+            case IMAGE_REL_BASED_ABSOLUTE:
+                break;
+            case IMAGE_REL_BASED_HIGH:
+                add_reloc_value( ptr + addr, sizeof(short), delta >> 16 );
+                break;
+            case IMAGE_REL_BASED_LOW:
+                add_reloc_value( ptr + addr, sizeof(short), delta );
+                break;
+            case IMAGE_REL_BASED_HIGHLOW:
+                add_reloc_value( ptr + addr, sizeof(int), delta );
+                break;
+            case IMAGE_REL_BASED_DIR64:
+                add_reloc_value( ptr + addr, sizeof(ULONGLONG), delta );
+                break;
+            default:  /* leave the others to the client */
+                return 0;
+            }
+        }
+        pos += rel->SizeOfBlock;
+    }
+    return 1;
+}
+
+/* create the relocated copy of an image for a given address; the temp file
+ * is laid out as in memory so that the sections can be mapped directly */
+static struct reloc_map *build_reloc_map( struct mapping *mapping, client_ptr_t base )
+{
+    IMAGE_DOS_HEADER dos;
+    IMAGE_SECTION_HEADER *sec = NULL;
+    IMAGE_DATA_DIRECTORY relocs;
+    struct
+    {
+        DWORD Signature;
+        IMAGE_FILE_HEADER FileHeader;
+        union
+        {
+            IMAGE_OPTIONAL_HEADER32 hdr32;
+            IMAGE_OPTIONAL_HEADER64 hdr64;
+        } opt;
+    } nt;
+    struct reloc_map *reloc;
+    struct file *file = NULL;
+    struct stat st;
+    mem_size_t map_size = mapping->image.map_size;
+    size_t sec_map_size, file_size;
+    off_t pos, file_start;
+    char *ptr = MAP_FAILED;
+    unsigned int i, align, nb_dirs;
+    int unix_fd, reloc_fd = -1, read_fd;
+
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) return NULL;
+    /* the copy is made synchronously on the main loop, so only small images are handled here
+     * and larger ones are left to the client to relocate */
+    if (map_size > MAX_RELOC_MAP_SIZE) goto not_supported;
+    if (fstat( unix_fd, &st ) == -1) goto io_error;
+
+    if (pread( unix_fd, &dos, sizeof(dos), 0 ) != sizeof(dos)) goto not_supported;
+    memset( &nt, 0, sizeof(nt) );
+    if (pread( unix_fd, &nt, sizeof(nt), dos.e_lfanew ) <
+        (ssize_t)(sizeof(nt.Signature) + sizeof(nt.FileHeader))) goto not_supported;
+    if (nt.FileHeader.SizeOfOptionalHeader < sizeof(nt.opt.hdr32)) goto not_supported;
+    if (nt.FileHeader.Characteristics & IMAGE_FILE_RELOCS_STRIPPED) goto not_supported;
+    if (nt.opt.hdr32.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+    {
+        if (nt.FileHeader.SizeOfOptionalHeader < sizeof(nt.opt.hdr64)) goto not_supported;
+        align   = nt.opt.hdr64.SectionAlignment;
+        nb_dirs = nt.opt.hdr64.NumberOfRvaAndSizes;
+        relocs  = nt.opt.hdr64.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    }
+    else
+    {
+        align   = nt.opt.hdr32.SectionAlignment;
+        nb_dirs = nt.opt.hdr32.NumberOfRvaAndSizes;
+        relocs  = nt.opt.hdr32.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    }
+    /* images without relocations are shared as is, and unaligned ones are never relocated */
+    if (align <= page_mask || nb_dirs <= IMAGE_DIRECTORY_ENTRY_BASERELOC) goto not_supported;
+    if (!relocs.Size || !relocs.VirtualAddress) goto not_supported;
+
+    pos = dos.e_lfanew + sizeof(nt.Signature) + sizeof(nt.FileHeader) + nt.FileHeader.SizeOfOptionalHeader;
+    file_size = nt.FileHeader.NumberOfSections * sizeof(*sec);
+    if (!(sec = mem_alloc( file_size ))) return NULL;
+    if (pread( unix_fd, sec, file_size, pos ) != file_size) goto not_supported;
+
+    /* the shared sections are mapped from their own file */
+    for (i = 0; i < nt.FileHeader.NumberOfSections; i++)
+        if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+            (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) goto not_supported;
+
+    /* clients only get the read-only descriptor, so they can't modify the shared copy */
+    if ((reloc_fd = create_temp_file_fds( map_size, &read_fd )) == -1) goto error;
+    if (!(file = create_file_for_fd( read_fd, FILE_GENERIC_READ, 0 ))) goto error;
+    ptr = mmap( NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, reloc_fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        file_set_error();
+        goto error;
+    }
+
+    if (pread( unix_fd, ptr, min( mapping->image.header_size, map_size ), 0 ) == -1) goto io_error;
+    for (i = 0; i < nt.FileHeader.NumberOfSections; i++)
+    {
+        get_section_sizes( &sec[i], &sec_map_size, &file_start, &file_size );
+        if (!sec[i].PointerToRawData || !file_size) continue;
+        if (sec[i].VirtualAddress >= map_size || file_size > map_size - sec[i].VirtualAddress)
+            goto not_supported;
+        if (pread( unix_fd, ptr + sec[i].VirtualAddress, file_size, file_start ) == -1) goto io_error;
+    }
+
+    if (!apply_relocations( ptr, map_size, &relocs, base - mapping->image.base )) goto not_supported;
+
+    /* the image now looks as if it had been linked for that address */
+    if (nt.opt.hdr32.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+        add_reloc_value( ptr + dos.e_lfanew + FIELD_OFFSET( IMAGE_NT_HEADERS64, OptionalHeader.ImageBase ),
+                         sizeof(ULONGLONG), base - mapping->image.base );
+    else
+        add_reloc_value( ptr + dos.e_lfanew + FIELD_OFFSET( IMAGE_NT_HEADERS32, OptionalHeader.ImageBase ),
+                         sizeof(DWORD), base - mapping->image.base );
+
+    if (!(reloc = alloc_object( &reloc_map_ops ))) goto error;
+    reloc->fd    = (struct fd *)grab_object( mapping->fd );
+    reloc->size  = st.st_size;
+    reloc->mtime = st.st_mtime;
+    reloc->base  = base;
+    reloc->file  = file;
+    list_add_head( &reloc_map_list, &reloc->entry );
+    munmap( ptr, map_size );
+    close( reloc_fd );
+    free( sec );
+    return reloc;
+
+ io_error:
+    file_set_error();
+    goto error;
+ not_supported:
+    set_error( STATUS_NOT_SUPPORTED );
+ error:
+    if (ptr != MAP_FAILED) munmap( ptr, map_size );
+    if (reloc_fd != -1) close( reloc_fd );
+    if (file) release_object( file );
+    free( sec );
+    return NULL;
+}
+
 /* retrieve the mapping parameters for an executable (PE) image */
 static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_size, int unix_fd )
 {
@@ -705,6 +983,7 @@ static struct object *create_mapping( struct object *root, const struct unicode_
     mapping->size        = size;
     mapping->fd          = NULL;
     mapping->shared      = NULL;
+    mapping->reloc       = NULL;
     mapping->committed   = NULL;
 
     if (!(mapping->flags = get_mapping_flags( handle, flags ))) goto error;
@@ -835,6 +1114,7 @@ static void mapping_destroy( struct object *obj )
     if (mapping->fd) release_object( mapping->fd );
     if (mapping->committed) release_object( mapping->committed );
     if (mapping->shared) release_object( mapping->shared );
+    if (mapping->reloc) release_object( mapping->reloc );
 }
 
 static enum server_fd_type mapping_get_fd_type( struct fd *fd )
@@ -910,6 +1190,7 @@ DECL_HANDLER(get_mapping_info)
     if (mapping->shared)
         reply->shared_file = alloc_handle( current->process, mapping->shared->file,
                                            GENERIC_READ|GENERIC_WRITE, 0 );
+    if (mapping->flags & SEC_IMAGE) reply->reloc_base = get_reloc_base( mapping );
     release_object( mapping );
 }
 
@@ -961,6 +1242,9 @@ DECL_HANDLER(map_view)
         view->fd        = !is_fd_removable( mapping->fd ) ? (struct fd *)grab_object( mapping->fd ) : NULL;
         view->committed = mapping->committed ? (struct ranges *)grab_object( mapping->committed ) : NULL;
         view->shared    = mapping->shared ? (struct shared_map *)grab_object( mapping->shared ) : NULL;
+        view->reloc     = NULL;
+        if (mapping->reloc && mapping->reloc->base == req->base)
+            view->reloc = (struct reloc_map *)grab_object( mapping->reloc );
         list_add_tail( &current->process->views, &view->entry );
     }
 
@@ -1004,3 +1288,38 @@ DECL_HANDLER(is_same_mapping)
         !is_same_file_fd( view1->fd, view2->fd ))
         set_error( STATUS_NOT_SAME_DEVICE );
 }
+
+/* get the relocated copy of an image mapping for a given address */
+DECL_HANDLER(get_image_reloc_fd)
+{
+    struct mapping *mapping;
+    struct reloc_map *reloc;
+
+    if (!(mapping = get_mapping_obj( current->process, req->mapping, SECTION_MAP_READ ))) return;
+
+    if (!(mapping->flags & SEC_IMAGE) || (req->base & page_mask) || req->base == mapping->image.base)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        release_object( mapping );
+        return;
+    }
+
+    if (mapping->reloc && mapping->reloc->base == req->base)
+        reloc = (struct reloc_map *)grab_object( mapping->reloc );
+    else
+    {
+        LIST_FOR_EACH_ENTRY( reloc, &reloc_map_list, struct reloc_map, entry )
+            if (reloc->base == req->base && is_same_reloc_file( reloc, mapping )) break;
+        if (&reloc->entry != &reloc_map_list) grab_object( reloc );
+        else reloc = build_reloc_map( mapping, req->base );
+    }
+
+    if (reloc)
+    {
+        /* the mapping keeps it alive until the view is added */
+        if (mapping->reloc) release_object( mapping->reloc );
+        mapping->reloc = reloc;
+        send_client_fd( current->process, get_file_unix_fd( reloc->file ), 0 );
+    }
+    release_object( mapping );
+}
@@ -35,6 +35,7 @@
 #include "thread.h"
 #include "request.h"
 #include "security.h"
+#include "fsync.h"
 
 struct mutex
 {
@@ -43,10 +44,13 @@ struct mutex
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
     struct list    entry;           /* entry in owner thread mutex list */
+    unsigned int   fsync_idx;       /* shared entry for in-process synchronization */
 };
 
 static void mutex_dump( struct object *obj, int verbose );
 static struct object_type *mutex_get_type( struct object *obj );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int mutex_map_access( struct object *obj, unsigned int access );
@@ -58,8 +62,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     mutex_dump,                /* dump */
     mutex_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -89,6 +93,53 @@ static void do_grab( struct mutex *mutex, struct thread *thread )
     }
 }
 
+/* put a mutex whose state lives in the shared entry on the list of the thread that owns it,
+ * the owner tid alone doesn't allow finding the mutexes to abandon when a thread dies */
+static void set_fsync_owner( struct mutex *mutex, struct thread *thread )
+{
+    if (mutex->owner == thread) return;
+    if (mutex->owner) list_remove( &mutex->entry );
+    mutex->owner = thread;
+    if (thread) list_add_head( &thread->mutex_list, &mutex->entry );
+    fsync_get_entry( mutex->fsync_idx )->owner = thread ? thread->id : 0;
+}
+
+/* grab a mutex whose state lives in the shared entry */
+static void do_grab_fsync( struct mutex *mutex, struct thread *thread )
+{
+    struct fsync_entry *entry = fsync_get_entry( mutex->fsync_idx );
+
+    if (fsync_get_state( mutex->fsync_idx ) == thread->id) entry->param++;
+    else
+    {
+        /* clients don't acquire it while we have waiters, and it is new otherwise */
+        fsync_set_state( mutex->fsync_idx, thread->id );
+        entry->param = 1;
+    }
+    set_fsync_owner( mutex, thread );
+}
+
+/* release a mutex whose state lives in the shared entry */
+static void do_release_fsync( struct mutex *mutex )
+{
+    fsync_set_state( mutex->fsync_idx, 0 );
+    fsync_wake_futex( mutex->fsync_idx );
+    wake_up( &mutex->obj, 0 );
+}
+
+/* check if a thread owns the mutex, returning the recursion count */
+static unsigned int get_mutex_count( struct mutex *mutex, struct thread *thread )
+{
+    if (mutex->fsync_idx)
+    {
+        int owner = fsync_get_state( mutex->fsync_idx );
+        if (!owner || (thread && owner != thread->id)) return 0;
+        return fsync_get_entry( mutex->fsync_idx )->param;
+    }
+    if (thread && mutex->owner != thread) return 0;
+    return mutex->count;
+}
+
 /* release a mutex once the recursion count is 0 */
 static void do_release( struct mutex *mutex )
 {
@@ -99,6 +150,25 @@ static void do_release( struct mutex *mutex )
     wake_up( &mutex->obj, 0 );
 }
 
+/* release a mutex owned by the current thread */
+static int release_mutex( struct mutex *mutex, unsigned int *prev )
+{
+    unsigned int count = get_mutex_count( mutex, current );
+
+    if (!count)
+    {
+        set_error( STATUS_MUTANT_NOT_OWNED );
+        return 0;
+    }
+    if (prev) *prev = count;
+    if (mutex->fsync_idx)
+    {
+        if (!--fsync_get_entry( mutex->fsync_idx )->param) do_release_fsync( mutex );
+    }
+    else if (!--mutex->count) do_release( mutex );
+    return 1;
+}
+
 static struct mutex *create_mutex( struct object *root, const struct unicode_str *name,
                                    unsigned int attr, int owned, const struct security_descriptor *sd )
 {
@@ -112,7 +182,11 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
-            if (owned) do_grab( mutex, current );
+            if ((mutex->fsync_idx = fsync_alloc( 0, 0 )))
+            {
+                if (owned) do_grab_fsync( mutex, current );
+            }
+            else if (owned) do_grab( mutex, current );
         }
     }
     return mutex;
@@ -120,23 +194,48 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
 
 void abandon_mutexes( struct thread *thread )
 {
+    struct mutex *mutex;
     struct list *ptr;
 
     while ((ptr = list_head( &thread->mutex_list )) != NULL)
     {
-        struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
+        mutex = LIST_ENTRY( ptr, struct mutex, entry );
         assert( mutex->owner == thread );
+        if (mutex->fsync_idx)
+        {
+            struct fsync_entry *entry = fsync_get_entry( mutex->fsync_idx );
+
+            set_fsync_owner( mutex, NULL );
+            if (fsync_get_state( mutex->fsync_idx ) != thread->id) continue;
+            entry->param = 0;
+            entry->abandoned = 1;
+            do_release_fsync( mutex );
+            continue;
+        }
         mutex->count = 0;
         mutex->abandoned = 1;
         do_release( mutex );
     }
 }
 
+enum fsync_type mutex_get_fsync_idx( struct object *obj, unsigned int *idx )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+
+    if (obj->ops != &mutex_ops) return FSYNC_NONE;
+    *idx = mutex->fsync_idx;
+    return FSYNC_MUTEX;
+}
+
 static void mutex_dump( struct object *obj, int verbose )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
+    if (mutex->fsync_idx)
+        fprintf( stderr, "Mutex count=%u owner=%04x\n", get_mutex_count( mutex, NULL ),
+                 fsync_get_state( mutex->fsync_idx ) );
+    else
+        fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
 }
 
 static struct object_type *mutex_get_type( struct object *obj )
@@ -146,10 +245,30 @@ static struct object_type *mutex_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return fsync_add_queue( obj, entry, mutex->fsync_idx );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    fsync_remove_queue( obj, entry, mutex->fsync_idx );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
+
+    if (mutex->fsync_idx)
+    {
+        int owner = fsync_get_state( mutex->fsync_idx );
+        return (!owner || owner == get_wait_queue_thread( entry )->id);
+    }
     return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
 }
 
@@ -158,6 +277,13 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->fsync_idx)
+    {
+        do_grab_fsync( mutex, get_wait_queue_thread( entry ));
+        if (interlocked_xchg( &fsync_get_entry( mutex->fsync_idx )->abandoned, 0 ))
+            make_wait_abandoned( entry );
+        return;
+    }
     do_grab( mutex, get_wait_queue_thread( entry ));
     if (mutex->abandoned) make_wait_abandoned( entry );
     mutex->abandoned = 0;
@@ -182,13 +308,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (!mutex->count || (mutex->owner != current))
-    {
-        set_error( STATUS_MUTANT_NOT_OWNED );
-        return 0;
-    }
-    if (!--mutex->count) do_release( mutex );
-    return 1;
+    return release_mutex( mutex, NULL );
 }
 
 static void mutex_destroy( struct object *obj )
@@ -196,6 +316,12 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->fsync_idx)
+    {
+        set_fsync_owner( mutex, NULL );
+        fsync_free( mutex->fsync_idx );
+        return;
+    }
     if (!mutex->count) return;
     mutex->count = 0;
     do_release( mutex );
@@ -242,12 +368,7 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
-        else
-        {
-            reply->prev_count = mutex->count;
-            if (!--mutex->count) do_release( mutex );
-        }
+        release_mutex( mutex, &reply->prev_count );
         release_object( mutex );
     }
 }
@@ -260,10 +381,33 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
-        reply->count = mutex->count;
-        reply->owned = (mutex->owner == current);
-        reply->abandoned = mutex->abandoned;
+        if (mutex->fsync_idx)
+        {
+            struct fsync_entry *entry = fsync_get_entry( mutex->fsync_idx );
+            reply->count = get_mutex_count( mutex, NULL );
+            reply->owned = (fsync_get_state( mutex->fsync_idx ) == current->id);
+            reply->abandoned = entry->abandoned;
+        }
+        else
+        {
+            reply->count = mutex->count;
+            reply->owned = (mutex->owner == current);
+            reply->abandoned = mutex->abandoned;
+        }
+
+        release_object( mutex );
+    }
+}
 
+/* a thread acquired a mutex client-side, make sure that it gets abandoned if the thread dies */
+DECL_HANDLER(fsync_own_mutex)
+{
+    struct mutex *mutex;
+
+    if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle, 0, &mutex_ops )))
+    {
+        if (mutex->fsync_idx && fsync_get_state( mutex->fsync_idx ) == current->id)
+            set_fsync_owner( mutex, current );
         release_object( mutex );
     }
 }
@@ -411,7 +411,8 @@ struct object *grab_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount < INT_MAX );
-    obj->refcount++;
+    if (worker_threads) interlocked_xchg_add( (int *)&obj->refcount, 1 );
+    else obj->refcount++;
     return obj;
 }
 
@@ -420,7 +421,8 @@ void release_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount );
-    if (!--obj->refcount)
+    /* worker threads only release references they grabbed themselves, so they never destroy objects */
+    if (worker_threads ? interlocked_xchg_add( (int *)&obj->refcount, -1 ) == 1 : !--obj->refcount)
     {
         assert( !obj->handle_count );
         /* if the refcount is 0, nobody can be in the wait queue */
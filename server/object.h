@@ -31,6 +31,14 @@
 
 #define DEBUG_OBJECTS
 
+/* some read-only requests can be handled by worker threads, so the request state is thread-local */
+#if defined(__GNUC__) && defined(HAVE_PTHREAD_H)
+# define USE_WORKER_THREADS
+# define SERVER_THREAD_LOCAL __thread
+#else
+# define SERVER_THREAD_LOCAL
+#endif
+
 /* kernel objects */
 
 struct namespace;
@@ -250,6 +258,9 @@ extern const char *server_argv0;
   /* server start time used for GetTickCount() */
 extern timeout_t server_start_time;
 
+  /* number of request worker threads, 0 if disabled */
+extern int worker_threads;
+
 #define KEYEDEVENT_WAIT       0x0001
 #define KEYEDEVENT_WAKE       0x0002
 #define KEYEDEVENT_ALL_ACCESS (STANDARD_RIGHTS_REQUIRED | 0x0003)
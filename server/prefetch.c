@@ -0,0 +1,138 @@
+/*
+ * Server-side list of the files to prefetch at process startup
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The loader reports the unix files of the modules that a process has
+ * loaded when it exits, and retrieves the list stored for its executable
+ * when it starts, so that it can start reading them before it needs them.
+ * The lists only live as long as the server, and the least recently used
+ * ones are dropped when there are too many of them.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "wine/list.h"
+#include "wine/unicode.h"
+#include "request.h"
+
+#define MAX_PREFETCH_LISTS  64
+#define MAX_PREFETCH_SIZE   65536
+
+struct prefetch_list
+{
+    struct list  entry;       /* entry in the lists, most recently used first */
+    WCHAR       *exe;         /* executable file name */
+    data_size_t  exe_len;     /* length of the name in bytes */
+    char        *files;       /* null-separated unix file names */
+    data_size_t  size;        /* size of the file names */
+};
+
+static struct list prefetch_lists = LIST_INIT( prefetch_lists );
+static unsigned int prefetch_count;
+
+static struct prefetch_list *find_prefetch_list( const WCHAR *exe, data_size_t len )
+{
+    struct prefetch_list *list;
+
+    LIST_FOR_EACH_ENTRY( list, &prefetch_lists, struct prefetch_list, entry )
+    {
+        if (list->exe_len != len || memicmpW( list->exe, exe, len / sizeof(WCHAR) )) continue;
+        list_remove( &list->entry );
+        list_add_head( &prefetch_lists, &list->entry );
+        return list;
+    }
+    return NULL;
+}
+
+static void free_prefetch_list( struct prefetch_list *list )
+{
+    list_remove( &list->entry );
+    prefetch_count--;
+    free( list->exe );
+    free( list->files );
+    free( list );
+}
+
+/* retrieve the files loaded by the previous runs of an executable */
+DECL_HANDLER(get_prefetch_list)
+{
+    struct prefetch_list *list;
+
+    if (!(list = find_prefetch_list( get_req_data(), get_req_data_size() & ~(sizeof(WCHAR) - 1) ))) return;
+
+    reply->total = list->size;
+    if (list->size <= get_reply_max_size()) set_reply_data( list->files, list->size );
+    else set_error( STATUS_BUFFER_OVERFLOW );
+}
+
+/* store the files loaded by an executable */
+DECL_HANDLER(set_prefetch_list)
+{
+    struct prefetch_list *list;
+    const WCHAR *exe = get_req_data();
+    data_size_t exe_len = min( req->exe_len, get_req_data_size() ) & ~(sizeof(WCHAR) - 1);
+    const char *files = (const char *)get_req_data() + exe_len;
+    data_size_t size = get_req_data_size() - exe_len;
+    char *ptr;
+
+    if (!exe_len || !size || size > MAX_PREFETCH_SIZE)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+
+    if ((list = find_prefetch_list( exe, exe_len )))
+    {
+        if (!(ptr = memdup( files, size ))) return;
+        free( list->files );
+        list->files = ptr;
+        list->size = size;
+        return;
+    }
+
+    if (prefetch_count >= MAX_PREFETCH_LISTS)
+        free_prefetch_list( LIST_ENTRY( list_tail( &prefetch_lists ), struct prefetch_list, entry ));
+
+    if (!(list = mem_alloc( sizeof(*list) ))) return;
+    list->exe = memdup( exe, exe_len );
+    list->files = memdup( files, size );
+    if (!list->exe || !list->files)
+    {
+        free( list->exe );
+        free( list->files );
+        free( list );
+        return;
+    }
+    list->exe_len = exe_len;
+    list->size = size;
+    list_add_head( &prefetch_lists, &list->entry );
+    prefetch_count++;
+}
@@ -1482,6 +1482,21 @@ DECL_HANDLER(write_process_memory)
     }
 }
 
+/* retrieve the unix pid of a process to access its memory directly */
+DECL_HANDLER(get_process_vm_pid)
+{
+    struct process *process;
+
+    if (!(process = get_process_from_handle( req->handle, 0 ))) return;
+
+    reply->access = get_handle_access( current->process, req->handle ) & (PROCESS_VM_READ | PROCESS_VM_WRITE);
+    if (!reply->access) set_error( STATUS_ACCESS_DENIED );
+    else if (process->unix_pid == -1 || !process->running_threads || process->is_terminating)
+        set_error( STATUS_PROCESS_IS_TERMINATING );
+    else reply->unix_pid = process->unix_pid;
+    release_object( process );
+}
+
 /* notify the server that a dll has been loaded */
 DECL_HANDLER(load_dll)
 {
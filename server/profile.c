@@ -0,0 +1,209 @@
+/*
+ * Server request profiling
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The profiler is disabled by default, and only costs a test of a global
+ * flag per request in that case. It is enabled either by setting the
+ * WINESERVERPROFILE environment variable when starting the server, or
+ * at run time with the get_server_profile request.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef __APPLE__
+# include <mach/mach_time.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "request.h"
+
+struct request_stats
+{
+    unsigned int     count;
+    unsigned __int64 total_time;
+    unsigned __int64 max_time;
+    unsigned __int64 bytes_in;
+    unsigned __int64 bytes_out;
+};
+
+int profile_enabled = 0;
+
+static struct request_stats request_stats[REQ_NB_REQUESTS];
+#ifdef USE_WORKER_THREADS
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;  /* for requests handled by workers */
+#endif
+static struct server_profile loop_stats;
+static unsigned __int64 profile_start_time;
+
+/* get a monotonic time in nanoseconds */
+unsigned __int64 profile_get_time(void)
+{
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+
+    if (!timebase.denom) mach_timebase_info( &timebase );
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timeval tv;
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    if (!clock_gettime( CLOCK_MONOTONIC, &ts ))
+        return (unsigned __int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    gettimeofday( &tv, NULL );
+    return (unsigned __int64)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
+static void reset_profile(void)
+{
+    memset( request_stats, 0, sizeof(request_stats) );
+    memset( &loop_stats, 0, sizeof(loop_stats) );
+    profile_start_time = profile_get_time();
+}
+
+/* enable profiling at startup if requested by the environment */
+void init_profile(void)
+{
+    const char *env = getenv( "WINESERVERPROFILE" );
+
+    profile_enabled = env && atoi( env );
+    if (profile_enabled) reset_profile();
+}
+
+/* record the statistics of a request handler call */
+void profile_request( enum request req, unsigned __int64 start, data_size_t bytes_in, data_size_t bytes_out )
+{
+    struct request_stats *stats;
+    unsigned __int64 time;
+
+    if (req >= REQ_NB_REQUESTS) return;
+
+    time = profile_get_time() - start;
+#ifdef USE_WORKER_THREADS
+    if (in_worker_thread) pthread_mutex_lock( &stats_mutex );
+#endif
+    stats = &request_stats[req];
+    stats->count++;
+    stats->total_time += time;
+    if (time > stats->max_time) stats->max_time = time;
+    stats->bytes_in += bytes_in + sizeof(union generic_request);
+    stats->bytes_out += bytes_out + sizeof(union generic_reply);
+#ifdef USE_WORKER_THREADS
+    if (in_worker_thread) pthread_mutex_unlock( &stats_mutex );
+#endif
+}
+
+/* record the time spent in a part of the main loop; returns the current time */
+unsigned __int64 profile_loop( enum profile_loop_part part, unsigned __int64 start )
+{
+    unsigned __int64 now, time;
+
+    if (!start) return 0;
+
+    now = profile_get_time();
+    time = now - start;
+    switch (part)
+    {
+    case PROFILE_LOOP_WAIT:
+        loop_stats.wait_time += time;
+        loop_stats.loops++;
+        break;
+    case PROFILE_LOOP_DISPATCH:
+        loop_stats.dispatch_time += time;
+        if (time > loop_stats.max_dispatch) loop_stats.max_dispatch = time;
+        break;
+    case PROFILE_LOOP_TIMEOUT:
+        loop_stats.timeout_time += time;
+        if (time > loop_stats.max_timeout) loop_stats.max_timeout = time;
+        break;
+    }
+    return now;
+}
+
+/* retrieve and control the server profiling data */
+DECL_HANDLER(get_server_profile)
+{
+    struct server_profile *profile;
+    struct request_profile *entry;
+    unsigned int i, count = 0;
+    data_size_t size;
+    const char *name;
+
+    if ((req->flags & PROFILE_ENABLE) && (req->flags & PROFILE_DISABLE))
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++) if (request_stats[i].count) count++;
+    size = sizeof(*profile) + count * sizeof(*entry);
+    reply->total = size;
+
+    if (size <= get_reply_max_size() && (profile = set_reply_data_size( size )))
+    {
+        *profile = loop_stats;
+        profile->elapsed = profile_enabled ? profile_get_time() - profile_start_time : 0;
+        profile->count = count;
+
+        entry = (struct request_profile *)(profile + 1);
+        for (i = 0; i < REQ_NB_REQUESTS; i++)
+        {
+            if (!request_stats[i].count) continue;
+            memset( entry, 0, sizeof(*entry) );
+            entry->req        = i;
+            entry->count      = request_stats[i].count;
+            entry->total_time = request_stats[i].total_time;
+            entry->max_time   = request_stats[i].max_time;
+            entry->bytes_in   = request_stats[i].bytes_in;
+            entry->bytes_out  = request_stats[i].bytes_out;
+            if ((name = get_request_name( i )))
+                memcpy( entry->name, name, min( strlen(name), sizeof(entry->name) - 1 ));
+            entry++;
+        }
+    }
+    else if (get_reply_max_size()) set_error( STATUS_BUFFER_TOO_SMALL );
+
+    if ((req->flags & PROFILE_ENABLE) && !profile_enabled)
+    {
+        profile_enabled = 1;
+        reset_profile();
+    }
+    else if ((req->flags & PROFILE_RESET) && !get_error()) reset_profile();
+    if (req->flags & PROFILE_DISABLE) profile_enabled = 0;
+
+    reply->enabled = profile_enabled;
+}
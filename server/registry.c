@@ -34,7 +34,13 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -78,6 +84,10 @@ struct key
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    struct hive      *hive;        /* hive holding the subkeys and values, until they are loaded */
+    unsigned int      hive_node;   /* offset of the key node in the hive */
+    struct child_index *subkey_index; /* hash index of the subkeys, for wide keys */
+    struct child_index *value_index;  /* hash index of the values, for wide keys */
 };
 
 /* key flags */
@@ -104,6 +114,77 @@ struct key_value
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
+/*
+ * The subkeys and values are normally kept sorted, in enumeration order.
+ * Once a key has MIN_INDEXED_CHILDREN of them, they are looked up through
+ * a case-insensitive hash index instead, and new ones are appended to the
+ * array so that bulk inserts don't have to move the array around; the
+ * enumeration order is then computed when it is first needed.
+ */
+#define MIN_INDEXED_CHILDREN 256
+
+struct child_index
+{
+    unsigned int      size;        /* number of hash buckets, a power of two */
+    unsigned int      count;       /* number of indexed children */
+    int              *buckets;     /* array position + 1 of the children, 0 if free */
+    int              *sorted;      /* array positions in enumeration order, built on demand */
+};
+
+typedef void (*child_name_func)( const struct key *key, int pos, struct unicode_str *name );
+
+/*
+ * The binary hive format stores a registry branch in a single file that is
+ * mapped in memory as is.  The subkeys and values of a key are only turned
+ * into objects the first time they are accessed; until then the key only
+ * points to its node in the hive.  Nodes are written children first, so the
+ * subkey offsets always point backwards, which rules out loops in the tree.
+ */
+
+#define HIVE_MAGIC    "WINEHIVE"
+#define HIVE_VERSION  1
+#define HIVE_ALIGN    8    /* alignment of the key nodes and arrays */
+
+struct hive_header
+{
+    char              magic[8];    /* HIVE_MAGIC */
+    unsigned int      version;     /* HIVE_VERSION */
+    unsigned int      arch;        /* prefix type */
+    unsigned int      root;        /* offset of the root key node */
+    unsigned int      size;        /* total file size */
+};
+
+/* a key node, followed by the key name and class */
+struct hive_key
+{
+    timeout_t         modif;       /* last modification time */
+    unsigned int      flags;       /* KEY_SYMLINK and KEY_WOW64 flags */
+    unsigned short    namelen;     /* length of key name */
+    unsigned short    classlen;    /* length of class name */
+    unsigned int      nb_subkeys;  /* count of subkeys */
+    unsigned int      nb_values;   /* count of values */
+    unsigned int      subkeys;     /* offset of the sorted array of subkey node offsets */
+    unsigned int      values;      /* offset of the sorted array of values */
+};
+
+struct hive_value
+{
+    unsigned int      type;        /* value type */
+    unsigned int      namelen;     /* length of value name */
+    data_size_t       len;         /* value data length in bytes */
+    unsigned int      name;        /* offset of value name */
+    unsigned int      data;        /* offset of value data */
+};
+
+/* a hive file loaded in memory */
+struct hive
+{
+    unsigned int      refcount;    /* count of keys pointing to the hive */
+    const char       *base;        /* file contents */
+    size_t            size;        /* file size */
+    int               mapped;      /* is the file mapped, or copied to a buffer? */
+};
+
 /* the root of the registry tree */
 static struct key *root_key;
 
@@ -111,6 +192,12 @@ static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89)
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
 static struct timeout_user *save_timeout_user;  /* saving timer */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
+static int use_hive_files;  /* save the registry branches as binary hives */
+static struct registry_shm *registry_shm;  /* generation counter for the client-side caches */
+static int registry_shm_fd = -1;
+#ifdef USE_WORKER_THREADS
+static pthread_mutex_t hive_mutex = PTHREAD_MUTEX_INITIALIZER;  /* serializes key loading and sorting in workers */
+#endif
 
 static const WCHAR root_name[] = { '\\','R','e','g','i','s','t','r','y','\\' };
 static const WCHAR wow6432node[] = {'W','o','w','6','4','3','2','N','o','d','e'};
@@ -118,18 +205,86 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static void free_child_index( struct child_index *index );
+static int get_subkey_pos( const struct key *key, int n );
+static int get_value_pos( const struct key *key, int n );
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index );
+static void materialize_key( struct key *key );
+
+/*
+ * When the change journal is enabled, the changes to a saved branch are
+ * appended to a journal file next to it, and written out in batches instead
+ * of rewriting the whole branch.  The journal is replayed on top of the
+ * branch file at startup.  Once the journal grows too large, it is renamed
+ * and a child process writes a new branch file from a copy of the server
+ * memory, then removes the old journal; the records are idempotent, so
+ * replaying an old journal on top of a newer branch file is harmless.
+ * Keys loaded from a file with NtLoadKey aren't journaled; instead the
+ * branch containing them is marked for a full save.
+ */
+
+#define JOURNAL_MAGIC    "WINEJRNL"
+#define JOURNAL_VERSION  1
+#define JOURNAL_BATCH_SIZE    (1024 * 1024)  /* max. size of the pending records */
+#define JOURNAL_COMPACT_SIZE  (1024 * 1024)  /* min. journal size before compacting it */
+
+struct journal_header
+{
+    char              magic[8];    /* JOURNAL_MAGIC */
+    unsigned int      version;     /* JOURNAL_VERSION */
+    unsigned int      unused;
+};
+
+enum journal_op
+{
+    JOURNAL_CREATE_KEY,
+    JOURNAL_DELETE_KEY,
+    JOURNAL_SET_VALUE,
+    JOURNAL_DELETE_VALUE
+};
+
+/* a journal record, followed by the key path, the value name or key class, and the value data */
+struct journal_record
+{
+    unsigned int      size;        /* total size of the record, padded to 8 bytes */
+    unsigned int      checksum;    /* checksum of the rest of the record */
+    unsigned int      op;          /* operation (enum journal_op) */
+    unsigned int      type;        /* value type, or key flags */
+    timeout_t         modif;       /* key modification time */
+    unsigned int      pathlen;     /* length of the key path, relative to the branch */
+    unsigned int      namelen;     /* length of the value name or key class */
+    data_size_t       len;         /* value data length in bytes */
+    unsigned int      unused;
+};
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    const char  *stale_path;       /* file in the other format, removed once the branch is saved */
+    char        *journal_path;     /* path of the change journal */
+    char        *old_journal_path; /* path of the journal being compacted */
+    int          journal_fd;       /* journal file, or -1 if not journaling */
+    char        *journal_buf;      /* records not written to the journal yet */
+    data_size_t  journal_len;      /* length of the pending records */
+    data_size_t  journal_buf_size; /* allocated size of the pending records buffer */
+    off_t        journal_size;     /* size of the journal file */
+    off_t        branch_size;      /* size of the branch file */
+    int          journal_error;    /* records were lost, the branch needs a full save */
+    int          journal_stale;    /* journal was replayed but isn't used anymore */
+    int          compact_fd;       /* pipe from the compaction process, or -1 */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
+static int use_journal;  /* save the changes to a journal instead of rewriting the branches */
+static struct timeout_user *journal_timeout_user;  /* journal flushing timer */
+static const timeout_t journal_period = -TICKS_PER_SEC;  /* delay between journal writes */
+
+static void journal_key( struct key *key, enum journal_op op );
+static void journal_value( struct key *key, enum journal_op op, const struct key_value *value );
 
 
 /* information about a file being loaded */
@@ -181,6 +336,76 @@ static inline int is_wow6432node( const WCHAR *name, unsigned int len )
             !memicmpW( name, wow6432node, sizeof(wow6432node)/sizeof(WCHAR) ));
 }
 
+/* release a reference to a hive, and free it if it was the last one */
+static void release_hive( struct hive *hive )
+{
+    if (--hive->refcount) return;
+    if (hive->mapped) munmap( (void *)hive->base, hive->size );
+    else free( (void *)hive->base );
+    free( hive );
+}
+
+/* return a pointer to a range of the hive, or NULL if it is out of bounds */
+static const void *get_hive_ptr( const struct hive *hive, unsigned int offset, size_t size )
+{
+    if (offset > hive->size || size > hive->size - offset) return NULL;
+    return hive->base + offset;
+}
+
+/* return the key node at a given offset, after checking that it is valid */
+static const struct hive_key *get_hive_key( const struct hive *hive, unsigned int offset )
+{
+    const struct hive_key *node;
+
+    if ((offset % HIVE_ALIGN) || !(node = get_hive_ptr( hive, offset, sizeof(*node) ))) return NULL;
+    if (node->namelen > MAX_NAME_LEN * sizeof(WCHAR) || (node->namelen % sizeof(WCHAR)) ||
+        (node->classlen % sizeof(WCHAR)))
+        return NULL;
+    if (!get_hive_ptr( hive, offset + sizeof(*node), node->namelen + node->classlen )) return NULL;
+    if (node->nb_subkeys > hive->size / sizeof(struct hive_key) || (node->subkeys % sizeof(unsigned int)) ||
+        !get_hive_ptr( hive, node->subkeys, node->nb_subkeys * sizeof(unsigned int) ))
+        return NULL;
+    if (node->nb_values > hive->size / sizeof(struct hive_value) || (node->values % sizeof(unsigned int)) ||
+        !get_hive_ptr( hive, node->values, node->nb_values * sizeof(struct hive_value) ))
+        return NULL;
+    return node;
+}
+
+/* return a subkey node of a given key node */
+static const struct hive_key *get_hive_subkey( const struct hive *hive, unsigned int offset,
+                                               const struct hive_key *node, unsigned int index,
+                                               unsigned int *subkey_offset )
+{
+    const struct hive_key *subkey;
+
+    *subkey_offset = ((const unsigned int *)(hive->base + node->subkeys))[index];
+    /* children are always stored before their parent */
+    if (*subkey_offset >= offset || !(subkey = get_hive_key( hive, *subkey_offset )))
+    {
+        fprintf( stderr, "wineserver: invalid registry hive node %x\n", *subkey_offset );
+        return NULL;
+    }
+    return subkey;
+}
+
+/* return a value of a given key node, along with its name and data */
+static const struct hive_value *get_hive_value( const struct hive *hive, const struct hive_key *node,
+                                                unsigned int index, const WCHAR **name, const void **data )
+{
+    const struct hive_value *value = (const struct hive_value *)(hive->base + node->values) + index;
+
+    if (value->namelen > MAX_VALUE_LEN * sizeof(WCHAR) || (value->namelen % sizeof(WCHAR)) ||
+        (value->name % sizeof(WCHAR)) ||
+        !(*name = get_hive_ptr( hive, value->name, value->namelen )) ||
+        !(*data = get_hive_ptr( hive, value->data, value->len )))
+    {
+        fprintf( stderr, "wineserver: invalid registry hive value at %x\n",
+                 node->values + index * (unsigned int)sizeof(*value) );
+        return NULL;
+    }
+    return value;
+}
+
 /*
  * The registry text file format v2 used by this code is similar to the one
  * used by REGEDIT import/export functionality, with the following differences:
@@ -256,11 +481,12 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    materialize_key( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -276,9 +502,9 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
             fprintf( f, "\"\n" );
         }
         if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
-        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[get_value_pos( key, i )], f );
     }
-    for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
+    for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[get_subkey_pos( key, i )], base, f );
 }
 
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
@@ -294,6 +520,12 @@ static void dump_operation( const struct key *key, const struct key_value *value
     else fprintf( stderr, "\n" );
 }
 
+/* invalidate the client-side caches; the counter is only mapped once a client asked for it */
+static void registry_changed(void)
+{
+    if (registry_shm) interlocked_xchg_add( (int *)&registry_shm->generation, 1 );
+}
+
 static void key_dump( struct object *obj, int verbose )
 {
     struct key *key = (struct key *)obj;
@@ -400,6 +632,8 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
     struct key * key = (struct key *) obj;
     struct notify *notify = find_notify( key, process, handle );
     if (notify) do_notification( key, notify, 1 );
+    /* the owner can't tell that the handle value may be reused */
+    if (!current || current->process != process) registry_changed();
     return 1;  /* ok to close */
 }
 
@@ -424,6 +658,9 @@ static void key_destroy( struct object *obj )
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free_child_index( key->subkey_index );
+    free_child_index( key->value_index );
+    if (key->hive) release_hive( key->hive );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -492,6 +729,10 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->values      = NULL;
         key->modif       = modif;
         key->parent      = NULL;
+        key->hive        = NULL;
+        key->hive_node   = 0;
+        key->subkey_index = NULL;
+        key->value_index = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -544,6 +785,7 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    registry_changed();
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -551,6 +793,204 @@ static void touch_key( struct key *key, unsigned int change )
         check_notify( k, change & ~REG_NOTIFY_CHANGE_LAST_SET, 0 );
 }
 
+static void get_subkey_name( const struct key *key, int pos, struct unicode_str *name )
+{
+    name->str = key->subkeys[pos]->name;
+    name->len = key->subkeys[pos]->namelen;
+}
+
+static void get_value_name( const struct key *key, int pos, struct unicode_str *name )
+{
+    name->str = key->values[pos].name;
+    name->len = key->values[pos].namelen;
+}
+
+static unsigned int hash_child_name( const struct unicode_str *name )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < name->len / sizeof(WCHAR); i++) hash = hash * 65599 + toupperW( name->str[i] );
+    return hash;
+}
+
+/* compare two names in enumeration order */
+static int compare_child_names( const struct unicode_str *name1, const struct unicode_str *name2 )
+{
+    int res = memicmpW( name1->str, name2->str, min( name1->len, name2->len ) / sizeof(WCHAR) );
+    if (!res) res = name1->len - name2->len;
+    return res;
+}
+
+static void free_child_index( struct child_index *index )
+{
+    if (!index) return;
+    free( index->buckets );
+    free( index->sorted );
+    free( index );
+}
+
+static void add_to_child_index( struct child_index *index, const struct unicode_str *name, int pos )
+{
+    unsigned int i;
+
+    for (i = hash_child_name( name ) & (index->size - 1); index->buckets[i]; i = (i + 1) & (index->size - 1))
+        ;
+    index->buckets[i] = pos + 1;
+    index->count++;
+    free( index->sorted );
+    index->sorted = NULL;
+}
+
+/* create a hash index for the first count children of a key */
+static struct child_index *create_child_index( const struct key *key, int count, child_name_func get_name )
+{
+    struct child_index *index;
+    struct unicode_str name;
+    unsigned int size = 2 * MIN_INDEXED_CHILDREN;
+    int pos;
+
+    while (size < 4 * count) size *= 2;  /* leave room to grow */
+    if (!(index = mem_alloc( sizeof(*index) ))) return NULL;
+    if (!(index->buckets = mem_alloc( size * sizeof(*index->buckets) )))
+    {
+        free( index );
+        return NULL;
+    }
+    memset( index->buckets, 0, size * sizeof(*index->buckets) );
+    index->size   = size;
+    index->count  = 0;
+    index->sorted = NULL;
+    for (pos = 0; pos < count; pos++)
+    {
+        get_name( key, pos, &name );
+        add_to_child_index( index, &name, pos );
+    }
+    return index;
+}
+
+/* make sure there is room in the index for a new child; return 0 on error */
+static int grow_child_index( const struct key *key, struct child_index **index, child_name_func get_name )
+{
+    struct child_index *new_index;
+
+    if (2 * ((*index)->count + 1) <= (*index)->size) return 1;
+    if (!(new_index = create_child_index( key, (*index)->count, get_name ))) return 0;
+    free_child_index( *index );
+    *index = new_index;
+    return 1;
+}
+
+/* find a child in the index and return its array position, or -1 */
+static int find_child_index( const struct key *key, const struct child_index *index,
+                             child_name_func get_name, const struct unicode_str *name )
+{
+    struct unicode_str child;
+    unsigned int i;
+
+    for (i = hash_child_name( name ) & (index->size - 1); index->buckets[i]; i = (i + 1) & (index->size - 1))
+    {
+        get_name( key, index->buckets[i] - 1, &child );
+        if (child.len == name->len && !memicmpW( child.str, name->str, name->len / sizeof(WCHAR) ))
+            return index->buckets[i] - 1;
+    }
+    return -1;
+}
+
+/* remove a child from the index; must be called before it is removed from the array */
+static void remove_from_child_index( const struct key *key, struct child_index *index,
+                                     child_name_func get_name, int pos )
+{
+    unsigned int i, j, home, mask = index->size - 1;
+    struct unicode_str name;
+
+    get_name( key, pos, &name );
+    for (i = hash_child_name( &name ) & mask; index->buckets[i] != pos + 1; i = (i + 1) & mask)
+        ;
+    /* move back the following entries that can't be found anymore once the bucket is free */
+    for (j = (i + 1) & mask; index->buckets[j]; j = (j + 1) & mask)
+    {
+        get_name( key, index->buckets[j] - 1, &name );
+        home = hash_child_name( &name ) & mask;
+        if (i < j ? (home <= i || home > j) : (home <= i && home > j))
+        {
+            index->buckets[i] = index->buckets[j];
+            i = j;
+        }
+    }
+    index->buckets[i] = 0;
+    index->count--;
+    /* the following children are moved down in the array */
+    if (pos < index->count)
+        for (i = 0; i < index->size; i++) if (index->buckets[i] > pos + 1) index->buckets[i]--;
+    free( index->sorted );
+    index->sorted = NULL;
+}
+
+struct sort_entry
+{
+    struct unicode_str name;
+    int                pos;
+};
+
+static int compare_sort_entries( const void *p1, const void *p2 )
+{
+    const struct sort_entry *entry1 = p1;
+    const struct sort_entry *entry2 = p2;
+    return compare_child_names( &entry1->name, &entry2->name );
+}
+
+/* return the array position of the n-th child in enumeration order; the array order
+ * is used instead if it can't be computed */
+static int get_child_pos( const struct key *key, struct child_index *index,
+                          child_name_func get_name, int n )
+{
+    struct sort_entry *entries;
+    int i, *sorted;
+
+    if (!index) return n;
+    if (index->sorted) return index->sorted[n];
+
+#ifdef USE_WORKER_THREADS
+    /* workers only hold the server lock for reading */
+    if (in_worker_thread) pthread_mutex_lock( &hive_mutex );
+#endif
+    if (!(sorted = index->sorted) && (sorted = mem_alloc( index->count * sizeof(*sorted) )))
+    {
+        if ((entries = mem_alloc( index->count * sizeof(*entries) )))
+        {
+            for (i = 0; i < index->count; i++)
+            {
+                get_name( key, i, &entries[i].name );
+                entries[i].pos = i;
+            }
+            qsort( entries, index->count, sizeof(*entries), compare_sort_entries );
+            for (i = 0; i < index->count; i++) sorted[i] = entries[i].pos;
+            free( entries );
+            interlocked_xchg_ptr( (void **)&index->sorted, sorted );
+        }
+        else
+        {
+            free( sorted );
+            sorted = NULL;
+        }
+    }
+#ifdef USE_WORKER_THREADS
+    if (in_worker_thread) pthread_mutex_unlock( &hive_mutex );
+#endif
+    if (!sorted) clear_error();
+    return sorted ? sorted[n] : n;
+}
+
+static int get_subkey_pos( const struct key *key, int n )
+{
+    return get_child_pos( key, key->subkey_index, get_subkey_name, n );
+}
+
+static int get_value_pos( const struct key *key, int n )
+{
+    return get_child_pos( key, key->value_index, get_value_name, n );
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -593,12 +1033,17 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         /* need to grow the array */
         if (!grow_subkeys( parent )) return NULL;
     }
+    if (parent->subkey_index && !grow_child_index( parent, &parent->subkey_index, get_subkey_name ))
+        return NULL;
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
+        if (parent->subkey_index) add_to_child_index( parent->subkey_index, name, index );
+        else if (parent->last_subkey + 1 >= MIN_INDEXED_CHILDREN)
+            parent->subkey_index = create_child_index( parent, parent->last_subkey + 1, get_subkey_name );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -615,6 +1060,7 @@ static void free_subkey( struct key *parent, int index )
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
+    if (parent->subkey_index) remove_from_child_index( parent, parent->subkey_index, get_subkey_name, index );
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
@@ -635,12 +1081,129 @@ static void free_subkey( struct key *parent, int index )
     }
 }
 
+/* make a key point to a hive node; its subkeys and values are loaded on first access */
+static int attach_hive_key( struct key *key, struct hive *hive, unsigned int offset,
+                            const struct hive_key *node )
+{
+    if (node->classlen && !key->class)
+    {
+        if (!(key->class = memdup( (const char *)(node + 1) + node->namelen, node->classlen ))) return 0;
+        key->classlen = node->classlen;
+    }
+    key->flags |= node->flags & (KEY_SYMLINK | KEY_WOW64);
+    key->hive = hive;
+    key->hive_node = offset;
+    hive->refcount++;
+    return 1;
+}
+
+/* create the subkeys and values of a key from its hive node */
+static void read_hive_key( struct key *key )
+{
+    struct hive *hive = key->hive;
+    const struct hive_key *node, *child;
+    const struct hive_value *value;
+    struct key_value *key_value;
+    struct key_value *values;
+    struct key **subkeys;
+    struct key *subkey;
+    struct unicode_str name;
+    unsigned int i, offset;
+    const void *data;
+
+    if (!(node = get_hive_key( hive, key->hive_node ))) goto done;
+
+    if (node->nb_subkeys)
+    {
+        if (!(subkeys = mem_alloc( max( node->nb_subkeys, MIN_SUBKEYS ) * sizeof(*subkeys) ))) goto done;
+        free( key->subkeys );
+        key->subkeys = subkeys;
+        key->nb_subkeys = max( node->nb_subkeys, MIN_SUBKEYS );
+        for (i = 0; i < node->nb_subkeys; i++)
+        {
+            if (!(child = get_hive_subkey( hive, key->hive_node, node, i, &offset ))) continue;
+            name.str = (const WCHAR *)(child + 1);
+            name.len = child->namelen;
+            if (!(subkey = alloc_key( &name, child->modif ))) goto done;
+            if (!attach_hive_key( subkey, hive, offset, child ))
+            {
+                release_object( subkey );
+                goto done;
+            }
+            subkey->parent = key;
+            key->subkeys[++key->last_subkey] = subkey;
+        }
+    }
+
+    if (node->nb_values)
+    {
+        if (!(values = mem_alloc( max( node->nb_values, MIN_VALUES ) * sizeof(*values) ))) goto done;
+        free( key->values );
+        key->values = values;
+        key->nb_values = max( node->nb_values, MIN_VALUES );
+        for (i = 0; i < node->nb_values; i++)
+        {
+            if (!(value = get_hive_value( hive, node, i, &name.str, &data ))) continue;
+            key_value = &key->values[key->last_value + 1];
+            key_value->name    = NULL;
+            key_value->namelen = value->namelen;
+            key_value->type    = value->type;
+            key_value->len     = value->len;
+            key_value->data    = NULL;
+            if (value->namelen && !(key_value->name = memdup( name.str, value->namelen ))) goto done;
+            if (value->len && !(key_value->data = memdup( data, value->len )))
+            {
+                free( key_value->name );
+                goto done;
+            }
+            key->last_value++;
+        }
+    }
+
+ done:
+    if (key->last_subkey + 1 >= MIN_INDEXED_CHILDREN)
+        key->subkey_index = create_child_index( key, key->last_subkey + 1, get_subkey_name );
+    if (key->last_value + 1 >= MIN_INDEXED_CHILDREN)
+        key->value_index = create_child_index( key, key->last_value + 1, get_value_name );
+    /* the contents must be complete before other workers can see the key as loaded */
+    interlocked_xchg_ptr( (void **)&key->hive, NULL );
+    release_hive( hive );
+}
+
+/* make sure the subkeys and values of a key are loaded */
+static void materialize_key( struct key *key )
+{
+    if (!key->hive) return;
+#ifdef USE_WORKER_THREADS
+    if (in_worker_thread)
+    {
+        /* workers only hold the server lock for reading */
+        pthread_mutex_lock( &hive_mutex );
+        if (key->hive) read_hive_key( key );
+        pthread_mutex_unlock( &hive_mutex );
+        return;
+    }
+#endif
+    read_hive_key( key );
+}
+
 /* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+static struct key *find_subkey( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    materialize_key( key );
+    if (key->subkey_index)
+    {
+        if ((i = find_child_index( key, key->subkey_index, get_subkey_name, name )) == -1)
+        {
+            *index = key->last_subkey + 1;  /* new subkeys are appended */
+            return NULL;
+        }
+        *index = i;
+        return key->subkeys[i];
+    }
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -828,6 +1391,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
         free(key->class);
         if (!(key->class = memdup( class->str, key->classlen ))) key->classlen = 0;
     }
+    journal_key( key, JOURNAL_CREATE_KEY );
     touch_key( key->parent, REG_NOTIFY_CHANGE_NAME );
     grab_object( key );
     return key;
@@ -877,7 +1441,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
+static void enum_key( struct key *key, int index, int info_class,
                       struct enum_key_reply *reply )
 {
     static const WCHAR backslash[] = { '\\' };
@@ -890,13 +1454,15 @@ static void enum_key( const struct key *key, int index, int info_class,
 
     if (index != -1)  /* -1 means use the specified key directly */
     {
+        materialize_key( key );
         if ((index < 0) || (index > key->last_subkey))
         {
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
-        key = key->subkeys[index];
+        key = key->subkeys[get_subkey_pos( key, index )];
     }
+    materialize_key( key );
 
     namelen = key->namelen;
     classlen = key->classlen;
@@ -996,6 +1562,14 @@ static int delete_key( struct key *key, int recurse )
     }
     assert( parent );
 
+    if (recurse && key->hive)
+    {
+        /* the contents have never been loaded, no need to create them just to delete them */
+        release_hive( key->hive );
+        key->hive = NULL;
+    }
+    materialize_key( key );
+
     while (recurse && (key->last_subkey>=0))
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
@@ -1012,6 +1586,7 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    journal_key( key, JOURNAL_DELETE_KEY );
     free_subkey( parent, index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 0;
@@ -1043,11 +1618,22 @@ static int grow_values( struct key *key )
 }
 
 /* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    materialize_key( key );
+    if (key->value_index)
+    {
+        if ((i = find_child_index( key, key->value_index, get_value_name, name )) == -1)
+        {
+            *index = key->last_value + 1;  /* new values are appended */
+            return NULL;
+        }
+        *index = i;
+        return &key->values[i];
+    }
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1084,6 +1670,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     {
         if (!grow_values( key )) return NULL;
     }
+    if (key->value_index && !grow_child_index( key, &key->value_index, get_value_name )) return NULL;
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
     value = &key->values[index];
@@ -1091,6 +1678,9 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_index) add_to_child_index( key->value_index, name, index );
+    else if (key->last_value + 1 >= MIN_INDEXED_CHILDREN)
+        key->value_index = create_child_index( key, key->last_value + 1, get_value_name );
     return value;
 }
 
@@ -1139,6 +1729,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
     value->len   = len;
     value->data  = ptr;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
+    journal_value( key, JOURNAL_SET_VALUE, value );
     if (debug_level > 1) dump_operation( key, value, "Set" );
 }
 
@@ -1167,13 +1758,14 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 {
     struct key_value *value;
 
+    materialize_key( key );
     if (i < 0 || i > key->last_value) set_error( STATUS_NO_MORE_ENTRIES );
     else
     {
         void *data;
         data_size_t namelen, maxlen;
 
-        value = &key->values[i];
+        value = &key->values[get_value_pos( key, i )];
         reply->type = value->type;
         namelen = value->namelen;
 
@@ -1225,6 +1817,8 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    journal_value( key, JOURNAL_DELETE_VALUE, value );
+    if (key->value_index) remove_from_child_index( key, key->value_index, get_value_name, index );
     free( value->name );
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
@@ -1693,10 +2287,127 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     free( info.tmp );
 }
 
+/* open a binary hive file, either by mapping it or by reading it into memory */
+static struct hive *open_hive( int fd, int map )
+{
+    const struct hive_header *header;
+    struct hive *hive;
+    struct stat st;
+    enum prefix_type type;
+    void *base;
+
+    if (fstat( fd, &st ) == -1)
+    {
+        file_set_error();
+        return NULL;
+    }
+    if (st.st_size < sizeof(*header) || st.st_size > UINT_MAX)
+    {
+        set_error( STATUS_NOT_REGISTRY_FILE );
+        return NULL;
+    }
+    if (map)
+    {
+        if ((base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+        {
+            file_set_error();
+            return NULL;
+        }
+    }
+    else
+    {
+        if (!(base = mem_alloc( st.st_size ))) return NULL;
+        if (pread( fd, base, st.st_size, 0 ) != st.st_size)
+        {
+            set_error( STATUS_NOT_REGISTRY_FILE );
+            free( base );
+            return NULL;
+        }
+    }
+    if (!(hive = mem_alloc( sizeof(*hive) )))
+    {
+        if (map) munmap( base, st.st_size );
+        else free( base );
+        return NULL;
+    }
+    hive->refcount = 1;
+    hive->base     = base;
+    hive->size     = st.st_size;
+    hive->mapped   = map;
+
+    header = base;
+    type = header->arch;
+    if (memcmp( header->magic, HIVE_MAGIC, sizeof(header->magic) ) ||
+        header->version != HIVE_VERSION || header->size != st.st_size ||
+        (type != PREFIX_UNKNOWN && prefix_type != PREFIX_UNKNOWN && type != prefix_type) ||
+        !get_hive_key( hive, header->root ))
+    {
+        set_error( STATUS_NOT_REGISTRY_FILE );
+        release_hive( hive );
+        return NULL;
+    }
+    return hive;
+}
+
+/* merge the contents of a hive node into an existing key */
+static void merge_hive_key( struct key *key, struct hive *hive, unsigned int offset,
+                            const struct hive_key *node )
+{
+    const struct hive_key *child;
+    const struct hive_value *value;
+    struct key_value *key_value;
+    struct key *subkey;
+    struct unicode_str name;
+    unsigned int i, child_offset;
+    const void *data;
+    void *ptr;
+    int index;
+
+    for (i = 0; i < node->nb_values; i++)
+    {
+        if (!(value = get_hive_value( hive, node, i, &name.str, &data ))) continue;
+        name.len = value->namelen;
+        if (!(key_value = find_value( key, &name, &index )) &&
+            !(key_value = insert_value( key, &name, index )))
+            return;
+        if (!value->len) ptr = NULL;
+        else if (!(ptr = memdup( data, value->len ))) return;
+        free( key_value->data );
+        key_value->data = ptr;
+        key_value->len  = value->len;
+        key_value->type = value->type;
+    }
+
+    for (i = 0; i < node->nb_subkeys; i++)
+    {
+        if (!(child = get_hive_subkey( hive, offset, node, i, &child_offset ))) continue;
+        name.str = (const WCHAR *)(child + 1);
+        name.len = child->namelen;
+        if ((subkey = find_subkey( key, &name, &index )))
+            merge_hive_key( subkey, hive, child_offset, child );
+        else if (!(subkey = alloc_subkey( key, &name, index, child->modif )) ||
+                 !attach_hive_key( subkey, hive, child_offset, child ))
+            return;
+    }
+}
+
+/* load a hive into a key; an empty key only points to it until it is accessed */
+static void load_hive( struct key *key, struct hive *hive )
+{
+    unsigned int offset = ((const struct hive_header *)hive->base)->root;
+    const struct hive_key *node = get_hive_key( hive, offset );
+
+    materialize_key( key );
+    if (key->last_subkey == -1 && key->last_value == -1) attach_hive_key( key, hive, offset, node );
+    else merge_hive_key( key, hive, offset, node );
+}
+
 /* load a part of the registry from a file */
 static void load_registry( struct key *key, obj_handle_t handle )
 {
     struct file *file;
+    struct hive *hive;
+    char magic[sizeof(HIVE_MAGIC) - 1];
     int fd;
 
     if (!(file = get_file_obj( current->process, handle, FILE_READ_DATA ))) return;
@@ -1704,7 +2415,22 @@ static void load_registry( struct key *key, obj_handle_t handle )
     release_object( file );
     if (fd != -1)
     {
-        FILE *f = fdopen( fd, "r" );
+        FILE *f;
+
+        if (pread( fd, magic, sizeof(magic), 0 ) == sizeof(magic) &&
+            !memcmp( magic, HIVE_MAGIC, sizeof(magic) ))
+        {
+            /* the file is copied, since the client could modify it under us */
+            if ((hive = open_hive( fd, 0 )))
+            {
+                load_hive( key, hive );
+                release_hive( hive );
+            }
+            close( fd );
+            return;
+        }
+
+        f = fdopen( fd, "r" );
         if (f)
         {
             load_keys( key, NULL, f, -1 );
@@ -1714,12 +2440,244 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* compute the checksum of a journal record */
+static unsigned int journal_checksum( const struct journal_record *rec )
+{
+    const unsigned char *p = (const unsigned char *)&rec->op;
+    size_t size = rec->size - offsetof( struct journal_record, op );
+    unsigned int sum = 0x811c9dc5;
+
+    while (size--) sum = (sum ^ *p++) * 0x01000193;
+    return sum;
+}
+
+/* find the key of a journal record, optionally creating it */
+static struct key *find_journal_key( struct key *key, const WCHAR *path, data_size_t pathlen,
+                                     int create, timeout_t modif )
+{
+    struct unicode_str name, token;
+    struct key *subkey;
+    int index;
+
+    name.str = path;
+    name.len = pathlen;
+    token.str = NULL;
+    if (!get_path_token( &name, &token )) return NULL;
+    while (token.len)
+    {
+        if (!(subkey = find_subkey( key, &token, &index )))
+        {
+            if (!create || !(subkey = alloc_subkey( key, &token, index, modif ))) return NULL;
+        }
+        key = subkey;
+        get_path_token( &name, &token );
+    }
+    return key;
+}
+
+/* apply a journal record to a branch */
+static void apply_journal_record( struct key *branch, const struct journal_record *rec )
+{
+    const WCHAR *path = (const WCHAR *)(rec + 1);
+    const char *data = (const char *)path + rec->pathlen + rec->namelen;
+    struct key_value *value;
+    struct unicode_str name;
+    struct key *key;
+    void *ptr;
+    int index;
+
+    name.str = (const WCHAR *)((const char *)path + rec->pathlen);
+    name.len = rec->namelen;
+
+    switch (rec->op)
+    {
+    case JOURNAL_CREATE_KEY:
+        if (!(key = find_journal_key( branch, path, rec->pathlen, 1, rec->modif ))) break;
+        if (name.len && !key->class && (key->class = memdup( name.str, name.len )))
+            key->classlen = name.len;
+        key->flags |= rec->type & KEY_SYMLINK;
+        key->modif = rec->modif;
+        break;
+    case JOURNAL_DELETE_KEY:
+        if ((key = find_journal_key( branch, path, rec->pathlen, 0, 0 )) && key != branch)
+            delete_key( key, 1 );
+        break;
+    case JOURNAL_SET_VALUE:
+        if (!(key = find_journal_key( branch, path, rec->pathlen, 1, rec->modif ))) break;
+        if (!(value = find_value( key, &name, &index )) && !(value = insert_value( key, &name, index )))
+            break;
+        if (!rec->len) ptr = NULL;
+        else if (!(ptr = memdup( data, rec->len ))) break;
+        free( value->data );
+        value->data = ptr;
+        value->len  = rec->len;
+        value->type = rec->type;
+        key->modif  = rec->modif;
+        break;
+    case JOURNAL_DELETE_VALUE:
+        if ((key = find_journal_key( branch, path, rec->pathlen, 0, 0 )) && find_value( key, &name, &index ))
+            delete_value( key, &name );
+        break;
+    }
+    clear_error();
+}
+
+/* replay a journal file on top of a branch, and return the size of its valid part */
+static off_t replay_journal( struct key *branch, const char *path )
+{
+    struct journal_header header;
+    struct journal_record *rec;
+    struct stat st;
+    char *buffer;
+    off_t pos;
+    int fd;
+
+    if ((fd = open( path, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(header) || st.st_size > INT_MAX ||
+        !(buffer = mem_alloc( st.st_size )))
+    {
+        close( fd );
+        return 0;
+    }
+    if (read( fd, buffer, st.st_size ) != st.st_size)
+    {
+        free( buffer );
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    memcpy( &header, buffer, sizeof(header) );
+    if (memcmp( header.magic, JOURNAL_MAGIC, sizeof(header.magic) ) || header.version != JOURNAL_VERSION)
+    {
+        fprintf( stderr, "%s is not a valid registry journal\n", path );
+        free( buffer );
+        return 0;
+    }
+
+    /* records are validated until the first one that wasn't completely written */
+    for (pos = sizeof(header); pos + sizeof(*rec) <= st.st_size; pos += rec->size)
+    {
+        rec = (struct journal_record *)(buffer + pos);
+        if (rec->size < sizeof(*rec) || (rec->size % 8) || rec->size > st.st_size - pos) break;
+        if (rec->pathlen > rec->size - sizeof(*rec) ||
+            rec->namelen > rec->size - sizeof(*rec) - rec->pathlen ||
+            rec->len > rec->size - sizeof(*rec) - rec->pathlen - rec->namelen ||
+            (rec->pathlen % sizeof(WCHAR)) || (rec->namelen % sizeof(WCHAR)))
+            break;
+        if (rec->checksum != journal_checksum( rec )) break;
+        apply_journal_record( branch, rec );
+    }
+    if (pos < st.st_size) fprintf( stderr, "%s: ignoring incomplete records at offset %x\n",
+                                   path, (unsigned int)pos );
+    free( buffer );
+    return pos;
+}
+
+/* open the journal of a branch for appending, keeping only its valid part */
+static void open_journal( struct save_branch_info *info, off_t size )
+{
+    static const struct journal_header header = { JOURNAL_MAGIC, JOURNAL_VERSION };
+
+    if ((info->journal_fd = open( info->journal_path, O_WRONLY | O_CREAT, 0666 )) == -1) goto error;
+    if (size < sizeof(header))
+    {
+        if (ftruncate( info->journal_fd, 0 ) == -1 ||
+            write( info->journal_fd, &header, sizeof(header) ) != sizeof(header))
+            goto error;
+        size = sizeof(header);
+    }
+    else if (ftruncate( info->journal_fd, size ) == -1) goto error;
+    if (lseek( info->journal_fd, size, SEEK_SET ) == -1) goto error;
+    info->journal_size = size;
+    return;
+
+error:
+    fprintf( stderr, "wineserver: cannot open registry journal %s: %s\n",
+             info->journal_path, strerror( errno ));
+    if (info->journal_fd != -1) close( info->journal_fd );
+    info->journal_fd = -1;
+    info->journal_error = 1;
+}
+
+/* replay the journals of a branch after loading it, and start a new journal if needed */
+static void init_journal( struct save_branch_info *info )
+{
+    struct stat st;
+    off_t size, old_size;
+
+    info->journal_fd = -1;
+    info->compact_fd = -1;
+    if (!(info->journal_path = malloc( strlen(info->path) + sizeof(".journal.old") )) ||
+        !(info->old_journal_path = malloc( strlen(info->path) + sizeof(".journal.old") )))
+        fatal_error( "out of memory\n" );
+    sprintf( info->journal_path, "%s.journal", info->path );
+    sprintf( info->old_journal_path, "%s.journal.old", info->path );
+    if (!stat( info->path, &st )) info->branch_size = st.st_size;
+
+    /* an old journal is left over if the server exited during a compaction */
+    old_size = replay_journal( info->key, info->old_journal_path );
+    size = replay_journal( info->key, info->journal_path );
+
+    if (use_journal) open_journal( info, size );
+    else if (size || old_size)
+    {
+        /* the branch file needs to be updated before removing the journals */
+        make_dirty( info->key );
+        info->journal_stale = 1;
+    }
+}
+
+/* load one of the initial hive files, if it is at least as recent as the text file */
+static int load_init_hive_from_file( const char *filename, const char *hive_filename, struct key *key )
+{
+    struct stat st, hive_st;
+    struct hive *hive;
+    int fd;
+
+    if ((fd = open( hive_filename, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &hive_st ) == -1 || (!stat( filename, &st ) && st.st_mtime > hive_st.st_mtime))
+    {
+        close( fd );
+        return 0;
+    }
+    hive = open_hive( fd, 1 );
+    close( fd );
+    if (!hive)
+    {
+        fprintf( stderr, "%s is not a valid registry hive, loading %s instead\n", hive_filename, filename );
+        clear_error();
+        return 0;
+    }
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = ((const struct hive_header *)hive->base)->arch;
+    load_hive( key, hive );
+    release_hive( hive );
+    return 1;
+}
+
 /* load one of the initial registry files */
-static int load_init_registry_from_file( const char *filename, struct key *key )
+static int load_init_registry_from_file( const char *filename, const char *hive_filename, struct key *key )
 {
+    const char *path = filename, *stale_path = NULL;
+    int ret;
     FILE *f;
 
-    if ((f = fopen( filename, "r" )))
+    if (use_hive_files)
+    {
+        /* the text file is out of date once the hive has been saved */
+        path = hive_filename;
+        stale_path = filename;
+    }
+
+    /* the hive is also loaded when hive files are disabled, if it is more recent
+     * than the text file; the text file is then written on the next save */
+    if ((ret = load_init_hive_from_file( filename, hive_filename, key )) && !use_hive_files)
+    {
+        make_dirty( key );
+        stale_path = hive_filename;
+    }
+
+    if (!ret && (f = fopen( filename, "r" )))
     {
         load_keys( key, filename, f, 0 );
         fclose( f );
@@ -1728,14 +2686,19 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
             fprintf( stderr, "%s is not a valid registry file\n", filename );
             return 1;
         }
+        /* write the hive on the next save */
+        if (use_hive_files) make_dirty( key );
+        ret = 1;
     }
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    save_branch_info[save_branch_count].path = path;
+    save_branch_info[save_branch_count].stale_path = stale_path;
+    save_branch_info[save_branch_count].key = (struct key *)grab_object( key );
     make_object_static( &key->obj );
-    return (f != NULL);
+    init_journal( &save_branch_info[save_branch_count++] );
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1811,6 +2774,9 @@ void init_registry(void)
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
 
+    if ((p = getenv( "WINEREGISTRYHIVE" ))) use_hive_files = atoi( p );
+    if ((p = getenv( "WINEREGISTRYJOURNAL" ))) use_journal = atoi( p );
+
     /* create the root key */
     root_key = alloc_key( &root_name, current_time );
     assert( root_key );
@@ -1821,7 +2787,7 @@ void init_registry(void)
     if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time )))
         fatal_error( "could not create Machine registry key\n" );
 
-    if (!load_init_registry_from_file( "system.reg", hklm ))
+    if (!load_init_registry_from_file( "system.reg", "system.hive", hklm ))
     {
         if ((p = getenv( "WINEARCH" )) && !strcmp( p, "win32" ))
             prefix_type = PREFIX_32BIT;
@@ -1836,7 +2802,7 @@ void init_registry(void)
     if (!(key = create_key_recursive( root_key, &HKU_name, current_time )))
         fatal_error( "could not create User\\.Default registry key\n" );
 
-    load_init_registry_from_file( "userdef.reg", key );
+    load_init_registry_from_file( "userdef.reg", "userdef.hive", key );
     release_object( key );
 
     /* load user.reg into HKEY_CURRENT_USER */
@@ -1847,7 +2813,7 @@ void init_registry(void)
         !(hkcu = create_key_recursive( root_key, &current_user_str, current_time )))
         fatal_error( "could not create HKEY_CURRENT_USER registry key\n" );
     free( current_user_path );
-    load_init_registry_from_file( "user.reg", hkcu );
+    load_init_registry_from_file( "user.reg", "user.hive", hkcu );
 
     /* set the shared flag on Software\Classes\Wow6432Node */
     if (prefix_type == PREFIX_64BIT)
@@ -1891,8 +2857,180 @@ static void save_all_subkeys( struct key *key, FILE *f )
     save_subkeys( key, key, f );
 }
 
+/* information about a hive file being saved */
+struct hive_writer
+{
+    FILE         *file;   /* output file */
+    unsigned int  pos;    /* current file offset */
+    int           error;  /* did an error occur? */
+};
+
+/* write data to a hive file and return its offset */
+static unsigned int write_hive_data( struct hive_writer *writer, const void *data, size_t size )
+{
+    unsigned int pos = writer->pos;
+
+    if (size > UINT_MAX - writer->pos || fwrite( data, 1, size, writer->file ) != size)
+    {
+        writer->error = 1;
+        return 0;
+    }
+    writer->pos += size;
+    return pos;
+}
+
+/* pad a hive file up to the next node boundary */
+static void align_hive_data( struct hive_writer *writer )
+{
+    static const char padding[HIVE_ALIGN];
+    write_hive_data( writer, padding, (HIVE_ALIGN - writer->pos % HIVE_ALIGN) % HIVE_ALIGN );
+}
+
+/* write a key node preceded by its subkey and value arrays, and return its offset */
+static unsigned int write_hive_key( struct hive_writer *writer, struct hive_key *node,
+                                    const unsigned int *subkeys, const struct hive_value *values,
+                                    const WCHAR *name, const WCHAR *class )
+{
+    unsigned int offset;
+
+    align_hive_data( writer );
+    node->subkeys = write_hive_data( writer, subkeys, node->nb_subkeys * sizeof(*subkeys) );
+    node->values  = write_hive_data( writer, values, node->nb_values * sizeof(*values) );
+    align_hive_data( writer );
+    offset = write_hive_data( writer, node, sizeof(*node) );
+    write_hive_data( writer, name, node->namelen );
+    write_hive_data( writer, class, node->classlen );
+    return offset;
+}
+
+/* copy the contents of a hive node and all its children without loading them */
+static unsigned int copy_hive_key( struct hive_writer *writer, const struct hive *hive,
+                                   unsigned int offset, const struct hive_key *node,
+                                   struct hive_key *new_node, const WCHAR *name, const WCHAR *class )
+{
+    const struct hive_key *child;
+    const struct hive_value *value;
+    struct hive_key child_node;
+    struct hive_value *values = NULL;
+    unsigned int i, child_offset, *subkeys = NULL;
+    const WCHAR *child_name, *value_name;
+    const void *data;
+
+    if ((node->nb_subkeys && !(subkeys = mem_alloc( node->nb_subkeys * sizeof(*subkeys) ))) ||
+        (node->nb_values && !(values = mem_alloc( node->nb_values * sizeof(*values) ))))
+    {
+        free( subkeys );
+        writer->error = 1;
+        return 0;
+    }
+
+    new_node->nb_subkeys = 0;
+    for (i = 0; i < node->nb_subkeys; i++)
+    {
+        if (!(child = get_hive_subkey( hive, offset, node, i, &child_offset ))) continue;
+        child_node = *child;
+        child_name = (const WCHAR *)(child + 1);
+        subkeys[new_node->nb_subkeys++] = copy_hive_key( writer, hive, child_offset, child, &child_node,
+                                                         child_name, child_name + child->namelen / sizeof(WCHAR) );
+    }
+    new_node->nb_values = 0;
+    for (i = 0; i < node->nb_values; i++)
+    {
+        if (!(value = get_hive_value( hive, node, i, &value_name, &data ))) continue;
+        values[new_node->nb_values] = *value;
+        values[new_node->nb_values].name = write_hive_data( writer, value_name, value->namelen );
+        values[new_node->nb_values].data = write_hive_data( writer, data, value->len );
+        new_node->nb_values++;
+    }
+
+    offset = write_hive_key( writer, new_node, subkeys, values, name, class );
+    free( subkeys );
+    free( values );
+    return offset;
+}
+
+/* save a key and all its subkeys to a hive file, and return the offset of its node */
+static unsigned int save_hive_key( struct hive_writer *writer, struct key *key )
+{
+    const struct hive_key *node;
+    struct hive_key new_node;
+    struct hive_value *values = NULL;
+    unsigned int offset, *subkeys = NULL;
+    struct key *subkey;
+    int i;
+
+    new_node.modif      = key->modif;
+    new_node.flags      = key->flags & (KEY_SYMLINK | KEY_WOW64);
+    new_node.namelen    = key->namelen;
+    new_node.classlen   = key->classlen;
+
+    /* the name may differ from the node if the hive was loaded under another key */
+    if (key->hive && (node = get_hive_key( key->hive, key->hive_node )))
+        return copy_hive_key( writer, key->hive, key->hive_node, node, &new_node, key->name, key->class );
+    materialize_key( key );
+
+    if ((key->last_subkey >= 0 && !(subkeys = mem_alloc( (key->last_subkey + 1) * sizeof(*subkeys) ))) ||
+        (key->last_value >= 0 && !(values = mem_alloc( (key->last_value + 1) * sizeof(*values) ))))
+    {
+        free( subkeys );
+        writer->error = 1;
+        return 0;
+    }
+
+    new_node.flags &= ~KEY_WOW64;
+    new_node.nb_subkeys = 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        subkey = key->subkeys[get_subkey_pos( key, i )];
+        if (subkey->flags & KEY_VOLATILE) continue;
+        if (is_wow6432node( subkey->name, subkey->namelen ) && !is_wow6432node( key->name, key->namelen ))
+            new_node.flags |= KEY_WOW64;
+        subkeys[new_node.nb_subkeys++] = save_hive_key( writer, subkey );
+    }
+    new_node.nb_values = 0;
+    for (i = 0; i <= key->last_value; i++)
+    {
+        const struct key_value *value = &key->values[get_value_pos( key, i )];
+        values[i].type    = value->type;
+        values[i].namelen = value->namelen;
+        values[i].len     = value->len;
+        values[i].name    = write_hive_data( writer, value->name, value->namelen );
+        values[i].data    = write_hive_data( writer, value->data, value->len );
+        new_node.nb_values++;
+    }
+
+    offset = write_hive_key( writer, &new_node, subkeys, values, key->name, key->class );
+    free( subkeys );
+    free( values );
+    return offset;
+}
+
+/* save a registry branch to a binary hive file */
+static int save_hive( struct key *key, FILE *f )
+{
+    struct hive_header header;
+    struct hive_writer writer;
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, HIVE_MAGIC, sizeof(header.magic) );
+    header.version = HIVE_VERSION;
+    header.arch    = prefix_type;
+
+    writer.file  = f;
+    writer.pos   = 0;
+    writer.error = 0;
+    write_hive_data( &writer, &header, sizeof(header) );
+    header.root = save_hive_key( &writer, key );
+    header.size = writer.pos;
+
+    /* now that the root offset is known, rewrite the header */
+    if (writer.error || fseek( f, 0, SEEK_SET ) || fwrite( &header, sizeof(header), 1, f ) != 1)
+        return 0;
+    return 1;
+}
+
 /* save a registry branch to a file handle */
-static void save_registry( struct key *key, obj_handle_t handle )
+static void save_registry( struct key *key, obj_handle_t handle, unsigned int format )
 {
     struct file *file;
     int fd;
@@ -1905,7 +3043,8 @@ static void save_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "w" );
         if (f)
         {
-            save_all_subkeys( key, f );
+            if (format == REG_STANDARD_FORMAT) save_all_subkeys( key, f );
+            else if (!save_hive( key, f )) set_error( STATUS_REGISTRY_IO_FAILED );
             if (fclose( f )) file_set_error();
         }
         else
@@ -1932,7 +3071,8 @@ static int save_branch( struct key *key, const char *path )
 
     /* test the file type */
 
-    if ((fd = open( path, O_WRONLY )) != -1)
+    /* hives are mapped while in use, so they can't be overwritten in place */
+    if (!use_hive_files && (fd = open( path, O_WRONLY )) != -1)
     {
         /* if file is not a regular file or has multiple links or is accessed
          * via symbolic links, write directly into it; otherwise use a temp file */
@@ -1974,8 +3114,15 @@ static int save_branch( struct key *key, const char *path )
         dump_operation( key, NULL, "saving" );
     }
 
-    save_all_subkeys( key, f );
-    ret = !fclose(f);
+    if (use_hive_files) ret = save_hive( key, f );
+    else
+    {
+        save_all_subkeys( key, f );
+        ret = 1;
+    }
+    /* the journal is truncated once the branch is saved, so it has to be on disk */
+    if (use_journal && (fflush( f ) || fsync( fileno( f ) ))) ret = 0;
+    if (fclose( f )) ret = 0;
 
     if (tmp)
     {
@@ -1990,6 +3137,255 @@ done:
     return ret;
 }
 
+/* return the branch that a key is saved to, or NULL if it isn't saved */
+static struct save_branch_info *get_key_branch( const struct key *key )
+{
+    int i;
+
+    for ( ; key; key = key->parent)
+    {
+        if (key->flags & KEY_VOLATILE) return NULL;
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    }
+    return NULL;
+}
+
+/* write the pending records of a branch to its journal */
+static int flush_journal( struct save_branch_info *info )
+{
+    data_size_t pos = 0;
+    ssize_t ret;
+
+    if (info->journal_error) return 0;
+    if (!info->journal_len) return 1;
+    while (pos < info->journal_len)
+    {
+        if ((ret = write( info->journal_fd, info->journal_buf + pos, info->journal_len - pos )) == -1)
+        {
+            if (errno == EINTR) continue;
+            goto error;
+        }
+        pos += ret;
+    }
+    if (fsync( info->journal_fd ) == -1) goto error;
+    info->journal_size += info->journal_len;
+    info->journal_len = 0;
+    return 1;
+
+error:
+    fprintf( stderr, "wineserver: could not write registry journal %s: %s\n",
+             info->journal_path, strerror( errno ));
+    info->journal_error = 1;  /* the whole branch will be saved instead */
+    return 0;
+}
+
+/* write the batch of pending records of all branches */
+static void journal_timeout( void *arg )
+{
+    int i;
+
+    journal_timeout_user = NULL;
+    for (i = 0; i < save_branch_count; i++) flush_journal( &save_branch_info[i] );
+}
+
+/* append a record for a change to the journal of the branch containing the key */
+static void journal_append( struct key *key, enum journal_op op, unsigned int type,
+                            const WCHAR *name, data_size_t namelen, const void *data, data_size_t len )
+{
+    static const WCHAR backslash = '\\';
+    struct save_branch_info *info;
+    struct journal_record *rec;
+    const struct key *k;
+    data_size_t pathlen = 0, size, pos;
+    char *ptr;
+
+    if (!(info = get_key_branch( key )) || info->journal_fd == -1 || info->journal_error) return;
+
+    for (k = key; k != info->key; k = k->parent) pathlen += k->namelen + sizeof(WCHAR);
+    if (pathlen) pathlen -= sizeof(WCHAR);
+    size = (sizeof(*rec) + pathlen + namelen + len + 7) & ~7;
+
+    if (info->journal_len + size > info->journal_buf_size)
+    {
+        data_size_t new_size = max( info->journal_buf_size * 2, info->journal_len + size );
+        if (!(ptr = realloc( info->journal_buf, new_size )))
+        {
+            info->journal_error = 1;
+            return;
+        }
+        info->journal_buf = ptr;
+        info->journal_buf_size = new_size;
+    }
+
+    rec = (struct journal_record *)(info->journal_buf + info->journal_len);
+    memset( rec, 0, size );
+    rec->size    = size;
+    rec->op      = op;
+    rec->type    = type;
+    rec->modif   = key->modif;
+    rec->pathlen = pathlen;
+    rec->namelen = namelen;
+    rec->len     = len;
+
+    /* build the path from the end, as in enum_key */
+    ptr = (char *)(rec + 1);
+    pos = pathlen;
+    for (k = key; k != info->key; k = k->parent)
+    {
+        pos -= k->namelen;
+        memcpy( ptr + pos, k->name, k->namelen );
+        if (!pos) break;
+        pos -= sizeof(WCHAR);
+        memcpy( ptr + pos, &backslash, sizeof(WCHAR) );
+    }
+    memcpy( ptr + pathlen, name, namelen );
+    memcpy( ptr + pathlen + namelen, data, len );
+    rec->checksum = journal_checksum( rec );
+    info->journal_len += size;
+
+    if (info->journal_len >= JOURNAL_BATCH_SIZE) flush_journal( info );
+    else if (!journal_timeout_user)
+        journal_timeout_user = add_timeout_user( journal_period, journal_timeout, NULL );
+}
+
+static void journal_key( struct key *key, enum journal_op op )
+{
+    if (op == JOURNAL_CREATE_KEY)
+        journal_append( key, op, key->flags & KEY_SYMLINK, key->class, key->classlen, NULL, 0 );
+    else
+        journal_append( key, op, 0, NULL, 0, NULL, 0 );
+}
+
+static void journal_value( struct key *key, enum journal_op op, const struct key_value *value )
+{
+    if (op == JOURNAL_SET_VALUE)
+        journal_append( key, op, value->type, value->name, value->namelen, value->data, value->len );
+    else
+        journal_append( key, op, 0, value->name, value->namelen, NULL, 0 );
+}
+
+/* remove the file of a branch in the other format, once the branch has been saved */
+static void remove_stale_branch( struct save_branch_info *info )
+{
+    if (!info->stale_path) return;
+    if (unlink( info->stale_path ) == -1 && errno != ENOENT)
+        fprintf( stderr, "wineserver: could not remove stale registry file %s: %s\n",
+                 info->stale_path, strerror( errno ));
+    info->stale_path = NULL;
+}
+
+/* check if the compaction process of a branch is done, optionally waiting for it */
+static void finish_compaction( struct save_branch_info *info, int wait )
+{
+    struct stat st;
+    char result;
+    int ret;
+
+    if (info->compact_fd == -1) return;
+    if (wait) fcntl( info->compact_fd, F_SETFL, 0 );
+    while ((ret = read( info->compact_fd, &result, 1 )) == -1 && errno == EINTR);
+    if (ret == -1 && errno == EAGAIN) return;
+
+    close( info->compact_fd );
+    info->compact_fd = -1;
+    if (ret != 1)
+        fprintf( stderr, "wineserver: could not compact registry journal %s\n", info->old_journal_path );
+    else
+    {
+        if (!stat( info->path, &st )) info->branch_size = st.st_size;
+        remove_stale_branch( info );
+    }
+}
+
+/* save the whole branch and start a new journal */
+static int compact_journal( struct save_branch_info *info )
+{
+    struct stat st;
+
+    finish_compaction( info, 1 );
+    make_dirty( info->key );
+    if (!save_branch( info->key, info->path )) return 0;
+
+    info->journal_len = 0;
+    info->journal_error = 0;
+    if (info->journal_fd != -1) close( info->journal_fd );
+    open_journal( info, 0 );
+    unlink( info->old_journal_path );
+    if (!stat( info->path, &st )) info->branch_size = st.st_size;
+    remove_stale_branch( info );
+    return 1;
+}
+
+/* compact the journal of a branch in a child process, working on a copy of the registry */
+static void start_compaction( struct save_branch_info *info )
+{
+#ifdef USE_PTRACE  /* other platforms don't expect SIGCHLD for non-client processes */
+    int fds[2];
+
+    if (info->compact_fd != -1) return;
+    /* an old journal is left over if the previous compaction failed */
+    if (!access( info->old_journal_path, F_OK ) || pipe( fds ) == -1)
+    {
+        compact_journal( info );
+        return;
+    }
+    fcntl( fds[0], F_SETFL, O_NONBLOCK );
+    if (rename( info->journal_path, info->old_journal_path ) == -1)
+    {
+        close( fds[0] );
+        close( fds[1] );
+        return;
+    }
+    close( info->journal_fd );
+    open_journal( info, 0 );
+
+    switch (fork())
+    {
+    case 0:  /* child */
+        close( fds[0] );
+        make_dirty( info->key );
+        if (save_branch( info->key, info->path ) && !unlink( info->old_journal_path ))
+            write( fds[1], "", 1 );
+        _exit( 0 );
+    case -1:
+        close( fds[0] );
+        close( fds[1] );
+        compact_journal( info );
+        return;
+    default:
+        close( fds[1] );
+        info->compact_fd = fds[0];
+        return;
+    }
+#else
+    compact_journal( info );
+#endif
+}
+
+/* save the changes made to a branch since the last save */
+static int update_branch( struct save_branch_info *info, int compact )
+{
+    if (!use_journal)
+    {
+        if (!save_branch( info->key, info->path )) return 0;
+        remove_stale_branch( info );
+        if (info->journal_stale)
+        {
+            unlink( info->journal_path );
+            unlink( info->old_journal_path );
+            info->journal_stale = 0;
+        }
+        return 1;
+    }
+
+    finish_compaction( info, 0 );
+    if (!flush_journal( info )) return compact_journal( info );
+    if (compact && info->journal_size > max( JOURNAL_COMPACT_SIZE, info->branch_size / 2 ))
+        start_compaction( info );
+    return 1;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -1997,8 +3393,7 @@ static void periodic_save( void *arg )
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    for (i = 0; i < save_branch_count; i++) update_branch( &save_branch_info[i], 1 );
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2018,7 +3413,7 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!update_branch( &save_branch_info[i], 0 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -2197,6 +3592,7 @@ DECL_HANDLER(delete_key_value)
 DECL_HANDLER(load_registry)
 {
     struct key *key, *parent;
+    struct save_branch_info *info;
     struct unicode_str name;
     const struct security_descriptor *sd;
     const struct object_attributes *objattr = get_req_object_attributes( &sd, &name, NULL );
@@ -2222,6 +3618,9 @@ DECL_HANDLER(load_registry)
         if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, sd, &dummy )))
         {
             load_registry( key, req->file );
+            /* the loaded keys aren't in the journal, the whole branch has to be saved */
+            if (use_journal && (info = get_key_branch( key ))) info->journal_error = 1;
+            registry_changed();
             release_object( key );
         }
         release_object( parent );
@@ -2256,9 +3655,16 @@ DECL_HANDLER(save_registry)
         return;
     }
 
+    if (req->format != REG_STANDARD_FORMAT && req->format != REG_LATEST_FORMAT &&
+        req->format != REG_NO_COMPRESSION)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+
     if ((key = get_hkey_obj( req->hkey, 0 )))
     {
-        save_registry( key, req->file );
+        save_registry( key, req->file, req->format );
         release_object( key );
     }
 }
@@ -2308,3 +3714,25 @@ DECL_HANDLER(set_registry_notification)
         release_object( key );
     }
 }
+
+/* retrieve the registry shared memory */
+DECL_HANDLER(get_registry_shm)
+{
+    void *ptr;
+
+    if (registry_shm_fd == -1)
+    {
+        if ((registry_shm_fd = create_temp_file( sizeof(*registry_shm) )) == -1) return;
+        ptr = mmap( NULL, sizeof(*registry_shm), PROT_READ | PROT_WRITE, MAP_SHARED, registry_shm_fd, 0 );
+        if (ptr == MAP_FAILED)
+        {
+            file_set_error();
+            close( registry_shm_fd );
+            registry_shm_fd = -1;
+            return;
+        }
+        registry_shm = ptr;
+    }
+    reply->size = sizeof(*registry_shm);
+    send_client_fd( current->process, registry_shm_fd, 0 );
+}
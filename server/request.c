@@ -35,6 +35,9 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
@@ -47,6 +50,9 @@
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 #include <unistd.h>
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -123,8 +129,8 @@ static const struct fd_ops master_socket_fd_ops =
 };
 
 
-struct thread *current = NULL;  /* thread handling the current request */
-unsigned int global_error = 0;  /* global error code for when no thread is current */
+SERVER_THREAD_LOCAL struct thread *current = NULL;  /* thread handling the current request */
+SERVER_THREAD_LOCAL unsigned int global_error = 0;  /* global error code for when no thread is current */
 timeout_t server_start_time = 0;  /* server startup time */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
 int config_dir_fd = -1;    /* file descriptor for the config dir */
@@ -132,6 +138,11 @@ int config_dir_fd = -1;    /* file descriptor for the config dir */
 static struct master_socket *master_socket;  /* the master socket object */
 static struct timeout_user *master_timeout;
 
+/* request data copied out of the shared memory, so that the client can't modify it under us */
+static SERVER_THREAD_LOCAL char shm_req_data[REQUEST_SHM_DATA_SIZE];
+
+C_ASSERT( sizeof(union generic_reply) == sizeof(((struct request_shm *)0)->reply) );
+
 /* complain about a protocol error and terminate the client connection */
 void fatal_protocol_error( struct thread *thread, const char *err, ... )
 {
@@ -157,11 +168,18 @@ void fatal_error( const char *err, ... )
     exit(1);
 }
 
+/* check if the current request has been passed through the shared memory */
+static inline int is_shm_request( struct thread *thread )
+{
+    return thread->req_data == shm_req_data;
+}
+
 /* allocate the reply data */
 void *set_reply_data_size( data_size_t size )
 {
     assert( size <= get_reply_max_size() );
-    if (size && !(current->reply_data = mem_alloc( size ))) size = 0;
+    if (size && is_shm_request( current )) current->reply_data = current->request_shm->reply_data;
+    else if (size && !(current->reply_data = mem_alloc( size ))) size = 0;
     current->reply_size = size;
     return current->reply_data;
 }
@@ -268,6 +286,11 @@ static void send_reply( union generic_reply *reply )
         if ((current->reply_towrite = current->reply_size - (ret - sizeof(*reply))))
         {
             /* couldn't write it all, wait for POLLOUT */
+            if (in_worker_thread)
+            {
+                defer_worker_request( current, 0 );
+                return;
+            }
             set_fd_events( current->reply_fd, POLLOUT );
             set_fd_events( current->request_fd, 0 );
             return;
@@ -278,7 +301,9 @@ static void send_reply( union generic_reply *reply )
     return;
 
  error:
-    if (ret >= 0)
+    if (in_worker_thread)  /* let the main loop deal with it */
+        defer_worker_request( current, ret >= 0 ? EIO : errno );
+    else if (ret >= 0)
         fatal_protocol_error( current, "partial write %d\n", ret );
     else if (errno == EPIPE)
         kill_thread( current, 0 );  /* normal death */
@@ -286,11 +311,70 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+#ifdef __linux__
+
+static inline int futex_wake( int *addr, int count )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+}
+
+static int futexes_supported(void)
+{
+    int dummy = 0;
+
+    return syscall( __NR_futex, &dummy, 0 /* FUTEX_WAIT */, 1, NULL, 0, 0 ) != -1 || errno != ENOSYS;
+}
+
+#else
+
+static inline int futex_wake( int *addr, int count )
+{
+    return 0;
+}
+
+static int futexes_supported(void)
+{
+    return 0;
+}
+
+#endif
+
+/* check if shared memory requests are enabled */
+static int use_request_shm(void)
+{
+    static int enabled = -1;
+    const char *env;
+
+    if (enabled == -1)
+        enabled = (env = getenv( "WINESHMREQUESTS" )) && atoi( env ) && futexes_supported();
+    return enabled;
+}
+
+/* send a reply through the shared memory of the current thread */
+static void send_shm_reply( union generic_reply *reply )
+{
+    struct request_shm *shm = current->request_shm;
+
+    if (current->reply_data != shm->reply_data)
+    {
+        memcpy( shm->reply_data, current->reply_data, current->reply_size );
+        free( current->reply_data );
+    }
+    current->reply_data = NULL;
+    memcpy( shm->reply, reply, sizeof(*reply) );
+
+    /* the client only needs a wake up if it gave up spinning */
+    if (interlocked_xchg( &shm->state, REQUEST_SHM_REPLIED ) == REQUEST_SHM_SLEEPING)
+        futex_wake( &shm->state, 1 );
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    data_size_t request_size = thread->req.request_header.request_size;
+    unsigned __int64 start = profile_start();
 
     current = thread;
     current->reply_size = 0;
@@ -311,7 +395,8 @@ static void call_req_handler( struct thread *thread )
             reply.reply_header.error = current->error;
             reply.reply_header.reply_size = current->reply_size;
             if (debug_level) trace_reply( req, &reply );
-            send_reply( &reply );
+            if (is_shm_request( current )) send_shm_reply( &reply );
+            else send_reply( &reply );
         }
         else
         {
@@ -319,22 +404,64 @@ static void call_req_handler( struct thread *thread )
             kill_thread( current, 1 );  /* no way to continue without reply fd */
         }
     }
+    /* the handler may have released the thread, only current can still be used */
+    if (start) profile_request( req, start, request_size, current ? current->reply_size : 0 );
     current = NULL;
 }
 
+/* handle a request whose data has been passed through the shared memory */
+static void read_shm_request( struct thread *thread )
+{
+    data_size_t size = thread->req.request_header.request_size;
+
+    if (size > REQUEST_SHM_DATA_SIZE || thread->req.request_header.reply_size > REQUEST_SHM_DATA_SIZE)
+    {
+        fatal_protocol_error( thread, "shared memory request %d too large\n",
+                              thread->req.request_header.req );
+        return;
+    }
+    if (queue_worker_request( thread, WORKER_QUEUED_SHM )) return;
+    memcpy( shm_req_data, thread->request_shm->req_data, size );
+    thread->req_data = shm_req_data;
+    call_req_handler( thread );
+    thread->req_data = NULL;
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
     int ret;
 
+    if (thread->worker_state != WORKER_IDLE)
+    {
+        fatal_protocol_error( thread, "request %d sent while another one is being handled\n",
+                              thread->req.request_header.req );
+        return;
+    }
+
     if (!thread->req_toread)  /* no pending request */
     {
         if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
                          sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        /* the header is still written to the pipe, to wake us up; the state in the
+         * shared memory can be changed by the client, so it can't tell us the request type */
+        if (thread->req.request_header.req & REQUEST_SHM_FLAG)
+        {
+            thread->req.request_header.req &= ~REQUEST_SHM_FLAG;
+            if (!thread->request_shm || thread->request_shm->state == REQUEST_SHM_IDLE ||
+                thread->request_shm->state == REQUEST_SHM_REPLIED)
+            {
+                fatal_protocol_error( thread, "shared memory request %d not posted\n",
+                                      thread->req.request_header.req );
+                return;
+            }
+            read_shm_request( thread );
+            return;
+        }
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
-            call_req_handler( thread );
+            if (!queue_worker_request( thread, WORKER_QUEUED )) call_req_handler( thread );
             return;
         }
         if (!(thread->req_data = malloc( thread->req_toread )))
@@ -355,6 +482,7 @@ void read_request( struct thread *thread )
         if (ret <= 0) break;
         if (!(thread->req_toread -= ret))
         {
+            if (queue_worker_request( thread, WORKER_QUEUED )) return;  /* the worker frees the data */
             call_req_handler( thread );
             free( thread->req_data );
             thread->req_data = NULL;
@@ -371,6 +499,55 @@ error:
         fatal_protocol_error( thread, "read: %s\n", strerror( errno ));
 }
 
+/* handle a request queued for a worker thread; called with the server lock held for reading */
+void handle_worker_request( struct thread *thread )
+{
+    if (thread->worker_state == WORKER_QUEUED_SHM)
+    {
+        memcpy( shm_req_data, thread->request_shm->req_data, thread->req.request_header.request_size );
+        thread->req_data = shm_req_data;
+        call_req_handler( thread );
+        thread->req_data = NULL;
+    }
+    else
+    {
+        call_req_handler( thread );
+        free( thread->req_data );
+        thread->req_data = NULL;
+    }
+}
+
+/* handle in the main loop a reply that a worker thread couldn't send */
+void finish_worker_request( struct thread *thread )
+{
+    if (!thread->worker_error)
+    {
+        /* couldn't write it all, wait for POLLOUT */
+        set_fd_events( thread->reply_fd, POLLOUT );
+        set_fd_events( thread->request_fd, 0 );
+    }
+    else if (thread->worker_error == EPIPE)
+        kill_thread( thread, 0 );  /* normal death */
+    else
+        fatal_protocol_error( thread, "reply write: %s\n", strerror( thread->worker_error ));
+}
+
+/* detach a dead thread from its shared memory; it stays mapped until the thread is destroyed,
+ * since the request being handled may still write its reply data */
+void cleanup_request_shm( struct thread *thread )
+{
+    if (!thread->request_shm) return;
+    if (is_shm_request( thread )) thread->req_data = NULL;
+    if (thread->reply_data == thread->request_shm->reply_data) thread->reply_data = NULL;
+}
+
+void free_request_shm( struct thread *thread )
+{
+    if (!thread->request_shm) return;
+    munmap( thread->request_shm, sizeof(*thread->request_shm) );
+    thread->request_shm = NULL;
+}
+
 /* receive a file descriptor on the process socket */
 int receive_fd( struct process *process )
 {
@@ -497,6 +674,9 @@ int send_client_fd( struct process *process, int fd, obj_handle_t handle )
 
     if (ret == sizeof(handle)) return 0;
 
+    /* worker threads can't kill the process, the main loop will notice the broken socket */
+    if (in_worker_thread) return -1;
+
     if (ret >= 0)
     {
         fprintf( stderr, "Protocol error: process %04x: partial sendmsg %d\n", process->id, ret );
@@ -897,3 +1077,33 @@ void close_master_socket( timeout_t timeout )
 
     master_timeout = add_timeout_user( timeout, close_socket_timeout, NULL );
 }
+
+
+/* retrieve the shared memory used to exchange requests with the current thread */
+DECL_HANDLER(get_request_shm)
+{
+    void *ptr;
+    int fd;
+
+    if (!use_request_shm())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    if (current->request_shm)
+    {
+        set_error( STATUS_ACCESS_DENIED );
+        return;
+    }
+    if ((fd = create_temp_file( sizeof(*current->request_shm) )) == -1) return;
+
+    ptr = mmap( NULL, sizeof(*current->request_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (ptr != MAP_FAILED)
+    {
+        current->request_shm = ptr;
+        reply->size = sizeof(*current->request_shm);
+        send_client_fd( current->process, fd, 0 );
+    }
+    else file_set_error();
+    close( fd );
+}
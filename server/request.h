@@ -54,6 +54,8 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern void cleanup_request_shm( struct thread *thread );
+extern void free_request_shm( struct thread *thread );
 extern unsigned int get_tick_count(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
@@ -64,6 +66,49 @@ extern int server_dir_fd, config_dir_fd;
 
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_request_name( enum request req );
+
+/* profiling functions */
+
+enum profile_loop_part
+{
+    PROFILE_LOOP_WAIT,      /* waiting for fd events */
+    PROFILE_LOOP_DISPATCH,  /* handling fd events */
+    PROFILE_LOOP_TIMEOUT    /* processing timeouts */
+};
+
+extern int profile_enabled;
+extern void init_profile(void);
+extern unsigned __int64 profile_get_time(void);
+extern void profile_request( enum request req, unsigned __int64 start,
+                             data_size_t bytes_in, data_size_t bytes_out );
+extern unsigned __int64 profile_loop( enum profile_loop_part part, unsigned __int64 start );
+
+/* start timing a profiled section; returns 0 if profiling is disabled */
+static inline unsigned __int64 profile_start(void)
+{
+    return profile_enabled ? profile_get_time() : 0;
+}
+
+/* worker thread functions */
+
+enum worker_state
+{
+    WORKER_IDLE,            /* no request handed to a worker */
+    WORKER_QUEUED,          /* request queued for a worker thread */
+    WORKER_QUEUED_SHM,      /* request queued, data still in the shared memory */
+    WORKER_DEFERRED         /* reply failed, waiting for the main loop to handle it */
+};
+
+extern SERVER_THREAD_LOCAL int in_worker_thread;
+extern void init_workers(void);
+extern void lock_server(void);
+extern void unlock_server(void);
+extern int queue_worker_request( struct thread *thread, enum worker_state state );
+extern void defer_worker_request( struct thread *thread, int error );
+extern void cancel_worker_request( struct thread *thread );
+extern void handle_worker_request( struct thread *thread );
+extern void finish_worker_request( struct thread *thread );
 
 /* get the request vararg data */
 static inline const void *get_req_data(void)
@@ -214,6 +259,7 @@ DECL_HANDLER(debug_break);
 DECL_HANDLER(set_debugger_kill_on_exit);
 DECL_HANDLER(read_process_memory);
 DECL_HANDLER(write_process_memory);
+DECL_HANDLER(get_process_vm_pid);
 DECL_HANDLER(create_key);
 DECL_HANDLER(open_key);
 DECL_HANDLER(delete_key);
@@ -261,6 +307,7 @@ DECL_HANDLER(get_serial_info);
 DECL_HANDLER(set_serial_info);
 DECL_HANDLER(register_async);
 DECL_HANDLER(cancel_async);
+DECL_HANDLER(complete_socket_asyncs);
 DECL_HANDLER(get_async_result);
 DECL_HANDLER(read);
 DECL_HANDLER(write);
@@ -380,9 +427,11 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
+DECL_HANDLER(set_fd_completion_mode);
 DECL_HANDLER(set_fd_disp_info);
 DECL_HANDLER(set_fd_name_info);
 DECL_HANDLER(get_window_layered_info);
@@ -400,6 +449,17 @@ DECL_HANDLER(process_in_job);
 DECL_HANDLER(set_job_limits);
 DECL_HANDLER(set_job_completion_port);
 DECL_HANDLER(terminate_job);
+DECL_HANDLER(get_fsync_shm);
+DECL_HANDLER(get_fsync_idx);
+DECL_HANDLER(fsync_wake);
+DECL_HANDLER(get_fsync_apc_idx);
+DECL_HANDLER(fsync_own_mutex);
+DECL_HANDLER(get_request_shm);
+DECL_HANDLER(get_server_profile);
+DECL_HANDLER(get_registry_shm);
+DECL_HANDLER(get_image_reloc_fd);
+DECL_HANDLER(get_prefetch_list);
+DECL_HANDLER(set_prefetch_list);
 
 #ifdef WANT_REQUEST_HANDLERS
 
@@ -508,6 +568,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_debugger_kill_on_exit,
     (req_handler)req_read_process_memory,
     (req_handler)req_write_process_memory,
+    (req_handler)req_get_process_vm_pid,
     (req_handler)req_create_key,
     (req_handler)req_open_key,
     (req_handler)req_delete_key,
@@ -555,6 +616,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_serial_info,
     (req_handler)req_register_async,
     (req_handler)req_cancel_async,
+    (req_handler)req_complete_socket_asyncs,
     (req_handler)req_get_async_result,
     (req_handler)req_read,
     (req_handler)req_write,
@@ -674,9 +736,11 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
+    (req_handler)req_set_fd_completion_mode,
     (req_handler)req_set_fd_disp_info,
     (req_handler)req_set_fd_name_info,
     (req_handler)req_get_window_layered_info,
@@ -694,6 +758,17 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_job_limits,
     (req_handler)req_set_job_completion_port,
     (req_handler)req_terminate_job,
+    (req_handler)req_get_fsync_shm,
+    (req_handler)req_get_fsync_idx,
+    (req_handler)req_fsync_wake,
+    (req_handler)req_get_fsync_apc_idx,
+    (req_handler)req_fsync_own_mutex,
+    (req_handler)req_get_request_shm,
+    (req_handler)req_get_server_profile,
+    (req_handler)req_get_registry_shm,
+    (req_handler)req_get_image_reloc_fd,
+    (req_handler)req_get_prefetch_list,
+    (req_handler)req_set_prefetch_list,
 };
 
 C_ASSERT( sizeof(affinity_t) == 8 );
@@ -1023,7 +1098,8 @@ C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, cacheable) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, options) == 20 );
-C_ASSERT( sizeof(struct get_handle_fd_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, comp_flags) == 24 );
+C_ASSERT( sizeof(struct get_handle_fd_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_directory_cache_entry_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_reply, entry) == 8 );
@@ -1274,7 +1350,8 @@ C_ASSERT( sizeof(struct get_mapping_info_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, size) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, flags) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, shared_file) == 20 );
-C_ASSERT( sizeof(struct get_mapping_info_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_mapping_info_reply, reloc_base) == 24 );
+C_ASSERT( sizeof(struct get_mapping_info_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct map_view_request, mapping) == 12 );
 C_ASSERT( FIELD_OFFSET(struct map_view_request, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct map_view_request, base) == 24 );
@@ -1359,6 +1436,11 @@ C_ASSERT( sizeof(struct read_process_memory_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct write_process_memory_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct write_process_memory_request, addr) == 16 );
 C_ASSERT( sizeof(struct write_process_memory_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_process_vm_pid_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_process_vm_pid_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_process_vm_pid_reply, unix_pid) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_process_vm_pid_reply, access) == 12 );
+C_ASSERT( sizeof(struct get_process_vm_pid_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_key_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_key_request, options) == 16 );
 C_ASSERT( sizeof(struct create_key_request) == 24 );
@@ -1414,6 +1496,7 @@ C_ASSERT( FIELD_OFFSET(struct unload_registry_request, hkey) == 12 );
 C_ASSERT( sizeof(struct unload_registry_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct save_registry_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct save_registry_request, file) == 16 );
+C_ASSERT( FIELD_OFFSET(struct save_registry_request, format) == 20 );
 C_ASSERT( sizeof(struct save_registry_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_registry_notification_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_registry_notification_request, event) == 16 );
@@ -1600,6 +1683,10 @@ C_ASSERT( FIELD_OFFSET(struct cancel_async_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct cancel_async_request, iosb) == 16 );
 C_ASSERT( FIELD_OFFSET(struct cancel_async_request, only_thread) == 24 );
 C_ASSERT( sizeof(struct cancel_async_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_asyncs_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_asyncs_request, type) == 16 );
+C_ASSERT( sizeof(struct complete_socket_asyncs_request) == 24 );
+C_ASSERT( sizeof(struct complete_socket_asyncs_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_async_result_request, user_arg) == 16 );
 C_ASSERT( sizeof(struct get_async_result_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct get_async_result_reply, size) == 8 );
@@ -2301,6 +2388,10 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_reply, count) == 8 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -2313,7 +2404,13 @@ C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, status) == 32 );
+C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, async) == 36 );
 C_ASSERT( sizeof(struct add_fd_completion_request) == 40 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, flags) == 16 );
+C_ASSERT( sizeof(struct set_fd_completion_mode_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_reply, flags) == 8 );
+C_ASSERT( sizeof(struct set_fd_completion_mode_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_disp_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_disp_info_request, unlink) == 16 );
 C_ASSERT( sizeof(struct set_fd_disp_info_request) == 24 );
@@ -2384,6 +2481,41 @@ C_ASSERT( sizeof(struct set_job_completion_port_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct terminate_job_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_job_request, status) == 16 );
 C_ASSERT( sizeof(struct terminate_job_request) == 24 );
+C_ASSERT( sizeof(struct get_fsync_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_fsync_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fsync_idx_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_reply, type) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_reply, idx) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_reply, access) == 16 );
+C_ASSERT( sizeof(struct get_fsync_idx_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct fsync_wake_request, handle) == 12 );
+C_ASSERT( sizeof(struct fsync_wake_request) == 16 );
+C_ASSERT( sizeof(struct get_fsync_apc_idx_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_apc_idx_reply, idx) == 8 );
+C_ASSERT( sizeof(struct get_fsync_apc_idx_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct fsync_own_mutex_request, handle) == 12 );
+C_ASSERT( sizeof(struct fsync_own_mutex_request) == 16 );
+C_ASSERT( sizeof(struct get_request_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_request_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_profile_request, flags) == 12 );
+C_ASSERT( sizeof(struct get_server_profile_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_profile_reply, enabled) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_server_profile_reply, total) == 12 );
+C_ASSERT( sizeof(struct get_server_profile_reply) == 16 );
+C_ASSERT( sizeof(struct get_registry_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_registry_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_registry_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_image_reloc_fd_request, mapping) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_image_reloc_fd_request, base) == 16 );
+C_ASSERT( sizeof(struct get_image_reloc_fd_request) == 24 );
+C_ASSERT( sizeof(struct get_prefetch_list_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_prefetch_list_reply, total) == 8 );
+C_ASSERT( sizeof(struct get_prefetch_list_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_prefetch_list_request, exe_len) == 12 );
+C_ASSERT( sizeof(struct set_prefetch_list_request) == 16 );
 
 #endif  /* WANT_REQUEST_HANDLERS */
 
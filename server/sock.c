@@ -1322,6 +1322,46 @@ DECL_HANDLER(enable_socket_event)
     release_object( &sock->obj );
 }
 
+/* complete pending asyncs whose I/O the client has carried out in a batch */
+DECL_HANDLER(complete_socket_asyncs)
+{
+    const async_result_t *results = get_req_data();
+    data_size_t i, count = get_req_data_size() / sizeof(*results);
+    struct async_queue *queue;
+    unsigned int access;
+    struct sock *sock;
+    char *completed;
+
+    switch (req->type)
+    {
+    case ASYNC_TYPE_READ:
+        access = FILE_READ_DATA;
+        break;
+    case ASYNC_TYPE_WRITE:
+        access = FILE_WRITE_DATA;
+        break;
+    default:
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+
+    if (!(sock = (struct sock *)get_handle_obj( current->process, req->handle, access, &sock_ops )))
+        return;
+
+    queue = req->type == ASYNC_TYPE_READ ? &sock->read_q : &sock->write_q;
+    if ((completed = set_reply_data_size( min( count, get_reply_max_size() ))))
+    {
+        for (i = 0; i < count; i++)
+        {
+            int done = results[i].status != STATUS_PENDING &&
+                       async_complete_queued( queue, current->process, results[i].user,
+                                              results[i].status, results[i].total );
+            if (i < get_reply_max_size()) completed[i] = done;
+        }
+    }
+    release_object( &sock->obj );
+}
+
 DECL_HANDLER(set_socket_deferred)
 {
     struct sock *sock, *acceptsock;
@@ -51,6 +51,7 @@
 #include "request.h"
 #include "user.h"
 #include "security.h"
+#include "fsync.h"
 
 
 #ifdef __i386__
@@ -199,6 +200,10 @@ static inline void init_thread_structure( struct thread *thread )
     thread->suspend         = 0;
     thread->desktop_users   = 0;
     thread->token           = NULL;
+    thread->fsync_apc_idx   = 0;
+    thread->request_shm     = NULL;
+    thread->worker_state    = WORKER_IDLE;
+    thread->worker_error    = 0;
 
     thread->creation_time = current_time;
     thread->exit_time     = 0;
@@ -244,6 +249,8 @@ struct thread *create_thread( int fd, struct process *process )
 
     list_add_head( &thread_list, &thread->entry );
 
+    thread->fsync_apc_idx = fsync_alloc( 0, 0 );
+
     if (!(thread->id = alloc_ptid( thread )))
     {
         close( fd );
@@ -282,6 +289,8 @@ static void cleanup_thread( struct thread *thread )
 
     clear_apc_queue( &thread->system_apc );
     clear_apc_queue( &thread->user_apc );
+    cancel_worker_request( thread );
+    cleanup_request_shm( thread );
     free( thread->req_data );
     free( thread->reply_data );
     if (thread->request_fd) release_object( thread->request_fd );
@@ -322,6 +331,8 @@ static void destroy_thread( struct object *obj )
     release_object( thread->process );
     if (thread->id) free_ptid( thread->id );
     if (thread->token) release_object( thread->token );
+    fsync_free( thread->fsync_apc_idx );
+    free_request_shm( thread );
 }
 
 /* dump a thread on stdout for debugging purposes */
@@ -921,6 +932,16 @@ static inline int is_in_apc_wait( struct thread *thread )
             (thread->wait && (thread->wait->flags & SELECT_INTERRUPTIBLE)));
 }
 
+/* reflect the state of the user APC queue in the shared entry used by client-side waits */
+static void update_fsync_apc( struct thread *thread )
+{
+    int pending = !list_empty( &thread->user_apc );
+
+    if (!thread->fsync_apc_idx) return;
+    if (interlocked_xchg( &fsync_get_entry( thread->fsync_apc_idx )->state, pending ) != pending && pending)
+        fsync_wake_futex( thread->fsync_apc_idx );
+}
+
 /* queue an existing APC to a given thread */
 static int queue_apc( struct process *process, struct thread *thread, struct thread_apc *apc )
 {
@@ -974,7 +995,10 @@ static int queue_apc( struct process *process, struct thread *thread, struct thr
     grab_object( apc );
     list_add_tail( queue, &apc->entry );
     if (!list_prev( queue, &apc->entry ))  /* first one */
+    {
+        if (queue == &thread->user_apc) update_fsync_apc( thread );
         wake_thread( thread );
+    }
 
     return 1;
 }
@@ -1006,6 +1030,7 @@ void thread_cancel_apc( struct thread *thread, struct object *owner, enum apc_ty
         apc->executed = 1;
         wake_up( &apc->obj, 0 );
         release_object( apc );
+        update_fsync_apc( thread );
         return;
     }
 }
@@ -1022,6 +1047,7 @@ static struct thread_apc *thread_dequeue_apc( struct thread *thread, int system_
         apc = LIST_ENTRY( ptr, struct thread_apc, entry );
         list_remove( ptr );
     }
+    if (ptr) update_fsync_apc( thread );
     return apc;
 }
 
@@ -89,6 +89,11 @@ struct thread
     timeout_t              creation_time; /* Thread creation time */
     timeout_t              exit_time;     /* Thread exit time */
     struct token          *token;         /* security token associated with this thread */
+    unsigned int           fsync_apc_idx; /* shared entry signaling pending user APCs */
+    struct request_shm    *request_shm;   /* shared memory for small requests */
+    struct list            worker_entry;  /* entry in the worker thread queues */
+    int                    worker_state;  /* state of a request handed to a worker thread */
+    int                    worker_error;  /* reply error to be handled by the main loop */
 };
 
 struct thread_snapshot
@@ -98,7 +103,7 @@ struct thread_snapshot
     int             priority;  /* priority class */
 };
 
-extern struct thread *current;
+extern SERVER_THREAD_LOCAL struct thread *current;
 
 /* thread functions */
 
@@ -139,7 +144,7 @@ extern int send_thread_signal( struct thread *thread, int sig );
 extern void get_selector_entry( struct thread *thread, int entry, unsigned int *base,
                                 unsigned int *limit, unsigned char *flags );
 
-extern unsigned int global_error;  /* global error code for when no thread is current */
+extern SERVER_THREAD_LOCAL unsigned int global_error;  /* global error code for when no thread is current */
 
 static inline unsigned int get_error(void)       { return current ? current->error : global_error; }
 static inline void set_error( unsigned int err ) { global_error = err; if (current) current->error = err; }
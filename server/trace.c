@@ -504,6 +504,24 @@ static void dump_varargs_user_handles( const char *prefix, data_size_t size )
     remove_data( size );
 }
 
+static void dump_varargs_async_results( const char *prefix, data_size_t size )
+{
+    const async_result_t *result = cur_data;
+    data_size_t len = size / sizeof(*result);
+
+    fprintf( stderr, "%s{", prefix );
+    while (len > 0)
+    {
+        dump_uint64( "{user=", &result->user );
+        dump_uint64( ",total=", &result->total );
+        fprintf( stderr, ",status=%s}", get_status_name( result->status ));
+        result++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_bytes( const char *prefix, data_size_t size )
 {
     const unsigned char *data = cur_data;
@@ -1206,6 +1224,52 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_completion_msgs( const char *prefix, data_size_t size )
+{
+    const struct completion_msg *msg;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*msg))
+    {
+        msg = cur_data;
+        dump_uint64( "{ckey=", &msg->ckey );
+        dump_uint64( ",cvalue=", &msg->cvalue );
+        dump_uint64( ",information=", &msg->information );
+        fprintf( stderr, ",status=%s}", get_status_name( msg->status ) );
+        size -= sizeof(*msg);
+        remove_data( sizeof(*msg) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
+static void dump_varargs_server_profile( const char *prefix, data_size_t size )
+{
+    const struct server_profile *profile = cur_data;
+    const struct request_profile *req;
+
+    if (size < sizeof(*profile))
+    {
+        fprintf( stderr, "%s{}", prefix );
+        return;
+    }
+    dump_uint64( prefix, &profile->elapsed );
+    fprintf( stderr, ",loops=%u,requests=%u", profile->loops, profile->count );
+    size -= sizeof(*profile);
+    remove_data( sizeof(*profile) );
+
+    fputc( '{', stderr );
+    while (size >= sizeof(*req))
+    {
+        req = cur_data;
+        fprintf( stderr, "{%.*s,count=%u}", (int)sizeof(req->name), req->name, req->count );
+        size -= sizeof(*req);
+        remove_data( sizeof(*req) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -1785,6 +1849,7 @@ static void dump_get_handle_fd_reply( const struct get_handle_fd_reply *req )
     fprintf( stderr, ", cacheable=%d", req->cacheable );
     fprintf( stderr, ", access=%08x", req->access );
     fprintf( stderr, ", options=%08x", req->options );
+    fprintf( stderr, ", comp_flags=%08x", req->comp_flags );
 }
 
 static void dump_get_directory_cache_entry_request( const struct get_directory_cache_entry_request *req )
@@ -2248,6 +2313,7 @@ static void dump_get_mapping_info_reply( const struct get_mapping_info_reply *re
     dump_uint64( " size=", &req->size );
     fprintf( stderr, ", flags=%08x", req->flags );
     fprintf( stderr, ", shared_file=%04x", req->shared_file );
+    dump_uint64( ", reloc_base=", &req->reloc_base );
     dump_varargs_pe_image_info( ", image=", cur_size );
 }
 
@@ -2420,6 +2486,17 @@ static void dump_write_process_memory_request( const struct write_process_memory
     dump_varargs_bytes( ", data=", cur_size );
 }
 
+static void dump_get_process_vm_pid_request( const struct get_process_vm_pid_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_process_vm_pid_reply( const struct get_process_vm_pid_reply *req )
+{
+    fprintf( stderr, " unix_pid=%d", req->unix_pid );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
 static void dump_create_key_request( const struct create_key_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2538,6 +2615,7 @@ static void dump_save_registry_request( const struct save_registry_request *req
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
     fprintf( stderr, ", file=%04x", req->file );
+    fprintf( stderr, ", format=%08x", req->format );
 }
 
 static void dump_set_registry_notification_request( const struct set_registry_notification_request *req )
@@ -2908,6 +2986,18 @@ static void dump_cancel_async_request( const struct cancel_async_request *req )
     fprintf( stderr, ", only_thread=%d", req->only_thread );
 }
 
+static void dump_complete_socket_asyncs_request( const struct complete_socket_asyncs_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", type=%d", req->type );
+    dump_varargs_async_results( ", results=", cur_size );
+}
+
+static void dump_complete_socket_asyncs_reply( const struct complete_socket_asyncs_reply *req )
+{
+    dump_varargs_bytes( " completed=", cur_size );
+}
+
 static void dump_get_async_result_request( const struct get_async_result_request *req )
 {
     dump_uint64( " user_arg=", &req->user_arg );
@@ -4326,6 +4416,17 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_completion_msgs( ", msgs=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4349,6 +4450,18 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     dump_uint64( ", cvalue=", &req->cvalue );
     dump_uint64( ", information=", &req->information );
     fprintf( stderr, ", status=%08x", req->status );
+    fprintf( stderr, ", async=%d", req->async );
+}
+
+static void dump_set_fd_completion_mode_request( const struct set_fd_completion_mode_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", flags=%08x", req->flags );
+}
+
+static void dump_set_fd_completion_mode_reply( const struct set_fd_completion_mode_reply *req )
+{
+    fprintf( stderr, " flags=%08x", req->flags );
 }
 
 static void dump_set_fd_disp_info_request( const struct set_fd_disp_info_request *req )
@@ -4496,6 +4609,100 @@ static void dump_terminate_job_request( const struct terminate_job_request *req
     fprintf( stderr, ", status=%d", req->status );
 }
 
+static void dump_get_fsync_shm_request( const struct get_fsync_shm_request *req )
+{
+}
+
+static void dump_get_fsync_shm_reply( const struct get_fsync_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_fsync_idx_request( const struct get_fsync_idx_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fsync_idx_reply( const struct get_fsync_idx_reply *req )
+{
+    fprintf( stderr, " type=%d", req->type );
+    fprintf( stderr, ", idx=%08x", req->idx );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_fsync_wake_request( const struct fsync_wake_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fsync_apc_idx_request( const struct get_fsync_apc_idx_request *req )
+{
+}
+
+static void dump_get_fsync_apc_idx_reply( const struct get_fsync_apc_idx_reply *req )
+{
+    fprintf( stderr, " idx=%08x", req->idx );
+}
+
+static void dump_fsync_own_mutex_request( const struct fsync_own_mutex_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_request_shm_request( const struct get_request_shm_request *req )
+{
+}
+
+static void dump_get_request_shm_reply( const struct get_request_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_server_profile_request( const struct get_server_profile_request *req )
+{
+    fprintf( stderr, " flags=%08x", req->flags );
+}
+
+static void dump_get_server_profile_reply( const struct get_server_profile_reply *req )
+{
+    fprintf( stderr, " enabled=%d", req->enabled );
+    fprintf( stderr, ", total=%u", req->total );
+    dump_varargs_server_profile( ", profile=", cur_size );
+}
+
+static void dump_get_registry_shm_request( const struct get_registry_shm_request *req )
+{
+}
+
+static void dump_get_registry_shm_reply( const struct get_registry_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_image_reloc_fd_request( const struct get_image_reloc_fd_request *req )
+{
+    fprintf( stderr, " mapping=%04x", req->mapping );
+    dump_uint64( ", base=", &req->base );
+}
+
+static void dump_get_prefetch_list_request( const struct get_prefetch_list_request *req )
+{
+    dump_varargs_unicode_str( " exe=", cur_size );
+}
+
+static void dump_get_prefetch_list_reply( const struct get_prefetch_list_reply *req )
+{
+    fprintf( stderr, " total=%u", req->total );
+    dump_varargs_bytes( ", files=", cur_size );
+}
+
+static void dump_set_prefetch_list_request( const struct set_prefetch_list_request *req )
+{
+    fprintf( stderr, " exe_len=%u", req->exe_len );
+    dump_varargs_unicode_str( ", exe=", min(cur_size,req->exe_len) );
+    dump_varargs_bytes( ", files=", cur_size );
+}
+
 static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_new_process_request,
     (dump_func)dump_get_new_process_info_request,
@@ -4599,6 +4806,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_debugger_kill_on_exit_request,
     (dump_func)dump_read_process_memory_request,
     (dump_func)dump_write_process_memory_request,
+    (dump_func)dump_get_process_vm_pid_request,
     (dump_func)dump_create_key_request,
     (dump_func)dump_open_key_request,
     (dump_func)dump_delete_key_request,
@@ -4646,6 +4854,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_serial_info_request,
     (dump_func)dump_register_async_request,
     (dump_func)dump_cancel_async_request,
+    (dump_func)dump_complete_socket_asyncs_request,
     (dump_func)dump_get_async_result_request,
     (dump_func)dump_read_request,
     (dump_func)dump_write_request,
@@ -4765,9 +4974,11 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
+    (dump_func)dump_set_fd_completion_mode_request,
     (dump_func)dump_set_fd_disp_info_request,
     (dump_func)dump_set_fd_name_info_request,
     (dump_func)dump_get_window_layered_info_request,
@@ -4785,6 +4996,17 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_job_limits_request,
     (dump_func)dump_set_job_completion_port_request,
     (dump_func)dump_terminate_job_request,
+    (dump_func)dump_get_fsync_shm_request,
+    (dump_func)dump_get_fsync_idx_request,
+    (dump_func)dump_fsync_wake_request,
+    (dump_func)dump_get_fsync_apc_idx_request,
+    (dump_func)dump_fsync_own_mutex_request,
+    (dump_func)dump_get_request_shm_request,
+    (dump_func)dump_get_server_profile_request,
+    (dump_func)dump_get_registry_shm_request,
+    (dump_func)dump_get_image_reloc_fd_request,
+    (dump_func)dump_get_prefetch_list_request,
+    (dump_func)dump_set_prefetch_list_request,
 };
 
 static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
@@ -4890,6 +5112,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_read_process_memory_reply,
     NULL,
+    (dump_func)dump_get_process_vm_pid_reply,
     (dump_func)dump_create_key_reply,
     (dump_func)dump_open_key_reply,
     NULL,
@@ -4937,6 +5160,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     NULL,
     NULL,
+    (dump_func)dump_complete_socket_asyncs_reply,
     (dump_func)dump_get_async_result_reply,
     (dump_func)dump_read_reply,
     (dump_func)dump_write_reply,
@@ -5056,9 +5280,11 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
+    (dump_func)dump_set_fd_completion_mode_reply,
     NULL,
     NULL,
     (dump_func)dump_get_window_layered_info_reply,
@@ -5076,6 +5302,17 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     NULL,
     NULL,
+    (dump_func)dump_get_fsync_shm_reply,
+    (dump_func)dump_get_fsync_idx_reply,
+    NULL,
+    (dump_func)dump_get_fsync_apc_idx_reply,
+    NULL,
+    (dump_func)dump_get_request_shm_reply,
+    (dump_func)dump_get_server_profile_reply,
+    (dump_func)dump_get_registry_shm_reply,
+    NULL,
+    (dump_func)dump_get_prefetch_list_reply,
+    NULL,
 };
 
 static const char * const req_names[REQ_NB_REQUESTS] = {
@@ -5181,6 +5418,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_debugger_kill_on_exit",
     "read_process_memory",
     "write_process_memory",
+    "get_process_vm_pid",
     "create_key",
     "open_key",
     "delete_key",
@@ -5228,6 +5466,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_serial_info",
     "register_async",
     "cancel_async",
+    "complete_socket_asyncs",
     "get_async_result",
     "read",
     "write",
@@ -5347,9 +5586,11 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
+    "set_fd_completion_mode",
     "set_fd_disp_info",
     "set_fd_name_info",
     "get_window_layered_info",
@@ -5367,6 +5608,17 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_job_limits",
     "set_job_completion_port",
     "terminate_job",
+    "get_fsync_shm",
+    "get_fsync_idx",
+    "fsync_wake",
+    "get_fsync_apc_idx",
+    "fsync_own_mutex",
+    "get_request_shm",
+    "get_server_profile",
+    "get_registry_shm",
+    "get_image_reloc_fd",
+    "get_prefetch_list",
+    "set_prefetch_list",
 };
 
 static const struct
@@ -5477,6 +5729,7 @@ static const struct
     { "PROCESS_IN_JOB",              STATUS_PROCESS_IN_JOB },
     { "PROCESS_IS_TERMINATING",      STATUS_PROCESS_IS_TERMINATING },
     { "PROCESS_NOT_IN_JOB",          STATUS_PROCESS_NOT_IN_JOB },
+    { "REGISTRY_IO_FAILED",          STATUS_REGISTRY_IO_FAILED },
     { "SECTION_TOO_BIG",             STATUS_SECTION_TOO_BIG },
     { "SEMAPHORE_LIMIT_EXCEEDED",    STATUS_SEMAPHORE_LIMIT_EXCEEDED },
     { "SHARING_VIOLATION",           STATUS_SHARING_VIOLATION },
@@ -5510,6 +5763,11 @@ static const char *get_status_name( unsigned int status )
     return buffer;
 }
 
+const char *get_request_name( enum request req )
+{
+    return req < REQ_NB_REQUESTS ? req_names[req] : NULL;
+}
+
 void trace_request(void)
 {
     enum request req = current->req.request_header.req;
@@ -0,0 +1,339 @@
+/*
+ * Server worker threads
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Requests that only look at the server state can be handled by a pool of
+ * worker threads, in parallel with each other.  All the server state is
+ * protected by a single read/write lock: the main loop holds it for writing
+ * except while it waits for events, and the workers hold it for reading while
+ * they handle a request.  This makes the handle tables, the object namespaces
+ * and the registry safe to look up from the workers, as long as the handlers
+ * neither create nor destroy anything; object reference counts are updated
+ * atomically.
+ *
+ * A worker can't touch the main loop state, so a reply that can't be sent
+ * at once is handed back to the main loop through a pipe.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "thread.h"
+#include "request.h"
+
+#define MAX_WORKER_THREADS 64
+
+int worker_threads = 0;                        /* number of worker threads */
+SERVER_THREAD_LOCAL int in_worker_thread = 0;  /* is the current thread a worker? */
+
+#ifdef USE_WORKER_THREADS
+
+struct worker_pipe
+{
+    struct object    obj;         /* object header */
+    struct fd       *fd;          /* file descriptor for the pipe read side */
+    int              pipe_write;  /* unix fd for the pipe write side */
+};
+
+static void worker_pipe_dump( struct object *obj, int verbose );
+static void worker_pipe_destroy( struct object *obj );
+
+static const struct object_ops worker_pipe_ops =
+{
+    sizeof(struct worker_pipe),   /* size */
+    worker_pipe_dump,             /* dump */
+    no_get_type,                  /* get_type */
+    no_add_queue,                 /* add_queue */
+    NULL,                         /* remove_queue */
+    NULL,                         /* signaled */
+    NULL,                         /* satisfied */
+    no_signal,                    /* signal */
+    no_get_fd,                    /* get_fd */
+    no_map_access,                /* map_access */
+    default_get_sd,               /* get_sd */
+    default_set_sd,               /* set_sd */
+    no_lookup_name,               /* lookup_name */
+    no_link_name,                 /* link_name */
+    NULL,                         /* unlink_name */
+    no_open_file,                 /* open_file */
+    no_close_handle,              /* close_handle */
+    worker_pipe_destroy           /* destroy */
+};
+
+static void worker_pipe_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops worker_pipe_fd_ops =
+{
+    NULL,                         /* get_poll_events */
+    worker_pipe_poll_event,       /* poll_event */
+    NULL,                         /* flush */
+    NULL,                         /* get_fd_type */
+    NULL,                         /* ioctl */
+    NULL,                         /* queue_async */
+    NULL                          /* reselect_async */
+};
+
+static pthread_rwlock_t server_lock;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static struct list request_queue = LIST_INIT( request_queue );  /* threads waiting for a worker */
+static struct list deferred_queue = LIST_INIT( deferred_queue );  /* threads waiting for the main loop */
+static int deferred_pending;  /* has the main loop been woken up already? */
+static struct worker_pipe *worker_pipe;
+
+/* check if a request can be handled by a worker thread */
+static int is_worker_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_get_handle_fd:
+    case REQ_enum_key:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void worker_pipe_dump( struct object *obj, int verbose )
+{
+    struct worker_pipe *wpipe = (struct worker_pipe *)obj;
+    fprintf( stderr, "Worker pipe fd=%p\n", wpipe->fd );
+}
+
+static void worker_pipe_destroy( struct object *obj )
+{
+    struct worker_pipe *wpipe = (struct worker_pipe *)obj;
+    if (wpipe->fd) release_object( wpipe->fd );
+    close( wpipe->pipe_write );
+}
+
+/* handle the replies that the workers handed back to the main loop */
+static void worker_pipe_poll_event( struct fd *fd, int event )
+{
+    struct thread *thread;
+    struct list *ptr;
+    char dummy;
+
+    if (event & (POLLERR | POLLHUP))
+    {
+        /* this is not supposed to happen */
+        fatal_error( "error on worker pipe\n" );
+    }
+    read( get_unix_fd( fd ), &dummy, 1 );
+
+    pthread_mutex_lock( &queue_mutex );
+    deferred_pending = 0;
+    while ((ptr = list_head( &deferred_queue )))
+    {
+        list_remove( ptr );
+        thread = LIST_ENTRY( ptr, struct thread, worker_entry );
+        thread->worker_state = WORKER_IDLE;
+        pthread_mutex_unlock( &queue_mutex );
+        finish_worker_request( thread );
+        pthread_mutex_lock( &queue_mutex );
+    }
+    pthread_mutex_unlock( &queue_mutex );
+}
+
+static void *worker_thread_proc( void *arg )
+{
+    struct thread *thread;
+    struct list *ptr;
+
+    in_worker_thread = 1;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &queue_mutex );
+        while (list_empty( &request_queue )) pthread_cond_wait( &queue_cond, &queue_mutex );
+        pthread_mutex_unlock( &queue_mutex );
+
+        /* the request is only removed from the queue once the lock is held,
+         * so that the main loop can't free the thread under us */
+        pthread_rwlock_rdlock( &server_lock );
+        pthread_mutex_lock( &queue_mutex );
+        if ((ptr = list_head( &request_queue ))) list_remove( ptr );
+        pthread_mutex_unlock( &queue_mutex );
+
+        if (ptr)
+        {
+            thread = LIST_ENTRY( ptr, struct thread, worker_entry );
+            handle_worker_request( thread );
+            if (thread->worker_state != WORKER_DEFERRED) thread->worker_state = WORKER_IDLE;
+        }
+        pthread_rwlock_unlock( &server_lock );
+    }
+    return NULL;
+}
+
+/* create the pipe used to wake up the main loop */
+static struct worker_pipe *create_worker_pipe(void)
+{
+    struct worker_pipe *wpipe;
+    int fd[2];
+
+    if (pipe( fd ) == -1) return NULL;
+    if (!(wpipe = alloc_object( &worker_pipe_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        return NULL;
+    }
+    wpipe->pipe_write = fd[1];
+    if (!(wpipe->fd = create_anonymous_fd( &worker_pipe_fd_ops, fd[0], &wpipe->obj, 0 )))
+    {
+        release_object( wpipe );
+        return NULL;
+    }
+    set_fd_events( wpipe->fd, POLLIN );
+    make_object_static( &wpipe->obj );
+    return wpipe;
+}
+
+/* start the worker threads if enabled */
+void init_workers(void)
+{
+    pthread_t id;
+    sigset_t set, old_set;
+    const char *env;
+    int i, count;
+
+    if (!(env = getenv( "WINESERVERTHREADS" )) || (count = atoi( env )) <= 0) return;
+    if (count > MAX_WORKER_THREADS) count = MAX_WORKER_THREADS;
+
+    /* readers are preferred, the queue can only grow while the main loop owns the lock */
+    pthread_rwlock_init( &server_lock, NULL );
+
+    if (!(worker_pipe = create_worker_pipe())) return;
+
+    /* signals are handled by the main thread */
+    sigfillset( &set );
+    pthread_sigmask( SIG_BLOCK, &set, &old_set );
+    for (i = 0; i < count; i++)
+    {
+        if (pthread_create( &id, NULL, worker_thread_proc, NULL )) break;
+        pthread_detach( id );
+    }
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+
+    if (!i) fprintf( stderr, "wineserver: failed to create worker threads\n" );
+    worker_threads = i;
+    /* the main loop owns the lock except while it waits for events */
+    lock_server();
+}
+
+/* acquire the server lock for the main loop */
+void lock_server(void)
+{
+    if (worker_threads) pthread_rwlock_wrlock( &server_lock );
+}
+
+void unlock_server(void)
+{
+    if (worker_threads) pthread_rwlock_unlock( &server_lock );
+}
+
+/* queue the current request of a thread for a worker, if it can be handled there */
+int queue_worker_request( struct thread *thread, enum worker_state state )
+{
+    if (!worker_threads || debug_level) return 0;  /* tracing is not thread-safe */
+    if (!thread->reply_fd || !is_worker_request( thread->req.request_header.req )) return 0;
+
+    thread->worker_state = state;
+    pthread_mutex_lock( &queue_mutex );
+    list_add_tail( &request_queue, &thread->worker_entry );
+    pthread_cond_signal( &queue_cond );
+    pthread_mutex_unlock( &queue_mutex );
+    return 1;
+}
+
+/* hand a reply that couldn't be sent back to the main loop; called from a worker */
+void defer_worker_request( struct thread *thread, int error )
+{
+    char dummy = 0;
+    int wake;
+
+    thread->worker_state = WORKER_DEFERRED;
+    thread->worker_error = error;
+    pthread_mutex_lock( &queue_mutex );
+    list_add_tail( &deferred_queue, &thread->worker_entry );
+    wake = !deferred_pending;
+    deferred_pending = 1;
+    pthread_mutex_unlock( &queue_mutex );
+    if (wake) write( worker_pipe->pipe_write, &dummy, 1 );
+}
+
+/* remove a dying thread from the worker queues */
+void cancel_worker_request( struct thread *thread )
+{
+    if (thread->worker_state == WORKER_IDLE) return;
+
+    pthread_mutex_lock( &queue_mutex );
+    list_remove( &thread->worker_entry );
+    pthread_mutex_unlock( &queue_mutex );
+    thread->worker_state = WORKER_IDLE;
+}
+
+#else  /* USE_WORKER_THREADS */
+
+void init_workers(void)
+{
+}
+
+void lock_server(void)
+{
+}
+
+void unlock_server(void)
+{
+}
+
+int queue_worker_request( struct thread *thread, enum worker_state state )
+{
+    return 0;
+}
+
+void defer_worker_request( struct thread *thread, int error )
+{
+}
+
+void cancel_worker_request( struct thread *thread )
+{
+}
+
+#endif  /* USE_WORKER_THREADS */